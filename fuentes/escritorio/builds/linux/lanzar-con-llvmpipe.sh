@@ -0,0 +1,3 @@
+export LIBGL_ALWAYS_SOFTWARE=1
+export GALLIUM_DRIVER=llvmpipe
+./bin/debug_exe $1
@@ -0,0 +1,492 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Almacén de geometría compartido por varios VAOs (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Implementación de las clases
+// **
+// **  + AsignadorRangos:   asignador de rangos libres dentro de un buffer
+// **  + AlmacenGeometria:  buffers de atributos e índices compartidos, con
+// **                       dibujo de lotes de regiones con una única llamada
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cstddef>   // offsetof
+#include <numeric>   // std::iota
+#include "aplic-3d.h"
+#include "almacen-geom.h"
+#include "vaos-vbos.h"
+
+// número de flotantes por vértice en cada tabla de atributos (posiciones, colores, coords. de textura, normales)
+constexpr GLint num_flotantes_atrib[numero_atributos_cauce_3d] = { 3, 3, 2, 3 } ;
+
+// capacidad inicial de los buffers (en vértices y en índices)
+constexpr GLuint capacidad_inicial_vertices = 1 << 16 ,
+                 capacidad_inicial_indices  = 1 << 18 ;
+
+// máscara con los bits de las columnas de las matrices por instancia (4 de la de modelado y 3 de la de normales)
+constexpr unsigned mascara_matrices = 0x7Fu << ind_atrib_mat_instancia ;
+
+// matrices de cada dibujo del lote, entrelazadas en el buffer de matrices (la de las normales 
+// se calcula en la CPU una vez por dibujo, en lugar de en el vertex shader en cada vértice)
+struct MatricesDibujo
+{
+   glm::mat4 modelado ;
+   glm::mat3 normales ;
+} ;
+
+// ------------------------------------------------------------------------------------------------------
+// Comando de dibujo indexado indirecto (formato fijado por OpenGL para 'glMultiDrawElementsIndirect')
+
+struct ComandoDibujoIndirecto
+{
+   GLuint count ;
+   GLuint instanceCount ;
+   GLuint firstIndex ;
+   GLint  baseVertex ;
+   GLuint baseInstance ;
+} ;
+
+// ------------------------------------------------------------------------------------------------------
+// Crea un buffer de 'tam_nuevo' bytes con una copia de los 'tam_actual' primeros bytes de 'buffer'
+// (si no es 0), elimina 'buffer' y devuelve el nuevo (se usan los 'targets' de copia, así no cambia
+// el estado de ningún VAO). Las regiones se escriben después con 'glBufferSubData' (al reservarlas
+// y reutilizarlas), así que el buffer se crea como dinámico
+
+static GLuint CopiarEnBufferAmpliado( const GLuint buffer, const GLsizeiptr tam_actual, const GLsizeiptr tam_nuevo )
+{
+   assert( tam_actual < tam_nuevo );
+   GLuint nuevo = 0 ;
+   glGenBuffers( 1, &nuevo ); assert( 0 < nuevo );
+   glBindBuffer( GL_COPY_WRITE_BUFFER, nuevo );
+   glBufferData( GL_COPY_WRITE_BUFFER, tam_nuevo, nullptr, GL_DYNAMIC_DRAW );
+
+   if ( buffer != 0 )
+   {
+      glBindBuffer( GL_COPY_READ_BUFFER, buffer );
+      if ( tam_actual > 0 )
+         glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, tam_actual );
+      glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+      glDeleteBuffers( 1, &buffer );
+   }
+   glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+   return nuevo ;
+}
+
+// ******************************************************************************************************
+// Clase AsignadorRangos
+// ------------------------------------------------------------------------------------------------------
+
+AsignadorRangos::AsignadorRangos( const GLuint p_capacidad )
+{
+   capacidad = p_capacidad ;
+   if ( capacidad > 0 )
+      libres[0] = capacidad ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool AsignadorRangos::reservar( const GLuint num, GLuint & inicio )
+{
+   assert( 0 < num );
+
+   for( auto it = libres.begin() ; it != libres.end() ; it++ )
+   {
+      if ( it->second < num )
+         continue ;
+
+      // usar el principio del rango libre, si sobra algo queda libre
+      inicio = it->first ;
+      const GLuint resto = it->second - num ;
+      libres.erase( it );
+      if ( resto > 0 )
+         libres[inicio+num] = resto ;
+      num_ocupadas += num ;
+      return true ;
+   }
+   return false ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AsignadorRangos::liberar( const GLuint inicio, const GLuint num )
+{
+   assert( 0 < num && inicio+num <= capacidad );
+   assert( num <= num_ocupadas );
+
+   num_ocupadas -= num ;
+   insertarLibre( inicio, num );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AsignadorRangos::ampliar( const GLuint nueva_capacidad )
+{
+   assert( capacidad < nueva_capacidad );
+
+   const GLuint anterior = capacidad ;
+   capacidad = nueva_capacidad ;
+   insertarLibre( anterior, nueva_capacidad - anterior );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AsignadorRangos::insertarLibre( const GLuint inicio, const GLuint num )
+{
+   GLuint ini = inicio,
+          n   = num ;
+
+   // fusionar con el rango libre siguiente, si empieza justo al final de este
+   auto sig = libres.lower_bound( ini );
+   assert( sig == libres.end() || ini+n <= sig->first ); // no puede solaparse con el siguiente
+   if ( sig != libres.end() && sig->first == ini+n )
+   {  n += sig->second ;
+      sig = libres.erase( sig );
+   }
+
+   // fusionar con el rango libre anterior, si acaba justo al principio de este
+   if ( sig != libres.begin() )
+   {
+      auto ant = std::prev( sig );
+      assert( ant->first + ant->second <= ini ); // no puede solaparse con el anterior
+      if ( ant->first + ant->second == ini )
+      {  ant->second += n ;
+         return ;
+      }
+   }
+   libres[ini] = n ;
+}
+
+// ******************************************************************************************************
+// Clase AlmacenGeometria
+// ------------------------------------------------------------------------------------------------------
+
+AlmacenGeometria * AlmacenGeometria::instancia_actual = nullptr ;
+
+// ------------------------------------------------------------------------------------------------------
+
+AlmacenGeometria * AlmacenGeometria::instancia()
+{
+   if ( instancia_actual == nullptr )
+      instancia_actual = new AlmacenGeometria();
+   return instancia_actual ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+AlmacenGeometria::AlmacenGeometria()
+{
+   using namespace std ;
+   CError();
+
+   // el dibujo de un lote con una llamada requiere 'glMultiDrawElementsIndirect' (OpenGL 4.3),
+   // que no está disponible en macOS
+#ifndef __APPLE__
+   GLint major = 0, minor = 0 ;
+   glGetIntegerv( GL_MAJOR_VERSION, &major );
+   glGetIntegerv( GL_MINOR_VERSION, &minor );
+   dibujo_indirecto = major > 4 || ( major == 4 && minor >= 3 );
+#endif
+
+   // crear el VAO y los buffers vacíos (las tablas de atributos se registran al ampliarlos)
+   glGenVertexArrays( 1, &array ); assert( 0 < array );
+   ampliarVertices( capacidad_inicial_vertices );
+   ampliarIndices( capacidad_inicial_indices );
+
+   // registrar las columnas de las matrices por instancia (inicialmente con matrices identidad,
+   // para que el buffer nunca esté vacío)
+   const MatricesDibujo identidad = { glm::mat4( 1.0f ), glm::mat3( 1.0f ) };
+   glGenBuffers( 1, &buffer_matrices ); assert( 0 < buffer_matrices );
+   glGenBuffers( 1, &buffer_comandos ); assert( 0 < buffer_comandos );
+
+   glBindVertexArray( array );
+   glBindBuffer( GL_ARRAY_BUFFER, buffer_matrices );
+   glBufferData( GL_ARRAY_BUFFER, sizeof( MatricesDibujo ), &identidad, GL_STREAM_DRAW );
+   for( GLuint c = 0 ; c < 4 ; c++ )
+   {  glVertexAttribPointer( ind_atrib_mat_instancia+c, 4, GL_FLOAT, GL_FALSE, sizeof( MatricesDibujo ),
+                            (void *)( offsetof( MatricesDibujo, modelado ) + c*sizeof( glm::vec4 )) );
+      glVertexAttribDivisor( ind_atrib_mat_instancia+c, 1 );
+   }
+   for( GLuint c = 0 ; c < 3 ; c++ )
+   {  glVertexAttribPointer( ind_atrib_mat_nor_instancia+c, 3, GL_FLOAT, GL_FALSE, sizeof( MatricesDibujo ),
+                            (void *)( offsetof( MatricesDibujo, normales ) + c*sizeof( glm::vec3 )) );
+      glVertexAttribDivisor( ind_atrib_mat_nor_instancia+c, 1 );
+   }
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
+   glBindVertexArray( 0 );
+   CError();
+
+   cout << "Almacén de geometría creado (dibujo de lotes "
+        << (dibujo_indirecto ? "con 'glMultiDrawElementsIndirect'" : "región a región") << ")." << endl ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::ampliarVertices( const GLuint nueva_capacidad )
+{
+   CError();
+   const GLuint capacidad = vertices.leerCapacidad() ;
+
+   // copiar cada tabla en un buffer más grande y registrarlo en el VAO
+   glBindVertexArray( array );
+   for( GLuint i = 0 ; i < numero_atributos_cauce_3d ; i++ )
+   {
+      const GLsizeiptr tam_vert = num_flotantes_atrib[i]*sizeof( float );
+      buffers_atrib[i] = CopiarEnBufferAmpliado( buffers_atrib[i], capacidad*tam_vert, nueva_capacidad*tam_vert );
+      glBindBuffer( GL_ARRAY_BUFFER, buffers_atrib[i] );
+      glVertexAttribPointer( i, num_flotantes_atrib[i], GL_FLOAT, GL_FALSE, 0, 0 );
+   }
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
+   glBindVertexArray( 0 );
+
+   vertices.ampliar( nueva_capacidad );
+   CError();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::ampliarIndices( const GLuint nueva_capacidad )
+{
+   CError();
+   const GLuint capacidad = indices.leerCapacidad() ;
+
+   // el buffer de índices activo es parte del estado del VAO
+   buffer_indices = CopiarEnBufferAmpliado( buffer_indices, capacidad*sizeof( GLuint ),
+                                            nueva_capacidad*sizeof( GLuint ) );
+   glBindVertexArray( array );
+   glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffer_indices );
+   glBindVertexArray( 0 );
+
+   indices.ampliar( nueva_capacidad );
+   CError();
+}
+// ------------------------------------------------------------------------------------------------------
+
+RegionAlmacenGeom AlmacenGeometria::reservar( const GLuint num_vertices, const glm::vec3 * posiciones,
+                                              const glm::vec3 * colores, const glm::vec2 * coord_text,
+                                              const glm::vec3 * normales,
+                                              const GLuint num_indices, const GLuint * indices_region )
+{
+   CError();
+   assert( 0 < num_vertices && posiciones != nullptr );
+   assert( 0 < num_indices  && indices_region != nullptr );
+
+   RegionAlmacenGeom region ;
+   region.num_vertices = num_vertices ;
+   region.num_indices  = num_indices ;
+
+   // reservar los rangos, ampliando los buffers (al doble) hasta que quepan
+   while( ! vertices.reservar( num_vertices, region.primer_vertice ) )
+      ampliarVertices( std::max( 2*vertices.leerCapacidad(), vertices.leerCapacidad()+num_vertices ) );
+   while( ! indices.reservar( num_indices, region.primer_indice ) )
+      ampliarIndices( std::max( 2*indices.leerCapacidad(), indices.leerCapacidad()+num_indices ) );
+
+   // copiar las tablas en los buffers (con los 'targets' de copia, para no cambiar el estado del VAO)
+   const void * tablas[numero_atributos_cauce_3d] = { posiciones, colores, coord_text, normales };
+   for( GLuint i = 0 ; i < numero_atributos_cauce_3d ; i++ )
+   {
+      if ( tablas[i] == nullptr )
+         continue ;
+      const GLsizeiptr tam_vert = num_flotantes_atrib[i]*sizeof( float );
+      glBindBuffer( GL_COPY_WRITE_BUFFER, buffers_atrib[i] );
+      glBufferSubData( GL_COPY_WRITE_BUFFER, region.primer_vertice*tam_vert, num_vertices*tam_vert, tablas[i] );
+      DescrVAO::contadores.bytes_subidos += num_vertices*tam_vert ;
+      region.mascara_atribs |= 1u << i ;
+   }
+   glBindBuffer( GL_COPY_WRITE_BUFFER, buffer_indices );
+   glBufferSubData( GL_COPY_WRITE_BUFFER, region.primer_indice*sizeof( GLuint ), num_indices*sizeof( GLuint ),
+                    indices_region );
+   glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+   DescrVAO::contadores.bytes_subidos += num_indices*sizeof( GLuint );
+
+   CError();
+   return region ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::liberar( const RegionAlmacenGeom & region )
+{
+   vertices.liberar( region.primer_vertice, region.num_vertices );
+   indices.liberar( region.primer_indice, region.num_indices );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::fijarMascara( const unsigned mascara )
+{
+   assert( (mascara & 1u) != 0 ); // las posiciones siempre están habilitadas
+
+   const unsigned cambios = mascara ^ mascara_habilitados ;
+   for( GLuint i = 0 ; i < numero_atributos_cauce_3d_inst ; i++ )
+      if ( cambios & (1u << i) )
+      {
+         if ( mascara & (1u << i) )
+            glEnableVertexAttribArray( i );
+         else
+            glDisableVertexAttribArray( i );
+      }
+   mascara_habilitados = mascara ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::dibujar( const RegionAlmacenGeom & region, const GLenum mode, const unsigned mascara,
+                                const GLuint inicio, const GLuint num )
+{
+   CError();
+   assert( inicio + num <= region.num_indices );
+
+   glBindVertexArray( array );
+   fijarMascara( mascara & region.mascara_atribs & ~mascara_matrices );
+   glDrawElementsBaseVertex( mode, num, GL_UNSIGNED_INT,
+                             (void *)( (region.primer_indice + inicio)*sizeof( GLuint ) ),
+                             region.primer_vertice );
+   DescrVAO::contadores.binds_vao++ ;
+   DescrVAO::contarDibujo( mode, num );
+   CError();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::agregarAlLote( const RegionAlmacenGeom & region, const glm::mat4 & matriz,
+                                      const unsigned mascara )
+{
+   lote_dibujos.push_back( { .region = region, .mascara = mascara & region.mascara_atribs } );
+   lote_matrices.push_back( matriz );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::dibujarLote( const GLenum mode )
+{
+   using namespace std ;
+   CError();
+
+   const unsigned n = lote_dibujos.size() ;
+   if ( n == 0 )
+      return ;
+
+   Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+   assert( cauce != nullptr );
+
+   // igual que en 'DescrVAO', si hay teselación los triángulos se envían como parches
+   GLenum draw_mode = mode ;
+   if ( SustituirTriangulosPorParches() )
+   {
+      assert( mode == GL_TRIANGLES );
+      draw_mode = GL_PATCHES ;
+      glPatchParameteri( GL_PATCH_VERTICES, 3 );
+   }
+
+   // las posiciones del almacén no están cuantizadas (el último VAO dibujado puede estarlo)
+   cauce->fijarDecodPosiciones( false, glm::vec3( 1.0f ), glm::vec3( 0.0f ) );
+
+   if ( ! dibujo_indirecto )
+   {
+      // sin dibujo indirecto, cada región se dibuja con su matriz compuesta con la del cauce
+      for( unsigned i = 0 ; i < n ; i++ )
+      {
+         cauce->pushMM();
+         cauce->compMM( lote_matrices[i] );
+         dibujar( lote_dibujos[i].region, draw_mode, lote_dibujos[i].mascara, 0, lote_dibujos[i].region.num_indices );
+         cauce->popMM();
+      }
+   }
+#ifndef __APPLE__
+   else
+   {
+      // ordenar los dibujos según las tablas de atributos que usan
+      vector<unsigned> orden( n );
+      iota( orden.begin(), orden.end(), 0 );
+      stable_sort( orden.begin(), orden.end(), [&]( unsigned a, unsigned b )
+                   { return lote_dibujos[a].mascara < lote_dibujos[b].mascara ; } );
+
+      // preparar las matrices y los comandos (el dibujo 'k' usa la matriz 'k', como instancia base)
+      vector<MatricesDibujo>         matrices( n );
+      vector<ComandoDibujoIndirecto> comandos( n );
+      for( unsigned k = 0 ; k < n ; k++ )
+      {
+         const RegionAlmacenGeom & region = lote_dibujos[orden[k]].region ;
+         matrices[k] = { .modelado = lote_matrices[orden[k]], 
+                         .normales = glm::transpose( glm::inverse( glm::mat3( lote_matrices[orden[k]] ))) };
+         comandos[k] = { .count         = region.num_indices,
+                         .instanceCount = 1,
+                         .firstIndex    = region.primer_indice,
+                         .baseVertex    = GLint( region.primer_vertice ),
+                         .baseInstance  = k };
+      }
+
+      // enviar las matrices y los comandos (se sustituyen los datos del lote anterior)
+      glBindVertexArray( array );
+      glBindBuffer( GL_ARRAY_BUFFER, buffer_matrices );
+      glBufferData( GL_ARRAY_BUFFER, n*sizeof( MatricesDibujo ), matrices.data(), GL_STREAM_DRAW );
+      glBindBuffer( GL_ARRAY_BUFFER, 0 );
+      glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffer_comandos );
+      glBufferData( GL_DRAW_INDIRECT_BUFFER, n*sizeof( ComandoDibujoIndirecto ), comandos.data(), GL_STREAM_DRAW );
+      DescrVAO::contadores.binds_vao++ ;
+      DescrVAO::contadores.bytes_subidos += n*( sizeof( MatricesDibujo ) + sizeof( ComandoDibujoIndirecto ) );
+
+      // una llamada por cada grupo de dibujos consecutivos con las mismas tablas
+      cauce->fijarUsarInstancias( true );
+      unsigned k0 = 0 ;
+      while( k0 < n )
+      {
+         const unsigned mascara = lote_dibujos[orden[k0]].mascara ;
+         unsigned k1 = k0+1 ;
+         while( k1 < n && lote_dibujos[orden[k1]].mascara == mascara )
+            k1++ ;
+         fijarMascara( mascara | mascara_matrices );
+         glMultiDrawElementsIndirect( draw_mode, GL_UNSIGNED_INT, (void *)( k0*sizeof( ComandoDibujoIndirecto )),
+                                      k1-k0, 0 );
+
+         // (se cuenta como una llamada, con los triángulos y vértices de todos los comandos)
+         uint64_t num_indices = 0 ;
+         for( unsigned k = k0 ; k < k1 ; k++ )
+            num_indices += comandos[k].count ;
+         DescrVAO::contarDibujo( draw_mode, num_indices );
+         k0 = k1 ;
+      }
+      cauce->fijarUsarInstancias( false );
+
+      glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+   }
+#endif
+
+   glBindVertexArray( 0 );
+   lote_dibujos.clear();
+   lote_matrices.clear();
+   CError();
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::size_t AlmacenGeometria::bytesRegion( const RegionAlmacenGeom & region )
+{
+   std::size_t bytes_vertice = 0 ;
+   for( GLuint i = 0 ; i < numero_atributos_cauce_3d ; i++ )
+      bytes_vertice += num_flotantes_atrib[i]*sizeof( float );
+   return region.num_vertices*bytes_vertice + region.num_indices*sizeof( GLuint );
+}
+// ------------------------------------------------------------------------------------------------------
+
+UsoMemoria AlmacenGeometria::leerUsoMemoria() const 
+{
+   const RegionAlmacenGeom todo = { .num_vertices = vertices.leerCapacidad(), 
+                                    .num_indices  = indices.leerCapacidad() };
+   UsoMemoria uso ;
+   uso.gpu_buffers = bytesRegion( todo );  // (no incluye los buffers de matrices y comandos del lote, que son pequeños)
+   uso.cpu_tablas  = lote_matrices.capacity()*sizeof( glm::mat4 ) + lote_dibujos.capacity()*sizeof( DibujoLote );
+   return uso ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void AlmacenGeometria::imprimirOcupacion() const
+{
+   using namespace std ;
+   cout << "Almacén de geometría: "
+        << vertices.leerNumOcupadas() << "/" << vertices.leerCapacidad() << " vértices, "
+        << indices.leerNumOcupadas()  << "/" << indices.leerCapacidad()  << " índices ocupados." << endl ;
+}
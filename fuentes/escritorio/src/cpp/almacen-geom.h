@@ -0,0 +1,183 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Almacén de geometría compartido por varios VAOs (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de las clases
+// **
+// **  + AsignadorRangos:   asignador de rangos libres dentro de un buffer
+// **  + AlmacenGeometria:  buffers de atributos e índices compartidos, con
+// **                       dibujo de lotes de regiones con una única llamada
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "utilidades.h"
+#include "cauce-3d.h"
+#include "uso-memoria.h"
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Asignador de rangos de posiciones consecutivas dentro de un buffer de capacidad dada
+/// @brief (guarda la lista de rangos libres ordenados por su primera posición, reserva en el primero
+/// @brief en el que cabe y, al liberar, fusiona el rango con los libres adyacentes)
+///
+class AsignadorRangos
+{
+   public:
+
+   /// @brief Crea un asignador con todas las posiciones libres
+   AsignadorRangos( const GLuint p_capacidad = 0 );
+
+   /// @brief Busca un rango libre con 'num' posiciones (num > 0), si lo hay lo marca como ocupado,
+   /// @brief escribe su primera posición en 'inicio' y devuelve true (si no lo hay, devuelve false)
+   bool reservar( const GLuint num, GLuint & inicio );
+
+   /// @brief Libera el rango de 'num' posiciones que empieza en 'inicio' (debe estar reservado)
+   void liberar( const GLuint inicio, const GLuint num );
+
+   /// @brief Aumenta la capacidad (las posiciones nuevas quedan libres)
+   void ampliar( const GLuint nueva_capacidad );
+
+   GLuint leerCapacidad()   const { return capacidad ; }
+   GLuint leerNumOcupadas() const { return num_ocupadas ; }
+
+   private:
+
+   // añade un rango a la lista de libres, fusionándolo con los adyacentes
+   void insertarLibre( const GLuint inicio, const GLuint num );
+
+   GLuint capacidad    = 0 ,
+          num_ocupadas = 0 ;
+   std::map<GLuint,GLuint> libres ; // rangos libres: primera posición --> número de posiciones
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Región del almacén de geometría ocupada por una secuencia indexada (los índices son
+/// @brief relativos al primer vértice de la región)
+///
+struct RegionAlmacenGeom
+{
+   GLuint   primer_vertice = 0 ,
+            num_vertices   = 0 ;
+   GLuint   primer_indice  = 0 ,
+            num_indices    = 0 ;
+   unsigned mascara_atribs = 0 ; // bit 'i' a 1 si la región tiene la tabla del atributo 'i'
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Almacén de geometría: un VAO con un buffer grande por cada atributo (posiciones, colores,
+/// @brief coordenadas de textura y normales, todos con flotantes) y otro de índices (enteros de 32 bits),
+/// @brief en los que se reservan regiones para las secuencias de muchos objetos (los buffers se amplían
+/// @brief al doble cuando no cabe una región).
+///
+/// @brief Las regiones se pueden dibujar una a una, o agruparlas en un lote (cada una con su matriz de
+/// @brief modelado) y dibujar todo el lote con una llamada a 'glMultiDrawElementsIndirect'. La matriz de
+/// @brief cada dibujo (y la de sus normales) se lee de los atributos por instancia 'ind_atrib_mat_instancia'
+/// @brief y 'ind_atrib_mat_nor_instancia', usando como instancia base el índice del dibujo en el lote. Si no hay OpenGL 4.3, el lote se dibuja región a región.
+///
+class AlmacenGeometria
+{
+   public:
+
+   /// @brief Devuelve el almacén de la aplicación (lo crea la primera vez, requiere un contexto OpenGL)
+   static AlmacenGeometria * instancia() ;
+
+   /// @brief Devuelve true si los lotes se dibujan con una sola llamada (requiere OpenGL 4.3)
+   bool dibujoIndirecto() const { return dibujo_indirecto ; }
+
+   /// @brief Reserva una región y copia en ella las tablas (las que no son nulas, excepto las
+   /// @brief posiciones y los índices, que no pueden ser nulas), devuelve la región
+   ///
+   RegionAlmacenGeom reservar( const GLuint num_vertices, const glm::vec3 * posiciones,
+                               const glm::vec3 * colores, const glm::vec2 * coord_text,
+                               const glm::vec3 * normales,
+                               const GLuint num_indices, const GLuint * indices );
+
+   /// @brief Libera una región reservada con 'reservar'
+   void liberar( const RegionAlmacenGeom & region );
+
+   /// @brief Dibuja los índices de la región en el rango [inicio,inicio+num), con las tablas de atributos
+   /// @brief indicadas en 'mascara' (si la región las tiene), deja activado el VAO del almacén
+   ///
+   void dibujar( const RegionAlmacenGeom & region, const GLenum mode, const unsigned mascara,
+                 const GLuint inicio, const GLuint num );
+
+   /// @brief Añade al lote actual un dibujo de la región, con la matriz de modelado 'matriz' (que se
+   /// @brief compone con la del cauce al dibujar el lote) y las tablas de atributos en 'mascara'
+   ///
+   void agregarAlLote( const RegionAlmacenGeom & region, const glm::mat4 & matriz, const unsigned mascara );
+
+   /// @brief Dibuja todas las regiones del lote y lo deja vacío (los dibujos con las mismas tablas
+   /// @brief de atributos se envían con una única llamada, si el cauce usa teselación, 'mode' debe
+   /// @brief ser GL_TRIANGLES y se envían parches)
+   ///
+   void dibujarLote( const GLenum mode );
+
+   /// @brief Imprime en 'cout' la ocupación de los buffers
+   void imprimirOcupacion() const ;
+
+   /// @brief Devuelve true si ya se ha creado el almacén (así se puede consultar sin crearlo)
+   static bool creado() { return instancia_actual != nullptr ; }
+
+   /// @brief Devuelve los bytes que ocupa una región en los buffers del almacén (todas las regiones 
+   /// @brief ocupan sitio en los buffers de todos los atributos, los tengan o no)
+   static std::size_t bytesRegion( const RegionAlmacenGeom & region );
+
+   /// @brief Devuelve la memoria que ocupan en la GPU los buffers del almacén (su capacidad, 
+   /// @brief incluyendo la parte libre)
+   UsoMemoria leerUsoMemoria() const ;
+
+   private:
+
+   AlmacenGeometria() ;
+
+   // amplía los buffers de atributos o de índices (copia el contenido en buffers nuevos más grandes)
+   void ampliarVertices( const GLuint nueva_capacidad );
+   void ampliarIndices( const GLuint nueva_capacidad );
+
+   // habilita las tablas con el bit a 1 en 'mascara' y deshabilita el resto (el VAO debe estar activado)
+   void fijarMascara( const unsigned mascara );
+
+   // objetos OpenGL (VAO y buffers)
+   GLuint array          = 0 ,
+          buffer_indices  = 0 ,
+          buffer_matrices = 0 , // matrices de los dibujos del lote (atributo por instancia)
+          buffer_comandos = 0 ; // comandos de dibujo indirecto del lote
+   GLuint buffers_atrib[numero_atributos_cauce_3d] = { 0, 0, 0, 0 } ;
+
+   AsignadorRangos vertices, indices ;  // ocupación de los buffers de atributos y de índices
+   unsigned mascara_habilitados = 0 ;   // tablas habilitadas actualmente en el VAO
+   bool     dibujo_indirecto    = false ;
+
+   // dibujos añadidos al lote actual (región, tablas de atributos y matriz de modelado)
+   struct DibujoLote
+   {
+      RegionAlmacenGeom region ;
+      unsigned          mascara = 0 ;
+   } ;
+   std::vector<DibujoLote> lote_dibujos ;
+   std::vector<glm::mat4>  lote_matrices ;
+
+   static AlmacenGeometria * instancia_actual ;
+} ;
@@ -25,9 +25,13 @@
 
 
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include "malla-ind.h"
 #include "aplic-3d.h"
 #include "androide.h"
+#include "hebra-simulacion.h"
+#include "reserva-hebras.h"
 
 
 //**********************************************************************
@@ -78,7 +82,7 @@ Cuadroide::Cuadroide(  )
    // -------------------------------------------------------------------------
    // entrada 0:
    // material por defeco al inicio del nodo raiz
-   agregar( matVerdePlano );
+   agregar( EntradaNGE( matVerdePlano, false ) ); // (lo destruye el cuadroide)
    // -------------------------------------------------------------------------
    // entrada 1:
    // poner una traslacion en vertical para llevarnos el cuadroide al origen
@@ -229,91 +233,80 @@ unsigned Cuadroide::leerNumParametros() const
 }
 
 // ----------------------------------------------------------------------
-// actualizar la matriz del correspondiente parámetro
+// oscilación de cada parámetro (ángulos en grados)
 
-void Cuadroide::actualizarEstadoParametro( const unsigned iParam, const float t_sec )
+OndaParamCuadroide Cuadroide::ondaParametro( const unsigned iParam )
 {
-   using namespace glm ;
-
-   assert( iParam < leerNumParametros() );
-
-   assert( pmTraslacionRaiz != nullptr );
-   assert( pmRotPieDerecho != nullptr );
-   assert( pmRotPieIzquierdo != nullptr );
-   assert( pmEscaladoTronco != nullptr );
-   assert( pmRotCabeza != nullptr );
-   assert( pmRotCodoDerecho != nullptr );
-   assert( pmRotHombroDerecho != nullptr );
-   assert( pmRotCodoIzquierdo != nullptr );
-   assert( pmRotHombroIzquierdo != nullptr );
-
-   float v ;
-   constexpr float dosPi = 2.0*M_PI ;
    using namespace std ;
 
-   //cout << __PRETTY_FUNCTION__ << " : iParam == " << iParam << ", t_sec == " << t_sec << endl ;
-
    switch( iParam )
    {
-      // traslacion (traslacion en Z)
-      case 0 :
-         v = sin( 0.5f*t_sec*dosPi );
-         *pmTraslacionRaiz = translate( vec3{ 0.0,0.0, v });
-         break ;
+      case 0 : return {   0.0f,   1.0f, 0.5f  } ; // traslacion (traslacion en Z)
+      case 1 : return {   0.0f,  60.0f, 0.82f } ; // pie derecho (rotacion en X)
+      case 2 : return {   0.0f, -60.0f, 0.8f  } ; // pie izquierdo (rotacion en X)
+      case 3 : return {   0.0f,   0.1f, 1.5f  } ; // escalado tronco (escalado no uniforme)
+      case 4 : return {   0.0f,  45.0f, 0.6f  } ; // giro cabeza (rotacion eje Y)
+      case 5 : return {  30.0f,  25.0f, 0.8f  } ; // rotacion codo derecho
+      case 6 : return {  20.0f,  15.0f, 1.2f  } ; // rotacion hombro derecho
+      case 7 : return {  30.0f,  25.0f, 0.8f  } ; // rotacion codo izquierdo ( igual a codo derecho)
+      case 8 : return { -20.0f,  15.0f, 1.2f  } ; // rotacion hombro izquierdo (simétrico a hombro derecho)
+      default :
+         cerr << "error (" << __PRETTY_FUNCTION__ << "): número de parámetros no es coherente con los casos del switch" << endl ;
+         exit(1);
+   }
+}
 
-      // pie derecho (rotacion en X)
-      case 1 :
-         v = +60.0f*sin( 0.82f*t_sec*dosPi );
-         *pmRotPieDerecho = rotate( radians(v), vec3{ 1.0,0.0,0.0 });
-         break ;
+// ----------------------------------------------------------------------
+// matriz de un parámetro a partir de su valor 'v'
 
-      // pie izquierdo (rotacion en X)
-      case 2 :
-         v = -60.0f*sin( 0.8f*t_sec*dosPi );
-         *pmRotPieIzquierdo = rotate( radians(v), vec3{ 1.0,0.0,0.0 });
-         break ;
+glm::mat4 Cuadroide::matrizParametro( const unsigned iParam, const float v )
+{
+   using namespace std ;
+   using namespace glm ;
 
-      // escalado tronco (escalado no uniforme)
-      case 3 :
-         v = 0.1f*sin( 1.5f*t_sec*dosPi );
-         *pmEscaladoTronco = scale( vec3( 1.0f+v,1.0f-v,1.0f+v ));
-         break ;
+   switch( iParam )
+   {
+      case 0 : return translate( vec3{ 0.0,0.0, v });
+      case 1 : 
+      case 2 : return rotate( radians(v), vec3{ 1.0,0.0,0.0 });
+      case 3 : return scale( vec3( 1.0f+v,1.0f-v,1.0f+v ));
+      case 4 : return rotate( radians(v), vec3{0.0,1.0,0.0} );
+      case 5 : 
+      case 6 : 
+      case 7 : 
+      case 8 : return rotate( radians(v), vec3{-1.0,0.0,0.0} );
+      default :
+         cerr << "error (" << __PRETTY_FUNCTION__ << "): número de parámetros no es coherente con los casos del switch" << endl ;
+         exit(1);
+   }
+}
 
-      // giro cabeza (rotacion eje Y)
-      case 4 :
-         v = 45.0f*sin( 0.6f*t_sec*dosPi );
-         *pmRotCabeza = rotate(  radians(v), vec3{0.0,1.0,0.0} );
-         break ;
+// ----------------------------------------------------------------------
 
-      // rotacion codo derecho
-      case 5 :
-         v = 30.0f + 25.0f*sin( 0.8f*t_sec*dosPi );
-         * pmRotCodoDerecho = rotate( radians(v), vec3{-1.0,0.0,0.0 });
-         break ;
+glm::mat4 * Cuadroide::leerPtrMatrizParametro( const unsigned iParam ) 
+{
+   assert( iParam < leerNumParametros() );
 
-      // rotacion hombro derecho
-      case 6 :
-         v = 20.0f + 15.0f*sin( 1.2f*t_sec*dosPi );
-         * pmRotHombroDerecho = rotate( radians(v), vec3{-1.0,0.0,0.0} );
-         break ;
+   glm::mat4 * const ptrs[9] = 
+   {  pmTraslacionRaiz, pmRotPieDerecho, pmRotPieIzquierdo, pmEscaladoTronco, pmRotCabeza, 
+      pmRotCodoDerecho, pmRotHombroDerecho, pmRotCodoIzquierdo, pmRotHombroIzquierdo 
+   };
+   assert( ptrs[iParam] != nullptr );
+   return ptrs[iParam] ;
+}
 
-      // traslacion codo izquierdo ( igual a codo izquierdo)
-      case 7 :
-         v = 30.0f + 25.0f*sin( 0.8f*t_sec*dosPi );
-         *pmRotCodoIzquierdo = rotate( radians(v), vec3{-1.0,0.0,0.0} );
-         break ;
+// ----------------------------------------------------------------------
+// actualizar la matriz del correspondiente parámetro
 
-      // traslacion hombro izquierdo (simétrico a hombro derecho)
-      case 8 :
-         v = -20.0f + 15.0f*sin( 1.2f*t_sec*dosPi );
-         *pmRotHombroIzquierdo = rotate( radians(v), vec3{-1.0,0.0,0.0} );
-         break ;
+void Cuadroide::actualizarEstadoParametro( const unsigned iParam, const float t_sec )
+{
+   assert( iParam < leerNumParametros() );
 
-      default :
-         cerr << "error (" << __PRETTY_FUNCTION__ << "): número de parámetros no es coherente con los casos del switch" << endl ;
-         exit(1);
-         break ;
-   }
+   constexpr float dosPi = 2.0*M_PI ;
+   const OndaParamCuadroide onda = ondaParametro( iParam );
+   const float v = onda.base + onda.amplitud*std::sin( onda.frecuencia*t_sec*dosPi );
+
+   *leerPtrMatrizParametro( iParam ) = matrizParametro( iParam, v );
 }
 
 
@@ -472,7 +465,7 @@ Ojo::Ojo(  const float p_ang_ry, Cuadroide * raiz )
    assert( raiz->matNegroBrill != NULL );
 
    ponerColor( { 0.0,0.0,0.0 } );
-   agregar( raiz->matNegroBrill );
+   agregar( EntradaNGE( raiz->matNegroBrill, false ) ); // (lo comparten los dos ojos)
    agregar( rotate( radians(ang_ry), vec3{0.0,1.0,0.0} ) );
    agregar( rotate( radians(ang_rx), vec3{1.0,0.0,0.0} ) );
    agregar( translate( vec3{ 0.0, 1.0, 0.0 }) );
@@ -498,6 +491,308 @@ Antena::Antena( const float p_ang_rz, Cuadroide * raiz )
 
    ponerNombre("antena");
 } ;
+// *****************************************************************************
+// clase EvaluadorAnimDroides
+
+// matrices de 'num_carriles' androides, como estructura de arrays: el elemento en la columna 'c' 
+// y la fila 'f' de la matriz del carril 'l' está en 'e[4*c+f][l]'
+
+constexpr unsigned num_carriles = EvaluadorAnimDroides::num_carriles ;
+
+struct MatricesCarriles
+{
+   alignas(32) float e[16][num_carriles] ;
+} ;
+
+// ----------------------------------------------------------------------------------
+// escribe en 's' el seno de los valores de 'x' (en radianes, con |x| < 2^22). Se resta a 'x' 
+// el múltiplo 'k*pi' más cercano (en dos partes, para no perder precisión), así queda en 
+// [-pi/2,pi/2], donde se evalúa el polinomio de Taylor de grado 9 (error menor que 4e-6), 
+// con el signo cambiado si 'k' es impar. Sin llamadas a funciones ni condiciones (se redondea
+// sumando y restando 1.5*2^23), el compilador vectoriza el bucle ('std::sin' no se vectoriza).
+
+static inline void SenoCarriles( const float * x, float * s )
+{
+   constexpr float inv_pi   = 1.0/M_PI ,
+                   pi_a     = 3.140625f ,          // pi = pi_a + pi_b ('pi_a' tiene pocos bits,
+                   pi_b     = M_PI - 3.140625 ,    // así 'k*pi_a' es exacto)
+                   redondeo = 12582912.0f ;        // 1.5*2^23
+
+   for( unsigned l = 0 ; l < num_carriles ; l++ )
+   {
+      const float k  = ( x[l]*inv_pi + redondeo ) - redondeo ,
+                  r  = ( x[l] - k*pi_a ) - k*pi_b ,
+                  r2 = r*r ,
+                  sg = float( 1 - 2*( int( k ) & 1 ) ) ;
+      s[l] = sg*r*( 1.0f + r2*( -1.0f/6.0f + r2*( 1.0f/120.0f + r2*( -1.0f/5040.0f + r2*( 1.0f/362880.0f )))));
+   }
+}
+
+// ----------------------------------------------------------------------------------
+// escribe en 'm' las matrices del parámetro 'ip' con los valores 'v' de cada carril (hace lo 
+// mismo que 'Cuadroide::matrizParametro', el constructor del evaluador comprueba que coinciden)
+
+static void MatrizParametroCarriles( const unsigned ip, const float * p_v, MatricesCarriles & m )
+{
+   using namespace std ;
+   constexpr float grados_a_rad = M_PI/180.0 ;
+   float v[num_carriles], ang[num_carriles], seno[num_carriles], coseno[num_carriles] ;
+
+   // (con una copia local, el compilador sabe que 'v' no se solapa con 'm' y vectoriza sin comprobarlo)
+   std::copy( p_v, p_v + num_carriles, v );
+
+   for( unsigned i = 0 ; i < 16 ; i++ )
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+         m.e[i][l] = ( i % 5 == 0 ) ? 1.0f : 0.0f ;
+
+   if ( ip == 1 || ip == 2 || ip == 4 || ( 5 <= ip && ip <= 8 ))
+   {
+      // rotaciones (en los parámetros 5 a 8, en torno a -X, es decir, con el ángulo opuesto en torno a X)
+      const float signo = ip >= 5 ? -1.0f : 1.0f ;
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+         ang[l] = signo*grados_a_rad*v[l] ;
+      SenoCarriles( ang, seno );
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+         ang[l] += 0.5f*float( M_PI ) ;
+      SenoCarriles( ang, coseno );
+   }
+
+   switch( ip )
+   {
+      case 0 : // traslación en Z
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+            m.e[14][l] = v[l] ;
+         break ;
+      case 1 : 
+      case 2 : 
+      case 5 :
+      case 6 :
+      case 7 :
+      case 8 : // rotación en torno a X
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+         {  m.e[5][l] = coseno[l] ; m.e[6][l]  = seno[l] ;
+            m.e[9][l] = -seno[l] ; m.e[10][l] = coseno[l] ;
+         }
+         break ;
+      case 3 : // escalado no uniforme
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+         {  m.e[0][l]  = 1.0f+v[l] ;
+            m.e[5][l]  = 1.0f-v[l] ;
+            m.e[10][l] = 1.0f+v[l] ;
+         }
+         break ;
+      case 4 : // rotación en torno a Y
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+         {  m.e[0][l] = coseno[l] ; m.e[2][l]  = -seno[l] ;
+            m.e[8][l] = seno[l] ;   m.e[10][l] = coseno[l] ;
+         }
+         break ;
+      default :
+         cerr << "error (" << __PRETTY_FUNCTION__ << "): número de parámetros no es coherente con los casos del switch" << endl ;
+         exit(1);
+   }
+}
+
+// ----------------------------------------------------------------------------------
+// r = a*b (las tres matrices de cada carril, 'r' no puede ser 'a' ni 'b')
+
+static inline void MultiplicarCarriles( const MatricesCarriles & a, const MatricesCarriles & b, MatricesCarriles & r )
+{
+   for( unsigned c = 0 ; c < 4 ; c++ )
+      for( unsigned f = 0 ; f < 4 ; f++ )
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+            r.e[4*c+f][l] = a.e[f][l]*b.e[4*c][l]   + a.e[4+f][l]*b.e[4*c+1][l] + 
+                            a.e[8+f][l]*b.e[4*c+2][l] + a.e[12+f][l]*b.e[4*c+3][l] ;
+}
+
+// ----------------------------------------------------------------------------------
+// r = a*b, con la misma matriz 'b' para todos los carriles ('r' no puede ser 'a')
+
+static inline void MultiplicarCarriles( const MatricesCarriles & a, const glm::mat4 & b, MatricesCarriles & r )
+{
+   for( unsigned c = 0 ; c < 4 ; c++ )
+      for( unsigned f = 0 ; f < 4 ; f++ )
+      {
+         const float b0 = b[c][0], b1 = b[c][1], b2 = b[c][2], b3 = b[c][3] ;
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+            r.e[4*c+f][l] = a.e[f][l]*b0 + a.e[4+f][l]*b1 + a.e[8+f][l]*b2 + a.e[12+f][l]*b3 ;
+      }
+}
+
+// ----------------------------------------------------------------------------------
+
+EvaluadorAnimDroides::EvaluadorAnimDroides( Cuadroide * master, const std::vector<HojaNGE> & hojas, 
+                                            const unsigned p_nx, const unsigned p_nz, 
+                                            const std::vector<float> & p_desfases )
+{
+   using namespace std ;
+   using namespace glm ;
+   assert( master != nullptr );
+   assert( hojas.size() > 0 );
+
+   nx     = p_nx ;
+   nz     = p_nz ;
+   numpar = master->leerNumParametros();
+   assert( p_desfases.size() == numpar*nx*nz );
+
+   // los desfases se copian con relleno hasta un múltiplo de 'num_carriles' androides
+   const unsigned num_droides = nx*nz ;
+   num_droides_rell = ( (num_droides + num_carriles - 1)/num_carriles )*num_carriles ;
+   desfases.assign( numpar*num_droides_rell, 0.0f );
+   for( unsigned ip = 0 ; ip < numpar ; ip++ )
+   {  copy( p_desfases.begin() + ip*num_droides, p_desfases.begin() + (ip+1)*num_droides, 
+            desfases.begin() + ip*num_droides_rell );
+      ondas.push_back( Cuadroide::ondaParametro( ip ) );
+   }
+
+   // comprobar que las matrices de los parámetros por carriles son las del grafo
+   for( unsigned ip = 0 ; ip < numpar ; ip++ )
+   {
+      float            v[num_carriles] ;
+      MatricesCarriles m ;
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+         v[l] = ondas[ip].base + ondas[ip].amplitud*( float(l)/float(num_carriles-1)*2.0f - 1.0f );
+      MatrizParametroCarriles( ip, v, m );
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+      {  const mat4 mp = Cuadroide::matrizParametro( ip, v[l] );
+         for( unsigned i = 0 ; i < 16 ; i++ )
+            assert( std::abs( m.e[i][l] - mp[i/4][i%4] ) < 1e-4f );
+      }
+   }
+
+   // extraer el esqueleto de cada parte: se recorre su camino, acumulando las matrices 
+   // fijas hasta encontrar la matriz de un parámetro
+   vector<const mat4 *> ptrs_par( numpar );
+   for( unsigned ip = 0 ; ip < numpar ; ip++ )
+      ptrs_par[ip] = master->leerPtrMatrizParametro( ip );
+
+   partes.resize( hojas.size() );
+   for( unsigned ih = 0 ; ih < hojas.size() ; ih++ )
+   {
+      assert( hojas[ih].camino.size() > 0 ); // 'hojas' debe obtenerse con el camino
+      ParteEsqueleto & parte = partes[ih] ;
+      mat4 fija = mat4( 1.0f );
+
+      for( const mat4 * pm : hojas[ih].camino )
+      {
+         const auto it = find( ptrs_par.begin(), ptrs_par.end(), pm );
+         if ( it == ptrs_par.end() )
+            fija = fija * (*pm) ;
+         else 
+         {  parte.fijas.push_back( fija );
+            parte.params.push_back( unsigned( it - ptrs_par.begin() ) );
+            fija = mat4( 1.0f );
+         }
+      }
+      parte.fijas.push_back( fija );
+   }
+
+   // número de hebras: las de la reserva más la que evalúa, pero sin bloques de menos de 'min_droides_hebra' androides
+   constexpr unsigned min_droides_hebra = 256 ;
+   const unsigned max_hebras = ReservaHebras::instancia()->leerNumHebras() + 1 ;
+   num_hebras = std::clamp( (nx*nz)/min_droides_hebra, 1u, max_hebras );
+}
+
+// ----------------------------------------------------------------------------------
+
+void EvaluadorAnimDroides::evaluar( const std::vector<float> & tiempo_par, 
+                                    const std::vector<DestinoParteDroides> & destinos )
+{
+   assert( tiempo_par.size() == numpar );
+   assert( destinos.size() == partes.size() );
+
+   const unsigned num_droides = nx*nz ;
+
+   if ( num_hebras == 1 )
+   {
+      evaluarBloque( tiempo_par, destinos, 0, num_droides );
+      return ;
+   }
+
+   // repartir los androides en bloques consecutivos entre las hebras de la reserva y la actual
+   // (sin crear hebras en cada evaluación, y sin competir con las tareas de la reserva), cada 
+   // bloque con un múltiplo de 'num_carriles' androides
+   const unsigned num_grupos = num_droides_rell/num_carriles ,
+                  tam_bloque = ( (num_grupos + num_hebras - 1)/num_hebras )*num_carriles ;
+
+   ReservaHebras::instancia()->paraCada( num_hebras, [&]( unsigned ib )
+   {
+      const unsigned id_ini = std::min( num_droides, ib*tam_bloque ),
+                     id_fin = std::min( num_droides, id_ini + tam_bloque );
+      evaluarBloque( tiempo_par, destinos, id_ini, id_fin );
+   });
+}
+
+// ----------------------------------------------------------------------------------
+
+void EvaluadorAnimDroides::evaluarBloque( const std::vector<float> & tiempo_par, 
+                                          const std::vector<DestinoParteDroides> & destinos, 
+                                          const unsigned id_ini, const unsigned id_fin ) 
+{
+   using namespace glm ;
+   constexpr float dosPi = 2.0*M_PI ;
+   assert( id_ini % num_carriles == 0 || id_ini == id_fin );
+
+   std::vector<MatricesCarriles> mat_par( numpar );
+   MatricesCarriles              m, aux ;
+   float                         fase[num_carriles], sen[num_carriles], val[num_carriles], 
+                                 tx[num_carriles], tz[num_carriles] ;
+
+   for( unsigned id = id_ini ; id < id_fin ; id += num_carriles )
+   {
+      const unsigned n = std::min( num_carriles, id_fin - id ); // carriles con androides del bloque
+
+      // (1) valores y matrices de los parámetros de los androides de los carriles
+      for( unsigned ip = 0 ; ip < numpar ; ip++ )
+      {
+         const float   base  = ondas[ip].base, 
+                       ampl  = ondas[ip].amplitud,
+                       w     = ondas[ip].frecuencia*dosPi,
+                       t_par = tiempo_par[ip] ;
+         const float * des   = desfases.data() + ip*num_droides_rell + id ;
+
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+            fase[l] = w*(t_par + des[l]) ;
+         SenoCarriles( fase, sen );
+         for( unsigned l = 0 ; l < num_carriles ; l++ )
+            val[l] = base + ampl*sen[l] ;
+         MatrizParametroCarriles( ip, val, mat_par[ip] );
+      }
+
+      // traslación de cada androide en la formación
+      for( unsigned l = 0 ; l < num_carriles ; l++ )
+      {  tx[l] = 2.0f*float( (id+l) % nx );
+         tz[l] = 2.0f*float( (id+l) / nx );
+      }
+
+      // (2) matrices de las partes: se componen las matrices fijas del esqueleto de cada 
+      // parte con las de sus parámetros, y se escriben las de los carriles con androides
+      for( unsigned k = 0 ; k < partes.size() ; k++ )
+      {
+         const ParteEsqueleto & parte = partes[k] ;
+         const mat4 &           f0    = parte.fijas[0] ;
+
+         // m = traslación del androide * fijas[0] 
+         for( unsigned c = 0 ; c < 4 ; c++ )
+            for( unsigned l = 0 ; l < num_carriles ; l++ )
+            {  m.e[4*c  ][l] = f0[c][0] + tx[l]*f0[c][3] ;
+               m.e[4*c+1][l] = f0[c][1] ;
+               m.e[4*c+2][l] = f0[c][2] + tz[l]*f0[c][3] ;
+               m.e[4*c+3][l] = f0[c][3] ;
+            }
+         for( unsigned j = 0 ; j < parte.params.size() ; j++ )
+         {  MultiplicarCarriles( m, mat_par[ parte.params[j] ], aux );
+            MultiplicarCarriles( aux, parte.fijas[j+1], m );
+         }
+
+         mat4 * const dest = destinos[k].matrices + std::size_t( id )*destinos[k].paso ;
+         for( unsigned l = 0 ; l < n ; l++ )
+            for( unsigned i = 0 ; i < 16 ; i++ )
+               dest[ l*destinos[k].paso ][i/4][i%4] = m.e[i][l] ;
+      }
+   }
+}
+
 // *****************************************************************************
 
 FormacionDroides::FormacionDroides( const unsigned pnx, const unsigned pnz )
@@ -521,6 +816,11 @@ FormacionDroides::~FormacionDroides()
 {
    using namespace std ;
    //cout << "Invocado destructor de FormacionDroides" << endl ; 
+   for( GrupoInstDroides & g : grupos )
+      delete g.dvao ; // también elimina los VBOs de las tablas por instancia
+   grupos.clear();
+   delete evaluador ;
+   evaluador = nullptr ;
    delete master ;
    master = nullptr ;
    tiempo_par.clear() ;
@@ -529,6 +829,22 @@ FormacionDroides::~FormacionDroides()
 }
 // ----------------------------------------------------------------------------------
 
+void FormacionDroides::acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const 
+{
+   if ( ! contados.insert( this ).second )
+      return ;
+
+   master->acumularUsoMemoria( uso, contados );
+
+   // cada grupo tiene su propio VAO, con las tablas de la malla y las matrices por instancia
+   for( const GrupoInstDroides & g : grupos )
+      uso += g.dvao->leerUsoMemoria();
+
+   uso.cpu_tablas += ( tiempo_par.size() + delta_par.size() )*sizeof( float ) + 
+                     ( grupo_parte.size() + ind_parte_grupo.size() )*sizeof( unsigned );
+}
+// ----------------------------------------------------------------------------------
+
 unsigned FormacionDroides::leerNumParametros() const 
 {
    return numpar ;
@@ -540,6 +856,7 @@ void FormacionDroides::actualizarEstadoParametro( const unsigned iParam, const f
    assert( iParam  < numpar );
    assert( master != nullptr );
    tiempo_par[ iParam ] = t_sec ;
+   matrices_actualizadas = false ;
    //master->actualizarEstadoParametro( iParam, t_sec );
 }
 // ----------------------------------------------------------------------------------
@@ -593,18 +910,256 @@ void FormacionDroides::visu_gen( unsigned modo )
    cauce->popMM() ;
 }
 
+// ----------------------------------------------------------------------------------
+// crea un grupo por cada par (malla,material) distinto en las hojas del androide maestro
+
+void FormacionDroides::crearGruposInstancias()
+{
+   using namespace std ;
+   using namespace glm ;
+   assert( master != nullptr );
+   assert( grupos.size() == 0 );
+
+   // recopilar las partes del maestro, el color base es el de la formación, si tiene, 
+   // o en otro caso el color actual del cauce (los nodos del androide fijan casi todos los colores)
+   Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+   const vec3 color_base = tieneColor() ? leerColor() : vec3( cauce->leerColorActual() );
+   vector<HojaNGE>      hojas ;
+   vector<const mat4 *> camino ;
+   master->recopilarHojas( mat4( 1.0f ), color_base, nullptr, hojas, &camino );
+   assert( hojas.size() > 0 );
+
+   // asignar cada parte a un grupo
+   const unsigned num_partes = hojas.size() ;
+   grupo_parte.resize( num_partes );
+   ind_parte_grupo.resize( num_partes );
+
+   for( unsigned ih = 0 ; ih < num_partes ; ih++ )
+   {
+      MallaInd * malla = dynamic_cast<MallaInd *>( hojas[ih].objeto );
+      if ( malla == nullptr )
+      {
+         cout << "Error: el objeto '" << hojas[ih].objeto->leerNombre() << "' del androide no es una malla indexada, no se puede instanciar." << endl ;
+         exit(1);
+      }
+      unsigned ig = 0 ;
+      while( ig < grupos.size() && ( grupos[ig].malla != malla || grupos[ig].material != hojas[ih].material ))
+         ig++ ;
+      if ( ig == grupos.size() )
+         grupos.push_back( { .malla = malla, .material = hojas[ih].material } );
+
+      grupo_parte[ih]     = ig ;
+      ind_parte_grupo[ih] = grupos[ig].num_partes ;
+      grupos[ig].num_partes++ ;
+   }
+
+   // crear el VAO de cada grupo, con las tablas por instancia (matrices y colores), 
+   // el índice de instancia es: índice de androide * partes del grupo + índice de parte en el grupo
+   const unsigned num_droides = nx*nz ;
+   for( unsigned ig = 0 ; ig < grupos.size() ; ig++ )
+   {
+      GrupoInstDroides & g = grupos[ig] ;
+      g.num_instancias = num_droides*g.num_partes ;
+
+      vector<vec3> colores( g.num_instancias );
+      for( unsigned ih = 0 ; ih < num_partes ; ih++ )
+         if ( grupo_parte[ih] == ig )
+            for( unsigned id = 0 ; id < num_droides ; id++ )
+               colores[ id*g.num_partes + ind_parte_grupo[ih] ] = hojas[ih].color ;
+
+      g.dvao          = g.malla->crearDescrVAOInstancias() ;
+      g.dvbo_matrices = new DescrVBOAtribs( ind_atrib_mat_instancia, vector<mat4>( g.num_instancias, mat4( 1.0f ) ) );
+      g.dvbo_mat_nor  = new DescrVBOAtribs( ind_atrib_mat_nor_instancia, vector<mat3>( g.num_instancias, mat3( 1.0f ) ) );
+      DescrVBOAtribs * dvbo_colores = new DescrVBOAtribs( ind_atrib_colores, colores );
+
+      g.dvbo_matrices->fijarDivisor( 1 );
+      g.dvbo_mat_nor->fijarDivisor( 1 );
+      dvbo_colores->fijarDivisor( 1 );
+      g.dvao->agregar( g.dvbo_matrices );
+      g.dvao->agregar( g.dvbo_mat_nor );
+      g.dvao->agregar( dvbo_colores );
+   }
+
+   // crear el evaluador de la animación, con los desfases de los parámetros de cada androide
+   vector<float> desfases( numpar*num_droides );
+   for( unsigned ip = 0 ; ip < numpar ; ip++ )
+      for( unsigned iz = 0 ; iz < nz ; iz++ )
+         for( unsigned ix = 0 ; ix < nx ; ix++ )
+            desfases[ ip*num_droides + ix+iz*nx ] = delta_t( ip, ix, iz );
+
+   evaluador = new EvaluadorAnimDroides( master, hojas, nx, nz, desfases );
+   matrices_actualizadas = false ;
+
+   cout << "Formación de androides: " << num_partes << " partes por androide, en " << grupos.size() 
+        << " grupos (una llamada de dibujo instanciado por grupo), animación evaluada con " 
+        << evaluador->leerNumHebras() << " hebra(s)." << endl ;
+}
+
+// ----------------------------------------------------------------------------------
+// calcula las matrices de las normales de las instancias de un grupo a partir de las 
+// matrices de modelado (ya escritas en los datos propios del VBO), y actualiza ambos VBOs
+// (así el vertex shader no tiene que invertir una matriz en cada vértice)
+
+static void ActualizarVBOsMatrices( GrupoInstDroides & g )
+{
+   using namespace glm ;
+   const mat4 * matrices = (const mat4 *) g.dvbo_matrices->leerDatosPropios() ;
+   mat3 *       mat_nor  = (mat3 *) g.dvbo_mat_nor->leerDatosPropios() ;
+   for( unsigned i = 0 ; i < g.num_instancias ; i++ )
+      mat_nor[i] = transpose( inverse( mat3( matrices[i] )));
+
+   g.dvbo_matrices->actualizarDatos();
+   g.dvbo_mat_nor->actualizarDatos();
+}
+// ----------------------------------------------------------------------------------
+
+void FormacionDroides::actualizarMatricesInstancias()
+{
+   using namespace glm ;
+   assert( evaluador != nullptr );
+   assert( grupos.size() > 0 );
+
+   // las matrices se escriben directamente en la copia de los datos de cada VBO
+   std::vector<DestinoParteDroides> destinos( grupo_parte.size() );
+   for( unsigned ih = 0 ; ih < grupo_parte.size() ; ih++ )
+   {
+      GrupoInstDroides & g = grupos[ grupo_parte[ih] ];
+      destinos[ih].matrices = (mat4 *) g.dvbo_matrices->leerDatosPropios() + ind_parte_grupo[ih] ;
+      destinos[ih].paso     = g.num_partes ;
+   }
+
+   evaluador->evaluar( tiempo_par, destinos );
+
+   for( GrupoInstDroides & g : grupos )
+      ActualizarVBOsMatrices( g );
+
+   matrices_actualizadas = true ;
+}
+
+// ----------------------------------------------------------------------------------
+
+void FormacionDroides::prepararInstantaneas()
+{
+   if ( grupos.size() == 0 )
+      crearGruposInstancias();
+   // con las matrices actualizadas, la hebra principal no usa el evaluador mientras 
+   // lo usa la hebra de simulación (solo se desactualizan al cambiar un parámetro)
+   if ( ! matrices_actualizadas )
+      actualizarMatricesInstancias();
+}
+
+// ----------------------------------------------------------------------------------
+// (en la hebra de simulación: solo lee los grupos, que no cambian una vez creados)
+
+void FormacionDroides::calcularInstantanea( InstantaneaSimulacion & inst )
+{
+   using namespace glm ;
+   assert( evaluador != nullptr );
+
+   // las matrices de los grupos van seguidas en la instantánea, en el orden de los grupos
+   std::vector<unsigned> inicio_grupo( grupos.size() );
+   unsigned num_matrices = 0 ;
+   for( unsigned ig = 0 ; ig < grupos.size() ; ig++ )
+   {
+      inicio_grupo[ig] = num_matrices ;
+      num_matrices    += grupos[ig].num_instancias ;
+   }
+   inst.matrices.resize( num_matrices );
+
+   std::vector<DestinoParteDroides> destinos( grupo_parte.size() );
+   for( unsigned ih = 0 ; ih < grupo_parte.size() ; ih++ )
+   {
+      destinos[ih].matrices = inst.matrices.data() + inicio_grupo[ grupo_parte[ih] ] + ind_parte_grupo[ih] ;
+      destinos[ih].paso     = grupos[ grupo_parte[ih] ].num_partes ;
+   }
+   evaluador->evaluar( inst.tiempos, destinos );
+}
+
+// ----------------------------------------------------------------------------------
+
+void FormacionDroides::aplicarInstantanea( const InstantaneaSimulacion & inst )
+{
+   using namespace glm ;
+   assert( inst.tiempos.size() == numpar );
+
+   // los tiempos se usan al recorrer el grafo del maestro ('visu_gen')
+   tiempo_par = inst.tiempos ;
+
+   const mat4 * origen = inst.matrices.data() ;
+   for( GrupoInstDroides & g : grupos )
+   {
+      assert( origen + g.num_instancias <= inst.matrices.data() + inst.matrices.size() );
+      std::copy( origen, origen + g.num_instancias, (mat4 *) g.dvbo_matrices->leerDatosPropios() );
+      ActualizarVBOsMatrices( g );
+      origen += g.num_instancias ;
+   }
+   matrices_actualizadas = true ;
+}
+
+// ----------------------------------------------------------------------------------
+
+void FormacionDroides::visu_inst( unsigned modo )
+{
+   assert( modo < 2 );
+
+   Aplicacion3D *   apl             = Aplicacion3D::instancia();
+   Cauce3D *        cauce           = apl->cauce3D() ;  
+   PilaMateriales * pila_materiales = apl->pilaMateriales();
+
+   if ( grupos.size() == 0 )
+      crearGruposInstancias();
+   if ( ! matrices_actualizadas )
+      actualizarMatricesInstancias();
+
+   // en modo 0 se usan los materiales de los grupos (si hay iluminación), 
+   // en modo 1 solo la geometría (se ignoran los colores y las normales de las tablas)
+   const bool usar_materiales = modo == 0 && apl->iluminacionActiva() ;
+
+   if ( usar_materiales )
+      pila_materiales->push();
+   cauce->fijarUsarInstancias( true );
+
+   for( GrupoInstDroides & g : grupos )
+   {
+      if ( usar_materiales && g.material != nullptr )
+         pila_materiales->activar( g.material );
+
+      if ( modo == 1 )
+      {  g.dvao->habilitarAtrib( ind_atrib_colores,  false );
+         g.dvao->habilitarAtrib( ind_atrib_normales, false );
+      }
+      
+      g.dvao->drawInstanciado( GL_TRIANGLES, g.num_instancias );
+
+      if ( modo == 1 )
+      {  g.dvao->habilitarAtrib( ind_atrib_colores,  true );
+         g.dvao->habilitarAtrib( ind_atrib_normales, true );
+      }
+   }
+
+   cauce->fijarUsarInstancias( false );
+   if ( usar_materiales )
+      pila_materiales->pop();
+}
+
 // ----------------------------------------------------------------------------------
 
 void FormacionDroides::visualizarGL()
 {
-   visu_gen( 0 );
+   if ( usar_instancias )
+      visu_inst( 0 );
+   else 
+      visu_gen( 0 );
 }
 
 // ----------------------------------------------------------------------------------
 
 void FormacionDroides::visualizarGeomGL(  ) 
 {
-   visu_gen( 1 );
+   if ( usar_instancias )
+      visu_inst( 1 );
+   else 
+      visu_gen( 1 );
 }
 
 // ----------------------------------------------------------------------------------
@@ -619,4 +1174,92 @@ void FormacionDroides::visualizarNormalesGL ()
 void FormacionDroides::visualizarModoSeleccionGL() 
 {
    visu_gen( 3 );
-}
\ No newline at end of file
+}
+
+// *****************************************************************************
+// benchmark de escalado de las formaciones de androides
+
+void BenchmarkFormacionDroides()
+{
+   using namespace std ;
+   using namespace glm ;
+   using namespace std::chrono ;
+
+   Aplicacion3D * apl   = Aplicacion3D::instancia();
+   Cauce3D *      cauce = apl->cauce3D() ;  
+
+   constexpr unsigned 
+      num_tams       = 5,
+      max_tam_grafo  = 100, // tamaño máximo para el que se mide el recorrido del grafo (es muy lento)
+      num_cuadros    = 10 ; // número de cuadros medidos (además de uno inicial, que no se mide)
+   constexpr unsigned 
+      tams[num_tams] = { 20, 50, 100, 200, 500 }; // número de androides en X y en Z
+   constexpr float 
+      dt_cuadro      = 1.0f/60.0f ; // tiempo simulado entre cuadros
+
+   GLint viewport[4] ;
+   glGetIntegerv( GL_VIEWPORT, viewport );
+   const float ratio_yx = float(viewport[3])/float(viewport[2]);
+
+   cauce->activar();
+   cauce->fijarColor( 1.0, 1.0, 1.0 );
+
+   // devuelve la media de los tiempos por cuadro (en milisegundos) y la media de los 
+   // tiempos de cálculo de las matrices en la CPU (solo con dibujo instanciado)
+   auto medir = [&]( FormacionDroides * formacion, const bool instancias, float & ms_matrices ) -> float
+   {
+      formacion->fijarUsarInstancias( instancias );
+      double seg_total = 0.0, seg_matrices = 0.0 ;
+
+      for( unsigned ic = 0 ; ic <= num_cuadros ; ic++ )
+      {
+         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+         glFinish();
+         const auto t0 = steady_clock::now();
+
+         formacion->actualizarEstado( dt_cuadro );
+         if ( instancias && formacion->grupos.size() > 0 )
+         {
+            formacion->actualizarMatricesInstancias();
+            seg_matrices += ic == 0 ? 0.0 : duration<double>( steady_clock::now() - t0 ).count() ;
+         }
+         formacion->visualizarGL();
+         glFinish();
+         
+         if ( ic > 0 ) // el primer cuadro crea los VAOs, no se mide
+            seg_total += duration<double>( steady_clock::now() - t0 ).count() ;
+      }
+      ms_matrices = 1000.0f*float( seg_matrices/num_cuadros );
+      return 1000.0f*float( seg_total/num_cuadros );
+   };
+
+   cout << endl << "Benchmark de formaciones de androides (" << num_cuadros << " cuadros por medida, tiempos en ms):" << endl 
+        << setw(10) << "tamaño" << setw(12) << "androides" << setw(16) << "matrices (CPU)" 
+        << setw(16) << "instanciado" << setw(16) << "grafo" << endl ;
+
+   for( unsigned it = 0 ; it < num_tams ; it++ )
+   {
+      const unsigned n = tams[it] ;
+      FormacionDroides * formacion = new FormacionDroides( n, n );
+
+      // cámara que ve la formación completa desde una esquina 
+      const float lado = 2.0f*n ;
+      cauce->fijarMatrizVista( lookAt( vec3( -0.25f*lado, 0.4f*lado, -0.25f*lado ), 
+                                       vec3( 0.5f*lado, 0.0f, 0.5f*lado ), vec3( 0.0f, 1.0f, 0.0f ) ));
+      cauce->fijarMatrizProyeccion( perspective( radians( 60.0f ), 1.0f/ratio_yx, 0.1f, 4.0f*lado ) );
+
+      float ms_matrices = 0.0f, ms_nada = 0.0f ;
+      const float ms_inst  = medir( formacion, true, ms_matrices );
+      const float ms_grafo = n <= max_tam_grafo ? medir( formacion, false, ms_nada ) : -1.0f ;
+
+      cout << setw(10) << (to_string(n) + "x" + to_string(n)) << setw(12) << n*n 
+           << fixed << setprecision(2) << setw(16) << ms_matrices << setw(16) << ms_inst ;
+      if ( ms_grafo >= 0.0f )
+         cout << setw(16) << ms_grafo << endl ;
+      else 
+         cout << setw(16) << "(no medido)" << endl ;
+
+      delete formacion ;
+   }
+   cout << "Fin del benchmark." << endl ;
+}
@@ -27,6 +27,17 @@
 
 #include "grafo-escena.h"
 
+// *****************************************************************************
+// Oscilación de un parámetro del cuadroide: en el instante 't' (en segundos), su 
+// valor es: base + amplitud*sin( 2*pi*frecuencia*t )
+
+struct OndaParamCuadroide
+{
+   float base       = 0.0f ;
+   float amplitud   = 0.0f ;
+   float frecuencia = 0.0f ; // en Hz
+} ;
+
 // *****************************************************************************
 
 class Cuadroide : public NodoGrafoEscena //NodoGrafoEscenaParam
@@ -39,6 +50,14 @@ class Cuadroide : public NodoGrafoEscena //NodoGrafoEscenaParam
    virtual unsigned leerNumParametros() const ; // tiene 10 parámetros
    virtual void actualizarEstadoParametro( const unsigned iParam, const float t_sec );
 
+   // oscilación de cada parámetro, y matriz de un parámetro a partir de su valor 
+   // (no modifican el grafo, se usan para evaluar la animación de muchos androides)
+   static OndaParamCuadroide ondaParametro( const unsigned iParam );
+   static glm::mat4 matrizParametro( const unsigned iParam, const float v );
+
+   // devuelve el puntero a la matriz del grafo que depende del parámetro 'iParam'
+   glm::mat4 * leerPtrMatrizParametro( const unsigned iParam ) ;
+
    // --------------------------------------------------------------------------
 
    private:
@@ -116,6 +135,90 @@ class Antena : public NodoGrafoEscena
    Antena( const float p_ang_rz, Cuadroide * raiz ) ;
    float ang_rz ;
 } ;
+// *****************************************************************************
+// Grupo de partes de los androides de una formación que comparten malla y material:
+// todas las instancias del grupo se visualizan con una única llamada de dibujo instanciado
+
+struct GrupoInstDroides
+{
+   MallaInd *       malla          = nullptr ; // malla que se instancia (no propietario)
+   Material *       material       = nullptr ; // material de las partes (no propietario, puede ser nulo)
+   unsigned         num_partes     = 0 ;       // número de partes de cada androide en este grupo
+   unsigned         num_instancias = 0 ;       // número de instancias (androides * partes)
+   DescrVAO *       dvao           = nullptr ; // VAO con la malla y las tablas por instancia (propietario)
+   DescrVBOAtribs * dvbo_matrices  = nullptr ; // VBO con las matrices de las instancias (propiedad de 'dvao')
+   DescrVBOAtribs * dvbo_mat_nor   = nullptr ; // VBO con las matrices de las normales de las instancias (propiedad de 'dvao')
+} ;
+
+// *****************************************************************************
+// Destino en la paleta de matrices de una parte de los androides: la matriz de la 
+// parte del androide 'id' se escribe en 'matrices[id*paso]'
+
+struct DestinoParteDroides
+{
+   glm::mat4 * matrices = nullptr ; 
+   unsigned    paso     = 1 ;
+} ;
+
+// *****************************************************************************
+// Evaluador de la animación de una formación de androides: calcula las matrices de 
+// todas las partes de todos los androides sin usar (ni modificar) el grafo del maestro.
+//
+// Al construirlo, se extrae del grafo el 'esqueleto' de cada parte: el producto de las 
+// matrices fijas que hay entre las matrices de los parámetros en su camino desde la raíz.
+// Los desfases de los parámetros de los androides se guardan como estructura de arrays
+// (un array por parámetro), y los androides se reparten en bloques entre varias hebras.
+// Cada hebra evalúa los androides de 'num_carriles' en 'num_carriles', uno en cada carril 
+// de los registros SIMD: los valores, los senos y las matrices de esos androides también 
+// se guardan como estructura de arrays, y todos los bucles interiores recorren los carriles 
+// (con un número fijo de iteraciones y sin llamadas, así el compilador los vectoriza con '-O2').
+
+class EvaluadorAnimDroides
+{
+   public:
+   // 'hojas' son las partes del maestro (obtenidas con el camino de matrices), 
+   // 'desfases' tiene los desfases en el tiempo de cada parámetro de cada androide
+   // (el del parámetro 'ip' del androide 'ix+iz*nx' está en 'desfases[ip*nx*nz + ix+iz*nx]')
+   EvaluadorAnimDroides( Cuadroide * master, const std::vector<HojaNGE> & hojas, 
+                         const unsigned p_nx, const unsigned p_nz, 
+                         const std::vector<float> & desfases );
+
+   // evalúa la animación en los tiempos 'tiempo_par' de cada parámetro, y escribe 
+   // las matrices de la parte 'k' de todos los androides en 'destinos[k]'
+   void evaluar( const std::vector<float> & tiempo_par, 
+                 const std::vector<DestinoParteDroides> & destinos );
+
+   unsigned leerNumHebras() const { return num_hebras ; }
+
+   // número de androides que se evalúan a la vez
+   static constexpr unsigned num_carriles = 8 ;
+
+   private:
+
+   // evalúa los androides con índices en [id_ini,id_fin) (cada hebra evalúa un bloque, 
+   // 'id_ini' es múltiplo de 'num_carriles')
+   void evaluarBloque( const std::vector<float> & tiempo_par, 
+                       const std::vector<DestinoParteDroides> & destinos, 
+                       const unsigned id_ini, const unsigned id_fin ) ;
+
+   // esqueleto de una parte: su matriz es fijas[0]*P[params[0]]*fijas[1]*P[params[1]]*...*fijas[n]
+   // (donde 'P[i]' es la matriz del parámetro 'i' y 'n' es el número de parámetros de su camino)
+   struct ParteEsqueleto
+   {
+      std::vector<unsigned>  params ;
+      std::vector<glm::mat4> fijas ;
+   } ;
+
+   unsigned nx = 0, nz = 0, numpar = 0 ;
+   unsigned num_hebras = 1 ; 
+   unsigned num_droides_rell = 0 ;  // 'nx*nz' redondeado a un múltiplo de 'num_carriles'
+
+   std::vector<ParteEsqueleto>  partes ;
+   std::vector<OndaParamCuadroide> ondas ;   // oscilación de cada parámetro
+   std::vector<float> desfases ; // desfase de cada parámetro de cada androide (un array de 'num_droides_rell' 
+                                 // valores por parámetro, los de relleno a cero)
+} ;
+
 // *****************************************************************************
 
 class FormacionDroides : public ObjetoVisu
@@ -124,6 +227,10 @@ class FormacionDroides : public ObjetoVisu
    FormacionDroides( const unsigned pnx, const unsigned pnz );
    virtual ~FormacionDroides() ;
 
+   // activa o desactiva el dibujo instanciado (si está desactivado, se recorre 
+   // el grafo del androide maestro para cada androide de la formación)
+   void fijarUsarInstancias( const bool nuevo_usar_instancias ) { usar_instancias = nuevo_usar_instancias ; }
+
    virtual unsigned leerNumParametros() const ; // tiene 10 parámetros
    virtual void actualizarEstadoParametro( const unsigned iParam, const float t_sec );
    virtual void visualizarGL() ;
@@ -131,11 +238,33 @@ class FormacionDroides : public ObjetoVisu
    virtual void visualizarNormalesGL ()  ;
    virtual void visualizarModoSeleccionGL() ;
 
+   // suma la memoria del androide maestro y de los VAOs de los grupos de instancias
+   virtual void acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const override ;
+
+   // simulación en otra hebra: las matrices de las instancias se calculan con el evaluador en la 
+   // hebra de simulación, y la hebra principal solo las copia en los VBOs (los grupos y el evaluador 
+   // se crean antes, en 'prepararInstantaneas')
+   virtual void prepararInstantaneas() override ;
+   virtual void calcularInstantanea( InstantaneaSimulacion & inst ) override ;
+   virtual void aplicarInstantanea( const InstantaneaSimulacion & inst ) override ;
+
    private:
 
    void visu_master( unsigned modo );
    void visu_gen( unsigned modo );
 
+   // dibujo instanciado: se usa para los modos 0 (visualizarGL) y 1 (visualizarGeomGL)
+   void visu_inst( unsigned modo );
+
+   // crea los grupos de instancias (la primera vez que se visualiza con dibujo instanciado)
+   void crearGruposInstancias();
+
+   // calcula en la CPU las matrices de todas las partes de todos los androides (con
+   // el evaluador de la animación) y las envía a los VBOs de matrices de los grupos
+   void actualizarMatricesInstancias();
+
+   friend void BenchmarkFormacionDroides();
+
    float delta_t( const unsigned ip, const unsigned ix, const unsigned iz ) const ;
    unsigned numpar = 0 ;
 
@@ -147,9 +276,25 @@ class FormacionDroides : public ObjetoVisu
 
    Cuadroide * master = nullptr ;
 
+   // estado del dibujo instanciado
+   bool usar_instancias       = true ;  // true -> dibujo instanciado, false -> recorrer grafo por androide
+   bool matrices_actualizadas = false ; // false si ha cambiado algún parámetro desde que se calcularon las matrices
+
+   std::vector<GrupoInstDroides> grupos ;          // grupos de instancias (vacío hasta que se crean)
+   std::vector<unsigned>         grupo_parte ;     // índice del grupo de cada parte (hoja) del maestro
+   std::vector<unsigned>         ind_parte_grupo ; // índice de cada parte dentro de su grupo
+   EvaluadorAnimDroides *        evaluador = nullptr ; // evaluador de la animación (se crea con los grupos)
+
    std::default_random_engine generator{ (std::random_device())() };
    std::uniform_real_distribution<float> uniform_dist{ 0.0f, 1.0f } ;
 
    
 };
 
+// *****************************************************************************
+// Mide el tiempo por cuadro de formaciones de androides de 20x20 hasta 500x500, 
+// con dibujo instanciado y recorriendo el grafo, e imprime los resultados en 'cout'
+// (se visualiza en el framebuffer actual, con el cauce de la aplicación 3D)
+
+void BenchmarkFormacionDroides();
+
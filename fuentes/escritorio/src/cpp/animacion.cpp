@@ -28,15 +28,8 @@
 #include "animacion.h" 
 #include "aplic-3d.h"
 
-using namespace std::chrono ;
 //using namespace tup_mat ;
 
-// tipo de datos para duraciones en segundos
-typedef duration<float,std::ratio<1,1>> DuracionSeg ;
-
-// instante de inicio de animaciones o instante de la última actualización
-time_point<steady_clock> ultima_actu ;
-
 // valor que indica si las animaciones están activadas o no lo están
 // (si lo están, se llama periodicamente a 'ActualizarEstado' para el objeto actual)
 
@@ -59,17 +52,26 @@ bool ActualizarEstado( )
    // if ( objeto.leerNumParametros() == 0 )
    //    return false ;
 
-   // calcular el instante actual y el tiempo transcurrido desde el anterior
-   const time_point<steady_clock> ahora = steady_clock::now();
-   const float tiempo_seg = DuracionSeg(ahora - ultima_actu).count();
+   AplicacionBase * apl   = AplicacionBase::instancia();
+   RitmoCuadros &   ritmo = apl->ritmoCuadros();
+
+   // con la simulación en una hebra propia, solo se visualiza el último estado que ha publicado
+   if ( apl->simulacionConcurrente() && apl->aplicarEstadoSimulado() )
+      return true ;
 
-   // fijar instante actual como instante de última actualización
-   ultima_actu = ahora ;
+   // calcular cuántos pasos fijos de simulación caben en el tiempo transcurrido desde la 
+   // actualización anterior (la velocidad de la animación no depende de los cuadros por segundo)
+   double         alfa  = 0.0 ;
+   const unsigned pasos = ritmo.avanzarSimulacion( alfa );
 
-   // actualizar el estado de la aplicación
-   
-   AplicacionBase * apl = AplicacionBase::instancia();
-   return apl->actualizarEstado( tiempo_seg );
+   // actualizar el estado de la aplicación, paso a paso
+   for( unsigned i = 0 ; i < pasos ; i++ )
+      apl->actualizarEstado( float( RitmoCuadros::paso_simulacion ) );
+
+   // visualizar el estado interpolado entre los dos últimos pasos: el instante visualizado va 
+   // un paso por detrás del real (así cambia de forma continua aunque no coincida con los pasos)
+   apl->interpolarEstado( float( (1.0-alfa)*RitmoCuadros::paso_simulacion ) );
+   return true ;
 }
 
 //----------------------------------------------------------------------
@@ -89,7 +91,7 @@ bool ProcesarTeclaAnimacion( ObjetoVisu * objeto, int glfw_key )
       case GLFW_KEY_KP_ADD :    // tecla '+' en el teclado numérico ¿?
          if ( ! animaciones_activadas )
          {  animaciones_activadas = true ;
-            ultima_actu = steady_clock::now(); // registrar instante de última actualización
+            AplicacionBase::instancia()->ritmoCuadros().iniciarSimulacion(); // empezar a contar el tiempo simulado
             cout << "Animaciones activadas." << endl ;
          }
          else
@@ -98,6 +100,18 @@ bool ProcesarTeclaAnimacion( ObjetoVisu * objeto, int glfw_key )
          }
          break ;
 
+      case GLFW_KEY_F :  // cambiar el ritmo de los cuadros (60 fps, 30 fps, vsync, sin límite)
+         AplicacionBase::instancia()->cambiarRitmo();
+         redisp = false ;
+         break ;
+
+      case GLFW_KEY_H :  // simular las animaciones en una hebra propia, o en la principal
+      {  AplicacionBase * apl = AplicacionBase::instancia();
+         apl->fijarSimulacionConcurrente( ! apl->simulacionConcurrente() );
+         redisp = false ;
+         break ;
+      }
+
       //case GLFW_KEY_PAGE_DOWN :
       case GLFW_KEY_SLASH :        // tecla con '-' y '_' en el teclado normal (NO en la plantilla)
       case GLFW_KEY_KP_SUBTRACT :  // tecla '-' en el teclado numérico
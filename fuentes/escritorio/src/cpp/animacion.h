@@ -38,7 +38,8 @@
 
 /// @brief Función  que actuliza periodicamente el estado de la aplicación actual
 /// @brief   (1) calcula el tiempo real transcurrido desde la última llamada a esta función
-///  @brief  (2) actualiza el estado del objeto, usando ese tiempo transcurrido
+///  @brief  (2) actualiza el estado del objeto, usando ese tiempo transcurrido, en pasos fijos
+///  @brief  (3) pone el estado visible interpolado entre los dos últimos pasos
 ///
 bool ActualizarEstado( ) ;
 
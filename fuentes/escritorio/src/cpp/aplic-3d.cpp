@@ -23,18 +23,28 @@
 // **
 // *********************************************************************
 
+#include <thread>   // std::this_thread::sleep_for
+#include <optional> // std::optional
 #include "utilidades.h"
 #include "camara.h"
 #include "colecciones-objs.h"
 #include "materiales-luces.h"
 #include "animacion.h"
+#include "androide.h"   // BenchmarkFormacionDroides
+#include "malla-ind.h"  // BenchmarkDisposicionesVAO
+#include "almacen-geom.h"
+#include "cache-recursos.h"
+#include "compresion-bc.h"  // BenchmarkCompresionBC
+#include "perfilador.h"
+#include "tiempos-cuadros.h"
+#include "rasterizador-cpu.h"
 #include "aplic-3d.h"
 
 // ---------------------------------------------------------------------
 
-Aplicacion3D::Aplicacion3D( const unsigned major, const unsigned minor )
+Aplicacion3D::Aplicacion3D( const unsigned major, const unsigned minor, const bool sin_ventana )
 
-: AplicacionBase( major, minor ) 
+: AplicacionBase( major, minor, sin_ventana ) 
 
 {
    using namespace std ;
@@ -67,7 +77,7 @@ Aplicacion3D::Aplicacion3D( const unsigned major, const unsigned minor )
    colecciones_objs.push_back( new ColeccionObjs3D_5() );
    colecciones_objs.push_back( new ColeccionObjs3D_6() );
    
-   cout << "Colecciones de objetos creadas." << endl ;
+   cout << "Colecciones de objetos creadas (cada objeto se crea en segundo plano al seleccionarlo por primera vez)." << endl ;
 
    // Dar un valor inicial adecuado a las variables de instancia 'col_fuentes' y 'material_ini'
    // (para 'col_fuentes', se usa una instancia de 'Col2Fuentes'). Los parámetros del material 
@@ -109,6 +119,9 @@ Aplicacion3D::~Aplicacion3D()
    using namespace std ;
    //cout << __FUNCTION__ << " inicio" << endl ;
 
+   // detener la simulación antes de eliminar los objetos que simula
+   hebra_simulacion.detener();
+
    // eliminar el cauce
    delete cauce ;
    cauce = nullptr ;
@@ -124,6 +137,11 @@ Aplicacion3D::~Aplicacion3D()
       delete col ;
    }
    colecciones_objs.clear() ;
+
+   // destruir ya los objetos de las colecciones, con el contexto de OpenGL todavía activo: 
+   // con sus nodos se destruyen los materiales y las texturas, y al destruirse la última 
+   // imagen de textura de un arreglo, el arreglo ('ArregloTexturas::liberarCapa')
+   ObjetoVisu::destruirPendientes();
    //cout << __FUNCTION__ << " fin." << endl ;
 
 }
@@ -165,15 +183,56 @@ bool Aplicacion3D::animable()
 }
 
 // ---------------------------------------------------------------------
+
+bool Aplicacion3D::hayCargasPendientes()
+{
+   if ( AplicacionBase::hayCargasPendientes() )
+      return true ;
+   for( ColeccionObjs * col : colecciones_objs )
+      if ( col->numCargasPendientes() > 0 )
+         return true ;
+   return false ;
+}
+// ---------------------------------------------------------------------
   
 bool Aplicacion3D::actualizarEstado( const float tiempo_seg ) 
 {
+   // el estado de los objetos es función del tiempo de sus parámetros: en cada paso de la 
+   // simulación basta con avanzar los tiempos, el estado se calcula una vez por cuadro en 
+   // 'interpolarEstado'
    assert( animable() );
-   coleccionActual()->objetoActual()->actualizarEstado( tiempo_seg );
+   coleccionActual()->objetoActual()->avanzarTiempoParametros( tiempo_seg );
    return true ;
 }
 // ---------------------------------------------------------------------
 
+void Aplicacion3D::interpolarEstado( const float retraso_seg )
+{
+   assert( animable() );
+   coleccionActual()->objetoActual()->fijarEstadoDesplazado( -retraso_seg );
+}
+// ---------------------------------------------------------------------
+
+bool Aplicacion3D::aplicarEstadoSimulado()
+{
+   // se simula el objeto actual: si ha cambiado (o la hebra estaba detenida), se vuelve a iniciar
+   assert( animable() );
+   ObjetoVisu * objeto = coleccionActual()->objetoActual() ;
+   if ( hebra_simulacion.leerObjeto() != objeto )
+   {  hebra_simulacion.detener();
+      hebra_simulacion.iniciar( objeto );
+   }
+   hebra_simulacion.aplicarUltima();
+   return true ;
+}
+// ---------------------------------------------------------------------
+
+void Aplicacion3D::detenerSimulacion()
+{
+   hebra_simulacion.detener();
+}
+// ---------------------------------------------------------------------
+
 Cauce3D * Aplicacion3D::cauce3D() 
 {
    using namespace std ;
@@ -196,32 +255,48 @@ void Aplicacion3D::visualizarFrame()
    using namespace std ;
    CError();
 
+   // contar el cuadro en la captura del perfil (si hay una en curso), antes de abrir las zonas
+   Perfilador::instancia()->inicioCuadro();
+   MedidorCuadros::instancia()->inicioVisualizacion();
+   ZONA_PERFIL_CPU( "visualizarFrame" );
+   ZONA_PERFIL_GPU( "visualizarFrame" );
+
    // asegurarnos de que existe un cauce
    assert( cauce != nullptr );
-  
-   // Configuración de OpenGL:
-   //    + habilitar test de comparación de profundidades para 3D (y 2D)
-   //      (no está por defecto: https://www.opengl.org/wiki/Depth_Buffer)
-   //    + deshabilitar filtrado de triangulos por su orientación:
-   //    + dibujar los polígonos rellenos más atrás que las aristas (fijar el 'polygon offset')
-   
-   glEnable( GL_DEPTH_TEST );   
-   glDisable( GL_CULL_FACE );  
-   glEnable( GL_POLYGON_OFFSET_FILL ); 
-   glPolygonOffset( 1.0, 1.0 );    
-   CError();
- 
-   // fijar el viewport
-   glViewport( 0, 0, ventana_tam_x, ventana_tam_y );
-   CError();
 
-   // Establecer color de fondo y limpiar la ventana
-   if ( fondo_blanco )
-      glClearColor( 0.75, 0.75, 0.75, 1.0 ) ;
+   const glm::vec3 fondo = fondo_blanco ? glm::vec3( 0.75, 0.75, 0.75 ) : glm::vec3( 0.2, 0.25, 0.3 );
+
+   // con el rasterizador por software no hay contexto de OpenGL: los VAOs se dibujan en su 
+   // imagen (que se borra igual)
+   if ( RasterizadorCPU::activo() )
+      RasterizadorCPU::instancia()->iniciarCuadro( ventana_tam_x, ventana_tam_y, fondo );
    else
-   glClearColor( 0.2, 0.25, 0.3, 1.0 );
-   glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-   CError();
+   {
+      // sin ventana, se visualiza en el framebuffer (se redimensiona si ha cambiado el tamaño)
+      if ( sinVentana() )
+         fbo_sin_ventana->activar( ventana_tam_x, ventana_tam_y );
+     
+      // Configuración de OpenGL:
+      //    + habilitar test de comparación de profundidades para 3D (y 2D)
+      //      (no está por defecto: https://www.opengl.org/wiki/Depth_Buffer)
+      //    + deshabilitar filtrado de triangulos por su orientación:
+      //    + dibujar los polígonos rellenos más atrás que las aristas (fijar el 'polygon offset')
+      
+      glEnable( GL_DEPTH_TEST );   
+      glDisable( GL_CULL_FACE );  
+      glEnable( GL_POLYGON_OFFSET_FILL ); 
+      glPolygonOffset( 1.0, 1.0 );    
+      CError();
+    
+      // fijar el viewport
+      glViewport( 0, 0, ventana_tam_x, ventana_tam_y );
+      CError();
+
+      // Establecer color de fondo y limpiar la ventana
+      glClearColor( fondo.r, fondo.g, fondo.b, 1.0 );
+      glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+      CError();
+   }
 
    // visualizar el objeto actual de la colección actual
    visualizarGL_OA() ;
@@ -237,15 +312,284 @@ void Aplicacion3D::visualizarFrame()
       if ( fbo != nullptr )
          DibujarFBO( *cauce, *fbo );
    }
+
+   // rasterizar lo que quede pendiente en el rasterizador por software
+   if ( RasterizadorCPU::activo() )
+      RasterizadorCPU::instancia()->terminarCuadro();
    
    // visualizar en pantalla el buffer trasero (donde se han dibujado las primitivas)
-   glfwSwapBuffers( ventana_glfw );
+   if ( ! sinVentana() )
+      glfwSwapBuffers( ventana_glfw );
+
+   // guardar los contadores de este cuadro (y empezar a contar los del siguiente), y
+   // registrar el tiempo del cuadro (con los contadores, si es un tirón)
+   estadisticas_cuadro = EstadisticasRender::leerYReiniciar();
+   MedidorCuadros::instancia()->finCuadro( estadisticas_cuadro );
 
    // si queremos imprimir los tiempos por cuadro, hacerlo.
    if ( imprimir_tiempos )
-      ImprimirFPS();
+      MedidorCuadros::instancia()->imprimirCuadro( std::cout );
+}
+
+// ---------------------------------------------------------------------
+
+void Aplicacion3D::visualizarSinVentana( const std::string & carpeta )
+{
+   using namespace std ;
+   using namespace std::chrono ;
+   assert( sinVentana() );
+
+   ofstream csv( carpeta + "/tiempos.csv" );
+   if ( ! csv.is_open() )
+   {
+      cout << "Error: no se puede escribir en la carpeta '" << carpeta << "' (aborto)." << endl ;
+      exit(1);
+   }
+   csv << "coleccion,objeto,nombre,cpu_ms,gpu_ms,imagen," ;
+   EstadisticasRender::escribirCabeceraCSV( csv );
+   csv << endl ;
+
+   // (con el rasterizador por software no hay contexto de OpenGL, ni tiempo de GPU)
+   const bool gpu      = ! RasterizadorCPU::activo() ;
+   GLuint     consulta = 0 ;
+   if ( gpu )
+      glGenQueries( 1, &consulta );
+
+   for( ind_coleccion_act = 0 ; ind_coleccion_act < colecciones_objs.size() ; ind_coleccion_act++ )
+   {
+      ColeccionObjs * col = coleccionActual() ;
+      for( unsigned j = 0 ; j < col->numObjetos() ; j++ )
+      {
+         // esperar a que se cree el objeto y se envíen sus texturas
+         esperarCargas();
+
+         // visualizar el frame medido: tiempo de CPU hasta que se han enviado todas las 
+         // órdenes, y tiempo de GPU con una consulta 'GL_TIME_ELAPSED'
+         const auto t0 = steady_clock::now();
+         if ( gpu )
+            glBeginQuery( GL_TIME_ELAPSED, consulta );
+         visualizarFrame();
+         if ( gpu )
+            glEndQuery( GL_TIME_ELAPSED );
+         const auto t1 = steady_clock::now();
+         GLuint64 ns_gpu = 0 ;
+         if ( gpu )
+            glGetQueryObjectui64v( consulta, GL_QUERY_RESULT, &ns_gpu );
+         CError();
+
+         const string imagen = "col" + to_string( ind_coleccion_act+1 ) + "-obj" + to_string( j+1 ) + ".ppm" ;
+         const bool escrita = RasterizadorCPU::activo() ? RasterizadorCPU::instancia()->escribirPPM( carpeta + "/" + imagen )
+                                                        : fbo_sin_ventana->escribirPPM( carpeta + "/" + imagen );
+         if ( ! escrita )
+            cout << "No se ha podido escribir la imagen '" << imagen << "'" << endl ;
+
+         csv << (ind_coleccion_act+1) << "," << (j+1) << "," << "\"" << col->objetoActual()->leerNombre() << "\"" << "," 
+             << duration<double,milli>( t1-t0 ).count() << "," << double( ns_gpu )*1e-6 << "," << imagen << "," ;
+         estadisticas_cuadro.escribirCSV( csv );
+         csv << endl ;
+
+         col->siguienteObjeto();
+      }
+   }
+   ind_coleccion_act = 0 ;
+   if ( gpu )
+      glDeleteQueries( 1, &consulta );
+   cout << "Visualización sin ventana terminada, resultados en '" << carpeta << "'" << endl ;
+}
+// ---------------------------------------------------------------------
+
+void Aplicacion3D::esperarCargas()
+{
+   // se visualiza en cada iteración, para que las texturas pidan el detalle que necesitan
+   do 
+   {  visualizarFrame();
+      completarCargas();
+      if ( hayCargasPendientes() )
+         std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+   }
+   while( hayCargasPendientes() );
+}
+// ---------------------------------------------------------------------
+// Punto de vista en el instante 't' (entre 0 y 1) del camino que sigue la cámara en 'medirTiempos', 
+// mirando al origen: una vuelta completa alrededor del eje Y, subiendo y bajando una vez, y 
+// acercándose y alejándose dos veces (empieza en el punto de vista de la primera cámara)
+
+static glm::vec3 PuntoRecorrido( const float t )
+{
+   const float ang  = 2.0f*float(M_PI)*t ,
+               a    = 0.25f*float(M_PI) + ang ,                     // longitud
+               b    = 0.6155f + 0.45f*std::sin( ang ) ,              // latitud (entre 0.17 y 1.07 rad.)
+               dist = std::sqrt( 27.0f )*( 0.7f + 0.3f*std::cos( 2.0f*ang ) ); // distancia al origen
+
+   return dist*glm::vec3( std::cos( b )*std::sin( a ), std::sin( b ), std::cos( b )*std::cos( a ) );
 }
+// ---------------------------------------------------------------------
+
+void Aplicacion3D::medirTiempos( const std::string & carpeta, const unsigned num_calentamiento, const unsigned num_medidos )
+{
+   using namespace std ;
+   using namespace std::chrono ;
+   assert( sinVentana() );
+   assert( 0 < num_medidos );
 
+   ofstream csv( carpeta + "/medidas.csv" ),
+            json( carpeta + "/medidas.json" );
+   if ( ! csv.is_open() || ! json.is_open() )
+   {
+      cout << "Error: no se puede escribir en la carpeta '" << carpeta << "' (aborto)." << endl ;
+      exit(1);
+   }
+   // con el rasterizador por software no hay contexto de OpenGL: el tiempo de GPU es 0
+   const bool  gpu      = ! RasterizadorCPU::activo() ;
+   GLint       viewport[4] = { 0, 0, GLint( ventana_tam_x ), GLint( ventana_tam_y ) } ;
+   std::string renderer = "rasterizador por software" ;
+   if ( gpu )
+   {  glGetIntegerv( GL_VIEWPORT, viewport );
+      renderer = (const char *) glGetString( GL_RENDERER );
+   }
+
+   csv  << "coleccion,objeto,nombre,cuadros,cpu_media_ms,cpu_p50_ms,cpu_p95_ms,cpu_p99_ms,"
+        << "gpu_media_ms,gpu_p50_ms,gpu_p95_ms,gpu_p99_ms," ;
+   EstadisticasRender::escribirCabeceraCSV( csv );
+   csv << endl ;
+   json << "{" << endl 
+        << "  \"renderer\": \"" << renderer << "\"," << endl 
+        << "  \"ancho\": " << viewport[2] << ", \"alto\": " << viewport[3] << "," << endl 
+        << "  \"cuadros_calentamiento\": " << num_calentamiento << ", \"cuadros_medidos\": " << num_medidos << "," << endl 
+        << "  \"cuantizacion\": \"" << NombreCuantizacion( DescrVAO::leerCuantizacionDefecto() ) << "\"," 
+        << " \"disposicion\": \"" << NombreDisposicion( DescrVAO::leerDisposicionDefecto() ) << "\"," << endl 
+        << "  \"objetos\": [" ;
+
+   // escribe la media y los percentiles de unos tiempos en el CSV o en el JSON
+   auto escribir_csv = [&]( const vector<double> & t ) 
+   {
+      double suma = 0.0 ;
+      for( const double v : t )
+         suma += v ;
+      csv << "," << suma/double( t.size() ) << "," << Percentil( t, 50.0 ) << "," << Percentil( t, 95.0 ) << "," << Percentil( t, 99.0 ) ;
+   };
+   auto escribir_json = [&]( const vector<double> & t ) 
+   {
+      double suma = 0.0 ;
+      for( const double v : t )
+         suma += v ;
+      json << "{ \"media\": " << suma/double( t.size() ) << ", \"p50\": " << Percentil( t, 50.0 ) 
+           << ", \"p95\": " << Percentil( t, 95.0 ) << ", \"p99\": " << Percentil( t, 99.0 ) << " }" ;
+   };
+
+   // una consulta 'GL_TIME_ELAPSED' por cuadro medido: los resultados se leen al final, para 
+   // no esperar a la GPU entre cuadros
+   vector<GLuint> consultas( num_medidos );
+   if ( gpu )
+      glGenQueries( num_medidos, consultas.data() );
+
+   // la cámara del recorrido se usa en lugar de las de la aplicación mientras se mide, se
+   // crea de nuevo en cada cuadro con el punto de vista del camino en el instante 't'
+   // (no se puede asignar una cámara a otra, se destruye y se construye en el mismo sitio)
+   const unsigned         ind_camara_ant = ind_camara_actual ;
+   optional<Camara3Modos> camara ;
+   ind_camara_actual = camaras.size() ;
+   camaras.push_back( &camara.emplace() );
+
+   auto situar_camara = [&]( const float t ) 
+   {
+      camara.emplace( true, PuntoRecorrido( t ), 1.0, glm::vec3( 0.0, 0.0, 0.0 ), 70.0 );
+   };
+
+   vector<double> cpu_ms( num_medidos ), gpu_ms( num_medidos ),
+                  cpu_ms_total, gpu_ms_total ;
+   bool           primero = true ;
+
+   for( ind_coleccion_act = 0 ; ind_coleccion_act < colecciones_objs.size() ; ind_coleccion_act++ )
+   {
+      ColeccionObjs * col = coleccionActual() ;
+      for( unsigned j = 0 ; j < col->numObjetos() ; j++ )
+      {
+         const string nombre = col->objetoActual()->leerNombre() ;
+         cout << "Midiendo tiempos de '" << nombre << "' (colección " << (ind_coleccion_act+1) << ", objeto " << (j+1) << ") ..." << endl ;
+
+         // calentamiento: recorrer el camino completo (más deprisa), completando las cargas 
+         // de texturas que se pidan, y esperar a que terminen todas
+         for( unsigned k = 0 ; k < num_calentamiento ; k++ )
+         {
+            situar_camara( float(k)/float(num_calentamiento) );
+            visualizarFrame();
+            completarCargas();
+         }
+         situar_camara( 0.0f );
+         esperarCargas();
+         if ( gpu )
+            glFinish();
+
+         // cuadros medidos (el tiempo de CPU es el de envío de las órdenes, sin esperar a la GPU)
+         for( unsigned k = 0 ; k < num_medidos ; k++ )
+         {
+            situar_camara( float(k)/float(num_medidos) );
+            const auto t0 = steady_clock::now();
+            if ( gpu )
+               glBeginQuery( GL_TIME_ELAPSED, consultas[k] );
+            visualizarFrame();
+            if ( gpu )
+               glEndQuery( GL_TIME_ELAPSED );
+            cpu_ms[k] = duration<double,milli>( steady_clock::now()-t0 ).count() ;
+         }
+         for( unsigned k = 0 ; k < num_medidos ; k++ )
+         {
+            GLuint64 ns_gpu = 0 ;
+            if ( gpu )
+               glGetQueryObjectui64v( consultas[k], GL_QUERY_RESULT, &ns_gpu );
+            gpu_ms[k] = double( ns_gpu )*1e-6 ;
+         }
+         CError();
+         cpu_ms_total.insert( cpu_ms_total.end(), cpu_ms.begin(), cpu_ms.end() );
+         gpu_ms_total.insert( gpu_ms_total.end(), gpu_ms.begin(), gpu_ms.end() );
+
+         csv << (ind_coleccion_act+1) << "," << (j+1) << ",\"" << nombre << "\"," << num_medidos ;
+         escribir_csv( cpu_ms );
+         escribir_csv( gpu_ms );
+         csv << "," ;
+         estadisticas_cuadro.escribirCSV( csv ); // (del último cuadro medido, el recorrido es igual para todos)
+         csv << endl ;
+
+         json << (primero ? "" : ",") << endl 
+              << "    { \"coleccion\": " << (ind_coleccion_act+1) << ", \"objeto\": " << (j+1) 
+              << ", \"nombre\": \"" << nombre << "\"," << endl << "      \"cpu_ms\": " ;
+         escribir_json( cpu_ms );
+         json << "," << endl << "      \"gpu_ms\": " ;
+         escribir_json( gpu_ms );
+         json << "," << endl << "      \"estadisticas\": " ;
+         estadisticas_cuadro.escribirJSON( json );
+         json << " }" ;
+         primero = false ;
+
+         col->siguienteObjeto();
+      }
+   }
+
+   // totales: todos los cuadros medidos de todos los objetos
+   if ( ! cpu_ms_total.empty() )
+   {
+      csv << "0,0,\"total\"," << cpu_ms_total.size() ;
+      escribir_csv( cpu_ms_total );
+      escribir_csv( gpu_ms_total );
+      csv << ",,,,,,,,,,,,," << endl ; // (sin estadísticas)
+
+      json << endl << "  ]," << endl << "  \"total\": { \"cuadros\": " << cpu_ms_total.size() << "," << endl << "      \"cpu_ms\": " ;
+      escribir_json( cpu_ms_total );
+      json << "," << endl << "      \"gpu_ms\": " ;
+      escribir_json( gpu_ms_total );
+      json << " }" << endl << "}" << endl ;
+   }
+   else
+      json << endl << "  ]" << endl << "}" << endl ;
+
+   camaras.pop_back();
+   ind_camara_actual = ind_camara_ant ;
+   ind_coleccion_act = 0 ;
+   if ( gpu )
+      glDeleteQueries( num_medidos, consultas.data() );
+   cout << "Medida de tiempos terminada, resultados en '" << carpeta << "/medidas.csv' y '" << carpeta << "/medidas.json'" << endl ;
+}
 // ---------------------------------------------------------------------
 
 void  Aplicacion3D::imprimeInfoColeccionActual() 
@@ -260,6 +604,85 @@ void  Aplicacion3D::imprimeInfoColeccionActual()
 
 // ---------------------------------------------------------------------
 
+void Aplicacion3D::informeUsoMemoria()
+{
+   using namespace std ;
+   const string nombre_arch = "uso-memoria.json" ;
+
+   // informe legible de la colección actual
+   cout << endl ;
+   coleccionActual()->imprimirUsoMemoria();
+
+   // informe de todas las colecciones en el archivo (los recursos compartidos entre 
+   // colecciones se cuentan en la primera en la que aparecen)
+   ofstream arch( nombre_arch );
+   if ( ! arch.is_open() )
+   {  cout << "Error: no se puede crear el archivo '" << nombre_arch << "'" << endl ;
+      return ;
+   }
+   UsoMemoria            total ;
+   set<const void *>     contados ;
+
+   // con qué tablas cuantizadas se han creado los VAOs (para comparar la memoria en la GPU)
+   arch << "{" << endl 
+        << "  \"cuantizacion\": \"" << NombreCuantizacion( DescrVAO::leerCuantizacionDefecto() ) << "\"," << endl 
+        << "  \"colecciones\": [" << endl ;
+   for( unsigned i = 0 ; i < colecciones_objs.size() ; i++ )
+   {
+      colecciones_objs[i]->escribirUsoMemoriaJSON( arch, total, contados );
+      arch << ( i+1 < colecciones_objs.size() ? "," : "" ) << endl ;
+   }
+   arch << "  ]," << endl ;
+
+   // framebuffer de selección (se suma al total)
+   UsoMemoria uso_fbo ;
+   if ( fbo != nullptr )
+      uso_fbo = fbo->leerUsoMemoria();
+   total += uso_fbo ;
+   arch << "  \"framebuffer_seleccion\": " ;
+   uso_fbo.escribirJSON( arch );
+   arch << "," << endl ;
+
+   // anillo de PBOs para enviar texturas (se suma al total)
+   const UsoMemoria uso_pbos = SubidorTexturas::instancia()->leerUsoMemoria();
+   total += uso_pbos ;
+   arch << "  \"pbos_texturas\": " ;
+   uso_pbos.escribirJSON( arch );
+   arch << "," << endl ;
+
+   // arreglos de texturas (se suman al total: las imágenes no cuentan sus capas)
+   const UsoMemoria uso_arreglos = ArregloTexturas::leerUsoMemoriaTotal();
+   total += uso_arreglos ;
+   arch << "  \"arreglos_texturas\": " ;
+   uso_arreglos.escribirJSON( arch );
+   arch << "," << endl ;
+
+   // capacidad del almacén de geometría (no se suma: las regiones ocupadas ya están en los objetos)
+   UsoMemoria uso_almacen ;
+   if ( AlmacenGeometria::creado() )
+      uso_almacen = AlmacenGeometria::instancia()->leerUsoMemoria();
+   arch << "  \"almacen_geometria\": " ;
+   uso_almacen.escribirJSON( arch );
+   arch << "," << endl ;
+
+   // aciertos y fallos de la caché de recursos (archivos leídos una sola vez)
+   arch << "  \"cache_recursos\": " ;
+   CacheRecursos::instancia()->escribirJSON( arch );
+   arch << "," << endl ;
+
+   arch << "  \"total\": " ;
+   total.escribirJSON( arch );
+   arch << endl << "}" << endl ;
+
+   cout << "Memoria total de la aplicación (tablas cuantizadas: " << NombreCuantizacion( DescrVAO::leerCuantizacionDefecto() ) << "): " ;
+   total.imprimir( cout );
+   cout << endl ;
+   CacheRecursos::instancia()->imprimirEstadisticas( cout );
+   cout << "Informe completo escrito en '" << nombre_arch << "'." << endl << flush ;
+}
+
+// ---------------------------------------------------------------------
+
 void Aplicacion3D::mgePulsarLevantarTecla( GLFWwindow* window, int key, int scancode, int action, int mods )
 {
   using namespace std ;
@@ -421,6 +844,39 @@ void Aplicacion3D::mgePulsarLevantarTecla( GLFWwindow* window, int key, int scan
          imprimir_tiempos = ! imprimir_tiempos ;
          cout << "imprimir tiempos : " << (imprimir_tiempos ? "activado" : "desactivado") << endl << flush ;
          break ;
+
+      case GLFW_KEY_B :   // medir tiempos de formaciones de androides de tamaño creciente
+         BenchmarkFormacionDroides();
+         break ;
+
+      case GLFW_KEY_D :   // medir tiempos con cada disposición de los atributos en los VAOs
+         BenchmarkDisposicionesVAO();
+         break ;
+
+      case GLFW_KEY_K :   // medir calidad y velocidad de la compresión de texturas (BC1 y BC7)
+         BenchmarkCompresionBC();
+         redib = false ;
+         break ;
+
+      case GLFW_KEY_X :   // imprimir las estadísticas del último cuadro (dibujos, cambios de estado, bytes enviados)
+         cout << "Estadísticas del último cuadro:" << endl ;
+         estadisticas_cuadro.imprimir( cout );
+         redib = false ;
+         break ;
+
+      case GLFW_KEY_Z :   // informe de los tiempos por cuadro (percentiles, histograma y tirones)
+         MedidorCuadros::instancia()->imprimirInforme( cout );
+         redib = false ;
+         break ;
+
+      case GLFW_KEY_J :   // capturar el perfil de los próximos cuadros (archivo JSON para 'chrome://tracing')
+         Perfilador::instancia()->iniciarCaptura( 60, "perfil.json" );
+         break ;
+
+      case GLFW_KEY_U :   // informe del uso de memoria (terminal y archivo JSON)
+         informeUsoMemoria();
+         redib = false ;
+         break ;
       
       case GLFW_KEY_T :
          {
@@ -541,6 +997,8 @@ void Aplicacion3D::mgeMovimientoRaton( GLFWwindow* window, double xpos, double y
 
 void Aplicacion3D::visualizarGL_OA(  )
 {
+   ZONA_PERFIL_CPU( "visualizarGL_OA" );
+   ZONA_PERFIL_GPU( "visualizarGL_OA" );
    CamaraInteractiva * camara = camaras[ind_camara_actual] ;
    ObjetoVisu * objeto = coleccionActual()->objetoActual() ;
    
@@ -580,7 +1038,8 @@ void Aplicacion3D::visualizarGL_OA(  )
       (modo_visu == ModosVisu::puntos) ?  GL_POINT :
       (modo_visu == ModosVisu::lineas) ?  GL_LINE  :
                                           GL_FILL  ;  // (modo_visu == modo relleno)
-   glPolygonMode( GL_FRONT_AND_BACK, modo_pol );
+   if ( ! RasterizadorCPU::activo() )
+      glPolygonMode( GL_FRONT_AND_BACK, modo_pol );
    
    CError();
 
@@ -634,7 +1093,8 @@ void Aplicacion3D::visualizarGL_OA(  )
       //      - fijar el modo de polígonos a modo 'lineas'
       
       cauce->fijarColor( 0.0, 0.0, 0.0 );
-      glPolygonMode( GL_FRONT_AND_BACK, GL_LINE ); // lineas
+      if ( ! RasterizadorCPU::activo() )
+         glPolygonMode( GL_FRONT_AND_BACK, GL_LINE ); // lineas
       objeto3D->visualizarGeomGL(  );
    }
 }
@@ -32,6 +32,8 @@
 #pragma once
 
 #include "aplic-base.h"
+#include "estadisticas-render.h"
+#include "hebra-simulacion.h"
 
 // --------------------------------------------------------------------
 ///
@@ -50,8 +52,9 @@ class Aplicacion3D : public AplicacionBase
    /// 
    /// @param major (unsigned) version de OpenGL requerida (major)
    /// @param minor (unsigned) version de OpenGL requerida (minor)
+   /// @param sin_ventana (bool) 'true' para visualizar en un framebuffer, sin ventana (ver 'visualizarSinVentana')
    ///
-   Aplicacion3D( const unsigned major, const unsigned minor ); 
+   Aplicacion3D( const unsigned major, const unsigned minor, const bool sin_ventana = false ); 
 
    /// @brief Destructor de Aplicacion3D: libera los recursos (cauce, pila de materiales, colecciones)
    ///
@@ -73,6 +76,9 @@ class Aplicacion3D : public AplicacionBase
 
    virtual void visualizarFrame() override ;
    virtual bool actualizarEstado( const float tiempo_seg ) override ;
+   virtual void interpolarEstado( const float retraso_seg ) override ;
+   virtual bool aplicarEstadoSimulado() override ;
+   virtual void detenerSimulacion() override ;
 
    // métodos gestores de eventos, redefinidos:
 
@@ -117,6 +123,11 @@ class Aplicacion3D : public AplicacionBase
    ///
    virtual bool animable() override ;
 
+   /// @brief Devuelve 'true' si alguna colección tiene objetos creándose en segundo plano (o hay texturas
+   /// @brief pendientes de enviar)
+   ///
+   virtual bool hayCargasPendientes() override ;
+
    /// @brief Método principal de selección, se llama al hacer click con el botón izquierdo
    /// @brief usa la posición donde se ha hecho click en coordenadas del dispositivo del FBO (enteras).
    /// @brief Si en ese pixel hay un objeto con identificador >0, ejecuta 'cuandoClick' del objeto.
@@ -136,10 +147,39 @@ class Aplicacion3D : public AplicacionBase
    ///
    bool iluminacionActiva() { return iluminacion ; } ; 
 
+   /// @brief devuelve las estadísticas de las órdenes enviadas a OpenGL en el último cuadro visualizado
+   ///
+   const EstadisticasRender & estadisticasCuadro() const { return estadisticas_cuadro ; }
+
    /// @brief Imprime información sobre la colección actual del objeto
    ///
    void imprimeInfoColeccionActual() ;
 
+   /// @brief Imprime la memoria en la CPU y la GPU de los objetos de la colección actual, y escribe 
+   /// @brief en el archivo 'uso-memoria.json' la de todas las colecciones, el framebuffer de 
+   /// @brief selección y el almacén de geometría
+   ///
+   void informeUsoMemoria() ;
+
+   /// @brief Sin ventana: visualiza cada objeto de cada colección (con la cámara actual) en el framebuffer,
+   /// @brief esperando antes a que el objeto y sus texturas estén completos, y escribe en 'carpeta' una 
+   /// @brief imagen PPM por objeto ('col<i>-obj<j>.ppm') y los tiempos de CPU y GPU de cada uno en 'tiempos.csv'
+   /// @brief (junto con las estadísticas del cuadro, ver 'EstadisticasRender')
+   /// @param carpeta - carpeta donde se escriben los archivos (debe existir)
+   ///
+   void visualizarSinVentana( const std::string & carpeta );
+
+   /// @brief Sin ventana: mide los tiempos de CPU y GPU por cuadro de cada objeto de cada colección, con una 
+   /// @brief cámara que recorre siempre el mismo camino alrededor del objeto. Se visualizan 'num_calentamiento'
+   /// @brief cuadros (recorriendo el camino completo, para que se completen las cargas de texturas) y después
+   /// @brief 'num_medidos' cuadros medidos. Escribe la media y los percentiles 50, 95 y 99 de cada objeto (y del 
+   /// @brief total) en 'medidas.csv' y 'medidas.json', con las estadísticas del último cuadro medido de cada objeto
+   /// @param carpeta - carpeta donde se escriben los archivos (debe existir)
+   /// @param num_calentamiento - número de cuadros visualizados antes de medir
+   /// @param num_medidos - número de cuadros medidos (al menos 1)
+   ///
+   void medirTiempos( const std::string & carpeta, const unsigned num_calentamiento, const unsigned num_medidos );
+
    /// @brief Procesa una pulsación de un tecla con la tecla 'S' pulsada,
    /// @brief Incrementa o decrementa el 'uniform' 'S' en el cauce de contorno.
    /// @param key - código de la tecla pulsada
@@ -159,6 +199,10 @@ class Aplicacion3D : public AplicacionBase
    ///
    CamaraInteractiva * camaraActual();
 
+   /// @brief Sin ventana: visualiza cuadros (con la cámara actual) hasta que no quedan cargas pendientes
+   ///
+   void esperarCargas() ;
+
 
    /// @brief pasa la cámara actual a la siguiente
    ///
@@ -239,6 +283,12 @@ class Aplicacion3D : public AplicacionBase
    // 'true' imprimir tiempo por frame, 'false', no imprimir 
    bool imprimir_tiempos  = false;  
 
+   // contadores del último cuadro visualizado (dibujos, cambios de estado, bytes enviados, etc...)
+   EstadisticasRender estadisticas_cuadro ;
+
+   // hebra que simula el objeto actual, si la simulación es concurrente (ver 'aplicarEstadoSimulado')
+   HebraSimulacion hebra_simulacion ;
+
    // puntero al cauce activo actualmente
    Cauce3D * cauce = nullptr ;  
 
@@ -32,6 +32,19 @@
 #include "colecciones-objs.h"
 #include "animacion.h"
 #include "fbo.h"
+#include "texturas.h"
+#include "perfilador.h"
+#include "tiempos-cuadros.h"
+#include "reserva-hebras.h"
+#include "rasterizador-cpu.h"
+
+#ifdef PCG_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
 
 
 // ---------------------------------------------------------------------
@@ -39,13 +52,16 @@
 
 void FGE_PulsarLevantarTecla( GLFWwindow* window, int key, int scancode, int action, int mods ) 
 {
+   TrabajoCuadro trabajo ; // (el tiempo de los gestores de eventos se suma al del siguiente cuadro)
    AplicacionBase * apl = AplicacionBase::instancia();
+   apl->detenerSimulacion(); // (la tecla puede cambiar el objeto simulado, se vuelve a iniciar en el siguiente cuadro)
    apl->mgePulsarLevantarTecla( window, key, scancode, action, mods );
 }
 // --------------------------------------------------------------------
 
 void FGE_Scroll( GLFWwindow* window, double xoffset, double yoffset  )
 {
+   TrabajoCuadro trabajo ;
    AplicacionBase * apl = AplicacionBase::instancia();
    apl->mgeScroll( window, xoffset, yoffset );
 }
@@ -53,6 +69,7 @@ void FGE_Scroll( GLFWwindow* window, double xoffset, double yoffset  )
  
 void FGE_PulsarLevantarBotonRaton( GLFWwindow* window, int button, int action, int mods )
 {
+   TrabajoCuadro trabajo ;
    AplicacionBase * apl = AplicacionBase::instancia();
    apl->mgePulsarLevantarBotonRaton( window, button, action, mods );
 }
@@ -60,6 +77,7 @@ void FGE_PulsarLevantarBotonRaton( GLFWwindow* window, int button, int action, i
 
 void FGE_MovimientoRaton( GLFWwindow* window, double xpos, double ypos )
 {
+   TrabajoCuadro trabajo ;
    AplicacionBase * apl = AplicacionBase::instancia();
    apl->mgeMovimientoRaton( window, xpos, ypos );
 }
@@ -69,6 +87,7 @@ void FGE_MovimientoRaton( GLFWwindow* window, double xpos, double ypos )
 
 void FGE_CambioTamano( GLFWwindow* ventana_glfw, int nuevo_ancho_fb, int nuevo_alto_fb )
 {
+   TrabajoCuadro trabajo ;
    AplicacionBase * apl = AplicacionBase::instancia();
    apl->cambioTamano( nuevo_ancho_fb, nuevo_alto_fb );
 }
@@ -85,7 +104,7 @@ AplicacionBase * AplicacionBase::instancia()
 }
 // ---------------------------------------------------------------------
                  
-AplicacionBase::AplicacionBase( const unsigned major, const unsigned minor )
+AplicacionBase::AplicacionBase( const unsigned major, const unsigned minor, const bool sin_ventana )
 {
    using namespace std ;
    cout << "Constructor de 'AplicacionBase': inicio" << endl ;
@@ -97,17 +116,49 @@ AplicacionBase::AplicacionBase( const unsigned major, const unsigned minor )
       exit(1);
    }
    
-   // Inicializar GLFW y crear la ventana 
-   inicializarGLFW( major, minor );
+   // con el rasterizador por software (solo sin ventana) no se usa OpenGL: no se crea ningún 
+   // contexto, las imágenes se obtienen en la memoria de la aplicación y las texturas no se 
+   // comprimen (el rasterizador las lee sin comprimir)
+   if ( RasterizadorCPU::activo() )
+   {
+      assert( sin_ventana );
+      cout << "Rasterizador por software: no se crea ningún contexto de OpenGL." << endl ;
+      ventana_tam_x    = 1280 ;
+      ventana_tam_y    = 720 ;
+      mouse_pos_factor = 1 ;
+      ImagenTextura::fijarFormatoTexels( FormatoTexels::rgb );
+   }
+   else
+   {
+      // Inicializar GLFW y crear la ventana (o crear el contexto sin ventana)
+      if ( sin_ventana )
+         inicializarEGL( major, minor );
+      else 
+         inicializarGLFW( major, minor );
+
+      // Inicialización de GLEW (dejar esta llamada siempre: en macOS no hace nada)
+      InicializaGLEW();  
 
-   // Inicialización de GLEW (dejar esta llamada siempre: en macOS no hace nada)
-   InicializaGLEW();  
+      // escribe características de OpenGL en pantalla (ver 'utilidades.cpp')
+      InformeOpenGL() ; 
 
-   // escribe características de OpenGL en pantalla (ver 'utilidades.cpp')
-   InformeOpenGL() ; 
+      // comprimir las texturas en BC1 (si OpenGL no lo admite, se envían sin comprimir)
+      ImagenTextura::fijarFormatoTexels( FormatoTexels::bc1 );
+
+      // sin ventana, los frames se visualizan en un framebuffer (no hay framebuffer por defecto)
+      if ( sin_ventana )
+         fbo_sin_ventana = new Framebuffer( ventana_tam_x, ventana_tam_y );
+   }
 
     cout << "ventana_glfw == " << ventana_glfw << endl ;
 
+   // crear la reserva de hebras, que comparten las cargas y los cálculos en segundo plano: las 
+   // tareas para la hebra principal despiertan al bucle principal si está esperando eventos
+   ReservaHebras * reserva = ReservaHebras::instancia() ;
+   if ( ! sin_ventana )
+      reserva->fijarAvisoPrincipal( []() { glfwPostEmptyEvent(); } );
+   cout << "Reserva de hebras: " << reserva->leerNumHebras() << " hebra(s) con robo de tareas." << endl ;
+
    // asignar la instancia actual de la aplicación
    aplBase = this ; 
    cout << "Constructor de 'AplicacionBase': fin." << endl ;
@@ -119,6 +170,21 @@ AplicacionBase::~AplicacionBase()
    // desconectar gestores de eventos de GLFW
    using namespace std ;
 
+   // sin ventana, destruir el framebuffer y el contexto de EGL
+   delete fbo_sin_ventana ;
+   fbo_sin_ventana = nullptr ;
+#ifdef PCG_EGL
+   if ( egl_contexto != nullptr )
+   {
+      eglMakeCurrent( EGLDisplay( egl_pantalla ), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+      eglDestroyContext( EGLDisplay( egl_pantalla ), EGLContext( egl_contexto ) );
+      eglTerminate( EGLDisplay( egl_pantalla ) );
+   }
+#endif
+
+   // las tareas para la hebra principal ya no pueden despertar al bucle principal
+   ReservaHebras::instancia()->fijarAvisoPrincipal( nullptr );
+
    // finalizar la librería GLFW (se llamó a glfwInit desde el constructor, 
    // indirectamente, via 'inicializarGLFW')
    glfwTerminate(); 
@@ -145,6 +211,55 @@ void AplicacionBase::cambioTamano(int nuevo_ancho_fb, int nuevo_alto_fb )
    // forzar un nuevo evento de redibujado, para actualizar ventana
    revisualizar = true ;
 }
+// ---------------------------------------------------------------------
+
+void AplicacionBase::fijarRitmo( const ModoRitmo modo, const double fps )
+{
+   using namespace std ;
+   double fps_ritmo = fps ;
+
+   if ( ! sinVentana() )
+   {
+      // con sincronización vertical, la frecuencia es la del monitor principal (si se conoce)
+      if ( modo == ModoRitmo::vsync )
+      {  const GLFWvidmode * modo_video = glfwGetVideoMode( glfwGetPrimaryMonitor() );
+         fps_ritmo = modo_video != nullptr && modo_video->refreshRate > 0 ? modo_video->refreshRate : 60.0 ;
+      }
+      glfwSwapInterval( modo == ModoRitmo::vsync ? 1 : 0 );
+   }
+   ritmo.fijarModo( modo, fps_ritmo );
+
+   // un cuadro que dura más que el periodo es un tirón (sin límite se deja el presupuesto anterior)
+   if ( modo != ModoRitmo::libre )
+      MedidorCuadros::instancia()->fijarPresupuesto( 1000.0/fps_ritmo );
+
+   cout << "Ritmo de cuadros en las animaciones: " << ritmo.descripcion() << endl ;
+}
+// ---------------------------------------------------------------------
+
+void AplicacionBase::fijarSimulacionConcurrente( const bool nuevo )
+{
+   using namespace std ;
+   if ( ! nuevo )
+   {  detenerSimulacion();
+      ritmo.iniciarSimulacion(); // (la hebra principal sigue desde el instante en que se ha detenido)
+   }
+   simulacion_concurrente = nuevo ;
+   cout << "Simulación de las animaciones: " << ( nuevo ? "en una hebra propia" : "en la hebra principal" ) << endl ;
+}
+// ---------------------------------------------------------------------
+
+void AplicacionBase::cambiarRitmo()
+{
+   if ( ritmo.leerModo() == ModoRitmo::objetivo && ritmo.leerFPS() > 45.0 )
+      fijarRitmo( ModoRitmo::objetivo, 30.0 );
+   else if ( ritmo.leerModo() == ModoRitmo::objetivo )
+      fijarRitmo( ModoRitmo::vsync );
+   else if ( ritmo.leerModo() == ModoRitmo::vsync )
+      fijarRitmo( ModoRitmo::libre );
+   else
+      fijarRitmo( ModoRitmo::objetivo, 60.0 );
+}
 
 
 // ---------------------------------------------------------------------
@@ -234,12 +349,100 @@ void AplicacionBase::inicializarGLFW( const unsigned major, const unsigned minor
    glfwSetMouseButtonCallback     ( ventana_glfw, FGE_PulsarLevantarBotonRaton );
    glfwSetCursorPosCallback       ( ventana_glfw, FGE_MovimientoRaton );
    glfwSetScrollCallback          ( ventana_glfw, FGE_Scroll );
+
+   // por defecto, las animaciones se visualizan a 60 cuadros por segundo
+   fijarRitmo( ModoRitmo::objetivo, 60.0 );
 }
 
 
 
 
 
+// ---------------------------------------------------------------------
+// inicialización de EGL sin ventana (contexto sin 'surface'). Se llama desde el constructor.
+
+void AplicacionBase::inicializarEGL( const unsigned major, const unsigned minor )
+{
+   using namespace std ;
+
+#ifndef PCG_EGL
+   cout << "Error: se ha pedido visualizar sin ventana, pero el programa se ha compilado sin EGL (aborto)." << endl ;
+   exit(1);
+#else
+   // obtener la pantalla de la plataforma 'surfaceless' de Mesa (no usa ningún sistema de 
+   // ventanas), si no está disponible, la pantalla por defecto
+   EGLDisplay pantalla = EGL_NO_DISPLAY ;
+   const auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+   if ( getPlatformDisplay != nullptr )
+      pantalla = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+   if ( pantalla == EGL_NO_DISPLAY )
+      pantalla = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+   EGLint egl_major = 0, egl_minor = 0 ;
+   if ( pantalla == EGL_NO_DISPLAY || ! eglInitialize( pantalla, &egl_major, &egl_minor ) )
+   {
+      cout << "Error: no se ha podido inicializar EGL (aborto)." << endl ;
+      exit(1);
+   }
+   cout << "EGL " << egl_major << "." << egl_minor << " (" << eglQueryString( pantalla, EGL_VENDOR ) << ")" << endl ;
+
+   // crear un contexto de OpenGL (no de OpenGL ES) con perfil 'core', como con GLFW
+   // (la plataforma 'surfaceless' solo tiene configuraciones para 'pbuffers', por defecto 
+   // se piden configuraciones para ventanas y no se encontraría ninguna)
+   const EGLint atrib_config[] = 
+   {  EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE 
+   };
+   const EGLint atrib_contexto[] = 
+   {  EGL_CONTEXT_MAJOR_VERSION,       EGLint( major ),
+      EGL_CONTEXT_MINOR_VERSION,       EGLint( minor ),
+      EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+      EGL_NONE 
+   };
+   EGLConfig  config   = nullptr ;
+   EGLint     num_conf = 0 ;
+   EGLContext contexto = EGL_NO_CONTEXT ;
+   if ( eglBindAPI( EGL_OPENGL_API ) && eglChooseConfig( pantalla, atrib_config, &config, 1, &num_conf ) && num_conf > 0 )
+      contexto = eglCreateContext( pantalla, config, EGL_NO_CONTEXT, atrib_contexto );
+
+   // activar el contexto sin 'surface' (requiere 'EGL_KHR_surfaceless_context')
+   if ( contexto == EGL_NO_CONTEXT || ! eglMakeCurrent( pantalla, EGL_NO_SURFACE, EGL_NO_SURFACE, contexto ) )
+   {
+      cout << "Error: no se ha podido crear un contexto de OpenGL " << major << "." << minor 
+           << " con EGL sin ventana (código " << hex << eglGetError() << dec << ") (aborto)." << endl ;
+      exit(1);
+   }
+   egl_pantalla = pantalla ;
+   egl_contexto = contexto ;
+
+   glGetIntegerv( GL_MAJOR_VERSION, &context_major );
+   glGetIntegerv( GL_MINOR_VERSION, &context_minor );
+   cout << "Versión de OpenGL (sin ventana): " << context_major << "." << context_minor << endl ;
+
+   // tamaño inicial del framebuffer (no hay eventos de ratón, así que el factor es 1)
+   ventana_tam_x    = 1280 ;
+   ventana_tam_y    = 720 ;
+   mouse_pos_factor = 1 ;
+#endif
+}
+// ---------------------------------------------------------------------
+
+bool AplicacionBase::completarCargas()
+{
+   ZONA_PERFIL_CPU( "completarCargas" );
+   // tareas encoladas para la hebra principal (como mucho 'max_ms_principal' ms por iteración)
+   constexpr double max_ms_principal = 2.0 ;
+   const bool tareas = ReservaHebras::instancia()->ejecutarPrincipal( max_ms_principal );
+   return SubidorTexturas::instancia()->subirPendientes() || tareas ;
+}
+// ---------------------------------------------------------------------
+
+bool AplicacionBase::hayCargasPendientes()
+{
+   return SubidorTexturas::instancia()->hayPendientes() || 
+          ReservaHebras::instancia()->hayPendientesPrincipal();
+}
 // ---------------------------------------------------------------------
 // bucle principal  de gestion de eventos GLFW
 
@@ -250,31 +453,63 @@ void AplicacionBase::buclePrincipalEventos(  )
 
    while ( ! terminar_programa  )
    {
-      // 1. visualizar coleccion 
-
-      if ( revisualizar )      //  si hay que volver a visualizar
-      {                        //
-         visualizarFrame();    //     visualizar de nuevo la ventana
-         revisualizar = false; //     evitar que se redibuje continuamente
+      // 0. sustituir los objetos que se han terminado de cargar en segundo plano
+      //    (el tiempo se suma al del siguiente cuadro)
+      
+      {  TrabajoCuadro trabajo ;
+         if ( completarCargas() )
+            revisualizar = true ;
       }
 
-      // 2. determinar si hay animaciones activas
+      // 1. determinar si hay animaciones activas
       //
       // hay una animación en curso si están las animaciones activdas por el usuario y
       // además la aplicación está en un estado animable (para una Aplic 3D: si el objeto actual tiene params animables)
+      // (durante una captura del perfil también se visualiza continuamente)
 
       //ObjetoVisu * objeto = objetoActual() ; assert( objeto != nullptr );
-      const bool animacion_activa = AnimacionesActivadas() && animable() ;
-      
+      const bool animacion_activa = AnimacionesActivadas() && animable() ,
+                 perfilando       = Perfilador::capturando() ,
+                 continuo         = animacion_activa || perfilando ;
+
+      // 2. visualizar coleccion 
+      //
+      // sin animaciones, en cuanto hay cambios; con animaciones, solo cuando llega el plazo
+      // del siguiente cuadro (antes se actualiza el estado hasta el instante actual)
+
+      bool visualizar_ahora = ! continuo ;      // (con animaciones, los cambios esperan al plazo)
+
+      if ( ! animacion_activa )                 // sin animaciones, la hebra de simulación (si la hay)
+         detenerSimulacion();                   //    no debe seguir simulando
+
+      if ( continuo && ritmo.plazoCumplido() )  // si ha llegado el plazo de un cuadro
+      {                                         //
+         if ( animacion_activa && ActualizarEstado() ) // actualizar el estado de la aplicación
+            revisualizar = true ;               //    si se ha cambiado algo, redibujar.
+         if ( perfilando )                      // durante la captura del perfil, se redibuja
+            revisualizar = true ;               //    en cada cuadro
+         ritmo.siguientePlazo();                // fijar el plazo del siguiente cuadro
+         visualizar_ahora = true ;              //
+      }                                         //
+
+      if ( revisualizar && visualizar_ahora )  //  si hay que volver a visualizar
+      {                        //
+         visualizarFrame();    //     visualizar de nuevo la ventana
+         revisualizar = false; //     evitar que se redibuje continuamente
+      }
+
       // 3. procesar eventos
 
-      if ( animacion_activa )                  // si hay alguna animación en curso
-      {                                        //
-         glfwPollEvents();                     // procesar todos los eventos pendientes, y llamar a la función correspondiente, si está definida
-         if ( ! revisualizar )                 // si no es necesario redibujar la ventana
-            if ( ActualizarEstado())           // actualizar el estado de la aplicación
-               revisualizar = true ;           // si se ha cambiado algo, redibujar.        
+      if ( continuo )                          // si hay alguna animación o captura del perfil en curso
+      {                                        //   esperar a un evento, como mucho hasta el plazo del
+         const double seg = ritmo.segundosHastaPlazo(); // siguiente cuadro (sin ocupar la CPU)
+         if ( seg > 0.0 )                      //
+            glfwWaitEventsTimeout( seg );      //
+         else                                  //   (si ya ha llegado, solo procesar los pendientes)
+            glfwPollEvents();                  //
       }                                        //
+      else if ( hayCargasPendientes() )        // si no hay animación, pero hay cargas en segundo plano
+         glfwWaitEventsTimeout( 0.05 );        //   esperar a un evento, como mucho 50 ms (para completar las cargas)
       else                                     // si no hay una animacion en curso
          glfwWaitEvents();                     //   esperar hasta que haya un evento y llamar a la función correspondiente, si está definida
 
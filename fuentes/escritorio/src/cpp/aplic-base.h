@@ -33,6 +33,7 @@
 
 #include <vector>
 #include "utilidades.h"
+#include "ritmo-cuadros.h"
 
 // declaraciones adelantadas de clases (para poder declarar punteros antes de "ver" la estructura de la clase)
 class ColeccionObjs ;
@@ -127,11 +128,14 @@ class AplicacionBase
    
    /// @brief Constructor: inicializa GLFW, crea la ventana, 
    /// @brief inicializa Glew e inicializa OpenGL.
+   /// @brief Sin ventana, crea un contexto de EGL sin sistema de ventanas y un framebuffer donde 
+   /// @brief se visualiza cada frame (ver 'inicializarEGL').
    ///
    /// @param vers_major (unsigned) - versión de openGL que se requiere (major), por defecto 3
    /// @param vers_minir (unisgned) - versión de openGL que se requiere (minor), por defecto 3
+   /// @param sin_ventana (bool) - 'true' para no usar GLFW ni ninguna ventana
    ///
-   AplicacionBase( const unsigned major, const unsigned minor ); 
+   AplicacionBase( const unsigned major, const unsigned minor, const bool sin_ventana = false ); 
 
    // Destructor 
    virtual ~AplicacionBase() ;
@@ -144,6 +148,21 @@ class AplicacionBase
    ///
    void inicializarGLFW( const unsigned major = 3, const unsigned minor = 3 ) ;
 
+   /// @brief Crea un contexto de OpenGL con EGL, sin ventana ni sistema de ventanas (con la 
+   /// @brief plataforma 'surfaceless' de Mesa, que funciona sin GPU con 'llvmpipe'), el tamaño 
+   /// @brief inicial es 1280 x 720 (se cambia con 'cambioTamano'). Solo está disponible si se ha 
+   /// @brief compilado con EGL (símbolo 'PCG_EGL'), si no, termina el programa.
+   /// @brief (se llama desde el constructor)
+   ///
+   /// @param major (unsigned) version requerida (major)
+   /// @param minor (unsigned) version requerida (minor)
+   ///
+   void inicializarEGL( const unsigned major, const unsigned minor ) ;
+
+   /// @brief Devuelve 'true' si la aplicación no tiene ventana (se visualiza en 'fbo_sin_ventana')
+   ///
+   bool sinVentana() const { return ventana_glfw == nullptr ; }
+
    /// @brief Indica si la aplicación es animable en el estado actual o no lo es
    ///
    virtual bool animable() = 0 ;
@@ -154,6 +173,62 @@ class AplicacionBase
    ///
    virtual bool actualizarEstado( const float tiempo_seg ) = 0 ;
 
+   /// @brief Pone el estado visible de la aplicación en un instante anterior al de la última actualización,
+   /// @brief sin cambiar el estado simulado (para interpolar entre dos pasos fijos de la simulación).
+   /// @brief Por defecto no hace nada.
+   /// @param retraso_seg - segundos anteriores al estado simulado (entre 0 y un paso de simulación)
+   ///
+   virtual void interpolarEstado( const float retraso_seg ) {}
+
+   /// @brief Activa o desactiva la simulación de las animaciones en una hebra propia (la hebra principal 
+   /// @brief solo visualiza el último estado publicado por esa hebra, ver 'HebraSimulacion')
+   ///
+   void fijarSimulacionConcurrente( const bool nuevo );
+
+   /// @brief Indica si la simulación de las animaciones se hace en una hebra propia
+   ///
+   bool simulacionConcurrente() const { return simulacion_concurrente ; }
+
+   /// @brief Con la simulación en una hebra propia: la inicia si no estaba en marcha, y pone el estado 
+   /// @brief visible de la aplicación en el último publicado por esa hebra. Por defecto devuelve 'false'
+   /// @brief (la aplicación no admite la simulación en otra hebra, y se simula en la hebra principal).
+   /// @return 'true' si la simulación está en otra hebra, 'false' si se debe simular en la principal
+   ///
+   virtual bool aplicarEstadoSimulado() { return false ; }
+
+   /// @brief Detiene la simulación en la hebra propia, si está en marcha (antes de cualquier cambio que 
+   /// @brief pueda cambiar o destruir lo que simula). Por defecto no hace nada.
+   ///
+   virtual void detenerSimulacion() {}
+
+   /// @brief Fija el ritmo de los cuadros durante las animaciones (y el intervalo de intercambio 
+   /// @brief de la ventana y el presupuesto de tiempo por cuadro)
+   /// @param modo - modo del ritmo (ver 'ModoRitmo')
+   /// @param fps - cuadros por segundo con 'ModoRitmo::objetivo' (con 'vsync' se usa la frecuencia del monitor)
+   ///
+   void fijarRitmo( const ModoRitmo modo, const double fps = 60.0 );
+
+   /// @brief Pasa al siguiente ritmo de cuadros: 60 fps, 30 fps, sincronización vertical y sin límite
+   ///
+   void cambiarRitmo();
+
+   /// @brief Devuelve el ritmo de cuadros (con los pasos de la simulación)
+   ///
+   RitmoCuadros & ritmoCuadros() { return ritmo ; }
+
+   /// @brief Completa las cargas en segundo plano que ya han terminado (se llama en cada iteración 
+   /// @brief del bucle principal, en la hebra del contexto OpenGL): ejecuta las tareas encoladas para la
+   /// @brief hebra principal (p.ej. la sustitución de los objetos diferidos ya creados o la entrega de las
+   /// @brief texturas decodificadas) y envía a la GPU parte de las texturas pendientes (ver 'SubidorTexturas').
+   /// @return 'true' si se ha cambiado algo visible y es necesario visualizar, 'false' si no.
+   ///
+   virtual bool completarCargas() ;
+
+   /// @brief Indica si todavía hay cargas en segundo plano (mientras las haya, el bucle principal no 
+   /// @brief espera indefinidamente a que llegue un evento). Por defecto, las texturas pendientes de enviar.
+   ///
+   virtual bool hayCargasPendientes() ;
+
    /// @brief Gestiona un evento de cambio de tamaño de la ventana
    ///
    /// @param nuevo_ancho_fb (int) - nuevo ancho de la ventana
@@ -243,6 +318,12 @@ class AplicacionBase
     // puntero a la ventana GLFW que está usando la aplicación
    GLFWwindow * ventana_glfw = nullptr; 
 
+   // sin ventana: pantalla y contexto de EGL (como punteros genéricos, para no incluir 
+   // aquí las cabeceras de EGL), y framebuffer donde se visualiza cada frame
+   void *        egl_pantalla    = nullptr ,
+         *       egl_contexto    = nullptr ;
+   Framebuffer * fbo_sin_ventana = nullptr ;
+
    // variables de estado para gestionar el bucle principal de eventos.
    // se modifican en las funciones gestoras de eventos y se tienen en cuenta 
    // en el bucle principal de eventos.
@@ -250,6 +331,12 @@ class AplicacionBase
    bool revisualizar      = true;    // true indica que hay que redibujar la coleccion
    bool terminar_programa = false;   // true indica que hay que cerrar la aplicación
 
+   // ritmo de los cuadros durante las animaciones (o capturas del perfil)
+   RitmoCuadros ritmo ;
+
+   // true si las animaciones se simulan en una hebra propia (ver 'fijarSimulacionConcurrente')
+   bool simulacion_concurrente = false ;
+
    // factor de conversión para displays "retina" en macOS
    unsigned mouse_pos_factor = 1 ;      
 
@@ -0,0 +1,83 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Buffer triple sin cerrojos (declaración e implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de
+// **
+// **  + BufferTriple: tres copias de un valor para pasarlo de una hebra productora a una
+// **                  hebra consumidora sin cerrojos: la productora escribe en una copia
+// **                  propia y la publica, la consumidora lee la última publicada
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <atomic>
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Buffer triple para una hebra productora y una consumidora (sin cerrojos ni esperas).
+/// @brief En cada momento una copia es de la productora, otra de la consumidora y la tercera es
+/// @brief la 'intermedia': al publicar, la productora intercambia la suya con la intermedia, y al
+/// @brief leer, la consumidora hace lo mismo si hay una publicada que no ha leído. Así ninguna
+/// @brief hebra espera a la otra, y la consumidora siempre ve una copia completa (la más reciente).
+/// @brief Las copias se reutilizan (la productora recibe una copia antigua, no vacía).
+///
+template< class T >
+class BufferTriple
+{
+   public:
+
+   /// @brief Devuelve la copia en la que escribe la productora (solo la usa la productora)
+   T & escritura() { return copias[ind_escritura] ; }
+
+   /// @brief Publica la copia de la productora, que pasa a escribir en otra
+   /// @brief (la publicada antes y no leída, si la hay, se descarta)
+   void publicar()
+   {
+      // 'release': la consumidora que lea el índice ve todo lo escrito en la copia
+      const unsigned anterior = intermedia.exchange( ind_escritura | bit_nueva, std::memory_order_acq_rel );
+      ind_escritura = anterior & mascara_ind ;
+   }
+
+   /// @brief Pasa a la copia publicada más reciente, si hay una nueva (solo la usa la consumidora)
+   /// @return 'true' si hay una copia nueva desde la anterior llamada, 'false' si no
+   bool actualizarLectura()
+   {
+      if ( ( intermedia.load( std::memory_order_relaxed ) & bit_nueva ) == 0 )
+         return false ;
+      // (solo la productora pone el bit, así que sigue puesto: se puede intercambiar)
+      const unsigned anterior = intermedia.exchange( ind_lectura, std::memory_order_acq_rel );
+      ind_lectura = anterior & mascara_ind ;
+      return true ;
+   }
+
+   /// @brief Devuelve la copia de la consumidora (la última obtenida con 'actualizarLectura')
+   const T & lectura() const { return copias[ind_lectura] ; }
+
+   private:
+
+   static constexpr unsigned bit_nueva   = 4 , // en 'intermedia': la copia no se ha leído
+                             mascara_ind = 3 ;
+
+   T                     copias[3] ;
+   unsigned              ind_escritura = 0 ,   // (solo lo usa la productora)
+                         ind_lectura   = 1 ;   // (solo lo usa la consumidora)
+   std::atomic<unsigned> intermedia { 2 } ;    // índice de la intermedia, con 'bit_nueva'
+} ;
@@ -0,0 +1,183 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Caché de recursos leídos de archivos (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <filesystem>
+#include "lector-ply.h"
+#include "texturas.h"
+#include "cache-recursos.h"
+
+// ******************************************************************************************************
+// CacheRecursos
+// ------------------------------------------------------------------------------------------------------
+
+CacheRecursos * CacheRecursos::instancia()
+{
+   static CacheRecursos cache ;
+   return &cache ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::string CacheRecursos::clave( const std::string & nombre_arch, const std::string & subcarpeta,
+                                  const std::string & parametros )
+{
+   // 'BuscarArchivo' aborta si el archivo no existe, así que la ruta siempre se puede normalizar
+   const std::string ruta = BuscarArchivo( nombre_arch, subcarpeta );
+   return std::filesystem::weakly_canonical( ruta ).string() + "|" + parametros ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+template< class T, class F >
+std::shared_ptr<T> CacheRecursos::buscarOCargar( std::map<std::string,std::weak_ptr<T>> & tabla,
+                                                 const std::string & clave, F cargar )
+{
+   // si el recurso lo sigue usando algún objeto, se comparte
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      auto it = tabla.find( clave );
+      if ( it != tabla.end() )
+         if ( std::shared_ptr<T> recurso = it->second.lock() )
+         {  num_aciertos++ ;
+            return recurso ;
+         }
+      num_fallos++ ;
+   }
+
+   // no está, o ya se liberó: leerlo de nuevo (sin el cerrojo, así otras hebras pueden 
+   // leer otros archivos mientras tanto)
+   std::shared_ptr<T> recurso = cargar();
+
+   // si otra hebra ha leído el mismo archivo a la vez, se usa el suyo y se descarta este
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   if ( std::shared_ptr<T> otro = tabla[clave].lock() )
+      return otro ;
+   tabla[clave] = recurso ;
+   return recurso ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<ImagenTextura> CacheRecursos::imagenTextura( const std::string & nombre_arch )
+{
+   return buscarOCargar( imagenes, clave( nombre_arch, "imgs", "rgb" ), [&]()
+   {
+      return std::make_shared<ImagenTextura>( nombre_arch );
+   });
+}
+// ------------------------------------------------------------------------------------------------------
+
+void CacheRecursos::retener( const std::string & clave, std::shared_ptr<const void> recurso, const std::size_t bytes )
+{
+   std::lock_guard<std::mutex> bloqueo( mutex );
+
+   // si ya estaba, pasa a ser el más reciente
+   for( auto it = retenidos.begin() ; it != retenidos.end() ; ++it )
+      if ( it->clave == clave )
+      {  retenidos.splice( retenidos.end(), retenidos, it );
+         return ;
+      }
+   retenidos.push_back( { clave, std::move( recurso ), bytes } );
+   bytes_retenidos += bytes ;
+
+   // el más reciente se retiene siempre, aunque no quepa en el presupuesto
+   while( bytes_retenidos > presupuesto_retenidos && retenidos.size() > 1 )
+   {  bytes_retenidos -= retenidos.front().bytes ;
+      retenidos.pop_front();
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const DatosPLY> CacheRecursos::mallaPLY( const std::string & nombre_arch )
+{
+   const std::string clave_ply = clave( nombre_arch, "plys", "completo" );
+   std::shared_ptr<const DatosPLY> datos = buscarOCargar( mallas_ply, clave_ply, [&]()
+   {
+      auto datos = std::make_shared<DatosPLY>();
+      LeerPLY( nombre_arch, datos->vertices, datos->triangulos );
+      return std::shared_ptr<const DatosPLY>( datos );
+   });
+   retener( clave_ply, datos, datos->vertices.size()*sizeof(glm::vec3) + datos->triangulos.size()*sizeof(glm::uvec3) );
+   return datos ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<const std::vector<glm::vec3>> CacheRecursos::verticesPLY( const std::string & nombre_arch )
+{
+   const std::string clave_ply = clave( nombre_arch, "plys", "vertices" );
+   std::shared_ptr<const std::vector<glm::vec3>> vertices = buscarOCargar( vertices_ply, clave_ply, [&]()
+   {
+      auto vertices = std::make_shared<std::vector<glm::vec3>>();
+      LeerVerticesPLY( nombre_arch, *vertices );
+      return std::shared_ptr<const std::vector<glm::vec3>>( vertices );
+   });
+   retener( clave_ply, vertices, vertices->size()*sizeof(glm::vec3) );
+   return vertices ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned long CacheRecursos::leerNumAciertos() const
+{
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   return num_aciertos ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned long CacheRecursos::leerNumFallos() const
+{
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   return num_fallos ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned CacheRecursos::leerNumCargados() const
+{
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   unsigned n = 0 ;
+   for( const auto & par : imagenes )
+      n += par.second.expired() ? 0 : 1 ;
+   for( const auto & par : mallas_ply )
+      n += par.second.expired() ? 0 : 1 ;
+   for( const auto & par : vertices_ply )
+      n += par.second.expired() ? 0 : 1 ;
+   return n ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::size_t CacheRecursos::leerBytesRetenidos() const
+{
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   return bytes_retenidos ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void CacheRecursos::imprimirEstadisticas( std::ostream & os ) const
+{
+   os << "Caché de recursos: " << leerNumAciertos() << " aciertos, " << leerNumFallos() << " fallos (lecturas de archivo), "
+      << leerNumCargados() << " recursos cargados, " << (leerBytesRetenidos()+1023)/1024 << " KB de PLYs retenidos." << std::endl ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void CacheRecursos::escribirJSON( std::ostream & os ) const
+{
+   os << "{ \"aciertos\": " << leerNumAciertos()
+      << ", \"fallos\": "   << leerNumFallos()
+      << ", \"cargados\": " << leerNumCargados()
+      << ", \"bytes_retenidos\": " << leerBytesRetenidos() << " }" ;
+}
@@ -0,0 +1,140 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Caché de recursos leídos de archivos (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de:
+// **
+// **  + DatosPLY:      vértices y triángulos leídos de un archivo PLY
+// **  + CacheRecursos: caché de imágenes de textura y datos de PLYs, compartidos
+// **                   con punteros con recuento de referencias
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "utilidades.h"
+
+class ImagenTextura ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Tablas de vértices y triángulos leídas de un archivo PLY completo
+///
+struct DatosPLY
+{
+   std::vector<glm::vec3>  vertices ;
+   std::vector<glm::uvec3> triangulos ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Caché de los recursos leídos de archivos (imágenes de textura y PLYs). Cada recurso
+/// @brief se identifica por la ruta canónica del archivo y los parámetros de la lectura, y se
+/// @brief entrega como un puntero compartido ('std::shared_ptr'). De las imágenes la caché solo
+/// @brief guarda punteros débiles, así que la imagen (y su memoria en la CPU y en la GPU) se libera
+/// @brief cuando se destruye la última textura que la usa. Las mallas copian las tablas de los PLYs
+/// @brief y los sueltan enseguida, así que de estos la caché guarda además punteros fuertes de los
+/// @brief usados más recientemente, hasta 'presupuesto_retenidos' bytes (si no, cada objeto que usa
+/// @brief el mismo PLY lo volvería a leer). Un recurso que ya no está se lee otra vez.
+/// @brief Se puede usar desde varias hebras a la vez (los archivos se leen fuera del cerrojo).
+///
+class CacheRecursos
+{
+   public:
+
+   /// @brief Devuelve la caché de la aplicación (la crea la primera vez)
+   static CacheRecursos * instancia() ;
+
+   /// @brief Devuelve la imagen de textura leída del archivo JPEG 'nombre_arch' (sin path),
+   /// @brief la lee solo si no la usa ya otro objeto
+   std::shared_ptr<ImagenTextura> imagenTextura( const std::string & nombre_arch );
+
+   /// @brief Devuelve los vértices y triángulos del archivo PLY 'nombre_arch' (sin path),
+   /// @brief los lee solo si no los usa ya otro objeto
+   std::shared_ptr<const DatosPLY> mallaPLY( const std::string & nombre_arch );
+
+   /// @brief Devuelve los vértices del archivo PLY 'nombre_arch' (sin path), ignorando las
+   /// @brief caras (p.ej. para un perfil), los lee solo si no los usa ya otro objeto
+   std::shared_ptr<const std::vector<glm::vec3>> verticesPLY( const std::string & nombre_arch );
+
+   /// @brief Número de peticiones atendidas con un recurso ya cargado (aciertos) y número de
+   /// @brief peticiones que han obligado a leer un archivo (fallos)
+   unsigned long leerNumAciertos() const ;
+   unsigned long leerNumFallos()   const ;
+
+   /// @brief Número de recursos cargados actualmente (usados por algún objeto o retenidos)
+   unsigned leerNumCargados() const ;
+
+   /// @brief Bytes de las tablas de PLYs que retiene la caché (ver 'presupuesto_retenidos')
+   std::size_t leerBytesRetenidos() const ;
+
+   /// @brief Máximo de bytes de tablas de PLYs que se retienen sin que las use ningún objeto
+   static constexpr std::size_t presupuesto_retenidos = std::size_t(64) << 20 ;
+
+   /// @brief Imprime los aciertos, los fallos y los recursos cargados
+   void imprimirEstadisticas( std::ostream & os ) const ;
+
+   /// @brief Escribe los aciertos, fallos y recursos cargados como un objeto JSON (sin salto de
+   /// @brief línea al final)
+   void escribirJSON( std::ostream & os ) const ;
+
+   private:
+
+   CacheRecursos() {}
+
+   // busca el recurso con la clave en la tabla, si ya no está cargado lo carga con 'cargar'
+   template< class T, class F >
+   std::shared_ptr<T> buscarOCargar( std::map<std::string,std::weak_ptr<T>> & tabla,
+                                     const std::string & clave, F cargar );
+
+   // clave de un archivo: ruta canónica del archivo seguida de los parámetros de la lectura
+   static std::string clave( const std::string & nombre_arch, const std::string & subcarpeta,
+                             const std::string & parametros );
+
+   // añade el recurso al final de la lista de retenidos (o lo pasa al final si ya está), y
+   // suelta los del principio mientras se supera el presupuesto
+   void retener( const std::string & clave, std::shared_ptr<const void> recurso, const std::size_t bytes );
+
+   // recurso retenido con un puntero fuerte (la lista va del usado hace más tiempo al más reciente)
+   struct RecursoRetenido
+   {
+      std::string                 clave ;
+      std::shared_ptr<const void> recurso ;
+      std::size_t                 bytes ;
+   } ;
+
+   std::map<std::string,std::weak_ptr<ImagenTextura>>                 imagenes ;
+   std::map<std::string,std::weak_ptr<const DatosPLY>>                mallas_ply ;
+   std::map<std::string,std::weak_ptr<const std::vector<glm::vec3>>>  vertices_ply ;
+
+   std::list<RecursoRetenido> retenidos ;
+   std::size_t                bytes_retenidos = 0 ;
+
+   unsigned long num_aciertos = 0 ,
+                 num_fallos   = 0 ;
+
+   mutable std::mutex mutex ; // protege las tablas y los contadores
+} ;
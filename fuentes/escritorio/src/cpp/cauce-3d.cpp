@@ -23,6 +23,7 @@
 
 #include "utilidades.h" 
 #include "cauce-3d.h" 
+#include "rasterizador-cpu.h" // RasterizadorCPU::activo
 
 // *****************************************************************************
 // Cauce programable 3D con iluminación (OpenGL 3.3)
@@ -61,6 +62,10 @@ void Cauce3D::inicializarUniforms3D()
    loc_num_luces         = leerLocation( "u_num_luces" );
    loc_pos_dir_luz_ec    = leerLocation( "u_pos_dir_luz_ec" );
    loc_color_luz         = leerLocation( "u_color_luz" );
+   loc_usar_instancias   = leerLocation( "u_usar_instancias" );
+   loc_decod_pos         = leerLocation( "u_decod_pos" );
+   loc_decod_pos_escala  = leerLocation( "u_decod_pos_escala" );
+   loc_decod_pos_despl   = leerLocation( "u_decod_pos_despl" );
 
    // dar valores iniciales por defecto a los parámetros uniform
  
@@ -72,6 +77,10 @@ void Cauce3D::inicializarUniforms3D()
    glUniform1f( loc_mil_ks,  0.0 );
    glUniform1f( loc_mil_exp, 0.0 );
    glUniform1i( loc_num_luces, 0 ); // por defecto: 0 fuentes de luz activas
+   glUniform1ui( loc_usar_instancias, usar_instancias );
+   glUniform1ui( loc_decod_pos, decod_pos );
+   glUniform3fv( loc_decod_pos_escala, 1, value_ptr( decod_pos_escala ) );
+   glUniform3fv( loc_decod_pos_despl,  1, value_ptr( decod_pos_despl ) );
    CError();
    
    glUseProgram( 0 );
@@ -82,20 +91,74 @@ void Cauce3D::inicializarUniforms3D()
 
 void Cauce3D::fijarEvalMIL( const bool nue_eval_mil  )
 {
-   CError();
    eval_mil = nue_eval_mil ; // registra valor en el objeto Cauce.
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+   CError();
    glUseProgram( id_prog );  // activa el programa 
    glUniform1ui( loc_eval_mil, eval_mil   ); // cambia parámetro del shader
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    CError();
 }
 // -----------------------------------------------------------------------------
 
 void Cauce3D::fijarUsarNormalesTri ( const bool nue_usar_normales_tri )
 {
-   CError();
    usar_normales_tri = nue_usar_normales_tri ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+   CError();
    glUseProgram( id_prog );
    glUniform1ui( loc_usar_normales_tri, usar_normales_tri );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
+   CError();
+}
+
+// -----------------------------------------------------------------------------
+
+void Cauce3D::fijarUsarInstancias( const bool nue_usar_instancias )
+{
+   usar_instancias = nue_usar_instancias ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+   CError();
+   glUseProgram( id_prog );
+   glUniform1ui( loc_usar_instancias, usar_instancias );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
+   CError();
+}
+
+// -----------------------------------------------------------------------------
+
+void Cauce3D::fijarDecodPosiciones( const bool nue_decod_pos, const glm::vec3 & escala, const glm::vec3 & despl )
+{
+   // la escala y el desplazamiento solo importan con la decodificación activada
+   const bool cambia_activacion = nue_decod_pos != decod_pos ,
+              cambia_params     = nue_decod_pos && ( escala != decod_pos_escala || despl != decod_pos_despl );
+   if ( ! cambia_activacion && ! cambia_params )
+      return ;
+
+   decod_pos = nue_decod_pos ;
+   if ( cambia_params )
+   {  decod_pos_escala = escala ;
+      decod_pos_despl  = despl ;
+   }
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+
+   CError();
+   if ( cambia_activacion )
+   {  glProgramUniform1ui( id_prog, loc_decod_pos, decod_pos );
+      contadores.uniforms++ ;
+   }
+   if ( cambia_params )
+   {  glProgramUniform3fv( id_prog, loc_decod_pos_escala, 1, glm::value_ptr( escala ) );
+      glProgramUniform3fv( id_prog, loc_decod_pos_despl,  1, glm::value_ptr( despl ) );
+      contadores.uniforms += 2 ;
+   }
    CError();
 }
 
@@ -104,14 +167,22 @@ void Cauce3D::fijarUsarNormalesTri ( const bool nue_usar_normales_tri )
 void Cauce3D::fijarParamsMIL( const float k_amb, const float k_dif,
                             const float k_pse, const float exp_pse )  
 {
+   mil_ka  = k_amb ;
+   mil_kd  = k_dif ;
+   mil_ks  = k_pse ;
+   mil_exp = exp_pse ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+
    CError();
-   assert( 0 < id_prog );
    glUseProgram( id_prog );
 
    assert( -1 < loc_mil_ka );  glUniform1f( loc_mil_ka,   k_amb );
    assert( -1 < loc_mil_kd );  glUniform1f( loc_mil_kd,   k_dif );
    assert( -1 < loc_mil_ks );  glUniform1f( loc_mil_ks,   k_pse );
    assert( -1 < loc_mil_exp ); glUniform1f( loc_mil_exp,  exp_pse );
+   contadores.binds_programa++ ;
+   contadores.uniforms += 4 ;
 
    CError();
 }
@@ -127,9 +198,6 @@ void Cauce3D::fijarFuentesLuz( const std::vector<glm::vec3> & color,
    assert( 0 < nl && nl <= maxNumFuentesLuz() );
    assert( nl == pos_dir_wc.size() );
 
-   assert( 0 < id_prog );
-   glUseProgram( id_prog );
-
    std::vector<vec4> pos_dir_ec ;
 
    for( unsigned i = 0 ; i < nl ; i++ )
@@ -141,25 +209,35 @@ void Cauce3D::fijarFuentesLuz( const std::vector<glm::vec3> & color,
       //cout << "Cauce::fijarFuentesLuz: i == " << i << ", pos_dir_wc[" << i << "] == " << pos_dir_wc[i] <<  endl ;
       pos_dir_ec.push_back( l );
    }
+   color_luces      = color ;
+   pos_dir_luces_ec = pos_dir_ec ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+
+   glUseProgram( id_prog );
    glUniform1i( loc_num_luces, nl );
    glUniform3fv( loc_color_luz, nl, (const float *)color.data() );
    glUniform4fv( loc_pos_dir_luz_ec, nl, (const float *)pos_dir_ec.data() );
+   contadores.binds_programa++ ;
+   contadores.uniforms += 3 ;
 }
 // -----------------------------------------------------------------------------
 
 void Cauce3D::actualizarUniformsMatricesMN()
 {
    //log("entra");
-   assert( 0 < id_prog );
+   mat_modelado_nor = transpose( inverse( mat_modelado ) );
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    assert( -1 < loc_mat_modelado );
    assert( -1 < loc_mat_modelado_nor );
 
-   mat_modelado_nor = transpose( inverse( mat_modelado ) );
-
    CError();
    glUseProgram( id_prog );
    glUniformMatrix4fv( loc_mat_modelado,     1, GL_FALSE, value_ptr( mat_modelado ) );
    glUniformMatrix4fv( loc_mat_modelado_nor, 1, GL_FALSE, value_ptr( mat_modelado_nor ));
+   contadores.binds_programa++ ;
+   contadores.uniforms += 2 ;
    CError();
    //log("sale");
 }
@@ -184,6 +262,13 @@ Cauce3D_ogl3::Cauce3D_ogl3()
    nombre_src_fs = "cauce33-3D-frag.glsl" ;
    nombre_src_vs = "cauce33-3D-vert.glsl" ;
 
+   // sin contexto de OpenGL (con el rasterizador por software) no hay objeto programa, el cauce
+   // solo registra el estado que lee el rasterizador
+   if ( RasterizadorCPU::activo() )
+   {  cout << "Sin contexto de OpenGL (rasterizador por software): no se compilan los shaders." << endl ;
+      return ;
+   }
+
    crearObjetoPrograma();
    inicializarUniformsBase();
    inicializarUniforms3D();
@@ -218,6 +303,12 @@ Cauce3D_ogl4::Cauce3D_ogl4()
 
    sustituir_tris_parches = true ; // ya que hay tesselation shaders
 
+   // (sin contexto de OpenGL no hay objeto programa, igual que en 'Cauce3D_ogl3')
+   if ( RasterizadorCPU::activo() )
+   {  cout << "Sin contexto de OpenGL (rasterizador por software): no se compilan los shaders." << endl ;
+      return ;
+   }
+
    crearObjetoPrograma();
    inicializarUniformsBase();
    inicializarUniforms3D();
@@ -244,12 +335,15 @@ void Cauce3D_ogl4::inicializarUniforms3D_ogl4()
 
 void Cauce3D_ogl4::fijarActivarTS( const bool nuevo_activar_ts )
 {
+   activar_ts = nuevo_activar_ts ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    CError();
-   assert( 0 < id_prog );
    glUseProgram( id_prog );
    assert( loc_activar_ts > -1 );
-   activar_ts = nuevo_activar_ts ;
    glUniform1ui( loc_activar_ts, activar_ts );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    CError();
 }
 
@@ -257,12 +351,15 @@ void Cauce3D_ogl4::fijarActivarTS( const bool nuevo_activar_ts )
 
 void Cauce3D_ogl4::fijarActivarGS( const bool nuevo_activar_gs )
 {
+   activar_gs = nuevo_activar_gs ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    CError();
-   assert( 0 < id_prog );
    glUseProgram( id_prog );
    assert( loc_activar_gs > -1 );
-   activar_gs = nuevo_activar_gs ;
    glUniform1ui( loc_activar_gs, activar_gs );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    CError();
 }
 
@@ -33,6 +33,14 @@ constexpr GLuint
    ind_atrib_normales        = 3 , 
    numero_atributos_cauce_3d = 4 ;
 
+// atributos por instancia usados en el dibujo instanciado: la matriz de modelado de 
+// cada instancia ocupa 4 índices consecutivos (una columna en cada uno), y la matriz de 
+// las normales (traspuesta de la inversa de la anterior, calculada en la CPU) ocupa 3
+constexpr GLuint 
+   ind_atrib_mat_instancia        = 4 , 
+   ind_atrib_mat_nor_instancia    = 8 , 
+   numero_atributos_cauce_3d_inst = 11 ;
+
 // -------------------------------------------------------------------------------------
 /// @brief Clase para el cauce de funcionalidad programable (OpenGL 3.3 o superior)
 ///
@@ -59,6 +67,10 @@ class Cauce3D : public CauceBase
    ///
    void fijarEvalMIL( const bool nue_eval_mil );
 
+   /// @brief Devuelve true si está activada la evaluación del MIL
+   ///
+   bool leerEvalMIL() { return eval_mil ; } ;
+
    /// @brief Activa o desactiva el uso de normales del triángulo para iluminación 
    ///
    /// @param nue_usar_normales_tri (bool) true -> activa uso de normales del triángulo, false -> desactiva
@@ -95,6 +107,24 @@ class Cauce3D : public CauceBase
    ///
    unsigned maxNumFuentesLuz() { return 8 ; } ;
 
+   /// @brief Activa o desactiva el uso de la matriz de modelado de cada instancia (dibujo instanciado)
+   /// @brief (cuando está activado, la matriz de modelado de la instancia se compone con la actual)
+   ///
+   /// @param nue_usar_instancias (bool) true -> activa, false -> desactiva
+   ///
+   void fijarUsarInstancias( const bool nue_usar_instancias );
+
+   /// @brief Activa o desactiva la decodificación de posiciones cuantizadas en el vertex shader
+   /// @brief (la posición en coords. de objeto es 'despl + escala*valor', donde 'valor' es el entero leído).
+   /// @brief Se llama antes de cada dibujo de un VAO: solo envía los uniforms que cambian, y sin
+   /// @brief cambiar el programa activo ('glProgramUniform')
+   ///
+   /// @param nue_decod_pos (bool) true -> activa, false -> desactiva
+   /// @param escala        (vec3) escala de cada coordenada
+   /// @param despl         (vec3) desplazamiento (centro de la caja englobante)
+   ///
+   void fijarDecodPosiciones( const bool nue_decod_pos, const glm::vec3 & escala, const glm::vec3 & despl );
+
    // -------------------------------------------------------------
    protected:
 
@@ -109,15 +139,36 @@ class Cauce3D : public CauceBase
       loc_mil_exp           = -1,
       loc_num_luces         = -1,
       loc_color_luz         = -1,
-      loc_pos_dir_luz_ec    = -1 ;
+      loc_pos_dir_luz_ec    = -1,
+      loc_usar_instancias   = -1,
+      loc_decod_pos         = -1,
+      loc_decod_pos_escala  = -1,
+      loc_decod_pos_despl   = -1 ;
 
    bool
       eval_mil          = false, // true -> evaluar MIL, false -> usar color plano
-      usar_normales_tri = false;
+      usar_normales_tri = false,
+      usar_instancias   = false, // true -> componer con la matriz de modelado de cada instancia
+      decod_pos         = false; // true -> decodificar posiciones cuantizadas
+   glm::vec3
+      decod_pos_escala  = glm::vec3( 1.0f ), // últimos valores enviados de la escala y el desplazamiento
+      decod_pos_despl   = glm::vec3( 0.0f ); // (ver 'fijarDecodPosiciones')
    glm::mat4
       mat_modelado_nor = glm::mat4(1.0f);   // matriz de modelado para normales
    std::vector<glm::mat4>   
       pila_mat_modelado_nor ;
+   float
+      mil_ka  = 0.2f ,  // copia de los parámetros del MIL (para el rasterizador por software)
+      mil_kd  = 0.8f ,
+      mil_ks  = 0.0f ,
+      mil_exp = 0.0f ;
+   std::vector<glm::vec3>
+      color_luces ;      // copia de los colores de las fuentes de luz
+   std::vector<glm::vec4>
+      pos_dir_luces_ec ; // copia de las posiciones/direcciones de las fuentes (en coords. de cámara)
+
+   // el rasterizador por software lee el estado del cauce al dibujar
+   friend class RasterizadorCPU ;
 
    // fijar (con glUniform) las matrices de modelado y de normales en el shader prog.
    virtual void actualizarUniformsMatricesMN() override;
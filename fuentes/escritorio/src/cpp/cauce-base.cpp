@@ -24,6 +24,8 @@
 
 #include "utilidades.h" 
 #include "cauce-base.h" 
+#include "perfilador.h"
+#include "rasterizador-cpu.h" // RasterizadorCPU::instancia
 
 // -----------------------------------------------------------------------------
 
@@ -152,6 +154,8 @@ void CauceBase::inicializarUniformsBase()
    loc_coefs_s           = leerLocation( "u_coefs_s" );
    loc_coefs_t           = leerLocation( "u_coefs_t" );
    loc_param_s           = leerLocation( "u_param_s" );
+   loc_tex_arreglo       = leerLocation( "u_tex_arreglo" );
+   loc_capa_text         = leerLocation( "u_capa_text" );
    
    // dar valores iniciales por defecto a los parámetros uniform
  
@@ -166,6 +170,10 @@ void CauceBase::inicializarUniformsBase()
    glUniform4fv( loc_coefs_t, 1, coefs_t );
    glUniform1f( loc_param_s, param_s );
 
+   // el arreglo de texturas usa la unidad 1 ('u_tex' usa la 0)
+   glUniform1i( loc_tex_arreglo, 1 );
+   glUniform1i( loc_capa_text, -1 );
+
    CError();
    
    glUseProgram( 0 );
@@ -236,9 +244,12 @@ GLint CauceBase::leerLocation( const char * name )
 void CauceBase::activar()
 {
    //log("activo cauce ",descripcion());
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    CError();
    assert( 0 < id_prog );
    glUseProgram( id_prog );
+   contadores.binds_programa++ ;
    CError();
 }
 
@@ -285,6 +296,8 @@ void CauceBase::fijarColor( const float r, const float g, const float b )
 {
    CError();
    color = { r,g,b } ; // registra color en el objeto cauce
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    glVertexAttrib3f( ind_atrib_colores, r, g, b  ); // cambia valor atributo
    CError();
 }
@@ -309,11 +322,14 @@ void CauceBase::popColor()
 void CauceBase::fijarMatrizVista( const glm::mat4 & nue_mat_vista )
 {
    using namespace glm ;
-   assert( 0 < id_prog );
 
    mat_vista = nue_mat_vista ;
-   glUseProgram( id_prog );
-   glUniformMatrix4fv( loc_mat_vista, 1, GL_FALSE, value_ptr( mat_vista ) );
+   if ( id_prog != 0 ) // (sin contexto de OpenGL no se fija el uniform)
+   {  glUseProgram( id_prog );
+      glUniformMatrix4fv( loc_mat_vista, 1, GL_FALSE, value_ptr( mat_vista ) );
+      contadores.binds_programa++ ;
+      contadores.uniforms++ ;
+   }
    
    pila_mat_modelado.clear();
    //pila_mat_modelado_nor.clear();
@@ -329,19 +345,53 @@ void CauceBase::fijarMatrizVista( const glm::mat4 & nue_mat_vista )
 
 void CauceBase::fijarMatrizProyeccion( const glm::mat4 & nue_mat_proyeccion )
 {
-   assert( 0 < id_prog );
    mat_proyeccion = nue_mat_proyeccion ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
 
    glUseProgram( id_prog );
    glUniformMatrix4fv( loc_mat_proyeccion, 1, GL_FALSE, value_ptr( mat_proyeccion ) );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    CError();
 }
 //-----------------------------------------------------------------------------
 
+float CauceBase::pixelsPorUnidadOC() const 
+{
+   using namespace glm ;
+
+   // origen de coordenadas de objeto en coordenadas de cámara, y longitud en coordenadas de 
+   // cámara de una unidad en coordenadas de objeto (media de las escalas de los tres ejes)
+   const mat4  mat_mv = mat_vista*mat_modelado ;
+   const vec4  origen = mat_mv*vec4( 0.0f, 0.0f, 0.0f, 1.0f );
+   const float escala = ( length( vec3( mat_mv[0] )) + length( vec3( mat_mv[1] )) + length( vec3( mat_mv[2] )) )/3.0f ;
+
+   if ( origen.z >= 0.0f )
+      return 0.0f ;
+
+   // proyectar el origen y un punto desplazado 'escala' en X (perpendicular a la dirección de vista)
+   const vec4 p0 = mat_proyeccion*origen ,
+              p1 = mat_proyeccion*( origen + vec4( escala, 0.0f, 0.0f, 0.0f ));
+   if ( p0.w <= 0.0f || p1.w <= 0.0f )
+      return 0.0f ;
+
+   // ancho del viewport (sin contexto de OpenGL, el de la imagen del rasterizador por software)
+   GLint viewport[4] = { 0, 0, 0, 0 } ;
+   if ( id_prog != 0 )
+      glGetIntegerv( GL_VIEWPORT, viewport );
+   else
+      viewport[2] = RasterizadorCPU::instancia()->leerAncho() ;
+   return 0.5f*float( viewport[2] )*std::abs( p1.x/p1.w - p0.x/p0.w );
+}
+//-----------------------------------------------------------------------------
+
 void CauceBase::fijarEvalText( const bool nue_eval_text, const int nue_text_id  )
 {
-   CError();
    eval_text = nue_eval_text ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+   CError();
 
    if ( eval_text )
    {
@@ -349,17 +399,44 @@ void CauceBase::fijarEvalText( const bool nue_eval_text, const int nue_text_id
       glActiveTexture( GL_TEXTURE0 ) ; // creo que necesario en el cauce prog., probar
       glBindTexture( GL_TEXTURE_2D, nue_text_id );
       glUniform1ui( loc_eval_text, true );
+      glUniform1i( loc_capa_text, -1 );
+      contadores.binds_textura++ ;
+      contadores.uniforms += 2 ;
       CError();
    }
    else
    {
       glUniform1ui( loc_eval_text, false );
+      contadores.uniforms++ ;
       CError();
    }
    CError();
 }
 //-----------------------------------------------------------------------------
 
+void CauceBase::fijarEvalTextArreglo( const GLuint ident_arreglo, const unsigned capa )
+{
+   assert( ident_arreglo != 0 );
+   eval_text = true ;
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
+   CError();
+
+   if ( ident_arreglo != ident_arreglo_ligado )
+   {
+      glActiveTexture( GL_TEXTURE1 ) ;
+      glBindTexture( GL_TEXTURE_2D_ARRAY, ident_arreglo );
+      glActiveTexture( GL_TEXTURE0 ) ;
+      ident_arreglo_ligado = ident_arreglo ;
+      contadores.binds_textura++ ;
+   }
+   glUniform1ui( loc_eval_text, true );
+   glUniform1i( loc_capa_text, int( capa ) );
+   contadores.uniforms += 2 ;
+   CError();
+}
+//-----------------------------------------------------------------------------
+
 void CauceBase::fijarTipoGCT( const int nue_tipo_gct,
                            const float * coefs_s, const float * coefs_t )
 {
@@ -371,15 +448,21 @@ void CauceBase::fijarTipoGCT( const int nue_tipo_gct,
    {
       assert( coefs_s != nullptr );
       assert( coefs_t != nullptr );
+      std::copy( coefs_s, coefs_s+4, this->coefs_s ); // (los lee el rasterizador por software)
+      std::copy( coefs_t, coefs_t+4, this->coefs_t );
    }
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
 
    //glUniform1i( loc_tipo_gct, tipo_gct  ? 1 : 0 );
    glUniform1i( loc_tipo_gct, tipo_gct );
+   contadores.uniforms++ ;
 
    if ( tipo_gct == 1 || tipo_gct == 2 )
    {
       glUniform4fv( loc_coefs_s, 1, coefs_s );
       glUniform4fv( loc_coefs_t, 1, coefs_t );
+      contadores.uniforms += 2 ;
    }
    CError();
 }
@@ -388,6 +471,7 @@ void CauceBase::fijarTipoGCT( const int nue_tipo_gct,
 void CauceBase::pushMM()
 {
    pila_mat_modelado.push_back( mat_modelado );
+   contadores.push_mm++ ;
 }
 // -----------------------------------------------------------------------------
 
@@ -398,6 +482,7 @@ void CauceBase::popMM()
    
    mat_modelado = pila_mat_modelado[n-1] ;
    pila_mat_modelado.pop_back();
+   contadores.pop_mm++ ;
    
    actualizarUniformsMatricesMN();
 }
@@ -408,6 +493,7 @@ void CauceBase::popMM()
 
 void CauceBase::compMM( const glm::mat4 & mat_componer )
 {
+   ZONA_PERFIL_CPU( "compMM" );
    using namespace glm ;
    CError();
 
@@ -420,12 +506,15 @@ void CauceBase::compMM( const glm::mat4 & mat_componer )
 
 void CauceBase::actualizarUniformsMatricesMN()
 {
-   assert( 0 < id_prog );
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+      return ;
    assert( -1 < loc_mat_modelado );
 
    CError();
    glUseProgram( id_prog );
    glUniformMatrix4fv( loc_mat_modelado,     1, GL_FALSE, value_ptr( mat_modelado ) );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    
    CError();
 }
@@ -441,10 +530,16 @@ void CauceBase::modificarParametroS( const float signo )
    // calcular el nuevo valor del parámetro s
    constexpr float delta = 0.1  ;   // va de 0 a 1 en 10 pasos.
    param_s = std::min( 1.0f, std::max( 0.0f, param_s + signo*delta ) );
+   if ( id_prog == 0 ) // (sin contexto de OpenGL)
+   {  cout << "Nuevo valor del parámetro s == " << param_s << endl ;
+      return ;
+   }
 
    // fijar el uniform en el objeto programa
    glUseProgram( id_prog );
    glUniform1f( loc_param_s, param_s );
+   contadores.binds_programa++ ;
+   contadores.uniforms++ ;
    
    // ya está.
    cout << "Nuevo valor del parámetro s == " << param_s << endl ;
@@ -27,6 +27,7 @@
 
 #include <vector>
 #include "utilidades.h"
+#include "estadisticas-render.h"
 
 // mapeo de atributos usados con índices de atributos enteros
 // índices de los atributos en los shaders de este cauce
@@ -94,11 +95,25 @@ class CauceBase
    /// @brief establece la matriz de proyección actual en este cauce
    void fijarMatrizProyeccion( const glm::mat4 & nue_mat_proyeccion );
 
+   /// @brief Devuelve (aproximadamente) el número de pixels del viewport que ocupa en la ventana una 
+   /// @brief distancia de una unidad en coordenadas de objeto, medida en el origen de coordenadas de 
+   /// @brief objeto (según las matrices de modelado, vista y proyección actuales). Devuelve 0 si 
+   /// @brief el origen está detrás de la cámara.
+   float pixelsPorUnidadOC() const ;
+
    /// @brief  Activa o desactiva la evaluación de textura en el cauce.
    /// @param nue_eval_text - 'true' para activar la evaluación de textura, 'false' para desactivarla.
    /// @param nue_text_id - si 'nue_eval_text' es 'true', identificador de la textura a usar.
    ///
    void fijarEvalText( const bool nue_eval_text, const int nue_text_id = -1 )  ;
+
+   /// @brief  Activa la evaluación de textura con una capa de un arreglo de texturas ('GL_TEXTURE_2D_ARRAY',
+   /// @brief  ver 'ArregloTexturas'). El arreglo se liga a la unidad 1 solo si no es el que ya estaba ligado, 
+   /// @brief  así las texturas con capas del mismo arreglo se activan cambiando solo un uniform.
+   /// @param ident_arreglo - identificador de la textura de OpenGL del arreglo.
+   /// @param capa - índice de la capa a usar.
+   ///
+   void fijarEvalTextArreglo( const GLuint ident_arreglo, const unsigned capa ) ;
    
    /// @brief Activa/desactiva y fija los coeficientes de generación de coordenadas de textura.
    /// @param nue_tipo_gct - vale 0, 1, 2 
@@ -150,6 +165,10 @@ class CauceBase
    ///
    void modificarParametroS( const float signo );
 
+   /// @brief contadores de programas y texturas activados, uniforms enviados y operaciones en la 
+   /// @brief pila de modelado (de todos los cauces, ver 'EstadisticasRender')
+   static inline ContadoresCauce contadores ;
+
    // -------------------------------------------------------------
    protected:
 
@@ -168,7 +187,8 @@ class CauceBase
       id_te_shader     = 0;       // identificador del tessellation evaluation shader
    
    GLint
-      id_prog               = 0 ,  // identificador del 'shader program'
+      id_prog               = 0 ,  // identificador del 'shader program' (0 sin contexto de OpenGL, con el 
+                                   // rasterizador por software: entonces los métodos solo registran el estado)
       
       loc_mat_modelado   = -1,  // 'localizaciones' de los parámetros uniform
       loc_mat_vista      = -1,
@@ -178,6 +198,8 @@ class CauceBase
       loc_eval_text      = -1,
       loc_coefs_s        = -1,
       loc_coefs_t        = -1 ,
+      loc_tex_arreglo    = -1 ,
+      loc_capa_text      = -1 ,
 
       loc_param_s        = -1 ; // localización del parámetro uniform 's' de los shaders
       
@@ -204,6 +226,9 @@ class CauceBase
    float 
       param_s = 0.0f ; // copia del valor del parámetro uniform 'u_param_s' de los shaders
 
+   static inline GLuint 
+      ident_arreglo_ligado = 0 ; // arreglo de texturas ligado a la unidad 1 (es común a todos los cauces)
+
    std::vector<glm::mat4>   // pilas de la matriz de modelado y de la matriz de modelado de normales.
       pila_mat_modelado ; //,
       //pila_mat_modelado_nor ;
@@ -47,6 +47,13 @@
 #include "malla-sp.h"
 #include "grafo-sp.h"
 #include "objetos-2d.h"
+#include "objeto-provisional.h"
+#include "reserva-hebras.h"
+
+// -----------------------------------------------------------------------------------------------
+
+unsigned    ColeccionObjs::max_cambios_sin_visita = 3 ;
+std::size_t ColeccionObjs::presupuesto_memoria    = std::size_t( 128 )*1024*1024 ; // 128 MB
 
 // -----------------------------------------------------------------------------------------------
 
@@ -59,6 +66,20 @@ ColeccionObjs::ColeccionObjs()
 
 ColeccionObjs::~ColeccionObjs()
 {
+   // esperar a que terminen de crearse los objetos diferidos (su sustitución, ya encolada o no, 
+   // se cancela), y destruir los objetos provisionales que ya no están en 'objetos'
+   for( auto & [i, dif] : diferidos )
+   {
+      if ( dif.tarea != nullptr )
+      {  ReservaHebras::instancia()->esperar( dif.tarea );
+         dif.creacion->cancelada = true ;
+         dif.creacion->objeto->pendienteDestruccion();
+      }
+      if ( dif.creado )
+         delete dif.provisional ;
+   }
+   diferidos.clear();
+
    for( ObjetoVisu * obj : objetos )
    {
       assert( obj != nullptr );
@@ -82,6 +103,8 @@ void ColeccionObjs::siguienteObjeto()
    assert( 0 < objetos.size() );
    assert( ind_objeto_actual < objetos.size() );
    ind_objeto_actual = (ind_objeto_actual+1 ) % objetos.size();
+   num_cambios++ ;
+   liberarDiferidosNoVisitados();
    imprimeInfoObjetoActual() ;
 }
 // -----------------------------------------------------------------------------------------------
@@ -91,6 +114,190 @@ void ColeccionObjs::imprimeInfoObjetoActual()
    using namespace std ;
    cout << "Objeto actual " << (ind_objeto_actual+1) << "/" << objetos.size() << " : " 
         << objetoActual()->leerNombre() << endl  ;
+
+   cout << "Memoria del objeto: " ;
+   objetoActual()->leerUsoMemoria().imprimir( cout );
+   cout << endl ;
+
+   const std::size_t bytes = bytesCPULiberados() ;
+   if ( bytes > 0 )
+      cout << "Memoria liberada en la CPU (tablas de mallas ya enviadas a la GPU): " 
+           << (bytes+1023)/1024 << " KB" << endl ;
+}
+// -----------------------------------------------------------------------------------------------
+
+std::size_t ColeccionObjs::bytesCPULiberados() const 
+{
+   std::size_t bytes = 0 ;
+   for( ObjetoVisu * obj : objetos )
+      if ( const MallaInd * malla = dynamic_cast<const MallaInd *>( obj ) )
+         bytes += malla->leerBytesCPULiberados();
+   return bytes ;
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const 
+{
+   for( ObjetoVisu * obj : objetos )
+      obj->acumularUsoMemoria( uso, contados );
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::imprimirUsoMemoria() const 
+{
+   using namespace std ;
+   cout << "Memoria de la colección '" << nombreColeccion << "':" << endl ;
+   for( unsigned i = 0 ; i < objetos.size() ; i++ )
+   {
+      cout << "   " << setw(2) << (i+1) << ". " << objetos[i]->leerNombre() << ": " ;
+      objetos[i]->leerUsoMemoria().imprimir( cout );
+      cout << endl ;
+   }
+
+   // en el total, los recursos compartidos por varios objetos se cuentan una vez
+   UsoMemoria            total ;
+   set<const void *>     contados ;
+   acumularUsoMemoria( total, contados );
+   cout << "   Total: " ;
+   total.imprimir( cout );
+   cout << endl ;
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::escribirUsoMemoriaJSON( std::ostream & os, UsoMemoria & uso, 
+                                            std::set<const void *> & contados ) const 
+{
+   os << "    { \"nombre\": " << CadenaJSON( nombreColeccion ) << "," << std::endl 
+      << "      \"objetos\": [" << std::endl ;
+   for( unsigned i = 0 ; i < objetos.size() ; i++ )
+   {
+      os << "        { \"nombre\": " << CadenaJSON( objetos[i]->leerNombre() ) << ", \"uso\": " ;
+      objetos[i]->leerUsoMemoria().escribirJSON( os );
+      os << " }" << ( i+1 < objetos.size() ? "," : "" ) << std::endl ;
+   }
+
+   // total de la colección (sin los recursos contados en colecciones anteriores)
+   UsoMemoria total ;
+   acumularUsoMemoria( total, contados );
+   uso += total ;
+   os << "      ]," << std::endl 
+      << "      \"total\": " ;
+   total.escribirJSON( os );
+   os << " }" ;
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::fijarResidenciaMallas( const ResidenciaMalla residencia )
+{
+   residencia_mallas = residencia ;
+   for( ObjetoVisu * obj : objetos )
+      if ( MallaInd * malla = dynamic_cast<MallaInd *>( obj ) )
+         malla->fijarResidencia( residencia );
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::agregarDiferido( const std::string & descripcion, std::function<ObjetoVisu *()> crear )
+{
+   assert( crear != nullptr );
+   ObjetoDiferido & dif = diferidos[ objetos.size() ] ;
+   dif.crear       = std::move( crear );
+   dif.provisional = new ObjetoProvisional( descripcion );
+   objetos.push_back( dif.provisional );
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::solicitarCreacion( const unsigned i )
+{
+   auto it = diferidos.find( i );
+   if ( it == diferidos.end() || it->second.creado || it->second.tarea != nullptr )
+      return ;
+
+   // la tarea solo crea el objeto, la sustitución (que usa 'objetos') se encola en la hebra 
+   // principal; si la colección ya no existe, la sustitución no hace nada ('cancelada')
+   ObjetoDiferido & dif = it->second ;
+   dif.creacion = std::make_shared<CreacionObjeto>();
+   dif.tarea    = ReservaHebras::instancia()->crearTarea( "crear objeto", 
+      [this, i, creacion = dif.creacion, crear = dif.crear]()
+      {
+         creacion->objeto = crear();
+         ReservaHebras::instancia()->encolarPrincipal( [this, i, creacion]()
+         {
+            if ( ! creacion->cancelada )
+               sustituirProvisional( i );
+         });
+      });
+   ReservaHebras::instancia()->lanzar( dif.tarea );
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::sustituirProvisional( const unsigned i )
+{
+   using namespace std ;
+   ObjetoDiferido & dif = diferidos.at( i );
+
+   // el objeto provisional se guarda, por si después se libera el objeto definitivo
+   ObjetoVisu * objeto = dif.creacion->objeto ;
+   assert( objeto != nullptr );
+   assert( objetos[i] == dif.provisional );
+   objetos[i]   = objeto ;
+   dif.creado   = true ;
+   dif.tarea    = nullptr ;
+   dif.creacion = nullptr ;
+
+   // las tablas se mueven (o no) al crear el VAO, que todavía no se ha creado
+   if ( MallaInd * malla = dynamic_cast<MallaInd *>( objeto ) )
+      malla->fijarResidencia( residencia_mallas );
+
+   cout << "Objeto creado en segundo plano: " << objeto->leerNombre() << endl ;
+}
+// -----------------------------------------------------------------------------------------------
+
+unsigned ColeccionObjs::numCargasPendientes() const 
+{
+   unsigned n = 0 ;
+   for( const auto & [i, dif] : diferidos )
+      if ( dif.tarea != nullptr )
+         n++ ;
+   return n ;
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::fijarLiberacionDiferidos( const unsigned num_cambios, const std::size_t presupuesto_bytes )
+{
+   max_cambios_sin_visita = num_cambios ;
+   presupuesto_memoria    = presupuesto_bytes ;
+}
+// -----------------------------------------------------------------------------------------------
+
+void ColeccionObjs::liberarDiferidosNoVisitados()
+{
+   using namespace std ;
+
+   while( true )
+   {
+      UsoMemoria        uso ;
+      set<const void *> contados ;
+      acumularUsoMemoria( uso, contados );
+      if ( uso.totalCPU() + uso.totalGPU() <= presupuesto_memoria )
+         return ;
+
+      // buscar el objeto diferido creado que lleva más cambios sin visitar (al menos 'max_cambios_sin_visita')
+      unsigned ind_lib = objetos.size() ;
+      for( const auto & [i, dif] : diferidos )
+         if ( dif.creado && i != ind_objeto_actual && num_cambios - dif.ultima_visita >= max_cambios_sin_visita )
+            if ( ind_lib == objetos.size() || dif.ultima_visita < diferidos.at( ind_lib ).ultima_visita )
+               ind_lib = i ;
+      if ( ind_lib == objetos.size() ) // no hay ninguno que se pueda liberar
+         return ;
+
+      // destruir el objeto (se volverá a crear si se selecciona) y poner el provisional en su lugar
+      ObjetoDiferido & dif = diferidos[ind_lib] ;
+      cout << "Liberando objeto no visitado en " << (num_cambios - dif.ultima_visita) << " cambios: " 
+           << objetos[ind_lib]->leerNombre() << endl ;
+      ObjetoVisu::destruirAhora( objetos[ind_lib] );
+      objetos[ind_lib] = dif.provisional ;
+      dif.creado = false ;
+   }
 }
 // -----------------------------------------------------------------------------------------------
 
@@ -101,6 +308,13 @@ ObjetoVisu * ColeccionObjs::objetoActual()
    assert( 0 < objetos.size() );
    assert( ind_objeto_actual < objetos.size() );
    assert( objetos[ind_objeto_actual] != nullptr );
+
+   // si es un objeto diferido, anotar la visita y empezar a crearlo si no está creado
+   auto it = diferidos.find( ind_objeto_actual );
+   if ( it != diferidos.end() )
+   {  it->second.ultima_visita = num_cambios ;
+      solicitarCreacion( ind_objeto_actual );
+   }
    return objetos[ind_objeto_actual] ;
 }
 // -----------------------------------------------------------------------------------------------
@@ -114,17 +328,20 @@ ColeccionObjs3D_1::ColeccionObjs3D_1()
    nombreColeccion = "Mallas indexadas sencillas" ;
    cout << "Creando objetos de la colección 1: " << nombre() << "." << endl ;
 
-   objetos.push_back( new CuboNorCol() );
-   objetos.push_back( new CuboNor() );
-   objetos.push_back( new Cubo() );
-   objetos.push_back( new Cilindro(32,16) );
-   objetos.push_back( new Esfera() );
-   objetos.push_back( new EsferaBajaRes() );
-   objetos.push_back( new Semiesfera() );
-   objetos.push_back( new Cono() );
-   objetos.push_back( new ConoTruncado() );
-   objetos.push_back( new Tetraedro() );
-   objetos.push_back( new Piramide() );
+   agregarDiferido( "CuboNorCol",    []() { return new CuboNorCol() ; } );
+   agregarDiferido( "CuboNor",       []() { return new CuboNor() ; } );
+   agregarDiferido( "Cubo",          []() { return new Cubo() ; } );
+   agregarDiferido( "Cilindro",      []() { return new Cilindro(32,16) ; } );
+   agregarDiferido( "Esfera",        []() { return new Esfera() ; } );
+   agregarDiferido( "EsferaBajaRes", []() { return new EsferaBajaRes() ; } );
+   agregarDiferido( "Semiesfera",    []() { return new Semiesfera() ; } );
+   agregarDiferido( "Cono",          []() { return new Cono() ; } );
+   agregarDiferido( "ConoTruncado",  []() { return new ConoTruncado() ; } );
+   agregarDiferido( "Tetraedro",     []() { return new Tetraedro() ; } );
+   agregarDiferido( "Piramide",      []() { return new Piramide() ; } );
+
+   // las mallas no se agrupan ni se instancian, no necesitan sus tablas después de crear el VAO
+   fijarResidenciaMallas( ResidenciaMalla::solo_gpu );
 }
 // -------------------------------------------------------------------------
 
@@ -137,13 +354,16 @@ ColeccionObjs3D_2::ColeccionObjs3D_2()
    nombreColeccion = "Mallas indexadas generadas proceduralmente o de archivos PLY" ;
    cout << "Creando objetos de la colección 2: " << nombre() << "." << endl ;
 
-   objetos.push_back( new ConoRevol() );
-   objetos.push_back( new MallaPLY( "beethoven.ply") );
-   objetos.push_back( new MallaPLY( "big_dodge.ply") );
-   objetos.push_back( new MallaRevolPLY( "peon.ply", 17 ) );
-   objetos.push_back( new DonutRevol( 1.2, 0.3, 32, 32 ) );
-   objetos.push_back( new DonutRevol( 1.2, 0.3, 64, 32 ) );
-   objetos.push_back( new DonutRevol( 1.2, 0.3, 256, 32 ) );
+   agregarDiferido( "ConoRevol",     []() { return new ConoRevol() ; } );
+   agregarDiferido( "beethoven.ply", []() { return new MallaPLY( "beethoven.ply" ) ; } );
+   agregarDiferido( "big_dodge.ply", []() { return new MallaPLY( "big_dodge.ply" ) ; } );
+   agregarDiferido( "peon.ply",      []() { return new MallaRevolPLY( "peon.ply", 17 ) ; } );
+   agregarDiferido( "DonutRevol",    []() { return new DonutRevol( 1.2, 0.3, 32, 32 ) ; } );
+   agregarDiferido( "DonutRevol",    []() { return new DonutRevol( 1.2, 0.3, 64, 32 ) ; } );
+   agregarDiferido( "DonutRevol",    []() { return new DonutRevol( 1.2, 0.3, 256, 32 ) ; } );
+
+   // las mallas no se agrupan ni se instancian, no necesitan sus tablas después de crear el VAO
+   fijarResidenciaMallas( ResidenciaMalla::solo_gpu );
 }
 
 // -------------------------------------------------------------------------
@@ -159,11 +379,13 @@ ColeccionObjs3D_3::ColeccionObjs3D_3()
 
    constexpr unsigned ns = 32, nt = 32 ;
 
-   objetos.push_back( new MallaSPEsfera( ns, nt ) );
-   objetos.push_back( new MallaSPCilindro( ns, nt ) );
-   objetos.push_back( new MallaSPCono( ns, nt ) );
-   objetos.push_back( new MallaSPColumna( 3*ns, 3*nt ) );
-   
+   agregarDiferido( "MallaSPEsfera",   [=]() { return new MallaSPEsfera( ns, nt ) ; } );
+   agregarDiferido( "MallaSPCilindro", [=]() { return new MallaSPCilindro( ns, nt ) ; } );
+   agregarDiferido( "MallaSPCono",     [=]() { return new MallaSPCono( ns, nt ) ; } );
+   agregarDiferido( "MallaSPColumna",  [=]() { return new MallaSPColumna( 3*ns, 3*nt ) ; } );
+
+   // las mallas no se agrupan ni se instancian, no necesitan sus tablas después de crear el VAO
+   fijarResidenciaMallas( ResidenciaMalla::solo_gpu );
 }
 
 // -------------------------------------------------------------------------
@@ -177,8 +399,13 @@ ColeccionObjs3D_4::ColeccionObjs3D_4()
    nombreColeccion = "Objetos modelados como grafos de escena" ;
    cout << "Creando objetos de la colección 3: " << nombre() << "." << endl ;
 
-   objetos.push_back( new Cuadroide() );
-   objetos.push_back( new FormacionDroides(20,20));
+   // el cuadroide se visualiza con dibujo indirecto (sus mallas en el almacén de geometría)
+   agregarDiferido( "Cuadroide", []() 
+   {  Cuadroide * cuadroide = new Cuadroide();
+      cuadroide->activarDibujoIndirecto();
+      return cuadroide ;
+   });
+   agregarDiferido( "FormacionDroides", []() { return new FormacionDroides(20,20) ; } );
 }
 // -------------------------------------------------------------------------
 
@@ -191,9 +418,17 @@ ColeccionObjs3D_5::ColeccionObjs3D_5()
    nombreColeccion = "Objetos con materiales y texturas" ;
    cout << "Creando objetos de la colección 5: " << nombre() << "." << endl ;
 
-   objetos.push_back( new LataPeones() );
-   objetos.push_back( new NodoCubo24() ); // cubo con 24 vértices
-   objetos.push_back( new GrafoSupPar() );
+   // son objetos estáticos: si se ha pedido, se usa el agrupado estático (una malla agrupada por material)
+   const bool agrupado = agrupado_estatico ;
+
+   const auto agrupar = [=]( NodoGrafoEscena * nodo )
+   {  if ( agrupado )
+         nodo->activarAgrupadoEstatico();
+      return nodo ;
+   };
+   agregarDiferido( "LataPeones",  [=]() { return agrupar( new LataPeones() ) ; } );
+   agregarDiferido( "NodoCubo24",  [=]() { return agrupar( new NodoCubo24() ) ; } ); // cubo con 24 vértices
+   agregarDiferido( "GrafoSupPar", [=]() { return agrupar( new GrafoSupPar() ) ; } );
 }
 // -------------------------------------------------------------------------
 
@@ -207,7 +442,7 @@ ColeccionObjs3D_6::ColeccionObjs3D_6()
    cout << "Creando objetos de la colección 5: " << nombre() << "." << endl ;
 
    constexpr unsigned int ident_dado = 345 ;
-   objetos.push_back( new VariasLatasPeones( ident_dado ) );
+   agregarDiferido( "VariasLatasPeones", [=]() { return new VariasLatasPeones( ident_dado ) ; } );
 }
 
 // -------------------------------------------------------------------------
@@ -38,8 +38,15 @@
 #pragma once
 
 
+#include <map>
 #include <vector>
+#include <memory>
+#include <functional>
 #include "objeto-visu.h"
+#include "malla-ind.h"
+#include "reserva-hebras.h"
+
+class ObjetoProvisional ;
 
 // *************************************************************************
 // Clase ColeccionObjs
@@ -55,14 +62,16 @@ class ColeccionObjs
    ///
    ColeccionObjs() ;
 
-   /// @brief destructor
+   /// @brief destructor (espera a que terminen de crearse los objetos diferidos)
    ~ColeccionObjs() ;
    
-   /// @brief pasa el objeto actual al siguiente
+   /// @brief pasa el objeto actual al siguiente (y libera los objetos diferidos que no se han 
+   /// @brief visitado recientemente, si la colección supera el presupuesto de memoria)
    ///
    void siguienteObjeto() ;
 
-   /// @brief devuelve puntero al objeto actual (h)
+   /// @brief devuelve puntero al objeto actual (h), si es un objeto diferido que no se ha creado 
+   /// @brief todavía, empieza a crearlo y devuelve su objeto provisional
    ///
    ObjetoVisu * objetoActual();
 
@@ -78,8 +87,88 @@ class ColeccionObjs
    ///
    unsigned numObjetos() { return objetos.size(); }
 
+   /// @brief devuelve los bytes de memoria de la aplicación liberados al mover a la GPU las 
+   /// @brief tablas de las mallas de la colección (solo las que ya se han visualizado)
+   ///
+   std::size_t bytesCPULiberados() const ;
+
+   /// @brief suma a 'uso' la memoria de todos los objetos de la colección, excepto los recursos 
+   /// @brief que ya están en 'contados' (ver 'ObjetoVisu::acumularUsoMemoria')
+   ///
+   void acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const ;
+
+   /// @brief escribe en el terminal la memoria de cada objeto y el total de la colección
+   ///
+   void imprimirUsoMemoria() const ;
+
+   /// @brief escribe en 'os' un objeto JSON con el nombre de la colección, la memoria de cada objeto
+   /// @brief y el total (también suma el total a 'uso', sin contar los recursos en 'contados')
+   ///
+   void escribirUsoMemoriaJSON( std::ostream & os, UsoMemoria & uso, std::set<const void *> & contados ) const ;
+
+   /// @brief devuelve el número de objetos que todavía se están creando en segundo plano
+   ///
+   unsigned numCargasPendientes() const ;
+
+   /// @brief fija cuándo se liberan los objetos diferidos ya creados: se libera un objeto si lleva 
+   /// @brief 'num_cambios' o más cambios de objeto sin ser el actual y la memoria (CPU+GPU) de la 
+   /// @brief colección supera 'presupuesto_bytes' (empezando por el que lleva más tiempo sin visitar)
+   ///
+   static void fijarLiberacionDiferidos( const unsigned num_cambios, const std::size_t presupuesto_bytes );
+
    protected:
 
+   // fija la residencia de las tablas de los objetos de la colección que son mallas indexadas
+   // (también la de los que se terminen de crear después, en segundo plano)
+   void fijarResidenciaMallas( const ResidenciaMalla residencia );
+
+   // añade un objeto diferido: en la colección se pone un objeto provisional (ver 'ObjetoProvisional'), 
+   // y el objeto definitivo se crea con 'crear' la primera vez que se selecciona (en otra hebra, así 
+   // que 'crear' no debe usar OpenGL). Al terminar, la tarea encola en la hebra principal la 
+   // sustitución del objeto provisional (ver 'sustituirProvisional').
+   void agregarDiferido( const std::string & descripcion, std::function<ObjetoVisu *()> crear );
+
+   // si el objeto en la posición 'i' es un diferido que no se ha creado ni se está creando, 
+   // encola su creación en la reserva de hebras
+   void solicitarCreacion( const unsigned i );
+
+   // pone en la posición 'i' el objeto diferido que se acaba de crear, en lugar del provisional 
+   // (se llama en la hebra principal: la residencia de las tablas se fija antes de crear el VAO)
+   void sustituirProvisional( const unsigned i );
+
+   // libera los objetos diferidos según los límites fijados en 'fijarLiberacionDiferidos'
+   void liberarDiferidosNoVisitados();
+
+   // resultado de la creación de un objeto diferido, compartido con la tarea que lo crea
+   // ('cancelada' se pone a true si la colección se destruye antes de la sustitución)
+   struct CreacionObjeto
+   {
+      ObjetoVisu * objeto    = nullptr ;
+      bool         cancelada = false ;
+   } ;
+
+   // estado de un objeto diferido
+   struct ObjetoDiferido
+   {
+      std::function<ObjetoVisu *()>   crear ;                  // crea el objeto definitivo
+      ObjetoProvisional *             provisional = nullptr ;  // se usa mientras no está creado
+      PtrTarea                        tarea ;                  // no nula mientras se está creando
+      std::shared_ptr<CreacionObjeto> creacion ;               // (ídem)
+      bool                            creado = false ;         // true si ya está en 'objetos'
+      unsigned                        ultima_visita = 0 ;      // valor de 'num_cambios' la última vez que fue el actual
+   } ;
+   std::map<unsigned,ObjetoDiferido> diferidos ; // objetos diferidos, por su posición en 'objetos'
+
+   // número de veces que se ha cambiado el objeto actual (con 'siguienteObjeto')
+   unsigned num_cambios = 0 ;
+
+   // límites para liberar objetos diferidos (ver 'fijarLiberacionDiferidos')
+   static unsigned    max_cambios_sin_visita ;
+   static std::size_t presupuesto_memoria ;
+
+   // residencia de las tablas de las mallas de la colección (ver 'fijarResidenciaMallas')
+   ResidenciaMalla residencia_mallas = ResidenciaMalla::cpu_y_gpu ;
+
    // vector de objetos (alternativos: se visualiza uno de ellos nada más)
    std::vector<ObjetoVisu *> objetos ;
 
@@ -127,6 +216,13 @@ class ColeccionObjs3D_5 : public ColeccionObjs
 {
    public:
       ColeccionObjs3D_5() ;
+
+      // indica si los objetos de la colección (que son estáticos) usan el agrupado estático, 
+      // una malla agrupada por material (por defecto no), se debe llamar antes de crearla
+      static void fijarAgrupadoEstatico( const bool nuevo_agrupado ) { agrupado_estatico = nuevo_agrupado ; }
+
+   private:
+      static inline bool agrupado_estatico = false ;
 } ;
 
 
@@ -0,0 +1,516 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Compresión de texturas en bloques BC1 y BC7 (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cmath>
+#include <chrono>
+#include <cassert>
+#include <cstring>     // std::memcpy
+#include <iomanip>
+#include <iostream>
+#include <algorithm>   // std::min, std::max, std::swap
+#include <filesystem>
+#include "utilidades.h"    // PathCarpetaMateriales
+#include "lector-jpg.h"
+#include "reserva-hebras.h"
+#include "compresion-bc.h"
+#include "perfilador.h"
+
+// ------------------------------------------------------------------------------------------------------
+// extremos del eje principal de los colores de un bloque: el eje se calcula con unas pocas iteraciones
+// del método de la potencia sobre la matriz de covarianzas, y los extremos son las proyecciones mínima
+// y máxima de los colores sobre el eje (colores entre 0 y 255, como flotantes)
+
+static void ExtremosEjePrincipal( const unsigned char texels[48], float ext0[3], float ext1[3] )
+{
+   float media[3] = { 0.0f, 0.0f, 0.0f };
+   for( unsigned i = 0 ; i < 16 ; i++ )
+      for( unsigned c = 0 ; c < 3 ; c++ )
+         media[c] += texels[3*i+c]/16.0f ;
+
+   float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr, rg, rb, gg, gb, bb
+   for( unsigned i = 0 ; i < 16 ; i++ )
+   {  const float r = texels[3*i+0] - media[0], g = texels[3*i+1] - media[1], b = texels[3*i+2] - media[2] ;
+      cov[0] += r*r ; cov[1] += r*g ; cov[2] += r*b ;
+      cov[3] += g*g ; cov[4] += g*b ; cov[5] += b*b ;
+   }
+
+   float eje[3] = { 1.0f, 1.0f, 1.0f };
+   for( unsigned it = 0 ; it < 8 ; it++ )
+   {  const float x = cov[0]*eje[0] + cov[1]*eje[1] + cov[2]*eje[2],
+                  y = cov[1]*eje[0] + cov[3]*eje[1] + cov[4]*eje[2],
+                  z = cov[2]*eje[0] + cov[4]*eje[1] + cov[5]*eje[2],
+                  m = std::max( std::fabs( x ), std::max( std::fabs( y ), std::fabs( z )));
+      if ( m < 1e-6f )   // bloque de un solo color (o casi): cualquier eje vale
+         break ;
+      eje[0] = x/m ; eje[1] = y/m ; eje[2] = z/m ;
+   }
+   const float lon2 = eje[0]*eje[0] + eje[1]*eje[1] + eje[2]*eje[2] ;
+
+   float tmin = 1e30f, tmax = -1e30f ;
+   for( unsigned i = 0 ; i < 16 ; i++ )
+   {  const float t = ( (texels[3*i+0]-media[0])*eje[0] + (texels[3*i+1]-media[1])*eje[1]
+                      + (texels[3*i+2]-media[2])*eje[2] )/lon2 ;
+      tmin = std::min( tmin, t );
+      tmax = std::max( tmax, t );
+   }
+   for( unsigned c = 0 ; c < 3 ; c++ )
+   {  ext0[c] = std::min( 255.0f, std::max( 0.0f, media[c] + tmin*eje[c] ));
+      ext1[c] = std::min( 255.0f, std::max( 0.0f, media[c] + tmax*eje[c] ));
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+// busca para cada texel el color más cercano de una paleta de 'n' colores, escribe los índices y
+// devuelve el error cuadrático total
+
+static unsigned ElegirIndices( const unsigned char texels[48], const int paleta[][3], const unsigned n,
+                               unsigned indices[16] )
+{
+   unsigned error_total = 0 ;
+   for( unsigned i = 0 ; i < 16 ; i++ )
+   {
+      unsigned mejor_error = ~0u ;
+      for( unsigned k = 0 ; k < n ; k++ )
+      {  const int dr = texels[3*i+0] - paleta[k][0], dg = texels[3*i+1] - paleta[k][1], db = texels[3*i+2] - paleta[k][2] ;
+         const unsigned error = unsigned( dr*dr + dg*dg + db*db );
+         if ( error < mejor_error )
+         {  mejor_error = error ;
+            indices[i]  = k ;
+         }
+      }
+      error_total += mejor_error ;
+   }
+   return error_total ;
+}
+// ------------------------------------------------------------------------------------------------------
+// ajuste por mínimos cuadrados de los extremos: con los índices fijos (cada uno con un peso 'w' entre
+// 0 y 1 del extremo 1), se buscan los extremos que minimizan el error. Devuelve 'false' si el sistema
+// es singular (todos los texels usan el mismo peso)
+
+static bool AjustarExtremos( const unsigned char texels[48], const unsigned indices[16], const float pesos[],
+                             float ext0[3], float ext1[3] )
+{
+   float a = 0.0f, b = 0.0f, c = 0.0f, x0[3] = { 0.0f, 0.0f, 0.0f }, x1[3] = { 0.0f, 0.0f, 0.0f };
+   for( unsigned i = 0 ; i < 16 ; i++ )
+   {  const float w = pesos[ indices[i] ], v = 1.0f - w ;
+      a += v*v ; b += v*w ; c += w*w ;
+      for( unsigned k = 0 ; k < 3 ; k++ )
+      {  x0[k] += v*texels[3*i+k] ;
+         x1[k] += w*texels[3*i+k] ;
+      }
+   }
+   const float det = a*c - b*b ;
+   if ( std::fabs( det ) < 1e-6f )
+      return false ;
+   for( unsigned k = 0 ; k < 3 ; k++ )
+   {  ext0[k] = std::min( 255.0f, std::max( 0.0f, ( c*x0[k] - b*x1[k] )/det ));
+      ext1[k] = std::min( 255.0f, std::max( 0.0f, ( a*x1[k] - b*x0[k] )/det ));
+   }
+   return true ;
+}
+
+// ******************************************************************************************************
+// BC1
+// ------------------------------------------------------------------------------------------------------
+
+static unsigned short CodificarRGB565( const float c[3] )
+{
+   const unsigned r = unsigned( c[0]*31.0f/255.0f + 0.5f ),
+                  g = unsigned( c[1]*63.0f/255.0f + 0.5f ),
+                  b = unsigned( c[2]*31.0f/255.0f + 0.5f );
+   return (unsigned short)( (r << 11) | (g << 5) | b );
+}
+// ------------------------------------------------------------------------------------------------------
+
+static void DecodificarRGB565( const unsigned short v, int c[3] )
+{
+   const int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31 ;
+   c[0] = (r << 3) | (r >> 2) ;
+   c[1] = (g << 2) | (g >> 4) ;
+   c[2] = (b << 3) | (b >> 2) ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+// paleta de un bloque BC1: con 'c0 > c1' hay dos colores intermedios, si no uno intermedio y negro
+static void PaletaBC1( const unsigned short c0, const unsigned short c1, int paleta[4][3] )
+{
+   DecodificarRGB565( c0, paleta[0] );
+   DecodificarRGB565( c1, paleta[1] );
+   for( unsigned k = 0 ; k < 3 ; k++ )
+      if ( c0 > c1 )
+      {  paleta[2][k] = (2*paleta[0][k] + paleta[1][k])/3 ;
+         paleta[3][k] = (paleta[0][k] + 2*paleta[1][k])/3 ;
+      }
+      else
+      {  paleta[2][k] = (paleta[0][k] + paleta[1][k])/2 ;
+         paleta[3][k] = 0 ;
+      }
+}
+// ------------------------------------------------------------------------------------------------------
+
+// codifica un bloque BC1 en modo de 4 colores a partir de dos extremos, devuelve el error cuadrático
+static unsigned CodificarBC1( const unsigned char texels[48], const float ext0[3], const float ext1[3],
+                              unsigned short & c0, unsigned short & c1, unsigned indices[16] )
+{
+   c0 = CodificarRGB565( ext0 );
+   c1 = CodificarRGB565( ext1 );
+   if ( c0 < c1 )
+      std::swap( c0, c1 );
+   if ( c0 == c1 )        // un solo color: todos los texels usan el índice 0
+   {  int paleta[4][3] ;
+      PaletaBC1( c0, c1, paleta );
+      for( unsigned i = 0 ; i < 16 ; i++ )
+         indices[i] = 0 ;
+      return ElegirIndices( texels, paleta, 1, indices );
+   }
+   int paleta[4][3] ;
+   PaletaBC1( c0, c1, paleta );
+   return ElegirIndices( texels, paleta, 4, indices );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ComprimirBloqueBC1( const unsigned char texels[48], unsigned char bloque[8] )
+{
+   float          ext0[3], ext1[3] ;
+   unsigned short c0, c1 ;
+   unsigned       indices[16] ;
+
+   ExtremosEjePrincipal( texels, ext0, ext1 );
+   unsigned error = CodificarBC1( texels, ext0, ext1, c0, c1, indices );
+
+   // dos iteraciones de ajuste de los extremos (pesos del extremo 'c1' de cada índice: 0, 1, 1/3, 2/3)
+   constexpr float pesos[4] = { 0.0f, 1.0f, 1.0f/3.0f, 2.0f/3.0f };
+   for( unsigned it = 0 ; it < 2 && error > 0 && c0 != c1 ; it++ )
+   {
+      float          nue_ext0[3], nue_ext1[3] ;
+      unsigned short nue_c0, nue_c1 ;
+      unsigned       nue_indices[16] ;
+      if ( ! AjustarExtremos( texels, indices, pesos, nue_ext0, nue_ext1 ) )
+         break ;
+      const unsigned nue_error = CodificarBC1( texels, nue_ext0, nue_ext1, nue_c0, nue_c1, nue_indices );
+      if ( nue_error >= error )
+         break ;
+      error = nue_error ; c0 = nue_c0 ; c1 = nue_c1 ;
+      std::memcpy( indices, nue_indices, sizeof( indices ));
+   }
+
+   // 'c0' y 'c1' en little-endian, y después 2 bits por texel empezando por los bits bajos
+   unsigned bits = 0 ;
+   for( unsigned i = 0 ; i < 16 ; i++ )
+      bits |= indices[i] << (2*i) ;
+   bloque[0] = c0 & 0xFF ; bloque[1] = c0 >> 8 ;
+   bloque[2] = c1 & 0xFF ; bloque[3] = c1 >> 8 ;
+   for( unsigned k = 0 ; k < 4 ; k++ )
+      bloque[4+k] = (bits >> (8*k)) & 0xFF ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescomprimirBloqueBC1( const unsigned char bloque[8], unsigned char texels[48] )
+{
+   const unsigned short c0   = bloque[0] | (bloque[1] << 8),
+                        c1   = bloque[2] | (bloque[3] << 8);
+   const unsigned       bits = bloque[4] | (bloque[5] << 8) | (bloque[6] << 16) | (unsigned( bloque[7] ) << 24);
+   int paleta[4][3] ;
+   PaletaBC1( c0, c1, paleta );
+   for( unsigned i = 0 ; i < 16 ; i++ )
+      for( unsigned k = 0 ; k < 3 ; k++ )
+         texels[3*i+k] = (unsigned char) paleta[ (bits >> (2*i)) & 3 ][k] ;
+}
+
+// ******************************************************************************************************
+// BC7 (modo 6)
+// ------------------------------------------------------------------------------------------------------
+
+// pesos (sobre 64) del segundo extremo para cada índice de 4 bits
+constexpr int pesos_bc7[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// escribe o lee campos de bits en un bloque de 128 bits, empezando por el bit bajo del byte 0
+struct BitsBloque
+{
+   unsigned char * bytes ;
+   unsigned        pos = 0 ;
+
+   void escribir( const unsigned valor, const unsigned num_bits )
+   {  for( unsigned i = 0 ; i < num_bits ; i++, pos++ )
+         if ( (valor >> i) & 1 )
+            bytes[pos/8] |= (unsigned char)( 1 << (pos % 8) );
+   }
+   unsigned leer( const unsigned num_bits )
+   {  unsigned valor = 0 ;
+      for( unsigned i = 0 ; i < num_bits ; i++, pos++ )
+         valor |= unsigned( (bytes[pos/8] >> (pos % 8)) & 1 ) << i ;
+      return valor ;
+   }
+} ;
+// ------------------------------------------------------------------------------------------------------
+
+// extremo de BC7 en modo 6: 7 bits por componente y un bit 'p' compartido, el valor es (c7 << 1) | p
+struct ExtremoBC7
+{
+   unsigned c7[3] ;
+   unsigned p ;
+} ;
+
+// cuantiza un extremo probando los dos valores del bit compartido
+static ExtremoBC7 CuantizarExtremoBC7( const float ext[3] )
+{
+   ExtremoBC7 mejor {} ;
+   float      mejor_error = 1e30f ;
+   for( unsigned p = 0 ; p < 2 ; p++ )
+   {  ExtremoBC7 e { {0,0,0}, p } ;
+      float      error = 0.0f ;
+      for( unsigned k = 0 ; k < 3 ; k++ )
+      {  e.c7[k] = unsigned( std::min( 127.0f, std::max( 0.0f, std::round( (ext[k] - float( p ))/2.0f ))));
+         const float d = float( (e.c7[k] << 1) | p ) - ext[k] ;
+         error += d*d ;
+      }
+      if ( error < mejor_error )
+      {  mejor_error = error ;
+         mejor       = e ;
+      }
+   }
+   return mejor ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+static void PaletaBC7( const ExtremoBC7 & e0, const ExtremoBC7 & e1, int paleta[16][3] )
+{
+   for( unsigned j = 0 ; j < 16 ; j++ )
+      for( unsigned k = 0 ; k < 3 ; k++ )
+      {  const int v0 = int( (e0.c7[k] << 1) | e0.p ), v1 = int( (e1.c7[k] << 1) | e1.p );
+         paleta[j][k] = ( (64 - pesos_bc7[j])*v0 + pesos_bc7[j]*v1 + 32 ) >> 6 ;
+      }
+}
+// ------------------------------------------------------------------------------------------------------
+
+static unsigned CodificarBC7( const unsigned char texels[48], const float ext0[3], const float ext1[3],
+                              ExtremoBC7 & e0, ExtremoBC7 & e1, unsigned indices[16] )
+{
+   int paleta[16][3] ;
+   e0 = CuantizarExtremoBC7( ext0 );
+   e1 = CuantizarExtremoBC7( ext1 );
+   PaletaBC7( e0, e1, paleta );
+   return ElegirIndices( texels, paleta, 16, indices );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ComprimirBloqueBC7( const unsigned char texels[48], unsigned char bloque[16] )
+{
+   float      ext0[3], ext1[3] ;
+   ExtremoBC7 e0, e1 ;
+   unsigned   indices[16] ;
+
+   ExtremosEjePrincipal( texels, ext0, ext1 );
+   unsigned error = CodificarBC7( texels, ext0, ext1, e0, e1, indices );
+
+   float pesos[16] ;
+   for( unsigned j = 0 ; j < 16 ; j++ )
+      pesos[j] = pesos_bc7[j]/64.0f ;
+   for( unsigned it = 0 ; it < 2 && error > 0 ; it++ )
+   {
+      float      nue_ext0[3], nue_ext1[3] ;
+      ExtremoBC7 nue_e0, nue_e1 ;
+      unsigned   nue_indices[16] ;
+      if ( ! AjustarExtremos( texels, indices, pesos, nue_ext0, nue_ext1 ) )
+         break ;
+      const unsigned nue_error = CodificarBC7( texels, nue_ext0, nue_ext1, nue_e0, nue_e1, nue_indices );
+      if ( nue_error >= error )
+         break ;
+      error = nue_error ; e0 = nue_e0 ; e1 = nue_e1 ;
+      std::memcpy( indices, nue_indices, sizeof( indices ));
+   }
+
+   // el bit alto del índice del texel 0 no se guarda (debe ser 0): si no lo es, se intercambian los extremos
+   if ( indices[0] >= 8 )
+   {  std::swap( e0, e1 );
+      for( unsigned i = 0 ; i < 16 ; i++ )
+         indices[i] = 15 - indices[i] ;
+   }
+
+   // modo 6 (bit 6 a 1), extremos R0 R1 G0 G1 B0 B1 A0 A1, bits 'p', e índices
+   std::memset( bloque, 0, 16 );
+   BitsBloque bits { bloque } ;
+   bits.escribir( 1 << 6, 7 );
+   for( unsigned k = 0 ; k < 3 ; k++ )
+   {  bits.escribir( e0.c7[k], 7 );
+      bits.escribir( e1.c7[k], 7 );
+   }
+   bits.escribir( 127, 7 );
+   bits.escribir( 127, 7 );
+   bits.escribir( e0.p, 1 );
+   bits.escribir( e1.p, 1 );
+   bits.escribir( indices[0], 3 );
+   for( unsigned i = 1 ; i < 16 ; i++ )
+      bits.escribir( indices[i], 4 );
+   assert( bits.pos == 128 );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescomprimirBloqueBC7( const unsigned char bloque[16], unsigned char texels[48] )
+{
+   BitsBloque bits { const_cast<unsigned char *>( bloque ) } ;
+   if ( bits.leer( 7 ) != (1 << 6) )
+   {  std::memset( texels, 0, 48 );
+      return ;
+   }
+   ExtremoBC7 e0, e1 ;
+   for( unsigned k = 0 ; k < 3 ; k++ )
+   {  e0.c7[k] = bits.leer( 7 );
+      e1.c7[k] = bits.leer( 7 );
+   }
+   bits.leer( 14 );  // alfa
+   e0.p = bits.leer( 1 );
+   e1.p = bits.leer( 1 );
+
+   int paleta[16][3] ;
+   PaletaBC7( e0, e1, paleta );
+   for( unsigned i = 0 ; i < 16 ; i++ )
+   {  const unsigned ind = bits.leer( i == 0 ? 3 : 4 );
+      for( unsigned k = 0 ; k < 3 ; k++ )
+         texels[3*i+k] = (unsigned char) paleta[ind][k] ;
+   }
+}
+
+// ******************************************************************************************************
+// niveles y cadenas
+// ------------------------------------------------------------------------------------------------------
+
+NivelMipmap ComprimirNivel( const NivelMipmap & nivel, const FormatoTexels formato )
+{
+   assert( nivel.formato == FormatoTexels::rgb && formato != FormatoTexels::rgb );
+
+   NivelMipmap comp { .ancho = nivel.ancho, .alto = nivel.alto, .formato = formato, .texels = {} };
+   const std::size_t bytes_fila   = comp.bytesFila() ,
+                     bytes_bloque = formato == FormatoTexels::bc1 ? 8 : 16 ;
+   comp.texels.resize( comp.numFilas()*bytes_fila );
+
+   ReservaHebras::instancia()->paraCada( comp.numFilas(), [&]( unsigned fb )
+   {
+      unsigned char texels[48] ;
+      for( unsigned cb = 0 ; cb < (nivel.ancho+3)/4 ; cb++ )
+      {
+         // copiar el bloque, repitiendo la última fila o columna si no está completo
+         for( unsigned y = 0 ; y < 4 ; y++ )
+         for( unsigned x = 0 ; x < 4 ; x++ )
+         {  const unsigned fila = std::min( 4*fb + y, nivel.alto-1 ),
+                           col  = std::min( 4*cb + x, nivel.ancho-1 );
+            std::memcpy( texels + 3*(4*y+x), nivel.texels.data() + (std::size_t( fila )*nivel.ancho + col)*3, 3 );
+         }
+         unsigned char * bloque = comp.texels.data() + fb*bytes_fila + cb*bytes_bloque ;
+         if ( formato == FormatoTexels::bc1 )
+            ComprimirBloqueBC1( texels, bloque );
+         else
+            ComprimirBloqueBC7( texels, bloque );
+      }
+   });
+   return comp ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+CadenaMipmaps ComprimirCadena( const CadenaMipmaps & cadena, const FormatoTexels formato )
+{
+   ZONA_PERFIL_CPU( "ComprimirCadena" );
+   CadenaMipmaps comp ;
+   for( const NivelMipmap & nivel : cadena )
+      comp.push_back( ComprimirNivel( nivel, formato ));
+   return comp ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+NivelMipmap DescomprimirNivel( const NivelMipmap & comp )
+{
+   assert( comp.formato != FormatoTexels::rgb );
+
+   NivelMipmap       nivel { .ancho = comp.ancho, .alto = comp.alto, .formato = FormatoTexels::rgb, .texels = {} };
+   const std::size_t bytes_fila   = comp.bytesFila() ,
+                     bytes_bloque = comp.formato == FormatoTexels::bc1 ? 8 : 16 ;
+   nivel.texels.resize( std::size_t( nivel.ancho )*nivel.alto*3 );
+
+   unsigned char texels[48] ;
+   for( unsigned fb = 0 ; fb < comp.numFilas() ; fb++ )
+   for( unsigned cb = 0 ; cb < (comp.ancho+3)/4 ; cb++ )
+   {
+      const unsigned char * bloque = comp.texels.data() + fb*bytes_fila + cb*bytes_bloque ;
+      if ( comp.formato == FormatoTexels::bc1 )
+         DescomprimirBloqueBC1( bloque, texels );
+      else
+         DescomprimirBloqueBC7( bloque, texels );
+
+      for( unsigned y = 0 ; y < 4 && 4*fb+y < nivel.alto ; y++ )
+      for( unsigned x = 0 ; x < 4 && 4*cb+x < nivel.ancho ; x++ )
+         std::memcpy( nivel.texels.data() + (std::size_t( 4*fb+y )*nivel.ancho + 4*cb+x)*3, texels + 3*(4*y+x), 3 );
+   }
+   return nivel ;
+}
+
+// ******************************************************************************************************
+// medida de la calidad y la velocidad
+// ------------------------------------------------------------------------------------------------------
+
+// relación señal/ruido (en dB) entre dos niveles RGB del mismo tamaño
+static double PSNR( const NivelMipmap & a, const NivelMipmap & b )
+{
+   assert( a.texels.size() == b.texels.size() );
+   double suma = 0.0 ;
+   for( std::size_t i = 0 ; i < a.texels.size() ; i++ )
+   {  const double d = double( a.texels[i] ) - double( b.texels[i] );
+      suma += d*d ;
+   }
+   const double ecm = suma/double( a.texels.size() );
+   return ecm == 0.0 ? 99.0 : 10.0*std::log10( 255.0*255.0/ecm );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void BenchmarkCompresionBC()
+{
+   using namespace std ;
+   using namespace std::chrono ;
+   namespace fs = std::filesystem ;
+
+   const string carpeta = PathCarpetaMateriales() + "/imgs" ;
+   cout << endl << "Benchmark de compresión BC1/BC7 (imágenes de '" << carpeta << "', "
+        << ReservaHebras::instancia()->leerNumHebras()+1 << " hebras, velocidad en Mtexels/s, PSNR en dB):" << endl
+        << setw(32) << "imagen" << setw(12) << "tamaño"
+        << setw(10) << "BC1 vel." << setw(10) << "BC1 PSNR" << setw(10) << "BC7 vel." << setw(10) << "BC7 PSNR" << endl ;
+
+   std::error_code error ;
+   for( const fs::directory_entry & entrada : fs::directory_iterator( carpeta, error ) )
+   {
+      if ( entrada.path().extension() != ".jpg" )
+         continue ;
+      const string nombre = entrada.path().filename().string() ;
+      NivelMipmap  nivel ;
+      unsigned char * pixels = LeerArchivoJPEG( nombre.c_str(), nivel.ancho, nivel.alto );
+      nivel.texels.assign( pixels, pixels + std::size_t( nivel.ancho )*nivel.alto*3 );
+      delete [] pixels ;
+
+      cout << setw(32) << nombre << setw(12) << (to_string( nivel.ancho ) + "x" + to_string( nivel.alto )) << fixed << setprecision(2) ;
+      for( FormatoTexels formato : { FormatoTexels::bc1, FormatoTexels::bc7 } )
+      {
+         const auto        t0   = steady_clock::now();
+         const NivelMipmap comp = ComprimirNivel( nivel, formato );
+         const double      seg  = duration<double>( steady_clock::now() - t0 ).count() ;
+         cout << setw(10) << double( nivel.ancho )*nivel.alto/seg/1e6 << setw(10) << PSNR( nivel, DescomprimirNivel( comp ));
+      }
+      cout << endl ;
+   }
+   cout << defaultfloat << flush ;
+}
@@ -0,0 +1,77 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Compresión de texturas en bloques BC1 y BC7 (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de funciones para:
+// **
+// **  + comprimir y descomprimir un bloque de 4x4 texels RGB en BC1 o BC7
+// **  + comprimir una cadena de mipmaps completa (en varias hebras)
+// **  + medir la calidad y la velocidad de los compresores
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include "mipmaps.h"
+
+// --------------------------------------------------------------------------------------------
+/// @brief Comprime un bloque de 4x4 texels RGB (48 bytes, por filas) en BC1 (8 bytes): dos colores
+/// @brief de 16 bits en los extremos del eje principal de los colores del bloque, y un índice de 2 bits
+/// @brief por texel para elegir entre los dos extremos y dos colores intermedios
+///
+void ComprimirBloqueBC1( const unsigned char texels[48], unsigned char bloque[8] );
+
+/// @brief Descomprime un bloque BC1 en 4x4 texels RGB (48 bytes, por filas)
+///
+void DescomprimirBloqueBC1( const unsigned char bloque[8], unsigned char texels[48] );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Comprime un bloque de 4x4 texels RGB (48 bytes, por filas) en BC7 (16 bytes). Se usa solo el
+/// @brief modo 6 de BC7 (un único segmento de colores de 7 bits por componente más un bit compartido, y
+/// @brief un índice de 4 bits por texel), que es el de más calidad para texturas sin transparencias
+/// @brief con bloques de un solo segmento. La componente alfa vale 254 o 255 (no se usa).
+///
+void ComprimirBloqueBC7( const unsigned char texels[48], unsigned char bloque[16] );
+
+/// @brief Descomprime un bloque BC7 en modo 6 en 4x4 texels RGB (48 bytes, por filas), ignorando el alfa
+/// @brief (los bloques en otros modos, que no produce 'ComprimirBloqueBC7', se descomprimen en negro)
+///
+void DescomprimirBloqueBC7( const unsigned char bloque[16], unsigned char texels[48] );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Comprime un nivel RGB en el formato 'formato' (BC1 o BC7). Los bloques de los bordes que no
+/// @brief están completos se rellenan repitiendo la última fila o columna. Las filas de bloques se
+/// @brief reparten entre las hebras de la reserva de hebras.
+///
+NivelMipmap ComprimirNivel( const NivelMipmap & nivel, const FormatoTexels formato );
+
+/// @brief Comprime todos los niveles de una cadena RGB en el formato 'formato'
+///
+CadenaMipmaps ComprimirCadena( const CadenaMipmaps & cadena, const FormatoTexels formato );
+
+/// @brief Descomprime un nivel en BC1 o BC7 (devuelve un nivel RGB del mismo tamaño)
+///
+NivelMipmap DescomprimirNivel( const NivelMipmap & nivel );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Comprime y descomprime el nivel 0 de todas las imágenes JPEG de la carpeta de materiales,
+/// @brief en BC1 y BC7, e imprime la velocidad de compresión (millones de texels por segundo) y la
+/// @brief calidad (PSNR en dB respecto a la imagen original). No usa OpenGL.
+///
+void BenchmarkCompresionBC();
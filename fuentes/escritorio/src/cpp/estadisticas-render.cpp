@@ -0,0 +1,96 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Estadísticas de las órdenes enviadas a OpenGL en cada cuadro (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include "aplic-3d.h"
+#include "cauce-base.h"
+#include "vaos-vbos.h"
+#include "texturas.h"
+#include "grafo-escena.h"
+#include "estadisticas-render.h"
+
+// ******************************************************************************************************
+// EstadisticasRender
+// ------------------------------------------------------------------------------------------------------
+
+EstadisticasRender EstadisticasRender::leerYReiniciar()
+{
+   EstadisticasRender est ;
+
+   est.cauce    = CauceBase::contadores ;
+   est.vaos     = DescrVAO::contadores ;
+   est.texturas = Textura::contadores ;
+   est.nodos    = NodoGrafoEscena::contadores ;
+
+   CauceBase::contadores       = {} ;
+   DescrVAO::contadores        = {} ;
+   Textura::contadores         = {} ;
+   NodoGrafoEscena::contadores = {} ;
+
+   return est ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void EstadisticasRender::imprimir( std::ostream & os ) const 
+{
+   os << "   dibujos:   " << vaos.draws << " draws, " << vaos.triangulos << " triángulos, " << vaos.vertices << " vértices" << std::endl 
+      << "   cambios:   " << vaos.binds_vao << " VAOs, " << cauce.binds_programa << " programas, " << cauce.binds_textura << " texturas ("
+                          << texturas.activaciones << " activaciones)" << std::endl 
+      << "   uniforms:  " << cauce.uniforms << " envíos" << std::endl 
+      << "   pila MM:   " << cauce.push_mm << " push, " << cauce.pop_mm << " pop" << std::endl 
+      << "   nodos:     " << nodos.visitados << " visualizados, " << nodos.descartados << " descartados" << std::endl 
+      << "   enviados:  " << vaos.bytes_subidos + texturas.bytes_subidos << " bytes (buffers " << vaos.bytes_subidos 
+                          << ", texturas " << texturas.bytes_subidos << ")" << std::endl ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void EstadisticasRender::escribirJSON( std::ostream & os ) const 
+{
+   os << "{ \"draws\": "             << vaos.draws 
+      << ", \"triangulos\": "        << vaos.triangulos 
+      << ", \"vertices\": "          << vaos.vertices 
+      << ", \"binds_vao\": "         << vaos.binds_vao 
+      << ", \"binds_programa\": "    << cauce.binds_programa 
+      << ", \"binds_textura\": "     << cauce.binds_textura 
+      << ", \"uniforms\": "          << cauce.uniforms 
+      << ", \"push_mm\": "           << cauce.push_mm 
+      << ", \"pop_mm\": "            << cauce.pop_mm 
+      << ", \"nodos_visitados\": "   << nodos.visitados 
+      << ", \"nodos_descartados\": " << nodos.descartados 
+      << ", \"bytes_buffers\": "     << vaos.bytes_subidos 
+      << ", \"bytes_texturas\": "    << texturas.bytes_subidos << " }" ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void EstadisticasRender::escribirCabeceraCSV( std::ostream & os )
+{
+   os << "draws,triangulos,vertices,binds_vao,binds_programa,binds_textura,uniforms,push_mm,pop_mm,"
+      << "nodos_visitados,nodos_descartados,bytes_buffers,bytes_texturas" ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void EstadisticasRender::escribirCSV( std::ostream & os ) const 
+{
+   os << vaos.draws << "," << vaos.triangulos << "," << vaos.vertices << "," << vaos.binds_vao << "," 
+      << cauce.binds_programa << "," << cauce.binds_textura << "," << cauce.uniforms << "," 
+      << cauce.push_mm << "," << cauce.pop_mm << "," << nodos.visitados << "," << nodos.descartados << "," 
+      << vaos.bytes_subidos << "," << texturas.bytes_subidos ;
+}
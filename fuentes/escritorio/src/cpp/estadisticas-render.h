@@ -0,0 +1,98 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Estadísticas de las órdenes enviadas a OpenGL en cada cuadro (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de:
+// **
+// **  + ContadoresCauce, ContadoresVAO, ContadoresTextura y ContadoresNodos: contadores que
+// **    incrementan, respectivamente, 'CauceBase', 'DescrVAO', 'Textura' y 'NodoGrafoEscena'
+// **  + EstadisticasRender: valores de todos los contadores en un cuadro
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// --------------------------------------------------------------------------------------------
+// Contadores de cada clase (son atributos estáticos 'contadores' de la clase, y solo se
+// incrementan en la hebra principal, que es la que usa OpenGL)
+
+/// @brief Contadores de 'CauceBase' (y de sus clases derivadas)
+struct ContadoresCauce
+{
+   uint64_t binds_programa = 0 ,  ///< llamadas a 'glUseProgram'
+            binds_textura  = 0 ,  ///< texturas (o arreglos de texturas) ligadas a una unidad
+            uniforms       = 0 ,  ///< llamadas a 'glUniform*'
+            push_mm        = 0 ,  ///< llamadas a 'pushMM'
+            pop_mm         = 0 ;  ///< llamadas a 'popMM'
+} ;
+
+/// @brief Contadores de 'DescrVAO' (incluyen los dibujos del almacén de geometría)
+struct ContadoresVAO
+{
+   uint64_t draws         = 0 ,  ///< llamadas a 'glDraw*' o 'glMultiDraw*'
+            triangulos    = 0 ,  ///< triángulos (o parches triangulares) enviados, con todas las instancias
+            vertices      = 0 ,  ///< vértices (o índices) enviados, con todas las instancias
+            binds_vao     = 0 ,  ///< llamadas a 'glBindVertexArray' para dibujar
+            bytes_subidos = 0 ;  ///< bytes enviados a los buffers de vértices, índices, matrices o comandos
+} ;
+
+/// @brief Contadores de 'Textura'
+struct ContadoresTextura
+{
+   uint64_t activaciones  = 0 ,  ///< llamadas a 'Textura::activar'
+            bytes_subidos = 0 ;  ///< bytes de texels enviados a la GPU
+} ;
+
+/// @brief Contadores de 'NodoGrafoEscena'
+struct ContadoresNodos
+{
+   uint64_t visitados   = 0 ,  ///< nodos visualizados
+            descartados = 0 ;  ///< nodos que no se visualizan porque no son visibles (no se cuentan en 'visitados')
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Valores de los contadores de todas las clases durante un cuadro
+///
+struct EstadisticasRender
+{
+   ContadoresCauce   cauce ;
+   ContadoresVAO     vaos ;
+   ContadoresTextura texturas ;
+   ContadoresNodos   nodos ;
+
+   /// @brief Devuelve los valores actuales de los contadores de todas las clases y los pone a cero
+   /// @brief (se llama al final de cada cuadro)
+   static EstadisticasRender leerYReiniciar() ;
+
+   /// @brief Escribe un informe legible (varias líneas)
+   void imprimir( std::ostream & os ) const ;
+
+   /// @brief Escribe un objeto JSON con todos los contadores
+   void escribirJSON( std::ostream & os ) const ;
+
+   /// @brief Escribe (sin fin de línea) los nombres de las columnas de 'escribirCSV', separados por comas
+   static void escribirCabeceraCSV( std::ostream & os );
+
+   /// @brief Escribe (sin fin de línea) los valores de los contadores, separados por comas
+   void escribirCSV( std::ostream & os ) const ;
+} ;
@@ -131,6 +131,41 @@ int Framebuffer::leerAlto() const
 
 // ------------------------------------------------------------------------------
 
+bool Framebuffer::escribirPPM( const std::string & nombre_archivo )
+{
+   CError();
+   std::vector<unsigned char> pixels( std::size_t( ancho )*std::size_t( alto )*3 );
+
+   glBindFramebuffer( GL_FRAMEBUFFER, fboId );
+   glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+   glReadPixels( 0, 0, ancho, alto, GL_RGB, GL_UNSIGNED_BYTE, pixels.data() );
+   glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+   CError();
+
+   // en OpenGL la primera fila es la de abajo, en PPM la de arriba
+   std::ofstream arch( nombre_archivo, std::ios::binary );
+   if ( ! arch.is_open() )
+      return false ;
+   arch << "P6\n" << ancho << " " << alto << "\n255\n" ;
+   for( int y = alto-1 ; y >= 0 ; y-- )
+      arch.write( reinterpret_cast<const char *>( pixels.data() ) + std::size_t( y )*ancho*3, std::size_t( ancho )*3 );
+   return bool( arch );
+}
+// ------------------------------------------------------------------------------
+
+UsoMemoria Framebuffer::leerUsoMemoria() const 
+{
+   // color en formato GL_RGB (3 bytes por pixel), profundidad en GL_DEPTH_COMPONENT (se
+   // asume que el driver usa 24 bits, alineados a 4 bytes por pixel)
+   constexpr std::size_t bytes_color = 3, 
+                         bytes_prof  = 4 ;
+   UsoMemoria uso ;
+   if ( fboId != 0 )
+      uso.gpu_render = std::size_t( ancho )*std::size_t( alto )*( bytes_color + bytes_prof );
+   return uso ;
+}
+// ------------------------------------------------------------------------------
+
 Framebuffer::~Framebuffer()
 {
    destruir();
@@ -22,6 +22,7 @@
 #pragma once
 
 #include "utilidades.h"
+#include "uso-memoria.h"
 
 class DescrVAO ; // declaración adelantada para romper circularidad.
 
@@ -54,6 +55,12 @@ class Framebuffer
       ///
       void leerPixel( const int ix, const int iy, unsigned char * rgb );
 
+      /// @brief lee los pixels del framebuffer y los escribe en un archivo PPM binario (sin pérdidas)
+      /// @param nombre_archivo - nombre del archivo (con 'path')
+      /// @return 'true' si se ha podido escribir, 'false' si no
+      ///
+      bool escribirPPM( const std::string & nombre_archivo );
+
       // devuelve el identificador actual del fbo (!=0)
       GLuint leerIdent() const { return fboId ; }
 
@@ -63,6 +70,10 @@ class Framebuffer
 
       GLuint leerTextId() { return textId ; }
 
+      /// @brief devuelve la memoria que ocupan en la GPU la textura de color y el z-buffer
+      ///
+      UsoMemoria leerUsoMemoria() const ;
+
 
       /// @brief escribe cada pixel de este framebuffer como una suma ponderada de los pixels de otros dos framebuffers 
       /// @brief (los otros dos framebuffers deben tener el mismo tamaño, este se redimensiona a ese tamaño si es necesario)
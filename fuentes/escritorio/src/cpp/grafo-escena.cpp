@@ -29,6 +29,8 @@
 #include "grafo-escena.h"
 #include "aplic-3d.h"    
 #include "seleccion.h"   // para 'ColorDesdeIdent' 
+#include "perfilador.h"
+#include "rasterizador-cpu.h"
 
 
 
@@ -57,11 +59,12 @@ EntradaNGE::EntradaNGE( const glm::mat4 & pMatriz )
 // ---------------------------------------------------------------------
 // Constructor para entrada de tipo "matriz de transformación"
 
-EntradaNGE::EntradaNGE( Material * pMaterial )
+EntradaNGE::EntradaNGE( Material * pMaterial, const bool pPropio )
 {
    assert( pMaterial != nullptr );
    tipo     = TipoEntNGE::material ;
    material = pMaterial ;
+   propio   = pPropio ;
 }
 
 // -----------------------------------------------------------------------------
@@ -95,9 +98,15 @@ NodoGrafoEscena::~NodoGrafoEscena()
 {
    using namespace std ;
    //cout << "Invocado destructor de nodo del grafo de escena (destr. matrices)'" << leerNombre() << "'" << endl ; 
+   // los materiales propios se destruyen con el nodo (y con ellos sus texturas, que así 
+   // sueltan sus imágenes de la caché de recursos)
    for( auto & ent : entradas )
       if ( ent.tipo == TipoEntNGE::transformacion )
          delete ent.matriz ;
+      else if ( ent.tipo == TipoEntNGE::material && ent.propio )
+         delete ent.material ;
+   for( auto & lote : lotes )
+      delete lote.malla ;
 }  
 
 // -----------------------------------------------------------------------------
@@ -119,13 +128,28 @@ void NodoGrafoEscena::pendienteDestruccion()
 
 void NodoGrafoEscena::visualizarGL(  )
 {
+   ZONA_PERFIL_CPU( "NodoGrafoEscena::visualizarGL" );
    using namespace std ;
+   contadores.visitados++ ;
    Aplicacion3D * apl = Aplicacion3D::instancia() ;
   
     // comprobar que hay un cauce y una pila de materiales y recuperarlos.
    Cauce3D *        cauce           = apl->cauce3D() ;            
    PilaMateriales * pila_materiales = apl->pilaMateriales(); 
 
+   // si el nodo usa agrupado estático, se visualizan los lotes en lugar de las entradas
+   if ( agrupado_estatico )
+   {
+      visualizarLotesGL( 0 );
+      return ;
+   }
+   // (con el rasterizador por software no hay almacén de geometría: se dibuja entrada a entrada)
+   if ( dibujo_indirecto && ! RasterizadorCPU::activo() )
+   {
+      visualizarIndirectoGL( 0 );
+      return ;
+   }
+
    // Visualización del nodo:
    //
    // Se deben de recorrer las entradas y llamar recursivamente de visualizarGL, pero 
@@ -211,6 +235,17 @@ void NodoGrafoEscena::visualizarGeomGL(  )
    // comprobar que hay un cauce 
    Aplicacion3D * apl   = Aplicacion3D::instancia() ;
    Cauce3D *      cauce = apl->cauce3D() ;; assert( cauce != nullptr );
+
+   if ( agrupado_estatico )
+   {
+      visualizarLotesGL( 1 );
+      return ;
+   }
+   if ( dibujo_indirecto && ! RasterizadorCPU::activo() )
+   {
+      visualizarIndirectoGL( 1 );
+      return ;
+   }
   
    // Visualización del nodo (ignorando colores)
    //
@@ -323,6 +358,12 @@ void NodoGrafoEscena::visualizarModoSeleccionGL()
    //      + Para las entradas transformación, componer la matriz (con 'compMM')
    // 5. Restaurar la matriz de modelado original (con 'popMM')   
    // 6. Si el identificador no es -1, restaurar el color previo del cauce (con 'popColor')
+
+   if ( agrupado_estatico )
+   {
+      visualizarLotesGL( 3 );
+      return ;
+   }
    
    const int ident_nodo = leerIdentificador();
    if ( ident_nodo != -1 )
@@ -405,6 +446,335 @@ glm::mat4 * NodoGrafoEscena::leerPtrMatriz( unsigned indice )
 
    return entradas[indice].matriz ;
 }
+// -----------------------------------------------------------------------------
+// recorrer el grafo acumulando las matrices, colores y materiales hasta cada objeto hoja
+
+void NodoGrafoEscena::recopilarHojas( const glm::mat4 & mmodelado, const glm::vec3 & color, 
+                                      Material * material, std::vector<HojaNGE> & hojas,
+                                      std::vector<const glm::mat4 *> * camino, 
+                                      const int ident )
+{
+   using namespace std ;
+   using namespace glm ;
+
+   // estado actual en el recorrido: empieza con el del padre, y el color e identificador del nodo si tiene
+   mat4       matriz     = mmodelado ;
+   const vec3 color_nodo = tieneColor() ? leerColor() : color ;
+   const int  ident_nodo = leerIdentificador() != -1 ? leerIdentificador() : ident ;
+   Material * mat_actual = material ;
+   const unsigned long tam_camino = camino != nullptr ? camino->size() : 0 ;
+
+   for( unsigned i = 0 ; i < entradas.size() ; i++ )
+      switch( entradas[i].tipo )
+      {
+         case TipoEntNGE::objeto :
+         {
+            assert( entradas[i].objeto != nullptr );
+            NodoGrafoEscena * nodo = dynamic_cast<NodoGrafoEscena *>( entradas[i].objeto );
+            if ( nodo != nullptr )
+               nodo->recopilarHojas( matriz, color_nodo, mat_actual, hojas, camino, ident_nodo );
+            else 
+            {  
+               ObjetoVisu3D * obj = entradas[i].objeto ;
+               hojas.push_back( { .objeto   = obj, 
+                                  .matriz   = matriz, 
+                                  .color    = obj->tieneColor() ? obj->leerColor() : color_nodo,
+                                  .material = mat_actual,
+                                  .ident    = obj->leerIdentificador() != -1 ? obj->leerIdentificador() : ident_nodo } );
+               if ( camino != nullptr )
+                  hojas.back().camino = *camino ;
+            }
+            break ;
+         }
+         case TipoEntNGE::transformacion :
+            assert( entradas[i].matriz != nullptr );
+            matriz = matriz * (*entradas[i].matriz) ;
+            if ( camino != nullptr )
+               camino->push_back( entradas[i].matriz );
+            break ;
+         case TipoEntNGE::material :
+            mat_actual = entradas[i].material ;
+            break ;
+         default:
+            cout << "error: tipo de entrada incorrecto en 'NodoGrafoEscena::recopilarHojas'" << endl ;
+            exit(1);
+            break ;
+      }
+
+   // dejar el camino como estaba al entrar (quitar las matrices de este nodo)
+   if ( camino != nullptr )
+      camino->resize( tam_camino );
+}
+// -----------------------------------------------------------------------------
+// agrupado estático: se crea un lote con una malla agrupada por cada material distinto 
+// en las hojas, y un lote por cada hoja que no se puede agrupar
+
+void NodoGrafoEscena::crearLotesEstaticos()
+{
+   using namespace std ;
+   using namespace glm ;
+   assert( lotes.size() == 0 );
+
+   // recopilar las hojas, el color heredado es el actual del cauce (igual que en 'visualizarGL')
+   Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+   vector<HojaNGE> hojas ;
+   recopilarHojas( mat4( 1.0f ), vec3( cauce->leerColorActual() ), nullptr, hojas );
+
+   unsigned num_agrupadas = 0 ;
+   for( const HojaNGE & hoja : hojas )
+   {
+      // no se agrupan los objetos que no son mallas indexadas, ni los que usan una textura con 
+      // coordenadas generadas a partir de las coordenadas de objeto (cambian al transformar los vértices)
+      MallaInd *      malla   = dynamic_cast<MallaInd *>( hoja.objeto );
+      const Textura * textura = hoja.material != nullptr ? hoja.material->leerTextura() : nullptr ;
+
+      if ( malla == nullptr || ( textura != nullptr && textura->leerModoGenCT() == mgct_coords_objeto ) )
+      {
+         lotes.push_back( { .material = hoja.material, .malla = nullptr, .hoja = hoja } );
+         continue ;
+      }
+
+      // buscar el lote agrupado con el material de la hoja, o crearlo si no hay ninguno
+      unsigned il = 0 ;
+      while( il < lotes.size() && ( lotes[il].malla == nullptr || lotes[il].material != hoja.material ))
+         il++ ;
+      if ( il == lotes.size() )
+         lotes.push_back( { .material = hoja.material, 
+                            .malla    = new MallaAgrupada( "malla agrupada (" + leerNombre() + ")" ) } );
+
+      lotes[il].malla->agregar( *malla, hoja.matriz, hoja.color, hoja.ident );
+      num_agrupadas++ ;
+   }
+
+   cout << "Agrupado estático de '" << leerNombre() << "': " << hojas.size() << " objetos en " 
+        << lotes.size() << " lotes (" << num_agrupadas << " mallas agrupadas)." << endl ;
+}
+
+// -----------------------------------------------------------------------------
+// visualiza los lotes del agrupado estático (se crean la primera vez)
+
+void NodoGrafoEscena::visualizarLotesGL( const unsigned modo )
+{
+   using namespace std ;
+   assert( modo == 0 || modo == 1 || modo == 3 );
+
+   Aplicacion3D *   apl             = Aplicacion3D::instancia() ;
+   Cauce3D *        cauce           = apl->cauce3D() ;            
+   PilaMateriales * pila_materiales = apl->pilaMateriales(); 
+   const bool       usar_materiales = modo == 0 && apl->iluminacionActiva() ;
+
+   if ( lotes.size() == 0 )
+      crearLotesEstaticos();
+
+   for( LoteEstaticoNGE & lote : lotes )
+   {
+      // cada lote se visualiza con su material, o con el activo al empezar si no tiene
+      if ( usar_materiales )
+      {  pila_materiales->push();
+         if ( lote.material != nullptr )
+            pila_materiales->activar( lote.material );
+      }
+
+      if ( lote.malla != nullptr ) // malla agrupada: ya tiene los colores, las matrices y los identificadores
+      {
+         switch( modo )
+         {  case 0 : lote.malla->visualizarGL() ; break ;
+            case 1 : lote.malla->visualizarGeomGL() ; break ;
+            case 3 : lote.malla->visualizarModoSeleccionGL() ; break ;
+         }
+      }
+      else // objeto no agrupado: se visualiza con su estado (color o identificador y matriz)
+      {
+         const HojaNGE & hoja = lote.hoja ;
+         const bool cambia_color = modo == 0 || ( modo == 3 && hoja.ident != -1 );
+         if ( cambia_color )
+         {  cauce->pushColor();
+            cauce->fijarColor( modo == 0 ? glm::vec4( hoja.color, 1.0f ) : ColorDesdeIdent( hoja.ident ) );
+         }
+         cauce->pushMM();
+         cauce->compMM( hoja.matriz );
+         switch( modo )
+         {  case 0 : hoja.objeto->visualizarGL() ; break ;
+            case 1 : hoja.objeto->visualizarGeomGL() ; break ;
+            case 3 : hoja.objeto->visualizarModoSeleccionGL() ; break ;
+         }
+         cauce->popMM();
+         if ( cambia_color )
+            cauce->popColor();
+      }
+
+      if ( usar_materiales )
+         pila_materiales->pop();
+   }
+}
+
+// -----------------------------------------------------------------------------
+// dibujo indirecto: se agrupan las hojas que son mallas en el almacén de geometría según su 
+// material y color, el resto se visualizan una a una
+
+void NodoGrafoEscena::crearGruposIndirecto()
+{
+   using namespace std ;
+   using namespace glm ;
+   assert( hojas_indirecto.size() == 0 );
+
+   // recopilar las hojas con su camino, el color heredado es el actual del cauce (igual que en 'visualizarGL')
+   Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+   vector<const mat4 *> camino ;
+   recopilarHojas( mat4( 1.0f ), vec3( cauce->leerColorActual() ), nullptr, hojas_indirecto, &camino );
+
+   // los VAOs de las mallas que no se han visualizado todavía se crean en el almacén
+   const bool usar_almacen_prev = DescrVAO::leerUsarAlmacenDefecto() ;
+   DescrVAO::fijarUsarAlmacenDefecto( true );
+
+   for( unsigned ih = 0 ; ih < hojas_indirecto.size() ; ih++ )
+   {
+      const HojaNGE & hoja  = hojas_indirecto[ih] ;
+      MallaInd *      malla = dynamic_cast<MallaInd *>( hoja.objeto );
+      DescrVAO *      dvao  = malla != nullptr ? malla->leerDescrVAO() : nullptr ;
+
+      if ( dvao == nullptr || ! dvao->enAlmacen() )
+      {
+         hojas_no_indirecto.push_back( ih );
+         continue ;
+      }
+
+      // buscar el grupo con el material y el color de la hoja, o crearlo si no hay ninguno
+      unsigned ig = 0 ;
+      while( ig < grupos_indirecto.size() && 
+             ( grupos_indirecto[ig].material != hoja.material || grupos_indirecto[ig].color != hoja.color ))
+         ig++ ;
+      if ( ig == grupos_indirecto.size() )
+         grupos_indirecto.push_back( { .material = hoja.material, .color = hoja.color } );
+
+      grupos_indirecto[ig].hojas.push_back( ih );
+      grupos_indirecto[ig].vaos.push_back( dvao );
+   }
+   DescrVAO::fijarUsarAlmacenDefecto( usar_almacen_prev );
+
+   cout << "Dibujo indirecto de '" << leerNombre() << "': " << hojas_indirecto.size() << " objetos, " 
+        << grupos_indirecto.size() << " grupos en el almacén de geometría (" 
+        << hojas_no_indirecto.size() << " objetos fuera del almacén)." << endl ;
+   AlmacenGeometria::instancia()->imprimirOcupacion();
+}
+
+// -----------------------------------------------------------------------------
+// visualiza con dibujo indirecto (los grupos se crean la primera vez)
+
+void NodoGrafoEscena::visualizarIndirectoGL( const unsigned modo )
+{
+   using namespace glm ;
+   assert( modo == 0 || modo == 1 );
+
+   Aplicacion3D *     apl             = Aplicacion3D::instancia() ;
+   Cauce3D *          cauce           = apl->cauce3D() ;            
+   PilaMateriales *   pila_materiales = apl->pilaMateriales(); 
+   AlmacenGeometria * almacen         = AlmacenGeometria::instancia();
+   const bool         usar_materiales = modo == 0 && apl->iluminacionActiva() ;
+
+   if ( hojas_indirecto.size() == 0 )
+      crearGruposIndirecto();
+
+   // matriz de modelado actual de una hoja, producto de las matrices de su camino
+   auto matriz_hoja = []( const HojaNGE & hoja ) -> mat4 
+   {
+      mat4 m( 1.0f );
+      for( const mat4 * pm : hoja.camino )
+         m = m * (*pm) ;
+      return m ;
+   };
+
+   // mallas del almacén: un lote por grupo (solo con las posiciones, un único lote con todas)
+   for( const GrupoIndirectoNGE & grupo : grupos_indirecto )
+   {
+      for( unsigned i = 0 ; i < grupo.hojas.size() ; i++ )
+         grupo.vaos[i]->agregarAlLoteAlmacen( matriz_hoja( hojas_indirecto[grupo.hojas[i]] ), modo == 1 );
+      if ( modo == 1 )
+         continue ;
+
+      if ( usar_materiales )
+      {  pila_materiales->push();
+         if ( grupo.material != nullptr )
+            pila_materiales->activar( grupo.material );
+      }
+      cauce->pushColor();
+      cauce->fijarColor( grupo.color );
+
+      almacen->dibujarLote( GL_TRIANGLES );
+
+      cauce->popColor();
+      if ( usar_materiales )
+         pila_materiales->pop();
+   }
+   if ( modo == 1 )
+      almacen->dibujarLote( GL_TRIANGLES );
+
+   // objetos fuera del almacén: se visualizan con su estado (color y matriz)
+   for( const unsigned ih : hojas_no_indirecto )
+   {
+      const HojaNGE & hoja = hojas_indirecto[ih] ;
+      if ( usar_materiales )
+      {  pila_materiales->push();
+         if ( hoja.material != nullptr )
+            pila_materiales->activar( hoja.material );
+      }
+      if ( modo == 0 )
+      {  cauce->pushColor();
+         cauce->fijarColor( hoja.color );
+      }
+      cauce->pushMM();
+      cauce->compMM( matriz_hoja( hoja ) );
+      if ( modo == 0 )
+         hoja.objeto->visualizarGL();
+      else 
+         hoja.objeto->visualizarGeomGL();
+      cauce->popMM();
+      if ( modo == 0 )
+         cauce->popColor();
+      if ( usar_materiales )
+         pila_materiales->pop();
+   }
+}
+
+// -----------------------------------------------------------------------------
+
+void NodoGrafoEscena::acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const 
+{
+   if ( ! contados.insert( this ).second ) // ya contado (el nodo aparece varias veces en el grafo)
+      return ;
+
+   // entradas: sub-objetos (recursivamente), matrices y texturas de los materiales
+   uso.cpu_tablas += entradas.capacity()*sizeof( EntradaNGE ) ;
+   for( const EntradaNGE & ent : entradas )
+      switch( ent.tipo )
+      {
+         case TipoEntNGE::objeto :
+            ent.objeto->acumularUsoMemoria( uso, contados );
+            break ;
+         case TipoEntNGE::transformacion :
+            uso.cpu_tablas += sizeof( glm::mat4 );
+            break ;
+         case TipoEntNGE::material :
+            {  // la imagen se comparte entre todas las texturas leídas del mismo archivo
+               const Textura * textura = ent.material->leerTextura() ;
+               if ( textura != nullptr && contados.insert( textura->leerImagen() ).second )
+                  uso += textura->leerUsoMemoria();
+            }
+            break ;
+         default :
+            break ;
+      }
+
+   // mallas agrupadas del agrupado estático (propiedad del nodo)
+   for( const LoteEstaticoNGE & lote : lotes )
+      if ( lote.malla != nullptr )
+         lote.malla->acumularUsoMemoria( uso, contados );
+
+   // hojas del dibujo indirecto (los VAOs son de las mallas, ya contadas)
+   for( const HojaNGE & hoja : hojas_indirecto )
+      uso.cpu_tablas += sizeof( HojaNGE ) + hoja.camino.size()*sizeof( const glm::mat4 * );
+}
+
 // -----------------------------------------------------------------------------
 // si 'centro_calculado' es 'false', recalcula el centro usando los centros
 // de los hijos (el punto medio de la caja englobante de los centros de hijos)
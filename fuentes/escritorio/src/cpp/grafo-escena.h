@@ -33,6 +33,7 @@
 #include "objeto-visu.h"
 #include "malla-ind.h" // para poder usar clase MallaInd
 #include "materiales-luces.h"
+#include "estadisticas-render.h"
 
 //using namespace tup_mat ;
 
@@ -55,17 +56,59 @@ struct EntradaNGE
    union
    {  ObjetoVisu3D * objeto = nullptr ;  // ptr. a un objeto (no propietario)
       glm::mat4    * matriz   ;  // ptr. a matriz 4x4 transf. (propietario)
-      Material     * material ; // ptr. a material (no propietario)
+      Material     * material ; // ptr. a material (propietario si 'propio')
    } ;
+   bool propio = false ;  // (material) true si el nodo destruye el material al destruirse
    // constructores (uno por tipo)
    EntradaNGE() = delete ; // prohibe constructor sin parámetros
 
    EntradaNGE( ObjetoVisu3D    * pObjeto   );  // (copia solo puntero)
    EntradaNGE( const glm::mat4 & pMatriz   );  // (crea copia en el heap)
-   EntradaNGE( Material        * pMaterial );  // (copia solo puntero)
+   EntradaNGE( Material        * pMaterial, const bool pPropio = true );  // (copia solo puntero)
    ~EntradaNGE() ;
 } ;
 
+// *********************************************************************
+// Objeto hoja de un grafo de escena (un objeto que no es un nodo), junto con 
+// el estado con el que se visualiza (se obtienen con 'recopilarHojas')
+
+struct HojaNGE
+{
+   ObjetoVisu3D * objeto   = nullptr ;         // objeto hoja (no propietario)
+   glm::mat4      matriz   = glm::mat4(1.0f) ; // matriz de modelado acumulada desde la raíz
+   glm::vec3      color    = { 1.0, 1.0, 1.0 }; // color heredado de los nodos ancestros (o el del objeto)
+   Material *     material = nullptr ;         // material activo en el objeto (nullptr si no hay ninguno)
+   int            ident    = -1 ;              // identificador con el que se dibuja en modo selección (-1 si ninguno)
+
+   // punteros a las matrices de las entradas de transformación desde la raíz hasta el objeto, 
+   // en orden (solo se rellena si se pide al recopilar las hojas)
+   std::vector<const glm::mat4 *> camino ;
+} ;
+
+// *********************************************************************
+// Lote del agrupado estático de un nodo: o bien una malla agrupada con todos los objetos 
+// del subgrafo que comparten material, o bien un objeto que no se puede agrupar (y que
+// se visualiza con su estado, que está en 'hoja')
+
+struct LoteEstaticoNGE
+{
+   Material *      material = nullptr ; // material del lote (nullptr: el activo al visualizar el nodo)
+   MallaAgrupada * malla    = nullptr ; // malla agrupada (propietario), nullptr si no es agrupable
+   HojaNGE         hoja     ;           // (solo si 'malla' es nulo) objeto no agrupable
+} ;
+
+// *********************************************************************
+// Grupo del dibujo indirecto de un nodo: mallas del subgrafo guardadas en el almacén de 
+// geometría que comparten material y color (se dibujan con un único lote del almacén)
+
+struct GrupoIndirectoNGE
+{
+   Material *              material = nullptr ;            // material del grupo (nullptr: el activo al visualizar el nodo)
+   glm::vec3               color    = { 1.0, 1.0, 1.0 } ;  // color de las mallas sin colores de vértices
+   std::vector<unsigned>   hojas    ;                      // índices de las hojas del grupo (en 'hojas_indirecto')
+   std::vector<DescrVAO *> vaos     ;                      // VAO de la malla de cada hoja (no propietario)
+} ;
+
 // *********************************************************************
 // Nodo del grafo de escena: es un objeto 3D parametrizado, que contiene una lista de entradas
 
@@ -81,6 +124,31 @@ class NodoGrafoEscena : public ObjetoVisu3D
    // (se calcula bajo demanda la primera vez en "buscar")
    bool centro_calculado = false ;
 
+   // agrupado estático: si está activado, se visualizan los lotes en lugar de recorrer 
+   // las entradas (los lotes se crean la primera vez que se visualiza el nodo)
+   bool agrupado_estatico = false ;
+   std::vector<LoteEstaticoNGE> lotes ;
+
+   // crea los lotes del agrupado estático, a partir de las hojas del subgrafo
+   void crearLotesEstaticos() ;
+
+   // visualiza los lotes: modo 0 ('visualizarGL'), 1 ('visualizarGeomGL') o 3 ('visualizarModoSeleccionGL')
+   void visualizarLotesGL( const unsigned modo ) ;
+
+   // dibujo indirecto: si está activado, las mallas del subgrafo se guardan en el almacén de geometría
+   // y se dibujan con un lote por cada material y color (las matrices de las hojas se calculan en cada 
+   // cuadro a partir de su camino, así que pueden cambiar), el resto de objetos se visualizan uno a uno
+   bool                           dibujo_indirecto = false ;
+   std::vector<HojaNGE>           hojas_indirecto ;    // hojas del subgrafo, con su camino de matrices
+   std::vector<GrupoIndirectoNGE> grupos_indirecto ;
+   std::vector<unsigned>          hojas_no_indirecto ; // índices de las hojas que no están en el almacén
+
+   // crea los grupos del dibujo indirecto, a partir de las hojas del subgrafo
+   void crearGruposIndirecto() ;
+
+   // visualiza con dibujo indirecto: modo 0 ('visualizarGL') o 1 ('visualizarGeomGL')
+   void visualizarIndirectoGL( const unsigned modo ) ;
+
    public:
 
    NodoGrafoEscena() ;
@@ -90,6 +158,10 @@ class NodoGrafoEscena : public ObjetoVisu3D
    // visualiza usando OpenGL
    virtual void visualizarGL(  ) ;
 
+   // contadores de nodos visualizados y descartados (de todos los nodos, ver 'EstadisticasRender'),
+   // los nodos no se descartan todavía (no hay recorte por visibilidad), así que 'descartados' es 0
+   static inline ContadoresNodos contadores ;
+
    // visualizar pura y simplemente la geometría, sin colores, normales, coord. text. etc...
    // (se supone que el estado de OpenGL está fijado antes de esta llamada de alguna forma adecuada)
    virtual void visualizarGeomGL(  ) ;
@@ -108,11 +180,33 @@ class NodoGrafoEscena : public ObjetoVisu3D
    // construir una entrada y añadirla (al final)
    unsigned agregar( ObjetoVisu3D *    pObjeto );   // objeto (copia solo puntero)
    unsigned agregar( const glm::mat4 & pMatriz );   // matriz (copia objeto)
-   unsigned agregar( Material *        pMaterial ); // material (copia solo puntero)
+   unsigned agregar( Material *        pMaterial ); // material (copia puntero, el nodo pasa a ser propietario)
 
    // devuelve el puntero a la matriz en la i-ésima entrada
    glm::mat4 * leerPtrMatriz( unsigned iEnt );
 
+   // activa el agrupado estático del nodo: se juntan en una sola malla (ya transformada) 
+   // todas las mallas del subgrafo que comparten material, y se dibuja una malla por 
+   // material (solo se debe usar si el subgrafo no cambia después de visualizarlo)
+   void activarAgrupadoEstatico() { agrupado_estatico = true ; }
+
+   // activa el dibujo indirecto del nodo: las mallas del subgrafo que compartan material y color
+   // se dibujan con una sola llamada (con 'glMultiDrawElementsIndirect', si está disponible), 
+   // las transformaciones pueden cambiar, pero no la estructura del subgrafo, después de visualizarlo
+   // (en modo selección se recorre el grafo como siempre)
+   void activarDibujoIndirecto() { dibujo_indirecto = true ; }
+
+   // recorre el grafo sin visualizar nada y añade al final de 'hojas' un registro por cada 
+   // objeto que no es un nodo, con su matriz de modelado, color y material (calculados igual 
+   // que en 'visualizarGL', a partir de los valores que se dan para este nodo)
+   // (si 'camino' no es nulo, contiene las matrices de los ancestros y se copia, junto 
+   // con las de este nodo, en el campo 'camino' de cada hoja; 'ident' es el identificador 
+   // heredado de los ancestros)
+   void recopilarHojas( const glm::mat4 & mmodelado, const glm::vec3 & color, 
+                        Material * material, std::vector<HojaNGE> & hojas,
+                        std::vector<const glm::mat4 *> * camino = nullptr, 
+                        const int ident = -1 );
+
    // método para buscar un objeto con un identificador
    virtual bool buscarObjeto( const int ident_busc, const glm::mat4 & mmodelado,
                     ObjetoVisu ** objeto, glm::vec3 & centro_wc )  ;
@@ -121,6 +215,9 @@ class NodoGrafoEscena : public ObjetoVisu3D
    // de los hijos (el punto medio de la caja englobante de los centros de hijos)
    virtual void calcularCentroOC() ;
 
+   // suma la memoria de los objetos del subgrafo, de las texturas de sus materiales, de las 
+   // matrices y de las mallas del agrupado estático (cada objeto o textura se cuenta una vez)
+   virtual void acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const override ;
    
 } ;
 
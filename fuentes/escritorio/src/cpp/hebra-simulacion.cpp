@@ -0,0 +1,151 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Simulación de las animaciones en una hebra propia (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cassert>
+#include <chrono>
+#include "hebra-simulacion.h"
+#include "objeto-visu.h"
+#include "ritmo-cuadros.h"
+#include "perfilador.h"
+
+// ******************************************************************************************************
+// HebraSimulacion
+// ------------------------------------------------------------------------------------------------------
+
+HebraSimulacion::~HebraSimulacion()
+{
+   detener();
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      salir = true ;
+   }
+   cambio.notify_all();
+   if ( hebra.joinable() )
+      hebra.join();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HebraSimulacion::iniciar( ObjetoVisu * p_objeto )
+{
+   assert( objeto == nullptr );
+   assert( p_objeto != nullptr );
+   assert( p_objeto->leerNumParametros() > 0 );
+
+   // (la hebra no está simulando, así que se pueden cambiar 'objeto' y 'tiempos' sin el cerrojo)
+   p_objeto->prepararInstantaneas();
+   tiempos = p_objeto->leerTiemposParametros();
+   objeto  = p_objeto ;
+
+   if ( ! hebra.joinable() )
+      hebra = std::thread( &HebraSimulacion::simular, this );
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      activa = true ;
+   }
+   cambio.notify_all();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HebraSimulacion::detener()
+{
+   if ( objeto == nullptr )
+      return ;
+
+   // pedir que deje de simular, y esperar a que lo haga (si no había empezado, ya no empieza)
+   {
+      std::unique_lock<std::mutex> bloqueo( mutex );
+      activa = false ;
+      cambio.notify_all();
+      cambio.wait( bloqueo, [this]() { return ! simulando ; } );
+   }
+
+   // seguir desde los tiempos simulados, y descartar la instantánea no leída (si la hay)
+   objeto->fijarTiemposParametros( tiempos );
+   instantaneas.actualizarLectura();
+   objeto = nullptr ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool HebraSimulacion::aplicarUltima()
+{
+   assert( objeto != nullptr );
+   if ( ! instantaneas.actualizarLectura() )
+      return false ;
+   objeto->aplicarInstantanea( instantaneas.lectura() );
+   return true ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HebraSimulacion::simular()
+{
+   using Segundos = std::chrono::duration<double> ;
+   Perfilador::instancia()->nombrarHebra( "simulación" );
+
+   std::unique_lock<std::mutex> bloqueo( mutex );
+   while( true )
+   {
+      cambio.wait( bloqueo, [this]() { return salir || activa ; } );
+      if ( salir )
+         return ;
+
+      // el tiempo simulado empieza a contar al iniciar (como al activar las animaciones)
+      simulando = true ;
+      RitmoCuadros reloj ;
+      reloj.iniciarSimulacion();
+
+      while( activa )
+      {
+         bloqueo.unlock();
+         double         alfa  = 0.0 ;
+         const unsigned pasos = reloj.avanzarSimulacion( alfa );
+         if ( pasos > 0 )
+            publicar( pasos );
+         bloqueo.lock();
+
+         // dormir hasta el siguiente paso (o hasta que se pida detener la simulación)
+         cambio.wait_for( bloqueo, Segundos( (1.0-alfa)*RitmoCuadros::paso_simulacion ), 
+                          [this]() { return ! activa ; } );
+      }
+      simulando = false ;
+      cambio.notify_all();
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HebraSimulacion::publicar( const unsigned pasos )
+{
+   ZONA_PERFIL_CPU( "simulación" );
+
+   // (como 'ObjetoVisu::avanzarTiempoParametros', un paso cada vez)
+   for( unsigned i = 0 ; i < pasos ; i++ )
+      for( float & t : tiempos )
+         t += float( RitmoCuadros::paso_simulacion );
+   num_paso += pasos ;
+
+   // la instantánea que se reutiliza es una antigua: se sustituye todo su contenido
+   InstantaneaSimulacion & inst = instantaneas.escritura();
+   inst.num_paso = num_paso ;
+   inst.tiempos  = tiempos ;
+   inst.matrices.clear();
+   objeto->calcularInstantanea( inst );
+   instantaneas.publicar();
+}
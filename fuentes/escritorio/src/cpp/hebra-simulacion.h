@@ -0,0 +1,106 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Simulación de las animaciones en una hebra propia (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de
+// **
+// **  + InstantaneaSimulacion: estado de un objeto animado en un instante de la simulación
+// **                           (tiempos de los parámetros y datos precalculados por el objeto)
+// **  + HebraSimulacion:       hebra que avanza la simulación de un objeto con pasos fijos y
+// **                           publica instantáneas en un buffer triple, la hebra principal
+// **                           visualiza la más reciente
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "buffer-triple.h"
+
+class ObjetoVisu ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Estado de un objeto en un instante de la simulación. No se modifica una vez publicada
+/// @brief (la hebra principal solo la lee), y no tiene punteros a datos que cambie la simulación.
+///
+struct InstantaneaSimulacion
+{
+   uint64_t               num_paso = 0 ;  // pasos de simulación dados hasta esta instantánea
+   std::vector<float>     tiempos ;       // tiempo (en segundos) de cada parámetro del objeto
+   std::vector<glm::mat4> matrices ;      // matrices calculadas por el objeto (ver 'ObjetoVisu::calcularInstantanea')
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Hebra de simulación de las animaciones de un objeto. Mientras está en marcha, la hebra es la
+/// @brief dueña de los tiempos de los parámetros: los avanza con pasos de 'RitmoCuadros::paso_simulacion'
+/// @brief segundos, llama a 'calcularInstantanea' del objeto y publica el resultado. La hebra principal
+/// @brief aplica al objeto la instantánea más reciente antes de visualizarlo ('aplicarUltima'), así que el
+/// @brief cálculo de los estados pesados (formaciones grandes) se solapa con el envío de órdenes a la GPU.
+/// @brief Se inicia y se detiene desde la hebra principal, y se debe detener antes de cambiar o destruir
+/// @brief el objeto. La hebra se crea la primera vez que se inicia, y al detenerla queda esperando.
+///
+class HebraSimulacion
+{
+   public:
+
+   /// @brief Detiene la simulación, si está en marcha, y termina la hebra
+   ~HebraSimulacion() ;
+
+   /// @brief Empieza a simular 'objeto' (con parámetros) en la hebra, desde los tiempos actuales
+   /// @brief de sus parámetros (antes llama a 'prepararInstantaneas' del objeto en esta hebra)
+   void iniciar( ObjetoVisu * p_objeto );
+
+   /// @brief Detiene la hebra (si está en marcha) y copia en el objeto los tiempos de los parámetros
+   /// @brief simulados, así la simulación puede seguir en la hebra principal desde ese instante
+   void detener() ;
+
+   /// @brief Devuelve el objeto que se está simulando (nulo si la hebra no está en marcha)
+   ObjetoVisu * leerObjeto() const { return objeto ; }
+
+   /// @brief Aplica al objeto la instantánea más reciente, si hay una nueva (se llama en la hebra principal)
+   /// @return 'true' si se ha aplicado una instantánea nueva, 'false' si no
+   bool aplicarUltima() ;
+
+   private:
+
+   // bucle de la hebra: espera a que se inicie la simulación, y mientras esté activa avanza los 
+   // tiempos y publica instantáneas (duerme entre los pasos)
+   void simular() ;
+
+   // avanza 'pasos' pasos de simulación y publica una instantánea con los tiempos resultantes
+   void publicar( const unsigned pasos );
+
+   ObjetoVisu *                        objeto = nullptr ;
+   std::thread                         hebra ;
+   std::mutex                          mutex ;             // protege 'activa', 'simulando' y 'salir'
+   std::condition_variable             cambio ;            // se notifica al cambiar cualquiera de ellos
+   bool                                activa    = false , // la hebra principal quiere que se simule
+                                       simulando = false , // la hebra está simulando (usa 'objeto' y 'tiempos')
+                                       salir     = false ; // la hebra debe terminar
+   std::vector<float>                  tiempos ;           // tiempos de los parámetros
+   uint64_t                            num_paso = 0 ;
+   BufferTriple<InstantaneaSimulacion> instantaneas ;
+} ;
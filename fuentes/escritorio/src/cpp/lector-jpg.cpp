@@ -27,11 +27,13 @@
 #include <string>
 #include <iostream>
 #include <cassert>
+#include <algorithm> // std::min
 #include <jpeglib.h>
 
 
 #include "utilidades.h" // para 'ProcesarNombreArchivo'
 #include "lector-jpg.h"
+#include "perfilador.h"
 
 /** -------------------------------------------------------------------- **/
 /// @brief abre un archivo para lectura en modo binario (modo="rb")
@@ -60,8 +62,10 @@ FILE * abrir_archivo_rb( const char * nombre )
 // código adaptado a C++11 a partir de:
 // https://github.com/Tinker-S/libjpeg-sample/blob/master/jpeg_sample.c
 
-unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsigned &alto )
+unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsigned &alto, 
+                                 const unsigned reduccion )
 {
+   ZONA_PERFIL_CPU( "LeerArchivoJPEG" );
    using namespace std ;
 
    const std::string nombre_arch_path = BuscarArchivo( nombre_arch, "imgs" );
@@ -71,8 +75,6 @@ unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsig
    struct jpeg_decompress_struct cinfo;
    struct jpeg_error_mgr         jerr;
 
-   JSAMPROW        row_ptr[1] = { nullptr };
-   unsigned long   location   = 0 ;
    unsigned char * buff       = nullptr ;
    FILE *          infile     = abrir_archivo_rb( nombre_arch_path.c_str() );
 
@@ -86,6 +88,9 @@ unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsig
    jpeg_create_decompress( &cinfo );
    jpeg_stdio_src( &cinfo, infile );
    jpeg_read_header( &cinfo, TRUE );
+   assert( reduccion == 1 || reduccion == 2 || reduccion == 4 || reduccion == 8 );
+   cinfo.scale_num   = 1 ;
+   cinfo.scale_denom = reduccion ;
    jpeg_start_decompress( &cinfo );
    const int num_components  = cinfo.num_components ;
 
@@ -95,18 +100,20 @@ unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsig
    }
    ancho      = cinfo.output_width;
    alto       = cinfo.output_height ;
-   row_ptr[0] = new unsigned char [ ancho*num_components ];
-   buff       = new unsigned char [ alto*ancho*num_components ];
+   buff       = new unsigned char [ std::size_t( alto )*ancho*num_components ];
 
+   // las filas se escriben directamente en 'buff', se piden de 16 en 16 (libjpeg
+   // puede devolver menos)
    while( cinfo.output_scanline < alto )
-	{  jpeg_read_scanlines( &cinfo, row_ptr, 1 );
-      for( unsigned long i = 0 ; i < ancho*num_components ; i++ )
-         buff[location++] = row_ptr[0][i];
+	{  JSAMPROW filas[16] ;
+      const unsigned num_filas = std::min( 16u, alto - cinfo.output_scanline );
+      for( unsigned i = 0 ; i < num_filas ; i++ )
+         filas[i] = buff + std::size_t( cinfo.output_scanline + i )*ancho*num_components ;
+      jpeg_read_scanlines( &cinfo, filas, num_filas );
 	}
    jpeg_finish_decompress( &cinfo );
    jpeg_destroy_decompress( &cinfo );
    fclose( infile );
-   delete [] row_ptr[0] ;
 
    //cout << "leído archivo jpg" << endl ;
 
@@ -35,10 +35,14 @@
 // los pixels se alojan en memoria dinámica y pueden ser eliminados con 'delete []'
 // El nombre del archivo debe ir sin el 'path', se busca en 'materiales/imgs' y si 
 // no está se busca en 'archivos-alumno'
+// Con 'reduccion' igual a 2, 4 u 8, la imagen se decodifica directamente a 1/2, 1/4 
+// o 1/8 de su tamaño (con el escalado de la DCT de libjpeg, mucho más rápido que 
+// decodificarla entera), y 'ancho' y 'alto' son los de la imagen reducida.
 //
 // código adaptado a C++11 a partir de:
 // https://github.com/Tinker-S/libjpeg-sample/blob/master/jpeg_sample.c
 
-unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsigned &alto );
+unsigned char * LeerArchivoJPEG( const char *nombre_arch, unsigned &ancho, unsigned &alto, 
+                                 const unsigned reduccion = 1 );
 
 #
@@ -25,9 +25,15 @@
 // **
 // *********************************************************************
 
+#include <cstdio>  // std::sscanf
 #include "objeto-visu.h"
 #include "aplic-2d.h"
 #include "aplic-3d.h"
+#include "colecciones-objs.h" // ColeccionObjs3D_5::fijarAgrupadoEstatico
+#include "perfilador.h"
+#include "rasterizador-cpu.h"
+#include "texturas.h"  // ImagenTextura::fijarUsarArreglos
+#include "vaos-vbos.h" // DescrVAO::fijarCuantizacionDefecto, DescrVAO::fijarDisposicionDefecto
 
 // evita la necesidad de escribir std::
 using namespace std ;
@@ -37,9 +43,10 @@ using namespace std ;
 /// @brief Crea la aplicación correspondiente al tipo de aplicación especificado en la linea de órdenes 
 /// @param argc (int) número de argumentos en la línea de órdenes
 /// @param argv (char *) argumentos de la línea de órdenes
+/// @param sin_ventana (bool) 'true' para crear la aplicación sin ventana (solo 3D)
 /// @return (AplicacionBase *) puntero a la aplicación creada
 ///
-AplicacionBase * CrearAplicacion( int argc, char * argv[] )
+AplicacionBase * CrearAplicacion( int argc, char * argv[], const bool sin_ventana )
 {
    if ( argc < 2 )
    {
@@ -50,18 +57,34 @@ AplicacionBase * CrearAplicacion( int argc, char * argv[] )
 
    AplicacionBase * apl = nullptr ;
 
+   if ( tipo_aplic == "2d" && sin_ventana )
+   {
+      cout << "Error: la aplicación 2D no se puede ejecutar sin ventana. Termino." << endl ;
+      exit(1);
+   }
+
    if ( tipo_aplic == "2d")
       apl = new Aplicacion2D(); // usa Cauce2D y Cauce2DLineas (deriv. de CauceBase)
    else if ( tipo_aplic == "3da" )
-      apl = new Aplicacion3D(3,3); // usa Cauce3D_ogl3 (deriv. de Cauce3D)
+      apl = new Aplicacion3D(3,3,sin_ventana); // usa Cauce3D_ogl3 (deriv. de Cauce3D)
    else if ( tipo_aplic == "3db" )
-      apl = new Aplicacion3D(4,2); // usa Cauce3D_ogl4 (deriv. de Cauce3D)
+      apl = new Aplicacion3D(4,2,sin_ventana); // usa Cauce3D_ogl4 (deriv. de Cauce3D)
    else
    {
       cout << "Error: tipo de aplicación no reconocido ('" << tipo_aplic << "'). Termino. " << endl ;
       cout << "    + Usa '2d' para una aplicación 2D con OpenGL 3.3 (shaders: VS+GS+FS)" << endl ;
       cout << "    + Usa '3da' para una aplicación 3D con OpenGL 3.3 (shaders: VS+FS)" << endl ;
       cout << "    + Usa '3db' para una aplicación 3D con OpenGL 4.5 (shaders: VS+TS+GS+FS)" << endl ;
+      cout << "    (en 3D, añade '--sin-ventana [carpeta] [ancho]x[alto]' para visualizar todos los objetos sin ventana)" << endl ;
+      cout << "    (en 3D, añade '--medir [carpeta] [ancho]x[alto] [calentamiento]+[medidos]' para medir los tiempos por cuadro)" << endl ;
+      cout << "    (en 3D sin ventana, añade '--software' para visualizar con el rasterizador por software, que hace lo mismo que los shaders VS+FS)" << endl ;
+      cout << "    (en 3D, añade '--perfilar[=cuadros]' para escribir el perfil de los primeros cuadros en 'perfil.json')" << endl ;
+      cout << "    (añade '--ritmo=[fps|vsync|libre]' para fijar el ritmo de los cuadros en las animaciones)" << endl ;
+      cout << "    (añade '--hebra-simulacion' para simular las animaciones en una hebra propia)" << endl ;
+      cout << "    (en 3D, añade '--arreglos-texturas' para agrupar las texturas en capas de arreglos de texturas)" << endl ;
+      cout << "    (en 3D, añade '--disposicion=[separada|entrelazada|pos-separada]' para fijar la disposición de los atributos en los VAOs)" << endl ;
+      cout << "    (en 3D, añade '--cuantizar[=pos,nor,col,ct]' para codificar esas tablas de los VAOs con menos bits, sin lista todas)" << endl ;
+      cout << "    (en 3D, añade '--agrupado-estatico' para visualizar los objetos de la colección 5 con una malla agrupada por material)" << endl ;
       exit(1) ;
    }
    return apl ;
@@ -79,13 +102,127 @@ int main( int argc, char *argv[] )
    using namespace std ;
    cout << "PCG (MDS) - curso 2023-24 (" << NOMBRE_OS << ")" << endl ;
 
+   // opciones '--sin-ventana' y '--medir' (tras el tipo de aplicación): carpeta de salida y tamaño 
+   // opcionales, y con '--medir' el número de cuadros de calentamiento y medidos por objeto
+   const bool  medir       = argc >= 3 && std::string( argv[2] ) == "--medir" ,
+               sin_ventana = medir || ( argc >= 3 && std::string( argv[2] ) == "--sin-ventana" );
+   std::string carpeta     = "." ;
+   unsigned    ancho       = 0, 
+               alto        = 0,
+               num_calent  = 30, 
+               num_medidos = 120 ,
+               num_perfil  = 0 ;
+   std::string ritmo ;
+   bool        hebra_simulacion = false ,
+               software         = false ,
+               arreglos         = false ,
+               agrupado         = false ;
+   CuantizacionVAO cuantizacion = DescrVAO::leerCuantizacionDefecto() ;
+   DisposicionVAO  disposicion  = DescrVAO::leerDisposicionDefecto() ;
+   for( int i = 2 ; i < argc ; i++ )
+   {
+      unsigned a = 0, h = 0 ;
+      // opción '--perfilar[=cuadros]' (en cualquier posición): capturar el perfil desde el inicio
+      if ( std::string( argv[i] ).starts_with( "--perfilar" ) )
+         num_perfil = std::sscanf( argv[i], "--perfilar=%u", &a ) == 1 && a > 0 ? a : 60 ;
+      // opción '--ritmo=[fps|vsync|libre]' (en cualquier posición): ritmo de los cuadros en las animaciones
+      else if ( std::string( argv[i] ).starts_with( "--ritmo=" ) )
+         ritmo = std::string( argv[i] ).substr( 8 );
+      // opción '--hebra-simulacion' (en cualquier posición): simular las animaciones en una hebra propia
+      else if ( std::string( argv[i] ) == "--hebra-simulacion" )
+         hebra_simulacion = true ;
+      // opción '--software' (en cualquier posición, solo sin ventana): usar el rasterizador por software
+      else if ( std::string( argv[i] ) == "--software" )
+         software = true ;
+      // opción '--arreglos-texturas' (en cualquier posición): usar arreglos de texturas
+      else if ( std::string( argv[i] ) == "--arreglos-texturas" )
+         arreglos = true ;
+      // opción '--agrupado-estatico' (en cualquier posición): agrupado estático en la colección 5
+      else if ( std::string( argv[i] ) == "--agrupado-estatico" )
+         agrupado = true ;
+      // opción '--disposicion=[separada|entrelazada|pos-separada]' (en cualquier posición): atributos en los VAOs
+      else if ( std::string( argv[i] ).starts_with( "--disposicion=" ) )
+      {  if ( ! LeerDisposicion( std::string( argv[i] ).substr( 14 ), disposicion ) )
+         {  cout << "Error: disposición no reconocida ('" << argv[i] << "'), debe ser 'separada', 'entrelazada' o 'pos-separada'. Termino." << endl ;
+            exit(1);
+         }
+      }
+      // opción '--cuantizar[=lista]' (en cualquier posición): tablas de los VAOs con menos bits
+      else if ( std::string( argv[i] ).starts_with( "--cuantizar" ) )
+      {  const std::string opcion = argv[i] ;
+         const std::string lista  = opcion == "--cuantizar" ? "pos,nor,col,ct" : 
+                                    opcion.starts_with( "--cuantizar=" ) ? opcion.substr( 12 ) : "?" ;
+         if ( ! LeerCuantizacion( lista, cuantizacion ) )
+         {  cout << "Error: opción no reconocida ('" << opcion << "'), las tablas son 'pos', 'nor', 'col' y 'ct'. Termino." << endl ;
+            exit(1);
+         }
+      }
+      else if ( ! sin_ventana || i == 2 )
+         continue ;
+      else if ( std::sscanf( argv[i], "%ux%u", &a, &h ) == 2 )
+      {  ancho = a ;
+         alto  = h ;
+      }
+      else if ( medir && std::sscanf( argv[i], "%u+%u", &a, &h ) == 2 && h > 0 )
+      {  num_calent  = a ;
+         num_medidos = h ;
+      }
+      else 
+         carpeta = argv[i] ;
+   }
+
+   // el rasterizador por software se activa antes de crear la aplicación (que entonces no crea 
+   // ningún contexto de OpenGL, y los VAOs y las texturas conservan sus datos en la CPU)
+   if ( software && ! sin_ventana )
+   {  cout << "Error: la opción '--software' solo se puede usar con '--sin-ventana' o '--medir'. Termino." << endl ;
+      exit(1);
+   }
+   RasterizadorCPU::fijarActivo( software );
+
+   // las imágenes de textura, los VAOs y las colecciones se crean con la aplicación (al crear las colecciones y visualizarlas)
+   ImagenTextura::fijarUsarArreglos( arreglos );
+   DescrVAO::fijarCuantizacionDefecto( cuantizacion );
+   DescrVAO::fijarDisposicionDefecto( disposicion );
+   ColeccionObjs3D_5::fijarAgrupadoEstatico( agrupado );
+   cout << "Tablas cuantizadas en los VAOs: " << NombreCuantizacion( cuantizacion ) 
+        << ", disposición de los atributos: " << NombreDisposicion( disposicion ) << endl ;
+
    // crear la aplicación en función de la línea de órdenes: 2D, 3D con OpenGL 3.3, o 3D con OpenGL 4.5.
-   AplicacionBase * apl = CrearAplicacion( argc, argv ) ;
+   AplicacionBase * apl = CrearAplicacion( argc, argv, sin_ventana ) ;
+   Perfilador::instancia()->nombrarHebra( "principal" );
+   if ( ritmo == "vsync" )
+      apl->fijarRitmo( ModoRitmo::vsync );
+   else if ( ritmo == "libre" )
+      apl->fijarRitmo( ModoRitmo::libre );
+   else if ( ! ritmo.empty() )
+   {  const double fps = std::atof( ritmo.c_str() );
+      if ( fps <= 0.0 )
+      {  cout << "Error: ritmo de cuadros no reconocido ('" << ritmo << "'), debe ser un número de cuadros por segundo, 'vsync' o 'libre'. Termino." << endl ;
+         exit(1);
+      }
+      apl->fijarRitmo( ModoRitmo::objetivo, fps );
+   }
+   if ( hebra_simulacion )
+      apl->fijarSimulacionConcurrente( true );
+   if ( num_perfil > 0 )
+      Perfilador::instancia()->iniciarCaptura( num_perfil, "perfil.json" );
       
-   // ejecuta el bucle principal de gestión de eventos de GLFW
-   apl->buclePrincipalEventos() ;   
+   // ejecuta el bucle principal de gestión de eventos de GLFW (o, sin ventana, visualiza
+   // todos los objetos o mide sus tiempos, y termina)
+   if ( sin_ventana )
+   {
+      if ( ancho > 2 && alto > 2 )
+         apl->cambioTamano( ancho, alto );
+      if ( medir )
+         dynamic_cast<Aplicacion3D *>( apl )->medirTiempos( carpeta, num_calent, num_medidos );
+      else
+         dynamic_cast<Aplicacion3D *>( apl )->visualizarSinVentana( carpeta );
+   }
+   else 
+      apl->buclePrincipalEventos() ;   
    
-   // destruye la aplicación
+   // escribir el perfil si la captura no ha terminado (el contexto OpenGL aún existe) y destruir la aplicación
+   Perfilador::instancia()->terminarCaptura();
    delete apl ;
 
    cout << "Programa terminado normalmente." << endl ;
@@ -28,10 +28,11 @@
 #include <limits>
 #include <set>
 #include "utilidades.h"
+#include "reserva-hebras.h"
 #include "aplic-3d.h"
 #include "malla-ind.h"   // declaración de 'ContextoVis'
-#include "lector-ply.h"
-#include "seleccion.h"   // para 'ColorDesdeIdent' 
+#include "seleccion.h"   // para 'ColorDesdeIdent'
+#include "rasterizador-cpu.h" // para 'RasterizadorCPU::activo' 
 
 // *****************************************************************************
 // funciones auxiliares
@@ -86,11 +87,12 @@ void MallaInd::calcularNormalesTriangulos()
       return ;
    }
 
-   // Creación de la tabla de normales de triángulos
+   // Creación de la tabla de normales de triángulos (cada triángulo es independiente: se
+   // reparten entre las hebras de la reserva en grupos de 'grano' triángulos)
    nor_tri.resize( nt ) ;
-   unsigned long nt_mal = 0 ;
+   constexpr unsigned grano = 4096 ;
 
-   for( unsigned it = 0 ; it < nt ; it++ )
+   auto normal_triangulo = [&]( unsigned it )
    {
       const glm::vec3
          & v0 = vertices[triangulos[it][0]],
@@ -103,11 +105,14 @@ void MallaInd::calcularNormalesTriangulos()
       if  ( ln > 1e-8 )
          nor_tri[it] = n/ln ;
       else
-      {
          nor_tri[it] = glm::vec3(0.0,0.0,0.0);
-         nt_mal++ ;
-      }
-   }
+   };
+
+   if ( nt <= grano )
+      for( unsigned it = 0 ; it < nt ; it++ )
+         normal_triangulo( it );
+   else
+      ReservaHebras::instancia()->paraCada( nt, normal_triangulo, grano );
 }
 
 
@@ -179,7 +184,8 @@ void MallaInd::visualizarGL( )
    CError();
 
    // si la malla no vértices o no tiene triángulos, imprimir advertencia y salir.
-   if ( triangulos.size() == 0 || vertices.size() == 0 )
+   // (si las tablas ya se han movido al VAO, la malla no estaba vacía)
+   if ( ! tablas_liberadas && ( triangulos.size() == 0 || vertices.size() == 0 ))
    {  cout << "advertencia: intentando dibujar malla vacía '" << leerNombre() << "'" << endl << flush ;
       return ;
    }
@@ -199,12 +205,7 @@ void MallaInd::visualizarGL( )
    //  Si el puntero 'dvao' es nulo, crear el descriptor de VAO (se usan las tablas de vértices, triángulos y atributos de la malla)
    //  Si el VAO ya está creado, (dvao no nulo), no hay que hacer nada.
    
-   if ( dvao == nullptr ) 
-      dvao = new DescrVAO({ .posiciones_3d = vertices, 
-                            .colores       = col_ver, 
-                            .normales      = nor_ver,  
-                            .coord_text    = cc_tt_ver, 
-                            .triangulos    = triangulos });
+   leerDescrVAO();
    
    CError();
    
@@ -236,16 +237,17 @@ void MallaInd::visualizarGeomGL( )
    //    1. Desactivar todas las tablas de atributos del VAO (que no estén vacías)
    //    2. Dibujar la malla (únicamente visualizará los triángulos), se usa el método 'draw' del VAO (dvao)
    //    3. Volver a activar todos los atributos para los cuales la tabla no esté vacía
+   //  (se consulta al VAO qué tablas tiene, ya que las de la malla pueden haberse liberado)
    
-   if ( 0 < col_ver.size() )   dvao->habilitarAtrib( ind_atrib_colores,    false );
-   if ( 0 < nor_ver.size() )   dvao->habilitarAtrib( ind_atrib_normales,   false );
-   if ( 0 < cc_tt_ver.size() ) dvao->habilitarAtrib( ind_atrib_coord_text, false );
+   if ( dvao->tieneTablaAtrib( ind_atrib_colores ) )    dvao->habilitarAtrib( ind_atrib_colores,    false );
+   if ( dvao->tieneTablaAtrib( ind_atrib_normales ) )   dvao->habilitarAtrib( ind_atrib_normales,   false );
+   if ( dvao->tieneTablaAtrib( ind_atrib_coord_text ) ) dvao->habilitarAtrib( ind_atrib_coord_text, false );
 
    dvao->draw( GL_TRIANGLES );
 
-   if ( 0 < col_ver.size() )   dvao->habilitarAtrib( ind_atrib_colores,    true );
-   if ( 0 < nor_ver.size() )   dvao->habilitarAtrib( ind_atrib_normales,   true );
-   if ( 0 < cc_tt_ver.size() ) dvao->habilitarAtrib( ind_atrib_coord_text, true );
+   if ( dvao->tieneTablaAtrib( ind_atrib_colores ) )    dvao->habilitarAtrib( ind_atrib_colores,    true );
+   if ( dvao->tieneTablaAtrib( ind_atrib_normales ) )   dvao->habilitarAtrib( ind_atrib_normales,   true );
+   if ( dvao->tieneTablaAtrib( ind_atrib_coord_text ) ) dvao->habilitarAtrib( ind_atrib_coord_text, true );
    
 }
 
@@ -259,20 +261,22 @@ void MallaInd::visualizarNormalesGL(  )
    //Aplicacion3D * apl = Aplicacion3D::instancia() ;
    //Cauce3D * cauce = apl->cauce3D() ;
 
+   // si las tablas se han liberado, el VAO de normales se ha creado antes (si la malla tenía normales)
+   if ( tablas_liberadas )
+   {
+      if ( dvao_normales == nullptr )
+         cout << "Advertencia: intentando dibujar normales de una malla que no tiene tabla (" << leerNombre() << ")." << endl ;
+      else 
+         dvao_normales->draw( GL_LINES );
+      return ;
+   }
+
    if ( nor_ver.size() == 0 )
    {
       cout << "Advertencia: intentando dibujar normales de una malla que no tiene tabla (" << leerNombre() << ")." << endl ;
       return ;
    }  
 
-   if( nor_ver.size() != vertices.size() )
-   {
-      cout << "Error visu. normales: tabla de normales no vacía y de tamaño distinto a la de vértices." << endl ;
-      cout << "Nombre del objeto        : " << leerNombre() << endl ;
-      cout << "Tamaño tabla vértices    : " << vertices.size() << endl ;
-      cout << "Tamaño tabla de normales : " << nor_ver.size() << endl ;
-      exit(1);
-   }
    CError();
 
    // Visualizar las normales del objeto MallaInd
@@ -294,21 +298,36 @@ void MallaInd::visualizarNormalesGL(  )
    //       tipo de primitiva 'GL_LINES'.
    
    if ( dvao_normales == nullptr )
-   {  
-      assert( segmentos_normales.size() == 0 );
+      crearDescrVAONormales();
+   
+   dvao_normales->draw( GL_LINES );
+}
+// -----------------------------------------------------------------------------
 
-      for( unsigned i = 0 ; i < vertices.size() ; i++ )
-      {  
-         segmentos_normales.push_back( vertices[i] );
-         segmentos_normales.push_back( vertices[i]+ 0.35f*(nor_ver[i]) );
-      }
-      constexpr unsigned num_atribs = 1 ;
-      dvao_normales = new DescrVAO( num_atribs, new DescrVBOAtribs( ind_atrib_posiciones, segmentos_normales )); 
-      
-      assert( dvao_normales != nullptr );
+void MallaInd::crearDescrVAONormales()
+{
+   using namespace std ;
+   assert( dvao_normales == nullptr );
+   assert( segmentos_normales.size() == 0 );
+
+   if( nor_ver.size() != vertices.size() )
+   {
+      cout << "Error visu. normales: tabla de normales no vacía y de tamaño distinto a la de vértices." << endl ;
+      cout << "Nombre del objeto        : " << leerNombre() << endl ;
+      cout << "Tamaño tabla vértices    : " << vertices.size() << endl ;
+      cout << "Tamaño tabla de normales : " << nor_ver.size() << endl ;
+      exit(1);
    }
+
+   for( unsigned i = 0 ; i < vertices.size() ; i++ )
+   {  
+      segmentos_normales.push_back( vertices[i] );
+      segmentos_normales.push_back( vertices[i]+ 0.35f*(nor_ver[i]) );
+   }
+   constexpr unsigned num_atribs = 1 ;
+   dvao_normales = new DescrVAO( num_atribs, new DescrVBOAtribs( ind_atrib_posiciones, std::move( segmentos_normales ) )); 
    
-   dvao_normales->draw( GL_LINES );
+   assert( dvao_normales != nullptr );
 }
 
 // -----------------------------------------------------------------------------
@@ -346,6 +365,136 @@ void MallaInd::visualizarModoSeleccionGL()
       cauce->popColor();
 }
 
+// -----------------------------------------------------------------------------
+// añadir una copia transformada de otra malla al final de las tablas de esta
+
+void MallaInd::agregarMallaTransformada( const MallaInd & malla, const glm::mat4 & matriz, 
+                                         const glm::vec3 & color )
+{
+   using namespace glm ;
+   assert( dvao == nullptr ); // las tablas no pueden cambiar una vez creado el VAO
+   assert( ! malla.tablas_liberadas ); // la otra malla debe conservar sus tablas
+   assert( col_ver.size() == vertices.size() );
+
+   const unsigned n_ini   = vertices.size() ;
+   const mat3     mat_nor = transpose( inverse( mat3( matriz ) ) );
+
+   // si la otra malla tiene normales o coordenadas de textura y esta no las tenía, se 
+   // ponen a cero para los vértices ya añadidos (y al revés, más abajo)
+   if ( nor_ver.size() == 0 && malla.nor_ver.size() > 0 )
+      nor_ver.resize( n_ini, vec3( 0.0f ) );
+   if ( cc_tt_ver.size() == 0 && malla.cc_tt_ver.size() > 0 )
+      cc_tt_ver.resize( n_ini, vec2( 0.0f ) );
+
+   for( unsigned i = 0 ; i < malla.vertices.size() ; i++ )
+   {
+      vertices.push_back( vec3( matriz*vec4( malla.vertices[i], 1.0f ) ) );
+      col_ver.push_back( malla.col_ver.size() > 0 ? malla.col_ver[i] : color );
+
+      if ( nor_ver.size() > 0 )
+         nor_ver.push_back( malla.nor_ver.size() > 0 ? normalize( mat_nor*malla.nor_ver[i] ) : vec3( 0.0f ) );
+      if ( cc_tt_ver.size() > 0 )
+         cc_tt_ver.push_back( malla.cc_tt_ver.size() > 0 ? malla.cc_tt_ver[i] : vec2( 0.0f ) );
+   }
+
+   for( const uvec3 & t : malla.triangulos )
+      triangulos.push_back( t + uvec3( n_ini ) );
+
+   // las normales de triángulos (si había) ya no son válidas
+   nor_tri.clear();
+}
+
+// -----------------------------------------------------------------------------
+// crea un descriptor de VAO para dibujo instanciado de esta malla
+// (el color de cada instancia se da en una tabla por instancia, así que no se incluye 'col_ver')
+
+DescrVAO * MallaInd::crearDescrVAOInstancias() const
+{
+   assert( ! tablas_liberadas ); // la malla debe conservar sus tablas
+   assert( triangulos.size() > 0 && vertices.size() > 0 );
+
+   DescrVAO * dvao_inst = new DescrVAO( { .posiciones_3d = vertices,
+                                          .normales      = nor_ver,
+                                          .coord_text    = cc_tt_ver,
+                                          .triangulos    = triangulos },
+                                        numero_atributos_cauce_3d_inst );
+   assert( dvao_inst != nullptr );
+   return dvao_inst ;
+}
+
+// -----------------------------------------------------------------------------
+
+DescrVAO * MallaInd::leerDescrVAO()
+{
+   if ( dvao != nullptr ) 
+      return dvao ;
+
+   if ( triangulos.size() == 0 || vertices.size() == 0 )
+      return nullptr ;
+
+   if ( residencia == ResidenciaMalla::cpu_y_gpu )
+   {
+      // el VAO hace su propia copia de las tablas (la libera al enviarla a la GPU)
+      dvao = new DescrVAO({ .posiciones_3d = vertices, 
+                            .colores       = col_ver, 
+                            .normales      = nor_ver,  
+                            .coord_text    = cc_tt_ver, 
+                            .triangulos    = triangulos });
+      return dvao ;
+   }
+
+   // antes de mover las tablas se crea el VAO de normales, si hay normales y no está creado 
+   // ya, y se envía ya a la GPU: así sus segmentos no se quedan en la CPU (con el rasterizador
+   // por software no hay GPU, los segmentos se quedan en la CPU y no cuentan como liberados)
+   if ( nor_ver.size() > 0 && dvao_normales == nullptr )
+   {  crearDescrVAONormales();
+      if ( ! RasterizadorCPU::activo() )
+      {  dvao_normales->crearVAO();
+         glBindVertexArray( 0 ); // ('crearVAO' lo deja activado)
+      }
+   }
+
+   // las tablas se mueven al VAO, que las libera después de enviarlas a la GPU (las normales 
+   // de triángulos solo se usan para calcular las de vértices, se liberan ya)
+   bytes_cpu_liberados = vertices.size()*sizeof( glm::vec3 ) + col_ver.size()*sizeof( glm::vec3 ) +
+                         nor_ver.size()*sizeof( glm::vec3 )  + nor_tri.size()*sizeof( glm::vec3 ) +
+                         cc_tt_ver.size()*sizeof( glm::vec2 ) + triangulos.size()*sizeof( glm::uvec3 );
+   if ( dvao_normales != nullptr )
+      bytes_cpu_liberados -= dvao_normales->leerUsoMemoria().cpu_tablas ;
+
+   dvao = new DescrVAO({ .posiciones_3d = std::move( vertices ), 
+                         .colores       = std::move( col_ver ), 
+                         .normales      = std::move( nor_ver ),  
+                         .coord_text    = std::move( cc_tt_ver ), 
+                         .triangulos    = std::move( triangulos ) });
+   std::vector<glm::vec3>().swap( nor_tri );
+   tablas_liberadas = true ;
+   return dvao ;
+}
+// -----------------------------------------------------------------------------
+
+void MallaInd::acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const 
+{
+   using namespace glm ;
+   if ( ! contados.insert( this ).second ) // ya contada (la malla aparece varias veces)
+      return ;
+
+   uso.cpu_tablas += vertices.size()*sizeof( vec3 ) + triangulos.size()*sizeof( uvec3 ) +
+                     col_ver.size()*sizeof( vec3 )  + nor_ver.size()*sizeof( vec3 ) + 
+                     nor_tri.size()*sizeof( vec3 )  + cc_tt_ver.size()*sizeof( vec2 ) + 
+                     segmentos_normales.size()*sizeof( vec3 );
+   if ( dvao != nullptr )
+      uso += dvao->leerUsoMemoria();
+   if ( dvao_normales != nullptr )
+      uso += dvao_normales->leerUsoMemoria();
+}
+// -----------------------------------------------------------------------------
+
+void MallaInd::fijarResidencia( const ResidenciaMalla nueva_residencia )
+{
+   assert( dvao == nullptr ); // las tablas se mueven (o no) al crear el VAO
+   residencia = nueva_residencia ;
+}
 
 // ****************************************************************************
 // Clase 'MallaPLY'
@@ -353,7 +502,15 @@ void MallaInd::visualizarModoSeleccionGL()
 MallaPLY::MallaPLY( const std::string & nombre_arch )
 {
    ponerNombre( std::string("Malla en archivo PLY (") + nombre_arch + ")" );
-   LeerPLY( nombre_arch, vertices, triangulos );
+
+   // obtener los datos de la caché (solo se lee el archivo si no lo usa ya otra malla), 
+   // la malla tiene su propia copia de las tablas, ya que puede moverlas al VAO, así que 
+   // no se conservan los datos compartidos (se liberan cuando ninguna malla los está copiando)
+   {
+      const std::shared_ptr<const DatosPLY> datos_ply = CacheRecursos::instancia()->mallaPLY( nombre_arch );
+      vertices   = datos_ply->vertices ;
+      triangulos = datos_ply->triangulos ;
+   }
    calcularNormales(); // calcular la tabla de normales
 }
 
@@ -1196,3 +1353,183 @@ Cilindro::Cilindro( const unsigned n_hor, const unsigned n_vert )
 
 }
 
+// ****************************************************************************
+// Clase 'MallaAgrupada'
+
+MallaAgrupada::MallaAgrupada( const std::string & nombreIni )
+:  MallaInd( nombreIni )
+{
+   ponerIdentificador( -1 ); // los identificadores están en los rangos
+}
+
+// -----------------------------------------------------------------------------
+
+void MallaAgrupada::agregar( const MallaInd & malla, const glm::mat4 & matriz, 
+                             const glm::vec3 & color, const int ident )
+{
+   const unsigned inicio = triangulos.size() ;
+   agregarMallaTransformada( malla, matriz, color );
+   const unsigned num_tris = triangulos.size() - inicio ;
+   num_mallas++ ;
+
+   // si el identificador es el del último rango, se extiende ese rango
+   if ( rangos.size() > 0 && rangos.back().ident == ident )
+      rangos.back().num_triangulos += num_tris ;
+   else 
+      rangos.push_back( { .inicio = inicio, .num_triangulos = num_tris, .ident = ident } );
+}
+
+// -----------------------------------------------------------------------------
+// se dibuja un rango de la tabla de índices por cada identificador distinto
+
+void MallaAgrupada::visualizarModoSeleccionGL() 
+{
+   Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+
+   // crear el descriptor de VAO, si no está creado (igual que en 'visualizarGL'), ya que
+   // el modo selección se puede visualizar antes que el modo normal
+   if ( leerDescrVAO() == nullptr )
+      return ;
+
+   if ( dvao->tieneTablaAtrib( ind_atrib_colores ) )    dvao->habilitarAtrib( ind_atrib_colores,    false );
+   if ( dvao->tieneTablaAtrib( ind_atrib_normales ) )   dvao->habilitarAtrib( ind_atrib_normales,   false );
+   if ( dvao->tieneTablaAtrib( ind_atrib_coord_text ) ) dvao->habilitarAtrib( ind_atrib_coord_text, false );
+
+   for( const RangoIdentMalla & r : rangos )
+   {
+      if ( r.ident != -1 )
+      {
+         cauce->pushColor();
+         cauce->fijarColor( ColorDesdeIdent( r.ident ) );
+      }
+      dvao->drawRango( GL_TRIANGLES, 3*r.inicio, 3*r.num_triangulos );
+      if ( r.ident != -1 )
+         cauce->popColor();
+   }
+
+   if ( dvao->tieneTablaAtrib( ind_atrib_colores ) )    dvao->habilitarAtrib( ind_atrib_colores,    true );
+   if ( dvao->tieneTablaAtrib( ind_atrib_normales ) )   dvao->habilitarAtrib( ind_atrib_normales,   true );
+   if ( dvao->tieneTablaAtrib( ind_atrib_coord_text ) ) dvao->habilitarAtrib( ind_atrib_coord_text, true );
+}
+
+// *****************************************************************************
+// benchmark de las disposiciones de los atributos en los VAOs
+
+void BenchmarkDisposicionesVAO()
+{
+   using namespace std ;
+   using namespace glm ;
+   using namespace std::chrono ;
+
+   Aplicacion3D * apl   = Aplicacion3D::instancia();
+   Cauce3D *      cauce = apl->cauce3D() ;  
+
+   constexpr unsigned 
+      num_res      = 3,  
+      num_disps    = 3,
+      num_cuadros  = 10, // número de cuadros medidos (además de uno inicial, que no se mide)
+      lado_rejilla = 4 ; // se dibujan lado_rejilla x lado_rejilla esferas
+   constexpr unsigned 
+      resols[num_res] = { 64, 256, 512 }; // número de meridianos y paralelos de la esfera
+   constexpr DisposicionVAO 
+      disps[num_disps] = { DisposicionVAO::separada, DisposicionVAO::entrelazada, 
+                           DisposicionVAO::entrelazada_pos_separada };
+   const string 
+      nombres[num_disps] = { "separada", "entrelazada", "pos. separada" };
+
+   GLint viewport[4] ;
+   glGetIntegerv( GL_VIEWPORT, viewport );
+   const float ratio_yx = float(viewport[3])/float(viewport[2]);
+
+   cauce->activar();
+   cauce->fijarColor( 1.0, 1.0, 1.0 );
+
+   // cámara que ve la rejilla de esferas completa
+   const float lado = 2.5f*lado_rejilla ;
+   cauce->fijarMatrizVista( lookAt( vec3( 0.5f*lado, 0.5f*lado, 1.5f*lado ), 
+                                    vec3( 0.5f*lado, 0.0f, 0.5f*lado ), vec3( 0.0f, 1.0f, 0.0f ) ));
+   cauce->fijarMatrizProyeccion( perspective( radians( 60.0f ), 1.0f/ratio_yx, 0.1f, 4.0f*lado ) );
+
+   // devuelve el tiempo medio por cuadro en milisegundos, visualizando todos los atributos 
+   // o solo la geometría (solo con las posiciones)
+   auto medir = [&]( DescrVAO * dvao, const bool solo_geometria ) -> float 
+   {
+      if ( solo_geometria )
+         for( unsigned ia : { ind_atrib_colores, ind_atrib_normales, ind_atrib_coord_text } )
+            dvao->habilitarAtrib( ia, false );
+
+      double seg_total = 0.0 ;
+      for( unsigned ic = 0 ; ic <= num_cuadros ; ic++ )
+      {
+         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+         glFinish();
+         const auto t0 = steady_clock::now();
+
+         for( unsigned iz = 0 ; iz < lado_rejilla ; iz++ )
+         for( unsigned ix = 0 ; ix < lado_rejilla ; ix++ )
+         {
+            cauce->pushMM();
+            cauce->compMM( translate( vec3( 2.5f*ix, 0.0f, 2.5f*iz ) ));
+            dvao->draw( GL_TRIANGLES );
+            cauce->popMM();
+         }
+         glFinish();
+         if ( ic > 0 ) // el primer cuadro crea el VAO, no se mide
+            seg_total += duration<double>( steady_clock::now() - t0 ).count() ;
+      }
+
+      if ( solo_geometria )
+         for( unsigned ia : { ind_atrib_colores, ind_atrib_normales, ind_atrib_coord_text } )
+            dvao->habilitarAtrib( ia, true );
+      return 1000.0f*float( seg_total/num_cuadros );
+   };
+
+   cout << endl << "Benchmark de disposiciones de VAOs (" << lado_rejilla*lado_rejilla << " esferas, " 
+        << num_cuadros << " cuadros por medida, tiempos en ms, renderer: '" << glGetString( GL_RENDERER ) << "'):" << endl 
+        << setw(10) << "esfera" << setw(12) << "vértices" ;
+   for( unsigned id = 0 ; id < num_disps ; id++ )
+      cout << setw(16) << (nombres[id] + " (tod.)") << setw(16) << (nombres[id] + " (geom.)") ;
+   cout << endl ;
+
+   for( unsigned ir = 0 ; ir < num_res ; ir++ )
+   {
+      // tablas de una esfera con todos los atributos (los colores dependen de la normal)
+      const unsigned n = resols[ir] ;
+      TablasDatosVAO tablas ;
+      for( unsigned i_lat  = 0 ; i_lat  <= n ; i_lat++ )
+      for( unsigned i_long = 0 ; i_long <= n ; i_long++ )
+      {
+         const float f_lat    = float(i_lat)/float(n),
+                     f_long   = float(i_long)/float(n),
+                     ang_lat  = (f_lat-0.5)*M_PI,
+                     ang_long = M_PI*2.0*f_long ;
+         const vec3  p        = { cos(ang_lat)*cos(ang_long), sin(ang_lat), cos(ang_lat)*sin(ang_long) };
+
+         tablas.posiciones_3d.push_back( p );
+         tablas.normales.push_back( p );
+         tablas.colores.push_back( 0.5f*(p + vec3( 1.0f )) );
+         tablas.coord_text.push_back( { f_long, f_lat } );
+      }
+      for( unsigned i_lat  = 0 ; i_lat  < n ; i_lat++ )
+      for( unsigned i_long = 0 ; i_long < n ; i_long++ )
+      {
+         const unsigned i = i_lat*(n+1) + i_long ;
+         tablas.triangulos.push_back( { i,     i+n+1, i+1 } );
+         tablas.triangulos.push_back( { i+n+1, i+n+2, i+1 } );
+      }
+
+      cout << setw(10) << (to_string(n) + "x" + to_string(n)) << setw(12) << tablas.posiciones_3d.size() 
+           << fixed << setprecision(2) ;
+
+      for( unsigned id = 0 ; id < num_disps ; id++ )
+      {
+         DescrVAO * dvao = new DescrVAO( tablas, numero_atributos_cauce_3d, disps[id] );
+         const float ms_todos = medir( dvao, false ), 
+                     ms_geom  = medir( dvao, true );
+         cout << setw(16) << ms_todos << setw(16) << ms_geom << flush ;
+         delete dvao ;
+      }
+      cout << endl ;
+   }
+   cout << "Fin del benchmark." << endl ;
+}
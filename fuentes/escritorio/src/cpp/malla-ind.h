@@ -28,9 +28,21 @@
 #pragma once
 
 #include <vector>       // usar std::vector
+#include <memory>       // usar std::shared_ptr
 #include <utilidades.h>
 #include <vaos-vbos.h>
 #include <objeto-visu.h>   // declaración de 'ObjetoVisu'
+#include <cache-recursos.h> // declaración de 'DatosPLY'
+
+// ---------------------------------------------------------------------
+///
+/// @brief Dónde se guardan las tablas de una malla indexada una vez creado su VAO
+///
+/// @brief * cpu_y_gpu: la malla conserva sus tablas (se pueden usar para agrupar la malla con otras, 
+/// @brief   para dibujo instanciado o para visualizar las normales)
+/// @brief * solo_gpu: las tablas se mueven al VAO (sin copiarlas) y se liberan al enviarlas a la GPU
+///
+enum class ResidenciaMalla { cpu_y_gpu, solo_gpu } ;
 
 
 // ---------------------------------------------------------------------
@@ -62,6 +74,11 @@ class MallaInd : public ObjetoVisu3D
       DescrVAO * dvao_normales = nullptr ;
 
       std::vector<glm::vec3> segmentos_normales ; // guarda los segmentos de normales
+
+      // residencia de las tablas, si ya se han movido al VAO y bytes que ocupaban en la CPU
+      ResidenciaMalla residencia          = ResidenciaMalla::cpu_y_gpu ;
+      bool            tablas_liberadas    = false ;
+      std::size_t     bytes_cpu_liberados = 0 ;
       
 
       // normales de triángulos y vértices
@@ -70,6 +87,16 @@ class MallaInd : public ObjetoVisu3D
       // calculo de las normales de triángulos (solo si no están creadas ya)
       void calcularNormalesTriangulos() ;
 
+      // crea el VAO de los segmentos de normales ('dvao_normales') a partir de las tablas de 
+      // vértices y normales (se llama antes de mover las tablas al VAO de la malla)
+      void crearDescrVAONormales() ;
+
+      // añade al final de las tablas de esta malla una copia de los vértices (transformados 
+      // con 'matriz'), normales, coordenadas de textura y triángulos de 'malla' (si 'malla' 
+      // no tiene colores de vértices, se usa 'color' para todos sus vértices)
+      void agregarMallaTransformada( const MallaInd & malla, const glm::mat4 & matriz, 
+                                     const glm::vec3 & color );
+
       
 
    public:
@@ -86,11 +113,32 @@ class MallaInd : public ObjetoVisu3D
       virtual void visualizarGeomGL(  ) override ;
       virtual void visualizarNormalesGL() override ;
       virtual void visualizarModoSeleccionGL() override ; 
+
+      // crea un nuevo descriptor de VAO con las tablas de posiciones, normales, coordenadas de 
+      // textura y triángulos de esta malla (sin colores), con espacio para añadir atributos 
+      // por instancia (se usa para dibujo instanciado, el VAO es propiedad de quien lo llama)
+      DescrVAO * crearDescrVAOInstancias() const ;
+
+      // devuelve el descriptor del VAO de la malla, creándolo si no está creado todavía
+      // (devuelve nullptr si la malla no tiene vértices o triángulos)
+      DescrVAO * leerDescrVAO() ;
+
+      // fija dónde se guardan las tablas una vez creado el VAO (solo antes de crearlo)
+      void fijarResidencia( const ResidenciaMalla nueva_residencia ) ;
+
+      // devuelve los bytes de memoria de la aplicación liberados al mover las tablas al VAO
+      // (0 si la malla conserva sus tablas o si todavía no se ha creado el VAO)
+      std::size_t leerBytesCPULiberados() const { return bytes_cpu_liberados ; }
+
+      // suma la memoria de las tablas de la malla y de sus VAOs (la de triángulos y la de normales)
+      virtual void acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const override ;
 } ;
 // ---------------------------------------------------------------------
 // Clase para mallas obtenidas de un archivo 'ply'
 // es un tipo de malla indexada que define un nuevo constructor
 // que recibe el nombre del archivo ply como parámetro
+// (el archivo se lee una sola vez para las mallas que se crean a la vez con
+// él, a través de la caché de recursos, cada malla se queda con su copia)
 
 class MallaPLY : public MallaInd
 {
@@ -204,3 +252,49 @@ class Cilindro : public MallaInd
       Cilindro(  const unsigned n_hor, const unsigned n_vert );
 };
 
+// ---------------------------------------------------------------------
+// Rango de triángulos consecutivos de una malla agrupada que tienen el mismo 
+// identificador (-1 si se usa el color actual del cauce en modo selección)
+
+struct RangoIdentMalla
+{
+   unsigned inicio         = 0 ;  // índice del primer triángulo
+   unsigned num_triangulos = 0 ;  
+   int      ident          = -1 ; 
+} ;
+
+// ---------------------------------------------------------------------
+// Malla obtenida juntando copias transformadas de otras mallas (se usa en el agrupado 
+// estático de los grafos de escena). Guarda los rangos de triángulos de cada identificador,
+// para poder visualizarla en modo selección igual que las mallas originales
+
+class MallaAgrupada : public MallaInd
+{
+   public:
+      MallaAgrupada( const std::string & nombreIni );
+
+      // añade una copia de 'malla' transformada con 'matriz', con el color 'color' (si la 
+      // malla no tiene colores de vértices) y el identificador 'ident'
+      void agregar( const MallaInd & malla, const glm::mat4 & matriz, 
+                    const glm::vec3 & color, const int ident );
+
+      // número de mallas agregadas y de rangos de triángulos con distinto identificador
+      unsigned leerNumMallas() const { return num_mallas ; }
+      unsigned leerNumRangos() const { return rangos.size() ; }
+
+      // visualiza cada rango con el color de su identificador 
+      virtual void visualizarModoSeleccionGL() override ;
+
+   private:
+      unsigned num_mallas = 0 ;
+      std::vector<RangoIdentMalla> rangos ;
+} ;
+
+// ---------------------------------------------------------------------
+// Mide el tiempo por cuadro al visualizar mallas de esferas de resolución creciente 
+// con cada disposición de los atributos en los VAOs (separada, entrelazada y entrelazada
+// con las posiciones separadas), visualizando todos los atributos y solo la geometría, 
+// e imprime los resultados en 'cout' (para medirlo sin GPU, se puede ejecutar el programa 
+// con Mesa llvmpipe, ver 'builds/linux/lanzar-con-llvmpipe.sh')
+
+void BenchmarkDisposicionesVAO();
@@ -28,7 +28,6 @@
 // *********************************************************************
 
 #include "utilidades.h"
-#include "lector-ply.h"
 #include "malla-revol.h"
 
 using namespace std ;
@@ -133,12 +132,11 @@ MallaRevolPLY::MallaRevolPLY
    ponerNombre( std::string("Malla de revolución, perfil en '"+ nombre_arch + "'" ));
 
    // Crear la malla de revolución
-   // Leer los vértice del perfil desde un PLY, después llamar a 'inicializar'
+   // Obtener los vértices del perfil de la caché (solo se lee el PLY si no lo usa ya 
+   // otra malla), después llamar a 'inicializar' (el perfil no se conserva, la malla 
+   // ya tiene sus tablas)
    
-   std::vector<glm::vec3> perfil_orig ;
-   LeerVerticesPLY( nombre_arch, perfil_orig );
-
-   inicializar( perfil_orig, nperfiles );
+   inicializar( *CacheRecursos::instancia()->verticesPLY( nombre_arch ), nperfiles );
 }
 
 
@@ -62,6 +62,9 @@ class Material
    void ponerNombre( const std::string & nuevo_nombre );
    std::string nombre() const ;
 
+   // devuelve la textura del material (nullptr si no tiene)
+   Textura * leerTextura() const { return textura ; }
+
    //--------------------------------------------------------
    protected:
 
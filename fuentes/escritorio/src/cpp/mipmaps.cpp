@@ -0,0 +1,471 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Generación de mipmaps en la CPU y caché en disco (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cmath>
+#include <cassert>
+#include <cstdint>
+#include <cstring>     // std::memcmp
+#include <fstream>
+#include <algorithm>   // std::min, std::max
+#include <filesystem>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MIPMAPS_SSE2
+#endif
+#include "reserva-hebras.h"
+#include "mipmaps.h"
+#include "perfilador.h"
+
+// ------------------------------------------------------------------------------------------------------
+// conversión entre sRGB (bytes) y colores lineales (flotantes entre 0 y 1), con tablas
+
+static const float * TablaSRGBaLineal()
+{
+   static const std::vector<float> tabla = []()
+   {
+      std::vector<float> t( 256 );
+      for( unsigned i = 0 ; i < 256 ; i++ )
+      {  const float c = float( i )/255.0f ;
+         t[i] = c <= 0.04045f ? c/12.92f : std::pow( (c+0.055f)/1.055f, 2.4f );
+      }
+      return t ;
+   }();
+   return tabla.data() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+// la tabla inversa tiene 4096 entradas (las diferencias con la fórmula son menores que medio byte)
+constexpr unsigned tam_tabla_lineal = 4096 ;
+
+static const unsigned char * TablaLinealASRGB()
+{
+   static const std::vector<unsigned char> tabla = []()
+   {
+      std::vector<unsigned char> t( tam_tabla_lineal );
+      for( unsigned i = 0 ; i < tam_tabla_lineal ; i++ )
+      {  const float c = float( i )/float( tam_tabla_lineal-1 ),
+                     s = c <= 0.0031308f ? 12.92f*c : 1.055f*std::pow( c, 1.0f/2.4f ) - 0.055f ;
+         t[i] = (unsigned char)( std::min( 255.0f, std::max( 0.0f, s*255.0f + 0.5f )) );
+      }
+      return t ;
+   }();
+   return tabla.data() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+inline unsigned char LinealASRGB( const float c, const unsigned char * tabla )
+{
+   const float v = std::min( 1.0f, std::max( 0.0f, c ));
+   return tabla[ unsigned( v*float( tam_tabla_lineal-1 ) + 0.5f ) ];
+}
+
+// ------------------------------------------------------------------------------------------------------
+// suma a 'dst' los 'n' valores de 'src' multiplicados por 'peso' (es el bucle interior del filtrado
+// vertical, con SSE2 se procesan 4 valores en cada iteración)
+
+static void AcumularFila( float * dst, const float * src, const float peso, const std::size_t n )
+{
+   std::size_t i = 0 ;
+#ifdef MIPMAPS_SSE2
+   const __m128 p4 = _mm_set1_ps( peso );
+   for( ; i+4 <= n ; i += 4 )
+      _mm_storeu_ps( dst+i, _mm_add_ps( _mm_loadu_ps( dst+i ), _mm_mul_ps( p4, _mm_loadu_ps( src+i ))));
+#endif
+   for( ; i < n ; i++ )
+      dst[i] += peso*src[i] ;
+}
+
+// ------------------------------------------------------------------------------------------------------
+// núcleo de reducción a la mitad de un filtro: el texel 'j' del nivel reducido se calcula con los texels
+// '2j+desp0', ..., '2j+desp0+pesos.size()-1' del nivel anterior (con repetición en los bordes,
+// como 'GL_REPEAT'), multiplicados por 'pesos' (que suman 1)
+
+struct NucleoFiltro
+{
+   int                desp0 ;
+   std::vector<float> pesos ;
+} ;
+
+// función de Bessel modificada de orden 0 (para la ventana de Kaiser)
+
+static double BesselI0( const double x )
+{
+   double suma = 1.0, termino = 1.0 ;
+   for( unsigned k = 1 ; k < 30 ; k++ )
+   {  termino *= (x/(2.0*k))*(x/(2.0*k)) ;
+      suma    += termino ;
+   }
+   return suma ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+static NucleoFiltro CrearNucleo( const FiltroMipmaps filtro )
+{
+   if ( filtro == FiltroMipmaps::caja )
+      return NucleoFiltro { .desp0 = 0, .pesos = { 0.5f, 0.5f } };
+
+   // sinc de frecuencia de corte 1/2 (en texels del nivel anterior) con ventana de Kaiser de radio 4:
+   // el centro del texel reducido 'j' está en '2j+1', y el del texel '2j+k' en '2j+k+0.5'
+   constexpr double radio = 4.0, beta = 4.0, pi = 3.14159265358979323846 ;
+   NucleoFiltro nucleo { .desp0 = -3, .pesos = {} };
+   double       suma = 0.0 ;
+
+   for( int k = -3 ; k <= 4 ; k++ )
+   {  const double d    = double( k ) - 0.5 ,
+                   x    = pi*d/2.0 ,
+                   sinc = std::sin( x )/x ,
+                   r    = d/radio ,
+                   vent = BesselI0( beta*std::sqrt( std::max( 0.0, 1.0 - r*r )))/BesselI0( beta ) ;
+      nucleo.pesos.push_back( float( sinc*vent ) );
+      suma += sinc*vent ;
+   }
+   for( float & p : nucleo.pesos )
+      p = float( p/suma );
+   return nucleo ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+inline unsigned Repetir( const int i, const unsigned n )
+{
+   return unsigned( ((i % int( n )) + int( n )) % int( n ) );
+}
+
+// ------------------------------------------------------------------------------------------------------
+// reduce un nivel (colores lineales, 3 flotantes por texel) a la mitad, el filtro es separable: primero
+// se reducen las columnas de cada fila, y después se combinan las filas
+
+static std::vector<float> ReducirNivel( const std::vector<float> & lineal, const unsigned ancho, const unsigned alto,
+                                        const unsigned ancho_red, const unsigned alto_red, const NucleoFiltro & nucleo )
+{
+   constexpr unsigned filas_bloque = 16 ; // filas que procesa cada iteración de 'paraCada'
+   ReservaHebras *    reserva      = ReservaHebras::instancia() ;
+   const unsigned     np           = nucleo.pesos.size() ;
+
+   // 1. filtrado horizontal: 'alto' filas de 'ancho_red' texels (con un ancho de 1, todos los 
+   // índices se repiten al único texel, que se copia)
+   std::vector<float> horiz( std::size_t( ancho_red )*alto*3 );
+
+   reserva->paraCada( (alto + filas_bloque-1)/filas_bloque, [&]( unsigned b )
+   {
+      for( unsigned y = b*filas_bloque ; y < std::min( alto, (b+1)*filas_bloque ) ; y++ )
+      {
+         const float * fila = lineal.data() + std::size_t( y )*ancho*3 ;
+         float *       dst  = horiz.data()  + std::size_t( y )*ancho_red*3 ;
+         for( unsigned j = 0 ; j < ancho_red ; j++ )
+         {
+            float suma[3] = { 0.0f, 0.0f, 0.0f };
+            for( unsigned k = 0 ; k < np ; k++ )
+            {  const float * t = fila + Repetir( int( 2*j ) + nucleo.desp0 + int( k ), ancho )*3 ;
+               suma[0] += nucleo.pesos[k]*t[0] ;
+               suma[1] += nucleo.pesos[k]*t[1] ;
+               suma[2] += nucleo.pesos[k]*t[2] ;
+            }
+            dst[3*j+0] = suma[0] ; dst[3*j+1] = suma[1] ; dst[3*j+2] = suma[2] ;
+         }
+      }
+   });
+
+   // 2. filtrado vertical: cada fila reducida es una combinación de filas completas de 'horiz'
+   std::vector<float> red( std::size_t( ancho_red )*alto_red*3, 0.0f );
+   const std::size_t  n = std::size_t( ancho_red )*3 ;
+
+   reserva->paraCada( (alto_red + filas_bloque-1)/filas_bloque, [&]( unsigned b )
+   {
+      for( unsigned i = b*filas_bloque ; i < std::min( alto_red, (b+1)*filas_bloque ) ; i++ )
+         for( unsigned k = 0 ; k < np ; k++ )
+            AcumularFila( red.data() + i*n, horiz.data() + Repetir( int( 2*i ) + nucleo.desp0 + int( k ), alto )*n,
+                          nucleo.pesos[k], n );
+   });
+
+   return red ;
+}
+
+// ******************************************************************************************************
+// funciones públicas
+// ------------------------------------------------------------------------------------------------------
+
+const char * NombreFormato( const FormatoTexels formato )
+{
+   switch( formato )
+   {
+      case FormatoTexels::bc1 : return "bc1" ;
+      case FormatoTexels::bc7 : return "bc7" ;
+      default :                 return "rgb" ;
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::size_t NivelMipmap::bytesFila() const 
+{
+   switch( formato )
+   {
+      case FormatoTexels::bc1 : return std::size_t( (ancho+3)/4 )*8 ;
+      case FormatoTexels::bc7 : return std::size_t( (ancho+3)/4 )*16 ;
+      default :                 return std::size_t( ancho )*3 ;
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void GenerarMipmaps( CadenaMipmaps & cadena, const FiltroMipmaps filtro )
+{
+   ZONA_PERFIL_CPU( "GenerarMipmaps" );
+   assert( cadena.size() == 1 && cadena[0].formato == FormatoTexels::rgb );
+
+   const float *         a_lineal = TablaSRGBaLineal();
+   const unsigned char * a_srgb   = TablaLinealASRGB();
+   const NucleoFiltro    nucleo   = CrearNucleo( filtro );
+
+   // los niveles se calculan a partir del anterior en colores lineales (sin cuantizar a bytes)
+   unsigned           ancho  = cadena[0].ancho ,
+                      alto   = cadena[0].alto ;
+   std::vector<float> lineal( cadena[0].texels.size() );
+   for( std::size_t i = 0 ; i < lineal.size() ; i++ )
+      lineal[i] = a_lineal[ cadena[0].texels[i] ];
+
+   while( ancho > 1 || alto > 1 )
+   {
+      const unsigned ancho_red = std::max( 1u, ancho/2 ),
+                     alto_red  = std::max( 1u, alto/2 );
+      lineal = ReducirNivel( lineal, ancho, alto, ancho_red, alto_red, nucleo );
+      ancho  = ancho_red ;
+      alto   = alto_red ;
+
+      NivelMipmap nivel { .ancho = ancho, .alto = alto, .formato = FormatoTexels::rgb, 
+                          .texels = std::vector<unsigned char>( lineal.size() ) };
+      for( std::size_t i = 0 ; i < lineal.size() ; i++ )
+         nivel.texels[i] = LinealASRGB( lineal[i], a_srgb );
+      cadena.push_back( std::move( nivel ) );
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+// pesos del remuestreo de 'n' texels a 'n_rem': el texel 'j' remuestreado es la suma de los texels 
+// 'indices[j][k]' multiplicados por 'pesos[j][k]'. Se usa un filtro triángulo (interpolación lineal al 
+// ampliar) que al reducir se ensancha hasta abarcar todos los texels originales que cubre cada uno.
+
+struct PesosRemuestreo
+{
+   std::vector<std::vector<unsigned>> indices ;
+   std::vector<std::vector<float>>    pesos ;
+} ;
+
+static PesosRemuestreo CrearPesosRemuestreo( const unsigned n, const unsigned n_rem )
+{
+   const float     escala = float( n )/float( n_rem ),
+                   radio  = std::max( 1.0f, escala );
+   PesosRemuestreo res ;
+
+   res.indices.resize( n_rem );
+   res.pesos.resize( n_rem );
+   for( unsigned j = 0 ; j < n_rem ; j++ )
+   {
+      const float centro = (float( j ) + 0.5f)*escala ; // en unidades de texels originales
+      float       suma   = 0.0f ;
+      for( int i = int( std::floor( centro - radio )) ; i <= int( std::ceil( centro + radio )) ; i++ )
+      {  const float peso = 1.0f - std::abs( float( i ) + 0.5f - centro )/radio ;
+         if ( peso <= 0.0f )
+            continue ;
+         res.indices[j].push_back( Repetir( i, n ) );
+         res.pesos[j].push_back( peso );
+         suma += peso ;
+      }
+      for( float & p : res.pesos[j] )
+         p /= suma ;
+   }
+   return res ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+NivelMipmap RemuestrearNivel( const NivelMipmap & nivel, const unsigned ancho, const unsigned alto )
+{
+   assert( nivel.formato == FormatoTexels::rgb && ancho > 0 && alto > 0 );
+
+   if ( nivel.ancho == ancho && nivel.alto == alto )
+      return nivel ;
+
+   constexpr unsigned    filas_bloque = 16 ;
+   ReservaHebras *       reserva      = ReservaHebras::instancia() ;
+   const float *         a_lineal     = TablaSRGBaLineal();
+   const unsigned char * a_srgb       = TablaLinealASRGB();
+   const PesosRemuestreo ph           = CrearPesosRemuestreo( nivel.ancho, ancho ),
+                         pv           = CrearPesosRemuestreo( nivel.alto, alto );
+
+   // 1. horizontal: cada fila original se remuestrea a 'ancho' texels (en colores lineales)
+   std::vector<float> horiz( std::size_t( ancho )*nivel.alto*3 );
+   reserva->paraCada( (nivel.alto + filas_bloque-1)/filas_bloque, [&]( unsigned b )
+   {
+      for( unsigned y = b*filas_bloque ; y < std::min( nivel.alto, (b+1)*filas_bloque ) ; y++ )
+      {
+         const unsigned char * fila = nivel.texels.data() + std::size_t( y )*nivel.ancho*3 ;
+         float *               dst  = horiz.data() + std::size_t( y )*ancho*3 ;
+         for( unsigned j = 0 ; j < ancho ; j++ )
+            for( unsigned k = 0 ; k < ph.indices[j].size() ; k++ )
+            {  const unsigned char * t = fila + ph.indices[j][k]*3 ;
+               dst[3*j+0] += ph.pesos[j][k]*a_lineal[t[0]] ;
+               dst[3*j+1] += ph.pesos[j][k]*a_lineal[t[1]] ;
+               dst[3*j+2] += ph.pesos[j][k]*a_lineal[t[2]] ;
+            }
+      }
+   });
+
+   // 2. vertical: cada fila remuestreada es una combinación de filas de 'horiz'
+   NivelMipmap       res { .ancho = ancho, .alto = alto, .formato = FormatoTexels::rgb, 
+                           .texels = std::vector<unsigned char>( std::size_t( ancho )*alto*3 ) };
+   const std::size_t n = std::size_t( ancho )*3 ;
+   reserva->paraCada( (alto + filas_bloque-1)/filas_bloque, [&]( unsigned b )
+   {
+      std::vector<float> fila( n );
+      for( unsigned i = b*filas_bloque ; i < std::min( alto, (b+1)*filas_bloque ) ; i++ )
+      {
+         std::fill( fila.begin(), fila.end(), 0.0f );
+         for( unsigned k = 0 ; k < pv.indices[i].size() ; k++ )
+            AcumularFila( fila.data(), horiz.data() + pv.indices[i][k]*n, pv.pesos[i][k], n );
+         for( std::size_t c = 0 ; c < n ; c++ )
+            res.texels[i*n+c] = LinealASRGB( fila[c], a_srgb );
+      }
+   });
+   return res ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::size_t BytesCadena( const CadenaMipmaps & cadena )
+{
+   std::size_t bytes = 0 ;
+   for( const NivelMipmap & nivel : cadena )
+      bytes += nivel.texels.size() ;
+   return bytes ;
+}
+
+// ------------------------------------------------------------------------------------------------------
+// archivo de caché: cabecera (identificación del formato, del filtro y de la imagen original) y después
+// el ancho, el alto y los texels de cada nivel
+
+constexpr char tipo_archivo[8] = { 'P','C','G','M','I','P','S','2' };
+
+struct CabeceraCacheMipmaps
+{
+   char          tipo[8] ;
+   std::uint32_t filtro ;
+   std::uint32_t formato ;
+   std::uint32_t num_niveles ;
+   std::uint32_t reservado ;     // (para que la cabecera no tenga relleno)
+   std::uint64_t tam_imagen ;    // tamaño en bytes del archivo de la imagen
+   std::int64_t  fecha_imagen ;  // fecha de modificación del archivo de la imagen
+} ;
+
+// cabecera esperada para la imagen (devuelve 'false' si no se puede leer la información del archivo)
+
+static bool CabeceraImagen( const std::string & ruta_imagen, const FiltroMipmaps filtro, const FormatoTexels formato,
+                            CabeceraCacheMipmaps & cab )
+{
+   namespace fs = std::filesystem ;
+   std::error_code error ;
+
+   std::memcpy( cab.tipo, tipo_archivo, sizeof( tipo_archivo ));
+   cab.filtro       = std::uint32_t( filtro );
+   cab.formato      = std::uint32_t( formato );
+   cab.num_niveles  = 0 ;
+   cab.reservado    = 0 ;
+   cab.tam_imagen   = fs::file_size( ruta_imagen, error );
+   if ( error )
+      return false ;
+   cab.fecha_imagen = fs::last_write_time( ruta_imagen, error ).time_since_epoch().count() ;
+   return ! error ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+static std::string RutaCache( const std::string & ruta_imagen, const FormatoTexels formato, const std::string & variante )
+{
+   const std::string base = variante.empty() ? ruta_imagen : ruta_imagen + "." + variante ;
+   if ( formato == FormatoTexels::rgb )
+      return base + ".mips" ;
+   return base + "." + NombreFormato( formato ) + ".mips" ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool LeerCacheMipmaps( const std::string & ruta_imagen, const FiltroMipmaps filtro, const FormatoTexels formato,
+                       CadenaMipmaps & cadena, const unsigned primer_nivel, const std::string & variante )
+{
+   ZONA_PERFIL_CPU( "LeerCacheMipmaps" );
+   CabeceraCacheMipmaps esperada, leida ;
+   if ( ! CabeceraImagen( ruta_imagen, filtro, formato, esperada ) )
+      return false ;
+
+   std::ifstream arch( RutaCache( ruta_imagen, formato, variante ), std::ios::binary );
+   if ( ! arch.read( reinterpret_cast<char *>( &leida ), sizeof( leida )) )
+      return false ;
+   if ( std::memcmp( leida.tipo, esperada.tipo, sizeof( leida.tipo )) != 0 || leida.filtro != esperada.filtro ||
+        leida.formato != esperada.formato ||
+        leida.tam_imagen != esperada.tam_imagen || leida.fecha_imagen != esperada.fecha_imagen ||
+        leida.num_niveles == 0 || leida.num_niveles > 32 )
+      return false ;
+
+   cadena.clear();
+   for( unsigned i = 0 ; i < leida.num_niveles ; i++ )
+   {
+      std::uint32_t tam[2] ;
+      if ( ! arch.read( reinterpret_cast<char *>( tam ), sizeof( tam )) || tam[0] == 0 || tam[1] == 0 )
+         return false ;
+      NivelMipmap nivel { .ancho = tam[0], .alto = tam[1], .formato = formato, .texels = {} };
+      if ( i < std::min( primer_nivel, leida.num_niveles-1 ) )
+      {  if ( ! arch.seekg( nivel.numFilas()*nivel.bytesFila(), std::ios::cur ) )
+            return false ;
+         continue ;
+      }
+      nivel.texels.resize( nivel.numFilas()*nivel.bytesFila() );
+      if ( ! arch.read( reinterpret_cast<char *>( nivel.texels.data() ), nivel.texels.size() ))
+         return false ;
+      cadena.push_back( std::move( nivel ) );
+   }
+   return true ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool EscribirCacheMipmaps( const std::string & ruta_imagen, const FiltroMipmaps filtro, const CadenaMipmaps & cadena,
+                           const std::string & variante )
+{
+   CabeceraCacheMipmaps cab ;
+   if ( cadena.empty() || ! CabeceraImagen( ruta_imagen, filtro, cadena[0].formato, cab ) )
+      return false ;
+   cab.num_niveles = cadena.size() ;
+
+   // se escribe en un archivo temporal que después se renombra, para que otra ejecución
+   // que lea la caché a la vez nunca encuentre un archivo a medio escribir
+   const std::string ruta_cache = RutaCache( ruta_imagen, cadena[0].formato, variante ),
+                     ruta_temp  = ruta_cache + ".tmp" ;
+   std::error_code   error ;
+   {
+      std::ofstream arch( ruta_temp, std::ios::binary );
+      arch.write( reinterpret_cast<const char *>( &cab ), sizeof( cab ));
+      for( const NivelMipmap & nivel : cadena )
+      {  const std::uint32_t tam[2] = { nivel.ancho, nivel.alto };
+         arch.write( reinterpret_cast<const char *>( tam ), sizeof( tam ));
+         arch.write( reinterpret_cast<const char *>( nivel.texels.data() ), nivel.texels.size() );
+      }
+      if ( ! arch )
+      {  arch.close();
+         std::filesystem::remove( ruta_temp, error );
+         return false ;
+      }
+   }
+   std::filesystem::rename( ruta_temp, ruta_cache, error );
+   return ! error ;
+}
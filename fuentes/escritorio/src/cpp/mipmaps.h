@@ -0,0 +1,122 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Generación de mipmaps en la CPU y caché en disco (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de:
+// **
+// **  + FormatoTexels:  formato de los texels (RGB sin comprimir, o bloques BC1 o BC7)
+// **  + NivelMipmap:    texels de un nivel de mipmap
+// **  + FiltroMipmaps:  filtro usado para reducir cada nivel al siguiente
+// **  + funciones para generar la cadena de mipmaps de una imagen y para leerla o
+// **    escribirla en un archivo de caché junto a la imagen
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Formato de los texels de un nivel de mipmap
+///
+enum class FormatoTexels
+{
+   rgb ,   ///< 3 bytes por texel, por filas
+   bc1 ,   ///< bloques de 4x4 texels comprimidos en 8 bytes (0.5 bytes por texel), ver 'compresion-bc.h'
+   bc7     ///< bloques de 4x4 texels comprimidos en 16 bytes (1 byte por texel), ver 'compresion-bc.h'
+} ;
+
+/// @brief Nombre del formato ("rgb", "bc1" o "bc7")
+const char * NombreFormato( const FormatoTexels formato );
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Un nivel de una cadena de mipmaps: texels (en sRGB) en el formato 'formato', por filas
+/// @brief de texels o de bloques
+///
+struct NivelMipmap
+{
+   unsigned                   ancho   = 0 ,
+                              alto    = 0 ;
+   FormatoTexels              formato = FormatoTexels::rgb ;
+   std::vector<unsigned char> texels ;
+
+   /// @brief Texels de alto de cada fila de 'texels' (1 sin comprimir, 4 con bloques)
+   unsigned altoFila() const { return formato == FormatoTexels::rgb ? 1 : 4 ; }
+
+   /// @brief Número de filas (de texels o de bloques) y bytes de cada una
+   unsigned    numFilas()  const { return (alto + altoFila()-1)/altoFila() ; }
+   std::size_t bytesFila() const ;
+} ;
+
+/// @brief Cadena de mipmaps: el nivel 0 es la imagen completa, cada nivel tiene la mitad de
+/// @brief columnas y filas que el anterior (al menos una), hasta el nivel de 1x1
+using CadenaMipmaps = std::vector<NivelMipmap> ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Filtro usado para calcular cada nivel a partir del anterior
+///
+enum class FiltroMipmaps
+{
+   caja ,   ///< media de 2x2 texels (como 'glGenerateMipmap' en la mayoría de los drivers)
+   kaiser   ///< 'sinc' con ventana de Kaiser, de 8x8 texels (más nítido, sin 'aliasing')
+} ;
+
+// --------------------------------------------------------------------------------------------
+/// @brief Añade a la cadena (que debe tener solo el nivel 0, en RGB) el resto de niveles. El filtrado se hace
+/// @brief con colores lineales (los texels se convierten desde sRGB y se vuelven a convertir al final),
+/// @brief y las filas de cada nivel se reparten entre las hebras de la reserva de hebras.
+///
+void GenerarMipmaps( CadenaMipmaps & cadena, const FiltroMipmaps filtro );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Devuelve una copia de un nivel RGB con 'ancho' x 'alto' texels (se amplía o reduce cada eje por
+/// @brief separado, con un filtro triángulo en colores lineales y repetición en los bordes)
+///
+NivelMipmap RemuestrearNivel( const NivelMipmap & nivel, const unsigned ancho, const unsigned alto );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Devuelve el número total de bytes de los texels de todos los niveles de una cadena
+///
+std::size_t BytesCadena( const CadenaMipmaps & cadena );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Lee la cadena de mipmaps en el formato 'formato' del archivo de caché de la imagen en 'ruta_imagen'
+/// @brief (con 'path'). Devuelve 'false' si no hay caché o si no es válida: se ha generado con otro filtro,
+/// @brief o la imagen ha cambiado después (su tamaño o su fecha de modificación no coinciden).
+/// @brief Si 'primer_nivel' es mayor que 0, se saltan los primeros niveles y la cadena empieza en ese.
+/// @brief 'variante' distingue cadenas obtenidas de otra forma de la misma imagen (p.ej. "capa" para la
+/// @brief imagen remuestreada a una capa de un arreglo de texturas), vacía para la cadena de la imagen.
+///
+bool LeerCacheMipmaps( const std::string & ruta_imagen, const FiltroMipmaps filtro, const FormatoTexels formato,
+                       CadenaMipmaps & cadena, const unsigned primer_nivel = 0, const std::string & variante = "" );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Escribe la cadena de mipmaps en el archivo de caché de la imagen en 'ruta_imagen' (el nombre
+/// @brief de la imagen seguido de '.mips', o de '.bc1.mips' o '.bc7.mips' si los niveles están comprimidos,
+/// @brief en la misma carpeta, con '.'+'variante' antes de la extensión si 'variante' no está vacía). Devuelve
+/// @brief 'false' si no se ha podido escribir (p.ej. si la carpeta es de solo lectura), en ese caso no hay
+/// @brief caché pero no es un error.
+///
+bool EscribirCacheMipmaps( const std::string & ruta_imagen, const FiltroMipmaps filtro, const CadenaMipmaps & cadena,
+                           const std::string & variante = "" );
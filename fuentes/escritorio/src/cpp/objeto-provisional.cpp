@@ -0,0 +1,88 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Objeto provisional, mientras se carga otro (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include "aplic-3d.h"
+#include "objeto-provisional.h"
+
+// ******************************************************************************************************
+// ObjetoProvisional
+// ------------------------------------------------------------------------------------------------------
+
+ObjetoProvisional::ObjetoProvisional( const std::string & descripcion )
+{
+   ponerNombre( "Sin crear todavía: " + descripcion );
+   ponerIdentificador( 0 ); // no seleccionable
+}
+// ------------------------------------------------------------------------------------------------------
+
+ObjetoProvisional::~ObjetoProvisional()
+{
+   delete dvao ;
+   dvao = nullptr ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ObjetoProvisional::visualizarGL()
+{
+   Cauce3D *  cauce    = Aplicacion3D::instancia()->cauce3D() ;
+   const bool eval_mil = cauce->leerEvalMIL() ;
+
+   cauce->fijarEvalMIL( false );
+   cauce->fijarEvalText( false );
+   cauce->pushColor();
+   cauce->fijarColor( 0.6, 0.6, 0.6 );
+
+   visualizarGeomGL();
+
+   cauce->popColor();
+   cauce->fijarEvalMIL( eval_mil );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ObjetoProvisional::visualizarGeomGL()
+{
+   using namespace std ;
+   using namespace glm ;
+
+   if ( dvao == nullptr )
+   {
+      // vértices de la caja: el bit 0 de 'i' da la X, el bit 1 la Y, y el bit 2 la Z
+      vector<vec3> vertices ;
+      for( unsigned i = 0 ; i < 8 ; i++ )
+         vertices.push_back({ (i & 1) ? +1.0f : -1.0f, (i & 2) ? +1.0f : -1.0f, (i & 4) ? +1.0f : -1.0f });
+
+      // aristas: unen los vértices que se diferencian en un solo bit
+      vector<unsigned> aristas ;
+      for( unsigned i = 0 ; i < 8 ; i++ )
+         for( unsigned bit = 1 ; bit < 8 ; bit *= 2 )
+            if ( (i & bit) == 0 )
+            {  aristas.push_back( i );
+               aristas.push_back( i | bit );
+            }
+
+      constexpr unsigned num_atribs = 1 ;
+      dvao = new DescrVAO( num_atribs, new DescrVBOAtribs( ind_atrib_posiciones, std::move( vertices ) ));
+      dvao->agregar( new DescrVBOInds( std::move( aristas ) ));
+   }
+
+   dvao->draw( GL_LINES );
+}
@@ -0,0 +1,63 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Objeto provisional, mientras se carga otro (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de la clase
+// **
+// **  + ObjetoProvisional: caja de aristas que se visualiza en lugar de un objeto
+// **                       que se está creando en segundo plano
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <string>
+#include "objeto-visu.h"
+#include "vaos-vbos.h"
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Objeto que ocupa el sitio de otro mientras este no está creado (se crea en otra hebra 
+/// @brief al seleccionarlo, ver 'ColeccionObjs::agregarDiferido'). Se visualiza como las aristas de la caja
+/// @brief [-1,1]^3 (la mayoría de los objetos de las colecciones caben en ella), sin iluminación.
+///
+class ObjetoProvisional : public ObjetoVisu3D
+{
+   public:
+
+   /// @brief Crea el objeto, su nombre indica qué objeto sustituye
+   ObjetoProvisional( const std::string & descripcion );
+
+   /// @brief Destruye el VAO de la caja, si se ha creado
+   virtual ~ObjetoProvisional();
+
+   /// @brief Visualiza las aristas de la caja con un color gris, sin iluminación ni texturas
+   virtual void visualizarGL() override ;
+
+   /// @brief Visualiza las aristas de la caja (con el color actual del cauce)
+   virtual void visualizarGeomGL() override ;
+
+   /// @brief No tiene normales ni es seleccionable: no dibuja nada
+   virtual void visualizarNormalesGL() override {}
+   virtual void visualizarModoSeleccionGL() override {}
+
+   private:
+
+   DescrVAO * dvao = nullptr ; // VAO con los vértices y las aristas de la caja (se crea al visualizar)
+} ;
@@ -28,6 +28,7 @@
 #include "aplic-base.h"  
 #include "colecciones-objs.h"
 #include "seleccion.h"
+#include "hebra-simulacion.h"
 #include "camara.h"
 
 using namespace std ;
@@ -76,11 +77,44 @@ void ObjetoVisu::destruirPendientes()
       //cout << "  -->hecho delete "<< i << "/" << n << endl << flush ;
       i++ ;
    }
+   pendientes_destr.clear(); // (se puede volver a llamar)
    cout << "Destruidos " << n << " objetos de tipo 'ObjetoVisu' pendientes de destrucción" << endl << flush ;
 }
 
 // -----------------------------------------------------------------------------
 
+void ObjetoVisu::destruirAhora( ObjetoVisu * objeto )
+{
+   assert( objeto != nullptr );
+
+   // recopilar el objeto y sus sub-objetos en un conjunto de pendientes vacío
+   std::set<ObjetoVisu *> previos, a_destruir ;
+   std::swap( previos, pendientes_destr );
+   objeto->pendienteDestruccion();
+   std::swap( a_destruir, pendientes_destr );
+   std::swap( previos, pendientes_destr );
+
+   for( ObjetoVisu * p : a_destruir )
+      if ( pendientes_destr.count( p ) == 0 )
+         delete p ;
+}
+// -----------------------------------------------------------------------------
+
+void ObjetoVisu::acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const 
+{
+   // por defecto un objeto no tiene tablas ni recursos en la GPU
+}
+// -----------------------------------------------------------------------------
+
+UsoMemoria ObjetoVisu::leerUsoMemoria() const 
+{
+   UsoMemoria            uso ;
+   std::set<const void *> contados ;
+   acumularUsoMemoria( uso, contados );
+   return uso ;
+}
+// -----------------------------------------------------------------------------
+
 std::string ObjetoVisu::leerNombre() const 
 {
    return nombre_obj ;
@@ -267,6 +301,53 @@ void ObjetoVisu::actualizarEstado( const float dtSec )
    }
 }
 
+// -----------------------------------------------------------------------------
+// Pone el estado visible en el instante desplazado 'dtSec' respecto del de cada 
+// parámetro (los tiempos de los parámetros no cambian)
+
+void ObjetoVisu::fijarEstadoDesplazado( const float dtSec )
+{
+   initTP();
+   for( unsigned i = 0 ; i < leerNumParametros() ; i++  )
+      actualizarEstadoParametro( i, tiempo_par_sec[i] + dtSec );
+}
+
+// -----------------------------------------------------------------------------
+// Avanza el tiempo de cada parámetro, sin actualizar el estado
+
+void ObjetoVisu::avanzarTiempoParametros( const float dtSec )
+{
+   initTP();
+   for( float & t : tiempo_par_sec )
+      t += dtSec ;
+}
+
+// -----------------------------------------------------------------------------
+// Devuelve los tiempos de los parámetros, o los cambia sin actualizar el estado
+
+const std::vector<float> & ObjetoVisu::leerTiemposParametros()
+{
+   initTP();
+   return tiempo_par_sec ;
+}
+
+void ObjetoVisu::fijarTiemposParametros( const std::vector<float> & tiempos )
+{
+   initTP();
+   assert( tiempos.size() == tiempo_par_sec.size() );
+   tiempo_par_sec = tiempos ;
+}
+
+// -----------------------------------------------------------------------------
+// Pone el estado visible en el de una instantánea de la simulación en otra hebra
+
+void ObjetoVisu::aplicarInstantanea( const InstantaneaSimulacion & inst )
+{
+   assert( inst.tiempos.size() == leerNumParametros() );
+   for( unsigned i = 0 ; i < inst.tiempos.size() ; i++ )
+      actualizarEstadoParametro( i, inst.tiempos[i] );
+}
+
 // -----------------------------------------------------------------------------
 // Pone los valores de los parámetros a cero (estado inicial)
 
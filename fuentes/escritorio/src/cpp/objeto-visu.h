@@ -29,6 +29,9 @@
 #include <vector>
 #include <glm/glm.hpp>
 #include <texturas.h>
+#include <uso-memoria.h>
+
+struct InstantaneaSimulacion ;
 
 
 // ------------------------------------------------------------------------------------
@@ -161,6 +164,39 @@ class ObjetoVisu
       //
       void actualizarEstado( const float dtSec );
 
+      // pone el estado visible del objeto en el instante desplazado 'dtSec' segundos respecto
+      // del tiempo de cada parámetro, sin cambiar esos tiempos (para interpolar entre dos pasos
+      // de la simulación, el siguiente 'actualizarEstado' parte del tiempo sin desplazar)
+      //
+      void fijarEstadoDesplazado( const float dtSec );
+
+      // avanza 'dtSec' segundos el tiempo de cada parámetro, sin actualizar el estado (el estado
+      // es función del tiempo, se actualiza después con 'fijarEstadoDesplazado')
+      //
+      void avanzarTiempoParametros( const float dtSec );
+
+      // devuelve los tiempos de los parámetros, o los cambia sin actualizar el estado
+      // (se usan al iniciar y al detener la simulación en otra hebra)
+      //
+      const std::vector<float> & leerTiemposParametros() ;
+      void fijarTiemposParametros( const std::vector<float> & tiempos );
+
+      // ----------------------------------------------------------------------
+      // métodos para simular las animaciones en otra hebra (ver 'HebraSimulacion')
+
+      // se llama en la hebra principal antes de iniciar la simulación en otra hebra, para 
+      // crear lo que necesite 'calcularInstantanea' (por defecto no hace nada)
+      virtual void prepararInstantaneas() {}
+
+      // se llama en la hebra de simulación, con los tiempos de 'inst' ya fijados: puede añadir a 
+      // 'inst' datos calculados a partir de esos tiempos, pero no puede usar OpenGL ni modificar
+      // nada que se use al visualizar el objeto (por defecto no añade nada)
+      virtual void calcularInstantanea( InstantaneaSimulacion & inst ) {}
+
+      // se llama en la hebra principal: pone el estado visible del objeto en el de 'inst' 
+      // (por defecto llama a 'actualizarEstadoParametro' con el tiempo de cada parámetro)
+      virtual void aplicarInstantanea( const InstantaneaSimulacion & inst );
+
       // ----------------------------------------------------------------------
       // métodos relativos al punto central del objeto (para selección).
 
@@ -180,6 +216,18 @@ class ObjetoVisu
       // añadir un puntero a este objeto a la lista de objetos pendientes de destruir (si no está ya)
       virtual void pendienteDestruccion();
 
+      // ----------------------------------------------------------------------
+      // métodos relativos a la memoria ocupada por el objeto
+
+      // suma a 'uso' la memoria ocupada por este objeto y por los objetos, VAOs y texturas que 
+      // usa, excepto los que ya están en 'contados' (que se añaden al conjunto, así un recurso 
+      // compartido se cuenta una vez). Por defecto no suma nada (redefinir en clases derivadas).
+      //
+      virtual void acumularUsoMemoria( UsoMemoria & uso, std::set<const void *> & contados ) const ;
+
+      // devuelve la memoria ocupada por este objeto y todo lo que usa (llama a 'acumularUsoMemoria')
+      UsoMemoria leerUsoMemoria() const ;
+
       // ----------------------------------------------------------------------
       // método para buscar un objeto (o subobjeto) con un identificador y devolver
       // un puntero al objeto y el punto central
@@ -202,6 +250,11 @@ class ObjetoVisu
       /// @brief destruye todos los objetos de la clase 'ObjetoVisu' que estén pendientes de destruir
       static void destruirPendientes();
 
+      /// @brief destruye ya un objeto y los sub-objetos que añade su método 'pendienteDestruccion'
+      /// @brief (excepto los que ya estaban pendientes de destruir, que se destruyen al final). Solo
+      /// @brief se puede usar si ningún otro objeto usa el objeto o sus sub-objetos.
+      static void destruirAhora( ObjetoVisu * objeto );
+
    protected: 
       // lista de objetos pendientes de destruir
       static std::set<ObjetoVisu *> pendientes_destr ;
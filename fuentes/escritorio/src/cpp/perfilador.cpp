@@ -0,0 +1,290 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Perfilador de zonas de código en la CPU y la GPU (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <chrono>
+#include "utilidades.h"
+#include "perfilador.h"
+#include "rasterizador-cpu.h"
+
+// ******************************************************************************************************
+// Perfilador
+// ------------------------------------------------------------------------------------------------------
+
+Perfilador * Perfilador::instancia()
+{
+   static Perfilador perfilador ;
+   return &perfilador ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+int64_t Perfilador::instanteNs()
+{
+   using namespace std::chrono ;
+   return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+BufferEventosHebra * Perfilador::bufferHebra()
+{
+   // cada hebra guarda un puntero a su buffer, que es del perfilador (así se puede leer
+   // aunque la hebra haya terminado)
+   static thread_local BufferEventosHebra * buffer = nullptr ;
+
+   if ( buffer == nullptr )
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      buffers.push_back( std::make_unique<BufferEventosHebra>() );
+      buffer            = buffers.back().get() ;
+      buffer->num_hebra = buffers.size() ;
+      buffer->nombre    = "hebra " + std::to_string( buffer->num_hebra );
+      buffer->eventos   = std::make_unique<RanuraEventoPerfil[]>( BufferEventosHebra::capacidad );
+   }
+   return buffer ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::nombrarHebra( const std::string & nombre )
+{
+   BufferEventosHebra * buffer = bufferHebra() ;
+   std::lock_guard<std::mutex> bloqueo( mutex );
+   buffer->nombre = nombre ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void BufferEventosHebra::escribir( const EventoPerfil & evento )
+{
+   // el evento se escribe antes de incrementar el contador, así quien lo lee después de leer el 
+   // contador lee el evento completo. La barrera hace que quien lea algún campo del evento 'i' 
+   // lea después en el contador al menos 'i': así sabe que la posición se estaba sobrescribiendo
+   const uint64_t       i      = num_escritos.load( std::memory_order_relaxed );
+   RanuraEventoPerfil & ranura = eventos[ i % capacidad ] ;
+
+   std::atomic_thread_fence( std::memory_order_release );
+   ranura.nombre.store( evento.nombre, std::memory_order_relaxed );
+   ranura.inicio_ns.store( evento.inicio_ns, std::memory_order_relaxed );
+   ranura.fin_ns.store( evento.fin_ns, std::memory_order_relaxed );
+   num_escritos.store( i+1, std::memory_order_release );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void BufferEventosHebra::leer( const uint64_t desde, const uint64_t hasta, std::vector<EventoPerfil> & copia ) const 
+{
+   const std::size_t primero = copia.size() ;
+   for( uint64_t i = desde ; i < hasta ; i++ )
+   {  const RanuraEventoPerfil & ranura = eventos[ i % capacidad ] ;
+      copia.push_back( { ranura.nombre.load( std::memory_order_relaxed ), 
+                         ranura.inicio_ns.load( std::memory_order_relaxed ), 
+                         ranura.fin_ns.load( std::memory_order_relaxed ) } );
+   }
+
+   // mientras se copiaba, la hebra dueña ha podido empezar a escribir hasta el evento 'n' (incluido), 
+   // que ocupa la posición del 'n-capacidad': solo valen los eventos posteriores a ese
+   std::atomic_thread_fence( std::memory_order_acquire );
+   const uint64_t n = num_escritos.load( std::memory_order_relaxed );
+   if ( n >= capacidad && desde <= n-capacidad )
+   {  const std::size_t descartados = std::min<uint64_t>( n-capacidad+1, hasta ) - desde ;
+      copia.erase( copia.begin() + primero, copia.begin() + primero + descartados );
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::registrar( const char * nombre, const int64_t inicio_ns, const int64_t fin_ns )
+{
+   // solo esta hebra escribe en su buffer (sin cerrojos)
+   bufferHebra()->escribir( { nombre, inicio_ns, fin_ns } );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::leerEventosHebra( const int64_t desde_ns, const int64_t hasta_ns, std::vector<EventoPerfil> & eventos )
+{
+   // (los eventos están ordenados por el instante final, se recorren desde el último)
+   BufferEventosHebra * buffer = bufferHebra() ;
+   const uint64_t       n      = buffer->num_escritos.load( std::memory_order_relaxed ),
+                        c      = BufferEventosHebra::capacidad ;
+
+   for( uint64_t i = n ; i > 0 && i + c > n ; i-- )
+   {
+      const RanuraEventoPerfil & ranura = buffer->eventos[ (i-1) % c ] ;
+      const EventoPerfil ev { ranura.nombre.load( std::memory_order_relaxed ), 
+                              ranura.inicio_ns.load( std::memory_order_relaxed ), 
+                              ranura.fin_ns.load( std::memory_order_relaxed ) };
+      if ( ev.fin_ns < desde_ns )
+         break ;
+      if ( ev.fin_ns <= hasta_ns )
+         eventos.push_back( ev );
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::iniciarCaptura( const unsigned num_cuadros, const std::string & nombre_arch )
+{
+   using namespace std ;
+   assert( 0 < num_cuadros );
+
+   if ( capturando() )
+   {  cout << "Ya hay una captura del perfil en curso." << endl ;
+      return ;
+   }
+
+   // relación entre los instantes de la GPU y los de la CPU (para ponerlos en la misma escala),
+   // con el rasterizador por software no hay contexto de OpenGL, ni zonas de la GPU
+   GLint64 instante_gpu = 0 ;
+   con_gpu = ! RasterizadorCPU::activo() ;
+   if ( con_gpu )
+      glGetInteger64v( GL_TIMESTAMP, &instante_gpu );
+   CError();
+
+   nombre_archivo    = nombre_arch ;
+   cuadros_restantes = num_cuadros ;
+   inicio_captura_ns = instanteNs() ;
+   desplaz_gpu_ns    = inicio_captura_ns - instante_gpu ;
+   zonas_gpu.clear();
+   activo.store( true );
+
+   cout << "Capturando el perfil de " << num_cuadros << " cuadros (" << (PCG_PERFILADOR ? "" : "sin zonas, ")
+        << "se escribirá en '" << nombre_arch << "') ..." << endl ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::inicioCuadro()
+{
+   if ( ! capturando() )
+      return ;
+   if ( cuadros_restantes == 0 )
+      terminarCaptura();
+   else
+      cuadros_restantes-- ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::terminarCaptura()
+{
+   using namespace std ;
+   if ( ! capturando() )
+      return ;
+
+   // las zonas que empiecen a partir de aquí ya no se registran (las que están en curso en
+   // otras hebras sí, pero terminan después del final de la captura y no se escriben)
+   activo.store( false );
+
+   if ( escribirTraza() )
+      cout << "Perfil escrito en '" << nombre_archivo << "' (se puede abrir con 'chrome://tracing' o 'ui.perfetto.dev')." << endl ;
+   else
+      cout << "Error: no se ha podido escribir el perfil en '" << nombre_archivo << "'" << endl ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned Perfilador::iniciarZonaGPU( const char * nombre )
+{
+   if ( ! con_gpu )
+      return zonas_gpu.size() ; // (no hay ninguna, 'terminarZonaGPU' no hace nada)
+
+   ZonaGPUPendiente zona ;
+   zona.nombre = nombre ;
+   for( unsigned & consulta : zona.consultas )
+   {
+      if ( consultas_libres.empty() )
+         glGenQueries( 1, &consulta );
+      else
+      {  consulta = consultas_libres.back() ;
+         consultas_libres.pop_back();
+      }
+   }
+   glQueryCounter( zona.consultas[0], GL_TIMESTAMP );
+   zonas_gpu.push_back( zona );
+   return zonas_gpu.size()-1 ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void Perfilador::terminarZonaGPU( const unsigned indice )
+{
+   // (la captura puede haber terminado mientras la zona estaba en curso)
+   if ( indice < zonas_gpu.size() )
+      glQueryCounter( zonas_gpu[indice].consultas[1], GL_TIMESTAMP );
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool Perfilador::escribirTraza()
+{
+   using namespace std ;
+
+   ofstream arch( nombre_archivo );
+   if ( ! arch.is_open() )
+      return false ;
+
+   const int64_t fin_captura_ns = instanteNs() ;
+   arch << fixed << setprecision( 3 ) ;
+   arch << "{ \"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl ;
+
+   // escribe un evento completo ('X') o el nombre de una hebra ('M'), los instantes en
+   // microsegundos desde el inicio de la captura
+   bool primero = true ;
+   auto escribir_evento = [&]( const char * nombre, const int64_t inicio_ns, const int64_t fin_ns, const unsigned tid, const char * cat )
+   {
+      arch << (primero ? "  " : ", ") << "{ \"name\": \"" << nombre << "\", \"cat\": \"" << cat << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << tid
+           << ", \"ts\": " << double( inicio_ns - inicio_captura_ns )*1e-3 << ", \"dur\": " << double( fin_ns - inicio_ns )*1e-3 << " }" << endl ;
+      primero = false ;
+   };
+   auto escribir_nombre_hebra = [&]( const unsigned tid, const string & nombre )
+   {
+      arch << (primero ? "  " : ", ") << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << tid
+           << ", \"args\": { \"name\": \"" << nombre << "\" } }" << endl ;
+      primero = false ;
+   };
+
+   // eventos de la CPU: los que hay en el buffer de cada hebra dentro de la captura (las 
+   // otras hebras pueden seguir registrando zonas mientras tanto: las que terminan tras la 
+   // captura o con el registro continuo activado)
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      std::vector<EventoPerfil>   copia ;
+      for( const auto & buffer : buffers )
+      {
+         escribir_nombre_hebra( buffer->num_hebra, buffer->nombre );
+         const uint64_t n = buffer->num_escritos.load( memory_order_acquire ),
+                        c = BufferEventosHebra::capacidad ;
+         copia.clear();
+         buffer->leer( n > c ? n-c : 0, n, copia );
+         for( const EventoPerfil & ev : copia )
+            if ( inicio_captura_ns <= ev.inicio_ns && ev.fin_ns <= fin_captura_ns )
+               escribir_evento( ev.nombre, ev.inicio_ns, ev.fin_ns, buffer->num_hebra, "cpu" );
+      }
+   }
+
+   // eventos de la GPU (en una hebra más), se espera a que estén los resultados de las consultas
+   const unsigned tid_gpu = 0 ;
+   escribir_nombre_hebra( tid_gpu, "GPU" );
+   for( const ZonaGPUPendiente & zona : zonas_gpu )
+   {
+      GLuint64 instantes[2] = { 0, 0 } ;
+      for( unsigned j = 0 ; j < 2 ; j++ )
+      {  glGetQueryObjectui64v( zona.consultas[j], GL_QUERY_RESULT, &instantes[j] );
+         consultas_libres.push_back( zona.consultas[j] );
+      }
+      escribir_evento( zona.nombre, int64_t( instantes[0] ) + desplaz_gpu_ns, int64_t( instantes[1] ) + desplaz_gpu_ns, tid_gpu, "gpu" );
+   }
+   zonas_gpu.clear();
+   CError();
+
+   arch << "] }" << endl ;
+   return true ;
+}
@@ -0,0 +1,233 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Perfilador de zonas de código en la CPU y la GPU (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de las clases
+// **
+// **  + Perfilador:  registra, durante un número de cuadros, los intervalos de tiempo de las
+// **                 zonas de código de todas las hebras (y de las zonas de la GPU), y los
+// **                 escribe en un archivo JSON con el formato de trazas de Chrome
+// **  + ZonaCPU:     objeto que registra el intervalo de tiempo entre su creación y su destrucción
+// **  + ZonaGPU:     igual, pero con el tiempo de ejecución en la GPU de las órdenes enviadas
+// **
+// ** y las macros 'ZONA_PERFIL_CPU' y 'ZONA_PERFIL_GPU' (se eliminan compilando con 'PCG_PERFILADOR=0')
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 'PCG_PERFILADOR=0' elimina las zonas del código (las capturas se pueden pedir igual, pero quedan vacías)
+#ifndef PCG_PERFILADOR
+#define PCG_PERFILADOR 1
+#endif
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Intervalo de tiempo de una zona registrado por el perfilador (instantes en nanosegundos
+/// @brief del reloj 'steady_clock'). El nombre debe ser una cadena literal (no se copia).
+///
+struct EventoPerfil
+{
+   const char * nombre    = nullptr ;
+   int64_t      inicio_ns = 0 ,
+                fin_ns    = 0 ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Posición del buffer circular de una hebra: los campos de un evento, atómicos porque otra
+/// @brief hebra los puede leer mientras la dueña los sobrescribe (ver 'BufferEventosHebra::leer')
+///
+struct RanuraEventoPerfil
+{
+   std::atomic<const char *> nombre    { nullptr } ;
+   std::atomic<int64_t>      inicio_ns { 0 } ,
+                             fin_ns    { 0 } ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Eventos de una hebra: buffer circular en el que solo escribe la hebra (sin cerrojos),
+/// @brief cuando está lleno se sobrescriben los eventos más antiguos. Otras hebras pueden leerlo
+/// @brief mientras se escribe: descartan los eventos que la dueña puede haber sobrescrito mientras
+/// @brief los copiaban (como en un 'seqlock', con 'num_escritos' como número de secuencia).
+///
+struct BufferEventosHebra
+{
+   static constexpr unsigned capacidad = 1u << 16 ;
+
+   std::unique_ptr<RanuraEventoPerfil[]> eventos ;   // 'capacidad' eventos, el 'i' se guarda en 'i % capacidad'
+   std::atomic<uint64_t>     num_escritos { 0 } ;   // número de eventos escritos desde que se creó
+   unsigned                  num_hebra = 0 ;        // identificador de la hebra en la traza ('tid')
+   std::string               nombre ;               // nombre de la hebra en la traza
+
+   /// @brief Escribe el evento siguiente (solo la hebra dueña)
+   void escribir( const EventoPerfil & evento );
+
+   /// @brief Copia en 'copia' los eventos del buffer con índices en ['desde','hasta') que siguen en el
+   /// @brief buffer y no se han sobrescrito mientras se copiaban (desde cualquier hebra, sin cerrojos)
+   void leer( const uint64_t desde, const uint64_t hasta, std::vector<EventoPerfil> & copia ) const ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Perfilador de la aplicación (hay una sola instancia). Las zonas solo se registran mientras
+/// @brief hay una captura en curso (o el registro continuo activado), si no cada zona solo lee dos 'std::atomic<bool>'.
+///
+class Perfilador
+{
+   public:
+
+   /// @brief Devuelve el perfilador de la aplicación (lo crea la primera vez)
+   static Perfilador * instancia() ;
+
+   /// @brief Devuelve 'true' si hay una captura en curso
+   static bool capturando() { return activo.load( std::memory_order_relaxed ); }
+
+   /// @brief Devuelve 'true' si las zonas de la CPU se están registrando (durante las capturas o 
+   /// @brief con el registro continuo activado)
+   static bool registrando() { return activo.load( std::memory_order_relaxed ) || continuo.load( std::memory_order_relaxed ); }
+
+   /// @brief Activa o desactiva el registro continuo: las zonas de la CPU se registran también fuera
+   /// @brief de las capturas (en los buffers circulares, no se escriben en ninguna traza)
+   void fijarRegistroContinuo( const bool activar ) { continuo.store( activar ); }
+
+   /// @brief Añade a 'eventos' los eventos de la hebra que llama que terminan en el intervalo 
+   /// @brief ['desde_ns', 'hasta_ns'] y siguen en su buffer
+   void leerEventosHebra( const int64_t desde_ns, const int64_t hasta_ns, std::vector<EventoPerfil> & eventos );
+
+   /// @brief Devuelve el instante actual en nanosegundos ('steady_clock')
+   static int64_t instanteNs() ;
+
+   /// @brief Empieza una captura de 'num_cuadros' cuadros, al terminar se escribe en 'nombre_arch'
+   /// @brief (no hace nada si ya hay una captura en curso). Se debe llamar desde la hebra principal,
+   /// @brief con el contexto OpenGL activo.
+   void iniciarCaptura( const unsigned num_cuadros, const std::string & nombre_arch );
+
+   /// @brief Se llama al inicio de cada cuadro: cuenta los cuadros de la captura en curso, y la
+   /// @brief termina cuando ya se han visualizado todos
+   void inicioCuadro() ;
+
+   /// @brief Termina la captura en curso (si hay alguna) y escribe el archivo de la traza
+   void terminarCaptura() ;
+
+   /// @brief Da nombre a la hebra que llama, en las trazas
+   void nombrarHebra( const std::string & nombre );
+
+   /// @brief Añade un evento al buffer de la hebra que llama
+   void registrar( const char * nombre, const int64_t inicio_ns, const int64_t fin_ns );
+
+   /// @brief Zonas de la GPU: 'iniciarZonaGPU' envía una consulta del instante de inicio y devuelve un
+   /// @brief índice para 'terminarZonaGPU', que envía la del final (solo en la hebra principal)
+   unsigned iniciarZonaGPU( const char * nombre );
+   void     terminarZonaGPU( const unsigned indice );
+
+   private:
+
+   Perfilador() {}
+
+   // devuelve el buffer de la hebra que llama (lo crea la primera vez)
+   BufferEventosHebra * bufferHebra() ;
+
+   // lee los resultados de las consultas de las zonas de la GPU y escribe la traza
+   bool escribirTraza() ;
+
+   // zona de la GPU: consultas 'GL_TIMESTAMP' de inicio y fin
+   struct ZonaGPUPendiente
+   {
+      const char * nombre = nullptr ;
+      unsigned     consultas[2] = { 0, 0 } ;
+   } ;
+
+   static inline std::atomic<bool> activo   { false } ,  // hay una captura en curso
+                                   continuo { false } ;  // registro continuo activado
+
+   std::mutex                                        mutex ;    // protege 'buffers'
+   std::vector<std::unique_ptr<BufferEventosHebra>>  buffers ;  // uno por hebra (no se liberan)
+
+   std::string                   nombre_archivo ;
+   unsigned                      cuadros_restantes = 0 ;
+   int64_t                       inicio_captura_ns = 0 ,
+                                 desplaz_gpu_ns    = 0 ;  // instante de la CPU menos instante de la GPU
+   std::vector<ZonaGPUPendiente> zonas_gpu ;
+   std::vector<unsigned>         consultas_libres ;       // consultas creadas que no se están usando
+   bool                          con_gpu = true ;         // hay contexto de OpenGL (se registran las zonas de la GPU)
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Zona de la CPU: registra el intervalo desde la creación hasta la destrucción del objeto
+/// @brief (si se estaban registrando las zonas al crearlo)
+///
+class ZonaCPU
+{
+   public:
+   ZonaCPU( const char * p_nombre )
+   :  nombre( p_nombre ),
+      inicio_ns( Perfilador::registrando() ? Perfilador::instanteNs() : -1 )
+   {}
+   ~ZonaCPU()
+   {  if ( inicio_ns >= 0 )
+         Perfilador::instancia()->registrar( nombre, inicio_ns, Perfilador::instanteNs() );
+   }
+   private:
+   const char * nombre ;
+   int64_t      inicio_ns ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Zona de la GPU: registra el tiempo en la GPU de las órdenes enviadas desde la creación
+/// @brief hasta la destrucción del objeto (solo en la hebra principal)
+///
+class ZonaGPU
+{
+   public:
+   ZonaGPU( const char * nombre )
+   :  activa( Perfilador::capturando() ),
+      indice( activa ? Perfilador::instancia()->iniciarZonaGPU( nombre ) : 0 )
+   {}
+   ~ZonaGPU()
+   {  if ( activa )
+         Perfilador::instancia()->terminarZonaGPU( indice );
+   }
+   private:
+   bool     activa ;
+   unsigned indice ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+// macros para declarar zonas (el nombre debe ser una cadena literal)
+
+#if PCG_PERFILADOR
+   #define PCG_CONCAT_AUX( a, b ) a##b
+   #define PCG_CONCAT( a, b )     PCG_CONCAT_AUX( a, b )
+   #define ZONA_PERFIL_CPU( nombre ) ZonaCPU PCG_CONCAT( zona_cpu_, __LINE__ )( nombre )
+   #define ZONA_PERFIL_GPU( nombre ) ZonaGPU PCG_CONCAT( zona_gpu_, __LINE__ )( nombre )
+#else
+   #define ZONA_PERFIL_CPU( nombre )
+   #define ZONA_PERFIL_GPU( nombre )
+#endif
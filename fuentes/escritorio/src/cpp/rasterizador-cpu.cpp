@@ -0,0 +1,742 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Rasterizador por software del cauce 3D (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <algorithm>  // std::min, std::max, std::clamp
+#include <cmath>
+#include <fstream>
+#include <glm/gtc/packing.hpp>  // 'unpackHalf1x16'
+#include <glm/gtc/type_ptr.hpp> // 'make_vec2', 'make_vec3', 'make_vec4'
+#include "aplic-3d.h"
+#include "cauce-3d.h"
+#include "vaos-vbos.h"
+#include "mipmaps.h"
+#include "perfilador.h"
+#include "reserva-hebras.h"
+#include "rasterizador-cpu.h"
+
+// vértices que procesa cada tarea de la reserva de hebras
+constexpr unsigned vertices_por_grupo = 1024 ;
+
+// pixels de una fila que se evalúan a la vez al rasterizar (un carril de la unidad vectorial cada uno)
+constexpr unsigned num_carriles = 8 ;
+static_assert( RasterizadorCPU::lado_tesela % num_carriles == 0 );
+
+// resolución del z-buffer para el término constante de 'glPolygonOffset' (24 bits)
+constexpr float resolucion_prof = 1.0f/float( 1 << 24 ) ;
+
+// ------------------------------------------------------------------------------------------------------
+// Tabla de atributos de un VAO tal como está en la memoria de la aplicación (nula si el VAO no la
+// tiene o está deshabilitada, entonces se usa el valor por defecto del atributo)
+
+struct TablaCPU
+{
+   const unsigned char * datos       = nullptr ;
+   GLenum                tipo        = GL_FLOAT ;
+   unsigned              num_comps   = 0 ,
+                         tam_tupla   = 0 ;
+   bool                  normalizado = false ;
+} ;
+
+// ------------------------------------------------------------------------------------------------------
+// Lee la tupla 'iv' de una tabla, convertida a flotantes igual que al leer los atributos en el
+// vertex shader (las componentes que faltan valen 0, excepto la cuarta, que vale 1)
+
+static glm::vec4 LeerAtributo( const TablaCPU & t, const std::size_t iv )
+{
+   glm::vec4 r( 0.0f, 0.0f, 0.0f, 1.0f );
+   const unsigned char * p = t.datos + iv*t.tam_tupla ;
+
+   // entero con o sin signo, normalizado (a [-1,1] o [0,1]) si procede
+   auto entero = [&]( const float valor, const float maximo, const bool con_signo )
+   {  if ( ! t.normalizado )
+         return valor ;
+      return con_signo ? std::max( valor/maximo, -1.0f ) : valor/maximo ;
+   };
+
+   switch( t.tipo )
+   {
+      case GL_FLOAT :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = reinterpret_cast<const float *>( p )[k] ;
+         break ;
+      case GL_DOUBLE :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = float( reinterpret_cast<const double *>( p )[k] );
+         break ;
+      case GL_HALF_FLOAT :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = glm::unpackHalf1x16( reinterpret_cast<const uint16_t *>( p )[k] );
+         break ;
+      case GL_BYTE :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = entero( reinterpret_cast<const int8_t *>( p )[k], 127.0f, true );
+         break ;
+      case GL_UNSIGNED_BYTE :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = entero( p[k], 255.0f, false );
+         break ;
+      case GL_SHORT :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = entero( reinterpret_cast<const int16_t *>( p )[k], 32767.0f, true );
+         break ;
+      case GL_UNSIGNED_SHORT :
+         for( unsigned k = 0 ; k < t.num_comps ; k++ )
+            r[k] = entero( reinterpret_cast<const uint16_t *>( p )[k], 65535.0f, false );
+         break ;
+      case GL_INT_2_10_10_10_REV :
+      {  // tres componentes de 10 bits y una de 2, con signo (la primera en los bits menos significativos)
+         const uint32_t w = *reinterpret_cast<const uint32_t *>( p );
+         for( unsigned k = 0 ; k < 3 ; k++ )
+            r[k] = entero( float( int32_t( w << ( 22 - 10*k ) ) >> 22 ), 511.0f, true );
+         r[3] = entero( float( int32_t( w ) >> 30 ), 1.0f, true );
+         break ;
+      }
+      default :
+         assert( false );
+   }
+   return r ;
+}
+// ------------------------------------------------------------------------------------------------------
+// Muestrea una imagen de textura RGB con filtro bilineal y repetición (como 'GL_REPEAT' y
+// 'GL_LINEAR' en el nivel 0), sin imagen devuelve un gris (como la textura provisional)
+
+static glm::vec3 MuestrearTextura( const NivelMipmap * nivel, const glm::vec2 & ct )
+{
+   if ( nivel == nullptr || nivel->texels.empty() )
+      return glm::vec3( 0.5f );
+   assert( nivel->formato == FormatoTexels::rgb );
+
+   const int   ancho = int( nivel->ancho ),
+               alto  = int( nivel->alto );
+   const float u     = ( ct.s - std::floor( ct.s ) )*float( ancho ) - 0.5f ,
+               v     = ( ct.t - std::floor( ct.t ) )*float( alto  ) - 0.5f ,
+               fu    = std::floor( u ),
+               fv    = std::floor( v ),
+               au    = u - fu ,
+               av    = v - fv ;
+
+   auto texel = [&]( int ix, int iy )
+   {  ix = ( ix + ancho ) % ancho ;
+      iy = ( iy + alto  ) % alto ;
+      const unsigned char * t = nivel->texels.data() + 3*( std::size_t( iy )*ancho + ix );
+      return glm::vec3( t[0], t[1], t[2] )*( 1.0f/255.0f );
+   };
+   const int ix = int( fu ), iy = int( fv );
+   return glm::mix( glm::mix( texel( ix, iy   ), texel( ix+1, iy   ), au ),
+                    glm::mix( texel( ix, iy+1 ), texel( ix+1, iy+1 ), au ), av );
+}
+// ------------------------------------------------------------------------------------------------------
+// Normaliza un vector, dejando el vector nulo como está (en lugar de obtener NaN)
+
+static glm::vec3 Normalizar( const glm::vec3 & v )
+{
+   const float l = glm::length( v );
+   return l > 0.0f ? v/l : v ;
+}
+
+// ******************************************************************************************************
+// Clase RasterizadorCPU
+// ------------------------------------------------------------------------------------------------------
+
+RasterizadorCPU * RasterizadorCPU::instancia()
+{
+   if ( instancia_actual == nullptr )
+      instancia_actual = new RasterizadorCPU();
+   return instancia_actual ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::iniciarCuadro( const unsigned p_ancho, const unsigned p_alto, const glm::vec3 & color_fondo )
+{
+   assert( 0 < p_ancho && 0 < p_alto );
+   ancho     = p_ancho ;
+   alto      = p_alto ;
+   teselas_x = ( ancho + lado_tesela - 1 )/lado_tesela ;
+   teselas_y = ( alto  + lado_tesela - 1 )/lado_tesela ;
+
+   color.assign( std::size_t( ancho )*alto, color_fondo );
+   profundidad.assign( std::size_t( ancho )*alto, 1.0f );
+
+   estados.clear();
+   triangulos.clear();
+   listas.resize( teselas_x*teselas_y );
+   for( auto & lista : listas )
+      lista.clear();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::terminarCuadro()
+{
+   ZONA_PERFIL_CPU( "RasterizadorCPU::terminarCuadro" );
+   if ( triangulos.empty() )
+      return ;
+
+   // cada tesela escribe solo en sus pixels, así que se pueden rasterizar todas a la vez
+   ReservaHebras::instancia()->paraCada( teselas_x*teselas_y, [this]( const unsigned it )
+   {  rasterizarTesela( it );
+   } );
+
+   estados.clear();
+   triangulos.clear();
+   for( auto & lista : listas )
+      lista.clear();
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned RasterizadorCPU::registrarEstado( const Cauce3D & cauce )
+{
+   EstadoRaster est ;
+   est.eval_text         = cauce.eval_text ;
+   est.eval_mil          = cauce.eval_mil ;
+   est.usar_normales_tri = cauce.usar_normales_tri ;
+   est.ka                = cauce.mil_ka ;
+   est.kd                = cauce.mil_kd ;
+   est.ks                = cauce.mil_ks ;
+   est.exp               = cauce.mil_exp ;
+   est.color_luz         = cauce.color_luces ;
+   est.pos_dir_luz_ec    = cauce.pos_dir_luces_ec ;
+   est.pm23_pm33         = glm::vec2( cauce.mat_proyeccion[2][3], cauce.mat_proyeccion[3][3] );
+   est.textura           = textura ;
+   estados.push_back( std::move( est ));
+   return estados.size()-1 ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::procesarVertices( const DescrVAO & dvao, const Cauce3D & cauce, const unsigned num_instancias,
+                                        const unsigned v_ini, const unsigned v_num )
+{
+   using namespace glm ;
+   ZONA_PERFIL_CPU( "RasterizadorCPU::procesarVertices" );
+
+   // tablas de atributos (en la CPU, ya que los VAOs conservan sus datos con el rasterizador activo)
+   auto tabla = [&]( const unsigned index )
+   {  TablaCPU t ;
+      if ( index >= dvao.num_atribs || dvao.dvbo_atributo[index] == nullptr ||
+           ( index > 0 && ! dvao.atrib_habilitado[index] ))
+         return t ;
+      const DescrVBOAtribs * dvbo = dvao.dvbo_atributo[index] ;
+      assert( dvbo->data != nullptr );
+      t.datos       = static_cast<const unsigned char *>( dvbo->data );
+      t.tipo        = dvbo->type ;
+      t.num_comps   = dvbo->size ;
+      t.normalizado = dvbo->normalizado ;
+      t.tam_tupla   = dvbo->type == GL_INT_2_10_10_10_REV ? 4 :
+                      dvbo->type == GL_DOUBLE ? 8*dvbo->size :
+                      dvbo->type == GL_FLOAT ? 4*dvbo->size :
+                      ( dvbo->type == GL_SHORT || dvbo->type == GL_UNSIGNED_SHORT || dvbo->type == GL_HALF_FLOAT ) ? 2*dvbo->size :
+                      dvbo->size ;
+      return t ;
+   };
+   const TablaCPU t_pos = tabla( ind_atrib_posiciones ),
+                  t_col = tabla( ind_atrib_colores ),
+                  t_ct  = tabla( ind_atrib_coord_text ),
+                  t_nor = tabla( ind_atrib_normales );
+   assert( t_pos.datos != nullptr );
+
+   // matrices de modelado de las instancias (y de sus normales), si el cauce las usa
+   // (igual que en el vertex shader, las de las normales se leen de su tabla por instancia, 
+   // y solo se calculan aquí si el VAO no la tiene)
+   std::vector<mat4> mat_inst ;
+   std::vector<mat3> mat_inst_nor ;
+   if ( cauce.usar_instancias && dvao.num_atribs > ind_atrib_mat_instancia &&
+        dvao.dvbo_atributo[ind_atrib_mat_instancia] != nullptr )
+   {
+      const mat4 * matrices = static_cast<const mat4 *>( dvao.dvbo_atributo[ind_atrib_mat_instancia]->data );
+      mat_inst.assign( matrices, matrices + num_instancias );
+      if ( dvao.num_atribs > ind_atrib_mat_nor_instancia && dvao.dvbo_atributo[ind_atrib_mat_nor_instancia] != nullptr )
+      {  const mat3 * mat_nor = static_cast<const mat3 *>( dvao.dvbo_atributo[ind_atrib_mat_nor_instancia]->data );
+         mat_inst_nor.assign( mat_nor, mat_nor + num_instancias );
+      }
+      else
+         for( const mat4 & m : mat_inst )
+            mat_inst_nor.push_back( transpose( inverse( mat3( m ))));
+   }
+
+   // matrices del cauce (igual que en el vertex shader, pero compuestas una sola vez)
+   const mat4  mat_mv     = cauce.mat_vista*cauce.mat_modelado ;
+   const mat3  mat_mv_nor = mat3( cauce.mat_vista )*mat3( cauce.mat_modelado_nor );
+   const mat4  mat_proy   = cauce.mat_proyeccion ;
+   const vec4  coefs_s    = make_vec4( cauce.coefs_s ),
+               coefs_t    = make_vec4( cauce.coefs_t );
+   const bool  eval_text  = cauce.eval_text ;
+   const int   tipo_gct   = cauce.tipo_gct ;
+   const vec3  color_cauce = cauce.color ;
+
+   vertices.resize( std::size_t( num_instancias )*v_num );
+
+   const unsigned num_grupos = ( vertices.size() + vertices_por_grupo - 1 )/vertices_por_grupo ;
+   ReservaHebras::instancia()->paraCada( num_grupos, [&]( const unsigned ig )
+   {
+      const std::size_t fin = std::min( vertices.size(), std::size_t( ig+1 )*vertices_por_grupo );
+      for( std::size_t i = std::size_t( ig )*vertices_por_grupo ; i < fin ; i++ )
+      {
+         const unsigned inst = i / v_num ,
+                        iv   = v_ini + i % v_num ;
+
+         vec3 posicion_occ( LeerAtributo( t_pos, iv ));
+         if ( dvao.pos_cuantizadas )
+            posicion_occ = dvao.decod_pos_despl + dvao.decod_pos_escala*posicion_occ ;
+         const vec3 posicion_gct = posicion_occ ;  // (la generación de coords. de textura no usa la instancia)
+         vec3 normal_occ = t_nor.datos != nullptr ? vec3( LeerAtributo( t_nor, iv )) : vec3( 0.0f );
+         if ( ! mat_inst.empty() )
+         {  posicion_occ = vec3( mat_inst[inst]*vec4( posicion_occ, 1.0f ));
+            normal_occ   = mat_inst_nor[inst]*normal_occ ;
+         }
+
+         VerticeRecortado & vr  = vertices[i] ;
+         const vec4 posic_ecc  = mat_mv*vec4( posicion_occ, 1.0f );
+         const vec3 normal_ecc = mat_mv_nor*normal_occ ;
+         const vec3 col        = t_col.datos != nullptr ? vec3( LeerAtributo( t_col, iv )) : color_cauce ;
+
+         vec2 coord_text( 0.0f );
+         if ( eval_text )
+         {  if ( tipo_gct == 0 )
+               coord_text = t_ct.datos != nullptr ? vec2( LeerAtributo( t_ct, iv )) : vec2( 0.0f );
+            else
+            {  const vec4 pos_ver = tipo_gct == 1 ? vec4( posicion_gct, 1.0f ) : posic_ecc ;
+               coord_text = vec2( dot( pos_ver, coefs_s ), dot( pos_ver, coefs_t ));
+            }
+         }
+
+         vr.pos = mat_proy*posic_ecc ;
+         for( unsigned k = 0 ; k < 3 ; k++ )
+         {  vr.var[var_posic_ecc+k]  = posic_ecc[k] ;
+            vr.var[var_normal_ecc+k] = normal_ecc[k] ;
+            vr.var[var_color+k]      = col[k] ;
+         }
+         vr.var[var_coord_text]   = coord_text.s ;
+         vr.var[var_coord_text+1] = coord_text.t ;
+      }
+   } );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::dibujar( const DescrVAO & dvao, const GLenum mode, const unsigned inicio, const unsigned num,
+                               const unsigned num_instancias )
+{
+   ZONA_PERFIL_CPU( "RasterizadorCPU::dibujar" );
+   const auto apl3d = Aplicacion3D::instancia() ;
+   const Cauce3D * cauce = apl3d != nullptr ? apl3d->cauce3D() : nullptr ;
+   if ( cauce == nullptr || ancho == 0 || num == 0 || num_instancias == 0 )
+      return ;
+
+   // índice del vértice en la posición 'k' de la secuencia
+   const DescrVBOInds * dvbo_ind = dvao.dvbo_indices ;
+   auto indice = [&]( const unsigned k ) -> unsigned
+   {  if ( dvbo_ind == nullptr )
+         return k ;
+      assert( dvbo_ind->indices != nullptr );
+      switch( dvbo_ind->type )
+      {  case GL_UNSIGNED_BYTE  : return static_cast<const uint8_t  *>( dvbo_ind->indices )[k] ;
+         case GL_UNSIGNED_SHORT : return static_cast<const uint16_t *>( dvbo_ind->indices )[k] ;
+         default                : return static_cast<const uint32_t *>( dvbo_ind->indices )[k] ;
+      }
+   };
+
+   // rango de vértices que usa el dibujo: solo se procesan esos (con 'drawRango' se dibujan 
+   // partes pequeñas de VAOs grandes)
+   const unsigned fin = inicio + num ;
+   unsigned       v_min = inicio, v_max = fin-1 ;
+   if ( dvbo_ind != nullptr )
+   {  v_min = indice( inicio );
+      v_max = v_min ;
+      for( unsigned k = inicio+1 ; k < fin ; k++ )
+      {  const unsigned ik = indice( k );
+         v_min = std::min( v_min, ik );
+         v_max = std::max( v_max, ik );
+      }
+   }
+   assert( v_max < unsigned( dvao.count ));
+   const unsigned v_num = v_max - v_min + 1 ;
+
+   procesarVertices( dvao, *cauce, num_instancias, v_min, v_num );
+   const unsigned estado = registrarEstado( *cauce );
+
+   // ensamblar las primitivas de cada instancia (igual que OpenGL, con los vértices procesados)
+   for( unsigned inst = 0 ; inst < num_instancias ; inst++ )
+   {
+      const VerticeRecortado * vi = vertices.data() + std::size_t( inst )*v_num ;
+      auto v = [&]( const unsigned k ) { return vi + ( indice( k ) - v_min ); };
+
+      switch( mode )
+      {
+         case GL_TRIANGLES :
+            for( unsigned k = inicio ; k+2 < fin ; k += 3 )
+            {  const VerticeRecortado * tri[3] = { v( k ), v( k+1 ), v( k+2 ) };
+               agregarPoligono( tri, 3, estado );
+            }
+            break ;
+         case GL_TRIANGLE_STRIP :
+            for( unsigned k = inicio ; k+2 < fin ; k++ )
+            {  const bool par = ( k - inicio ) % 2 == 0 ;
+               const VerticeRecortado * tri[3] = { v( par ? k : k+1 ), v( par ? k+1 : k ), v( k+2 ) };
+               agregarPoligono( tri, 3, estado );
+            }
+            break ;
+         case GL_TRIANGLE_FAN :
+            for( unsigned k = inicio+1 ; k+1 < fin ; k++ )
+            {  const VerticeRecortado * tri[3] = { v( inicio ), v( k ), v( k+1 ) };
+               agregarPoligono( tri, 3, estado );
+            }
+            break ;
+         case GL_LINES :
+            for( unsigned k = inicio ; k+1 < fin ; k += 2 )
+               agregarSegmento( *v( k ), *v( k+1 ), estado );
+            break ;
+         case GL_LINE_STRIP :
+         case GL_LINE_LOOP :
+            for( unsigned k = inicio ; k+1 < fin ; k++ )
+               agregarSegmento( *v( k ), *v( k+1 ), estado );
+            if ( mode == GL_LINE_LOOP && num > 2 )
+               agregarSegmento( *v( fin-1 ), *v( inicio ), estado );
+            break ;
+         case GL_POINTS :
+            for( unsigned k = inicio ; k < fin ; k++ )
+               agregarSegmento( *v( k ), *v( k ), estado );
+            break ;
+         default :
+            assert( false );
+      }
+   }
+
+   // si hay demasiados triángulos pendientes, rasterizarlos ya (los siguientes se dibujan encima)
+   if ( triangulos.size() > max_triangulos_pendientes )
+      terminarCuadro();
+}
+// ------------------------------------------------------------------------------------------------------
+// Interpola linealmente dos vértices recortados
+
+static VerticeRecortado Interpolar( const VerticeRecortado & a, const VerticeRecortado & b, const float t )
+{
+   VerticeRecortado r ;
+   r.pos = glm::mix( a.pos, b.pos, t );
+   for( unsigned k = 0 ; k < num_var_raster ; k++ )
+      r.var[k] = a.var[k] + t*( b.var[k] - a.var[k] );
+   return r ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+VerticePantalla RasterizadorCPU::proyectar( const VerticeRecortado & vr ) const
+{
+   VerticePantalla vp ;
+   vp.inv_w = 1.0f/vr.pos.w ;
+   vp.x     = ( vr.pos.x*vp.inv_w + 1.0f )*0.5f*float( ancho );
+   vp.y     = ( vr.pos.y*vp.inv_w + 1.0f )*0.5f*float( alto );
+   vp.z     = ( vr.pos.z*vp.inv_w + 1.0f )*0.5f ;
+   for( unsigned k = 0 ; k < num_var_raster ; k++ )
+      vp.var[k] = vr.var[k]*vp.inv_w ;
+   return vp ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::agregarPoligono( const VerticeRecortado * const * vert, const unsigned n, const unsigned estado )
+{
+   assert( n == 3 );
+   using namespace glm ;
+
+   // normal del triángulo en coords. de cámara (la del fragment shader, calculada una vez)
+   auto posic = [&]( const unsigned i ) { return make_vec3( vert[i]->var + var_posic_ecc ); };
+   TrianguloRaster tri ;
+   tri.normal_tri = Normalizar( cross( posic( 1 ) - posic( 0 ), posic( 2 ) - posic( 0 )));
+   tri.estado     = estado ;
+
+   // recortar contra el plano delantero (z >= -w), queda un polígono de hasta 4 vértices
+   VerticeRecortado recortado[4] ;
+   unsigned         num_rec = 0 ;
+   for( unsigned i = 0 ; i < n ; i++ )
+   {
+      const VerticeRecortado & a = *vert[i] ,
+                             & b = *vert[(i+1) % n] ;
+      const float da = a.pos.z + a.pos.w ,
+                  db = b.pos.z + b.pos.w ;
+      if ( da >= 0.0f )
+         recortado[num_rec++] = a ;
+      if ( ( da >= 0.0f ) != ( db >= 0.0f ) )
+         recortado[num_rec++] = Interpolar( a, b, da/( da - db ) );
+   }
+   if ( num_rec < 3 )
+      return ;
+
+   // proyectar y añadir los triángulos del abanico
+   VerticePantalla vp[4] ;
+   for( unsigned i = 0 ; i < num_rec ; i++ )
+      vp[i] = proyectar( recortado[i] );
+
+   for( unsigned i = 1 ; i+1 < num_rec ; i++ )
+   {
+      tri.v[0] = vp[0] ;
+      tri.v[1] = vp[i] ;
+      tri.v[2] = vp[i+1] ;
+
+      // desplazamiento de 'glPolygonOffset(1,1)': máxima pendiente de la profundidad más una unidad
+      const float x1 = tri.v[1].x - tri.v[0].x , y1 = tri.v[1].y - tri.v[0].y , z1 = tri.v[1].z - tri.v[0].z ,
+                  x2 = tri.v[2].x - tri.v[0].x , y2 = tri.v[2].y - tri.v[0].y , z2 = tri.v[2].z - tri.v[0].z ,
+                  area2 = x1*y2 - x2*y1 ;
+      if ( area2 == 0.0f )
+         continue ;
+      const float dzdx = ( z1*y2 - z2*y1 )/area2 ,
+                  dzdy = ( x1*z2 - x2*z1 )/area2 ;
+      tri.despl_prof = std::max( std::abs( dzdx ), std::abs( dzdy )) + resolucion_prof ;
+      agregarTriangulo( tri );
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::agregarSegmento( const VerticeRecortado & a, const VerticeRecortado & b, const unsigned estado )
+{
+   using namespace glm ;
+
+   // recortar contra el plano delantero
+   const float da = a.pos.z + a.pos.w ,
+               db = b.pos.z + b.pos.w ;
+   if ( da < 0.0f && db < 0.0f )
+      return ;
+   const VerticeRecortado ra = da >= 0.0f ? a : Interpolar( a, b, da/( da - db )),
+                          rb = db >= 0.0f ? b : Interpolar( a, b, da/( da - db ));
+   VerticePantalla pa = proyectar( ra ),
+                   pb = proyectar( rb );
+
+   // dirección del segmento en la ventana (un punto es un cuadrado de un pixel de lado)
+   vec2        dir  = vec2( pb.x - pa.x, pb.y - pa.y );
+   const float long_dir = length( dir );
+   if ( long_dir < 1e-6f )
+   {  dir   = vec2( 0.5f, 0.0f );
+      pa.x -= 0.5f ;
+      pb.x += 0.5f ;
+   }
+   else
+      dir *= 0.5f/long_dir ;
+   const vec2 perp( -dir.y, dir.x );
+
+   // rectángulo de un pixel de ancho alrededor del segmento (dos triángulos)
+   VerticePantalla q[4] = { pa, pa, pb, pb };
+   q[0].x -= perp.x ; q[0].y -= perp.y ;
+   q[1].x += perp.x ; q[1].y += perp.y ;
+   q[2].x -= perp.x ; q[2].y -= perp.y ;
+   q[3].x += perp.x ; q[3].y += perp.y ;
+
+   TrianguloRaster tri ;
+   tri.normal_tri = vec3( 0.0f, 0.0f, 1.0f );
+   tri.estado     = estado ;
+   tri.despl_prof = 0.0f ; // (solo se desplazan los rellenos)
+   tri.v[0] = q[0] ; tri.v[1] = q[2] ; tri.v[2] = q[3] ;
+   agregarTriangulo( tri );
+   tri.v[0] = q[0] ; tri.v[1] = q[3] ; tri.v[2] = q[1] ;
+   agregarTriangulo( tri );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::agregarTriangulo( const TrianguloRaster & tri )
+{
+   // caja englobante en pixels (se descarta si está fuera de la imagen)
+   const float xmin = std::min( { tri.v[0].x, tri.v[1].x, tri.v[2].x } ),
+               xmax = std::max( { tri.v[0].x, tri.v[1].x, tri.v[2].x } ),
+               ymin = std::min( { tri.v[0].y, tri.v[1].y, tri.v[2].y } ),
+               ymax = std::max( { tri.v[0].y, tri.v[1].y, tri.v[2].y } );
+   if ( ! ( xmax >= 0.0f && ymax >= 0.0f && xmin < float( ancho ) && ymin < float( alto )))
+      return ; // (también descarta los que tienen coordenadas NaN)
+
+   const unsigned tx0 = unsigned( std::max( xmin, 0.0f ))/lado_tesela ,
+                  ty0 = unsigned( std::max( ymin, 0.0f ))/lado_tesela ,
+                  tx1 = std::min( unsigned( xmax )/lado_tesela, teselas_x-1 ),
+                  ty1 = std::min( unsigned( ymax )/lado_tesela, teselas_y-1 );
+
+   const uint32_t ind = triangulos.size() ;
+   triangulos.push_back( tri );
+   for( unsigned ty = ty0 ; ty <= ty1 ; ty++ )
+      for( unsigned tx = tx0 ; tx <= tx1 ; tx++ )
+         listas[ty*teselas_x + tx].push_back( ind );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RasterizadorCPU::rasterizarTesela( const unsigned it )
+{
+   ZONA_PERFIL_CPU( "RasterizadorCPU::rasterizarTesela" );
+
+   const int tx0 = int( it % teselas_x )*lado_tesela ,
+             ty0 = int( it / teselas_x )*lado_tesela ,
+             tx1 = std::min( tx0 + int( lado_tesela ), int( ancho ) ), // (no incluidos)
+             ty1 = std::min( ty0 + int( lado_tesela ), int( alto ) );
+
+   float var[num_var_raster] ;
+
+   // copia de la profundidad de la tesela (los pixels fuera de la imagen valen 0, así que no pasan
+   // el test de profundidad): los bloques de 'num_carriles' pixels alineados con la tesela leen y
+   // escriben siempre dentro de ella
+   alignas(32) float prof_tesela[lado_tesela*lado_tesela] ;
+   for( int y = 0 ; y < int( lado_tesela ) ; y++ )
+      for( int x = 0 ; x < int( lado_tesela ) ; x++ )
+         prof_tesela[y*lado_tesela + x] = ( tx0+x < tx1 && ty0+y < ty1 )
+                                        ? profundidad[std::size_t( ty0+y )*ancho + tx0+x] : 0.0f ;
+
+   for( const uint32_t ind : listas[it] )
+   {
+      const TrianguloRaster & tri = triangulos[ind] ;
+      const EstadoRaster &    est = estados[tri.estado] ;
+
+      // orden de los vértices en sentido antihorario (el área con signo queda positiva)
+      const VerticePantalla * v[3] = { &tri.v[0], &tri.v[1], &tri.v[2] };
+      float area = ( v[1]->x - v[0]->x )*( v[2]->y - v[0]->y ) - ( v[2]->x - v[0]->x )*( v[1]->y - v[0]->y );
+      if ( area == 0.0f )
+         continue ;
+      if ( area < 0.0f )
+      {  std::swap( v[1], v[2] );
+         area = -area ;
+      }
+      const float inv_area = 1.0f/area ;
+
+      // funciones de arista: e[i](x,y) = a[i]*x + b[i]*y + c[i], positiva a la izquierda de la arista
+      // opuesta al vértice 'i'. Los pixels sobre una arista solo se incluyen si es superior o izquierda
+      // (así los pixels de las aristas compartidas se dibujan una sola vez)
+      float a[3], b[3], c[3] ;
+      bool  incluir_cero[3] ;
+      for( unsigned i = 0 ; i < 3 ; i++ )
+      {
+         const VerticePantalla & p = *v[(i+1) % 3] ,
+                               & q = *v[(i+2) % 3] ;
+         a[i] = -( q.y - p.y );
+         b[i] =    q.x - p.x ;
+         c[i] = -( a[i]*p.x + b[i]*p.y );
+         incluir_cero[i] = q.y < p.y || ( q.y == p.y && q.x < p.x );
+      }
+
+      // pixels de la tesela que pueden estar dentro (centros en x+0.5, y+0.5)
+      const int xmin = std::max( tx0, int( std::floor( std::min( { v[0]->x, v[1]->x, v[2]->x } ))) ),
+                xmax = std::min( tx1, int( std::ceil ( std::max( { v[0]->x, v[1]->x, v[2]->x } ))) ),
+                ymin = std::max( ty0, int( std::floor( std::min( { v[0]->y, v[1]->y, v[2]->y } ))) ),
+                ymax = std::min( ty1, int( std::ceil ( std::max( { v[0]->y, v[1]->y, v[2]->y } ))) );
+
+      const float a0 = a[0], a1 = a[1], a2 = a[2] ,
+                  z0 = v[0]->z*inv_area, z1 = v[1]->z*inv_area, z2 = v[2]->z*inv_area ,
+                  despl = tri.despl_prof ;
+      const int   incl0 = incluir_cero[0], incl1 = incluir_cero[1], incl2 = incluir_cero[2] ;
+
+      // bloques de 'num_carriles' pixels consecutivos de una fila, empezando en un múltiplo de 
+      // 'num_carriles' desde el inicio de la tesela: las funciones de arista, la profundidad y su 
+      // test se evalúan en todos los carriles a la vez sin saltos (el bucle se vectoriza), y después 
+      // se sombrean solo los pixels que han pasado el test
+      const int xb_ini = tx0 + ( ( xmin - tx0 )/int( num_carriles ) )*int( num_carriles );
+      for( int y = ymin ; y < ymax ; y++ )
+      {
+         const float py = float( y ) + 0.5f ,
+                     f0 = b[0]*py + c[0], f1 = b[1]*py + c[1], f2 = b[2]*py + c[2] ;
+
+         for( int xb = xb_ini ; xb < xmax ; xb += int( num_carriles ) )
+         {
+            float * const prof = prof_tesela + ( y - ty0 )*lado_tesela + ( xb - tx0 );
+            alignas(32) float e0[num_carriles], e1[num_carriles], e2[num_carriles] ;
+            alignas(32) int   cubre[num_carriles] ;
+            int               num_cubre = 0 ;
+
+            for( unsigned k = 0 ; k < num_carriles ; k++ )
+            {
+               const float px = float( xb + int( k ) ) + 0.5f ;
+               e0[k] = a0*px + f0 ;
+               e1[k] = a1*px + f1 ;
+               e2[k] = a2*px + f2 ;
+               const int dentro = ( ( e0[k] > 0.0f ) | ( ( e0[k] == 0.0f ) & incl0 ) ) &
+                                  ( ( e1[k] > 0.0f ) | ( ( e1[k] == 0.0f ) & incl1 ) ) &
+                                  ( ( e2[k] > 0.0f ) | ( ( e2[k] == 0.0f ) & incl2 ) ) ;
+
+               // profundidad (lineal en la ventana) y test 'GL_LESS'
+               const float z = e0[k]*z0 + e1[k]*z1 + e2[k]*z2 + despl ;
+               cubre[k]   = dentro & ( 0.0f <= z ) & ( z <= 1.0f ) & ( z < prof[k] ) ;
+               prof[k]    = cubre[k] ? z : prof[k] ;
+               num_cubre += cubre[k] ;
+            }
+            if ( num_cubre == 0 )
+               continue ;
+
+            for( unsigned k = 0 ; k < num_carriles ; k++ )
+            {
+               if ( ! cubre[k] )
+                  continue ;
+
+               // atributos interpolados con corrección de perspectiva (coordenadas baricéntricas en la ventana)
+               const float l0 = e0[k]*inv_area , l1 = e1[k]*inv_area , l2 = e2[k]*inv_area ;
+               const float w  = 1.0f/( l0*v[0]->inv_w + l1*v[1]->inv_w + l2*v[2]->inv_w );
+               for( unsigned j = 0 ; j < num_var_raster ; j++ )
+                  var[j] = ( l0*v[0]->var[j] + l1*v[1]->var[j] + l2*v[2]->var[j] )*w ;
+
+               color[std::size_t( y )*ancho + xb + k] = glm::clamp( sombrear( est, tri, var ), 0.0f, 1.0f );
+            }
+         }
+      }
+   }
+
+   // escribir la profundidad de la tesela
+   for( int y = ty0 ; y < ty1 ; y++ )
+      std::copy( prof_tesela + ( y - ty0 )*lado_tesela, prof_tesela + ( y - ty0 )*lado_tesela + ( tx1 - tx0 ),
+                 profundidad.begin() + std::size_t( y )*ancho + tx0 );
+}
+// ------------------------------------------------------------------------------------------------------
+
+glm::vec3 RasterizadorCPU::sombrear( const EstadoRaster & est, const TrianguloRaster & tri, const float * var ) const
+{
+   using namespace glm ;
+
+   const vec3 color_obj = est.eval_text ? MuestrearTextura( est.textura, make_vec2( var + var_coord_text ))
+                                        : make_vec3( var + var_color );
+   if ( ! est.eval_mil )
+      return color_obj ;
+
+   // vectores hacia el observador y normal (hacia el lado del observador), como en 'EvalMIL'
+   const vec3 posic_ecc = make_vec3( var + var_posic_ecc );
+   const vec3 v = Normalizar( est.pm23_pm33[0]*posic_ecc + vec3( 0.0f, 0.0f, est.pm23_pm33[1] ));
+   vec3       n = est.usar_normales_tri ? tri.normal_tri : Normalizar( make_vec3( var + var_normal_ecc ));
+   if ( dot( n, v ) < 0.0f )
+      n = -n ;
+
+   vec3 col_suma( 0.0f );
+   for( unsigned i = 0 ; i < est.color_luz.size() ; i++ )
+   {
+      col_suma += est.color_luz[i]*color_obj*est.ka ;
+
+      const vec4 & pd = est.pos_dir_luz_ec[i] ;
+      const vec3   l  = Normalizar( pd.w == 1.0f ? vec3( pd ) - posic_ecc : vec3( pd ));
+      const float  nl = dot( n, l );
+      if ( 0.0f < nl )
+      {  const float hn = std::max( 0.0f, dot( n, Normalizar( l + v )));
+         col_suma += est.color_luz[i]*( color_obj*( est.kd*nl ) + std::pow( hn, est.exp )*est.ks );
+      }
+   }
+   return col_suma ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool RasterizadorCPU::escribirPPM( const std::string & nombre_archivo ) const
+{
+   // la primera fila de la imagen es la de abajo (como en OpenGL), en PPM es la de arriba
+   std::ofstream arch( nombre_archivo, std::ios::binary );
+   if ( ! arch.is_open() )
+      return false ;
+   arch << "P6\n" << ancho << " " << alto << "\n255\n" ;
+   std::vector<unsigned char> fila( std::size_t( ancho )*3 );
+   for( int y = int( alto )-1 ; y >= 0 ; y-- )
+   {
+      for( unsigned x = 0 ; x < ancho ; x++ )
+         for( unsigned k = 0 ; k < 3 ; k++ )
+            fila[3*x+k] = (unsigned char)( color[std::size_t( y )*ancho + x][k]*255.0f + 0.5f );
+      arch.write( reinterpret_cast<const char *>( fila.data() ), fila.size() );
+   }
+   return bool( arch );
+}
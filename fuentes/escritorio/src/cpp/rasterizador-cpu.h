@@ -0,0 +1,205 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Rasterizador por software del cauce 3D (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de
+// **
+// **  + VerticeRecortado: vértice procesado, en coordenadas de recortado, con sus atributos
+// **  + VerticePantalla:  vértice proyectado en coordenadas de ventana, con sus
+// **                      atributos divididos por 'w' (para interpolar con perspectiva)
+// **  + TrianguloRaster:  triángulo preparado para rasterizar, con el estado del cauce
+// **                      con el que se ha dibujado
+// **  + RasterizadorCPU:  rasterizador por teselas que hace en la CPU lo mismo que
+// **                      los shaders 'cauce33-3D-vert.glsl' y 'cauce33-3D-frag.glsl'
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "utilidades.h"
+
+class DescrVAO ;
+class Cauce3D ;
+struct NivelMipmap ;
+
+// --------------------------------------------------------------------------------------------
+// atributos que se interpolan en los triángulos ('varyings' de los shaders): posición y normal
+// en coordenadas de cámara, color y coordenadas de textura (el vector al observador se obtiene
+// de la posición en cada pixel)
+
+constexpr unsigned
+   var_posic_ecc     = 0 ,
+   var_normal_ecc    = 3 ,
+   var_color         = 6 ,
+   var_coord_text    = 9 ,
+   num_var_raster    = 11 ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Vértice procesado (la salida del vertex shader): posición en coordenadas de recortado
+/// @brief y atributos que se interpolan
+///
+struct VerticeRecortado
+{
+   glm::vec4 pos ;
+   float     var[num_var_raster] ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Vértice de un triángulo en coordenadas de ventana (en pixels, con la 'y' hacia arriba
+/// @brief igual que en OpenGL), con la profundidad en [0,1], '1/w' y los atributos multiplicados por '1/w'
+///
+struct VerticePantalla
+{
+   float x, y, z, inv_w ;
+   float var[num_var_raster] ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Triángulo listo para rasterizar (los segmentos y puntos se convierten en dos triángulos)
+///
+struct TrianguloRaster
+{
+   VerticePantalla v[3] ;
+   glm::vec3       normal_tri ;  // normal del triángulo en coords. de cámara (para 'usar_normales_tri')
+   unsigned        estado ;      // índice del estado del cauce con el que se ha dibujado
+   float           despl_prof ;  // desplazamiento de la profundidad ('glPolygonOffset' de los rellenos)
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Rasterizador por software: cuando está activo, 'DescrVAO' le pasa los dibujos en lugar de
+/// @brief enviarlos a OpenGL, y se obtiene la imagen en la memoria de la aplicación (para servidores
+/// @brief sin GPU y para comparar imágenes de referencia). Procesa los vértices igual que el vertex
+/// @brief shader del cauce 3D, con el estado del cauce de la aplicación en el momento del dibujo, y
+/// @brief reparte los triángulos en listas por tesela de la imagen. Al terminar el cuadro (o si hay
+/// @brief demasiados triángulos pendientes), las teselas se rasterizan en paralelo en la reserva de
+/// @brief hebras, cada una con sus triángulos en el orden en el que se dibujaron, evaluando en cada
+/// @brief pixel lo mismo que el fragment shader (textura, MIL con hasta 'maxNumFuentesLuz' fuentes).
+///
+class RasterizadorCPU
+{
+   public:
+
+   /// @brief Devuelve el rasterizador de la aplicación (lo crea la primera vez)
+   static RasterizadorCPU * instancia() ;
+
+   /// @brief Activa o desactiva el rasterizador. Se debe activar antes de crear la aplicación:
+   /// @brief mientras está activo no hay contexto de OpenGL (no se llama a ninguna función de OpenGL,
+   /// @brief los cauces solo registran su estado), los VAOs conservan sus tablas en la CPU y no usan el
+   /// @brief almacén de geometría, y las texturas conservan su imagen (ver 'ImagenTextura::leerNivelCPU').
+   static void fijarActivo( const bool nuevo_activo ) { activo_rasterizador = nuevo_activo ; }
+
+   /// @brief Indica si el rasterizador está activo
+   static bool activo() { return activo_rasterizador ; }
+
+   /// @brief Empieza un cuadro de 'ancho' x 'alto' pixels: borra la imagen con 'color_fondo'
+   /// @brief y la profundidad con 1 (como 'glClear'), y descarta lo pendiente
+   void iniciarCuadro( const unsigned p_ancho, const unsigned p_alto, const glm::vec3 & color_fondo );
+
+   /// @brief Rasteriza los triángulos pendientes (se llama al terminar el cuadro, antes de leer la imagen)
+   void terminarCuadro() ;
+
+   /// @brief Procesa un dibujo de un VAO con el estado actual del cauce 3D de la aplicación
+   /// @brief ('inicio' y 'num' son el rango de índices, o de vértices si no es indexado)
+   void dibujar( const DescrVAO & dvao, const GLenum mode, const unsigned inicio, const unsigned num,
+                 const unsigned num_instancias = 1 );
+
+   /// @brief Fija la imagen de textura que se usa cuando el cauce evalúa texturas (nulo si la textura
+   /// @brief todavía no está en la CPU: se usa un gris, como la textura provisional)
+   void fijarTextura( const NivelMipmap * nivel ) { textura = nivel ; }
+
+   /// @brief Escribe la imagen (tras 'terminarCuadro') en un archivo PPM binario
+   /// @return 'true' si se ha podido escribir, 'false' si no
+   bool escribirPPM( const std::string & nombre_archivo ) const ;
+
+   /// @brief Devuelve el tamaño de la imagen en pixels
+   unsigned leerAncho() const { return ancho ; }
+   unsigned leerAlto()  const { return alto ; }
+
+   /// @brief Lado de las teselas en pixels
+   static constexpr unsigned lado_tesela = 64 ;
+
+   private:
+
+   // estado del cauce 3D con el que se ha dibujado un grupo de triángulos (lo que usa el
+   // fragment shader)
+   struct EstadoRaster
+   {
+      bool                   eval_text         = false ,
+                             eval_mil          = false ,
+                             usar_normales_tri = false ;
+      float                  ka = 0.2f , kd = 0.8f , ks = 0.0f , exp = 0.0f ;
+      std::vector<glm::vec3> color_luz ;
+      std::vector<glm::vec4> pos_dir_luz_ec ;
+      glm::vec2              pm23_pm33 = glm::vec2( -1.0f, 0.0f ) ; // de la matriz de proyección (vector al observador)
+      const NivelMipmap *    textura   = nullptr ;
+   } ;
+
+   RasterizadorCPU() = default ;
+
+   // guarda una copia del estado del cauce 3D (y de la textura actual) para los triángulos del
+   // dibujo actual, devuelve su índice en 'estados'
+   unsigned registrarEstado( const Cauce3D & cauce );
+
+   // procesa en paralelo los vértices 'v_ini' a 'v_ini+v_num-1' (los que usa el dibujo) de las
+   // instancias, escribe 'num_instancias*v_num' vértices
+   void procesarVertices( const DescrVAO & dvao, const Cauce3D & cauce, const unsigned num_instancias,
+                          const unsigned v_ini, const unsigned v_num );
+
+   // recorta un polígono contra el plano delantero (w = z) y añade sus triángulos
+   void agregarPoligono( const VerticeRecortado * const * vert, const unsigned n, const unsigned estado );
+
+   // añade un segmento o un punto (extremos iguales) como dos triángulos de un pixel de ancho
+   void agregarSegmento( const VerticeRecortado & a, const VerticeRecortado & b, const unsigned estado );
+
+   // proyecta un vértice recortado a coordenadas de ventana
+   VerticePantalla proyectar( const VerticeRecortado & vr ) const ;
+
+   // añade un triángulo proyectado a las listas de las teselas que cubre su caja englobante
+   void agregarTriangulo( const TrianguloRaster & tri );
+
+   // rasteriza los triángulos de la tesela 'it'
+   void rasterizarTesela( const unsigned it );
+
+   // evalúa el color de un fragmento (el 'fragment shader')
+   glm::vec3 sombrear( const EstadoRaster & est, const TrianguloRaster & tri, const float * var ) const ;
+
+   static inline bool activo_rasterizador = false ;
+   static inline RasterizadorCPU * instancia_actual = nullptr ;
+
+   // máximo de triángulos pendientes antes de rasterizar (para acotar la memoria)
+   static constexpr std::size_t max_triangulos_pendientes = 1 << 18 ;
+
+   unsigned                       ancho = 0 , alto = 0 ,
+                                  teselas_x = 0 , teselas_y = 0 ;
+   std::vector<glm::vec3>         color ;        // imagen (por filas, la primera es la de abajo)
+   std::vector<float>             profundidad ;  // z-buffer
+   std::vector<EstadoRaster>      estados ;      // estados del cauce de los triángulos pendientes
+   std::vector<TrianguloRaster>   triangulos ;   // triángulos pendientes
+   std::vector<std::vector<uint32_t>> listas ;   // para cada tesela, índices de sus triángulos pendientes
+   std::vector<VerticeRecortado>  vertices ;     // vértices procesados del dibujo actual
+   const NivelMipmap *            textura = nullptr ;
+} ;
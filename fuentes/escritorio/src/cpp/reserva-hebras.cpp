@@ -0,0 +1,370 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Reserva de hebras para ejecutar tareas en segundo plano (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cassert>
+#include <algorithm>  // std::max, std::min
+#include "reserva-hebras.h"
+#include "perfilador.h"
+
+// reserva a la que pertenece la hebra que se está ejecutando (nula si no es de ninguna), y su índice
+static thread_local ReservaHebras * reserva_hebra = nullptr ;
+static thread_local unsigned        indice_hebra  = 0 ;
+
+// ******************************************************************************************************
+// ColaRobo
+// (las operaciones sobre 'principio' y 'final' que compiten entre la dueña y los ladrones son
+// 'seq_cst', en lugar de usar barreras sueltas, que las herramientas de análisis no entienden bien)
+// ------------------------------------------------------------------------------------------------------
+
+bool ColaRobo::agregar( TareaReserva * tarea )
+{
+   const int64_t f = final.load( std::memory_order_relaxed ),
+                 p = principio.load( std::memory_order_acquire );
+   if ( f - p >= capacidad )
+      return false ;
+   tareas[f & mascara].store( tarea, std::memory_order_relaxed );
+   final.store( f+1, std::memory_order_release );  // (los ladrones ven la tarea al ver el final)
+   return true ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+TareaReserva * ColaRobo::extraer()
+{
+   // reservar la última tarea antes de mirar el principio: un ladrón que llegue después ya no la ve
+   const int64_t f = final.load( std::memory_order_relaxed ) - 1 ;
+   final.store( f, std::memory_order_seq_cst );
+   int64_t p = principio.load( std::memory_order_seq_cst );
+
+   if ( f < p ) // estaba vacía
+   {  final.store( f+1, std::memory_order_relaxed );
+      return nullptr ;
+   }
+   TareaReserva * tarea = tareas[f & mascara].load( std::memory_order_relaxed );
+   if ( f == p ) // era la única: se la puede llevar un ladrón, gana quien avance el principio
+   {  if ( ! principio.compare_exchange_strong( p, p+1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+         tarea = nullptr ;
+      final.store( f+1, std::memory_order_relaxed );
+   }
+   return tarea ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+TareaReserva * ColaRobo::robar()
+{
+   int64_t       p = principio.load( std::memory_order_seq_cst );
+   const int64_t f = final.load( std::memory_order_seq_cst );
+   if ( f <= p )
+      return nullptr ;
+
+   // la tarea solo es del ladrón si consigue avanzar el principio (si no, otra hebra se la ha llevado)
+   TareaReserva * tarea = tareas[p & mascara].load( std::memory_order_relaxed );
+   if ( ! principio.compare_exchange_strong( p, p+1, std::memory_order_seq_cst, std::memory_order_relaxed ))
+      return nullptr ;
+   return tarea ;
+}
+
+// ******************************************************************************************************
+// ReservaHebras
+// ------------------------------------------------------------------------------------------------------
+
+ReservaHebras::ReservaHebras( const unsigned num_hebras )
+{
+   // las colas se crean antes que las hebras, que roban de todas
+   for( unsigned i = 0 ; i < std::max( 1u, num_hebras ) ; i++ )
+      colas.push_back( std::make_unique<ColaRobo>() );
+   for( unsigned i = 0 ; i < colas.size() ; i++ )
+      hebras.push_back( std::thread( [this,i]()
+      {
+         Perfilador::instancia()->nombrarHebra( "reserva " + std::to_string( i ) );
+         ejecutarTareas( i );
+      }));
+}
+// ------------------------------------------------------------------------------------------------------
+
+ReservaHebras::~ReservaHebras()
+{
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex );
+      terminar = true ;
+   }
+   hay_tareas.notify_all();
+   for( std::thread & hebra : hebras )
+      hebra.join();
+}
+// ------------------------------------------------------------------------------------------------------
+
+ReservaHebras * ReservaHebras::instancia()
+{
+   // 'hardware_concurrency' puede devolver 0 si no se conoce el número de núcleos
+   static ReservaHebras reserva( std::max( 2u, std::thread::hardware_concurrency() ) - 1 );
+   return &reserva ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+PtrTarea ReservaHebras::crearTarea( const char * nombre, std::function<void()> funcion )
+{
+   return std::make_shared<TareaReserva>( nombre, std::move( funcion ) );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::agregarDependencia( const PtrTarea & tarea, const PtrTarea & previa )
+{
+   assert( tarea != nullptr && previa != nullptr );
+   assert( tarea->propia == nullptr ); // (no se ha lanzado)
+
+   tarea->pendientes.fetch_add( 1, std::memory_order_relaxed );
+   std::lock_guard<std::mutex> bloqueo( previa->mutex );
+   if ( previa->fin.load( std::memory_order_relaxed ) )
+      tarea->pendientes.fetch_sub( 1, std::memory_order_relaxed );
+   else
+      previa->sucesoras.push_back( tarea );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::lanzar( const PtrTarea & tarea )
+{
+   assert( tarea != nullptr && tarea->propia == nullptr );
+   tarea->propia = tarea ;
+   if ( tarea->pendientes.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+      encolarLista( tarea.get() );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::esperar( const PtrTarea & tarea )
+{
+   assert( tarea != nullptr && ( tarea->propia != nullptr || tarea->terminada() ));
+   while( ! tarea->terminada() )
+   {
+      // ayudar mientras tanto, y si no hay nada que hacer, dormir un poco (pueden llegar tareas nuevas)
+      if ( TareaReserva * otra = buscarTarea() )
+      {  ejecutar( otra );
+         continue ;
+      }
+      std::unique_lock<std::mutex> bloqueo( tarea->mutex );
+      tarea->terminar.wait_for( bloqueo, std::chrono::milliseconds( 1 ), 
+                                [&]() { return tarea->fin.load( std::memory_order_relaxed ); } );
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::paraCada( const unsigned n, const std::function<void(unsigned)> & iteracion, const unsigned grano )
+{
+   if ( n == 0 )
+      return ;
+
+   // tamaño de los grupos de iteraciones: con 'grano' 0, unos cuatro grupos por hebra (contando la que llama)
+   const unsigned tam_grupo  = grano > 0 ? grano : std::max( 1u, n/( 4*( leerNumHebras()+1 ))) ,
+                  num_grupos = ( n + tam_grupo - 1 )/tam_grupo ;
+
+   // estado compartido con las tareas auxiliares, que pueden empezar después de que 
+   // termine esta función (entonces no quedan grupos y no usan 'iteracion')
+   struct Estado
+   {
+      std::atomic<unsigned>                     siguiente { 0 },
+                                                terminados { 0 } ;
+      unsigned                                  n, tam_grupo, num_grupos ;
+      const std::function<void(unsigned)> *     iteracion ;
+      std::mutex                                mutex ;
+      std::condition_variable                   fin ;
+   } ;
+   auto estado = std::make_shared<Estado>();
+   estado->n          = n ;
+   estado->tam_grupo  = tam_grupo ;
+   estado->num_grupos = num_grupos ;
+   estado->iteracion  = &iteracion ;
+
+   auto ejecutar_grupos = [estado]()
+   {
+      for( unsigned g = estado->siguiente++ ; g < estado->num_grupos ; g = estado->siguiente++ )
+      {
+         const unsigned ini = g*estado->tam_grupo ,
+                        fin = std::min( estado->n, ini + estado->tam_grupo );
+         for( unsigned i = ini ; i < fin ; i++ )
+            (*estado->iteracion)( i );
+         if ( ++estado->terminados == estado->num_grupos )
+         {  std::lock_guard<std::mutex> bloqueo( estado->mutex );
+            estado->fin.notify_all();
+         }
+      }
+   };
+
+   // las tareas auxiliares van a la cola de la hebra que llama (si es de la reserva), las demás las roban
+   for( unsigned h = 0 ; h < std::min<std::size_t>( num_grupos-1, hebras.size() ) ; h++ )
+      lanzar( crearTarea( "paraCada", ejecutar_grupos ));
+
+   ejecutar_grupos();
+   std::unique_lock<std::mutex> bloqueo( estado->mutex );
+   estado->fin.wait( bloqueo, [&]() { return estado->terminados == num_grupos ; } );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::encolarPrincipal( std::function<void()> tarea )
+{
+   std::function<void()> aviso ;
+   {
+      std::lock_guard<std::mutex> bloqueo( mutex_principal );
+      principal.push_back( std::move( tarea ));
+      aviso = aviso_principal ;
+   }
+   if ( aviso )
+      aviso();
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool ReservaHebras::ejecutarPrincipal( const double max_ms )
+{
+   const int64_t fin_ns   = Perfilador::instanteNs() + int64_t( max_ms*1e6 );
+   bool          ejecutada = false ;
+
+   // (al menos se ejecuta una, aunque se haya pasado el tiempo)
+   do
+   {
+      std::function<void()> tarea ;
+      {
+         std::lock_guard<std::mutex> bloqueo( mutex_principal );
+         if ( principal.empty() )
+            break ;
+         tarea = std::move( principal.front() );
+         principal.pop_front();
+      }
+      ZONA_PERFIL_CPU( "tarea principal" );
+      tarea();
+      ejecutada = true ;
+   }
+   while( Perfilador::instanteNs() < fin_ns );
+
+   return ejecutada ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool ReservaHebras::hayPendientesPrincipal()
+{
+   std::lock_guard<std::mutex> bloqueo( mutex_principal );
+   return ! principal.empty() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::fijarAvisoPrincipal( std::function<void()> aviso )
+{
+   std::lock_guard<std::mutex> bloqueo( mutex_principal );
+   aviso_principal = std::move( aviso );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::encolarLista( TareaReserva * tarea )
+{
+   // se cuenta antes de encolarla, así el contador nunca es menor que las tareas encoladas
+   num_encoladas.fetch_add( 1, std::memory_order_seq_cst );
+
+   if ( reserva_hebra != this || ! colas[indice_hebra]->agregar( tarea ) )
+   {  std::lock_guard<std::mutex> bloqueo( mutex );
+      compartida.push_back( tarea );
+   }
+
+   // despertar a una hebra si hay alguna dormida (una hebra que se va a dormir incrementa 
+   // 'num_dormidas' y después mira 'num_encoladas', así que una de las dos hebras ve a la otra)
+   if ( num_dormidas.load( std::memory_order_seq_cst ) > 0 )
+   {
+      { std::lock_guard<std::mutex> bloqueo( mutex ); }  // (si está a punto de esperar, se espera a que lo haga)
+      hay_tareas.notify_one();
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+TareaReserva * ReservaHebras::buscarTarea()
+{
+   const bool     propia = reserva_hebra == this ;
+   TareaReserva * tarea  = propia ? colas[indice_hebra]->extraer() : nullptr ;
+
+   // después, la más antigua de la cola compartida
+   if ( tarea == nullptr )
+   {  std::lock_guard<std::mutex> bloqueo( mutex );
+      if ( ! compartida.empty() )
+      {  tarea = compartida.front();
+         compartida.pop_front();
+      }
+   }
+
+   // si no hay, robar de las colas de las otras hebras, empezando por la siguiente
+   const unsigned n = colas.size() ;
+   for( unsigned k = 0 ; k < n && tarea == nullptr ; k++ )
+   {
+      const unsigned j = ( ( propia ? indice_hebra+1 : 0 ) + k ) % n ;
+      if ( propia && j == indice_hebra )
+         continue ;
+      if ( ( tarea = colas[j]->robar() ) != nullptr )
+         num_robos.fetch_add( 1, std::memory_order_relaxed );
+   }
+
+   if ( tarea != nullptr )
+      num_encoladas.fetch_sub( 1, std::memory_order_seq_cst );
+   return tarea ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::ejecutar( TareaReserva * tarea )
+{
+   // la tarea se mantiene hasta el final de esta función (después, si no la tiene nadie, se destruye)
+   PtrTarea mantener = std::move( tarea->propia );
+   {
+      ZONA_PERFIL_CPU( tarea->nombre );
+      tarea->funcion();
+   }
+   tarea->funcion = nullptr ; // (libera lo que ha capturado)
+
+   std::vector<PtrTarea> sucesoras ;
+   {
+      std::lock_guard<std::mutex> bloqueo( tarea->mutex );
+      tarea->fin.store( true, std::memory_order_release );
+      sucesoras.swap( tarea->sucesoras );
+   }
+   tarea->terminar.notify_all();
+
+   for( const PtrTarea & sucesora : sucesoras )
+      if ( sucesora->pendientes.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+         encolarLista( sucesora.get() );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void ReservaHebras::ejecutarTareas( const unsigned ih )
+{
+   reserva_hebra = this ;
+   indice_hebra  = ih ;
+
+   while( true )
+   {
+      if ( TareaReserva * tarea = buscarTarea() )
+      {  ejecutar( tarea );
+         continue ;
+      }
+
+      // dormir hasta que haya alguna tarea encolada (en cualquier cola) o se termine la reserva,
+      // al terminar, se ejecutan antes las tareas que quedan
+      std::unique_lock<std::mutex> bloqueo( mutex );
+      num_dormidas.fetch_add( 1, std::memory_order_seq_cst );
+      hay_tareas.wait( bloqueo, [this]() 
+         { return terminar || num_encoladas.load( std::memory_order_seq_cst ) > 0 ; } );
+      num_dormidas.fetch_sub( 1, std::memory_order_seq_cst );
+      if ( terminar && num_encoladas.load( std::memory_order_seq_cst ) == 0 )
+         return ;
+   }
+}
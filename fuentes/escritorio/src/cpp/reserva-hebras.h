@@ -0,0 +1,219 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Reserva de hebras para ejecutar tareas en segundo plano (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de las clases
+// **
+// **  + TareaReserva:  tarea de la reserva, con las tareas que deben terminar antes que ella
+// **  + ColaRobo:      cola doble sin cerrojos de una hebra de la reserva: la hebra añade y quita
+// **                   tareas por un extremo, y las demás le 'roban' tareas por el otro
+// **  + ReservaHebras: conjunto fijo de hebras que ejecutan las tareas de sus colas (y roban
+// **                   las de las otras hebras cuando se les acaban), más una cola de tareas
+// **                   para la hebra principal (las que usan OpenGL)
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+class TareaReserva ;
+using PtrTarea = std::shared_ptr<TareaReserva> ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Tarea de la reserva de hebras: una función sin parámetros, con un nombre para el perfilador
+/// @brief (debe ser una cadena literal) y las tareas que se ejecutan cuando termina. Se crea con
+/// @brief 'ReservaHebras::crearTarea' y no se usa directamente.
+///
+class TareaReserva
+{
+   public:
+   TareaReserva( const char * p_nombre, std::function<void()> p_funcion )
+   :  nombre( p_nombre ), funcion( std::move( p_funcion ))
+   {}
+
+   /// @brief Indica si la tarea ya se ha ejecutado
+   bool terminada() const { return fin.load( std::memory_order_acquire ); }
+
+   private:
+   friend class ReservaHebras ;
+
+   const char *            nombre ;
+   std::function<void()>   funcion ;
+   std::atomic<unsigned>   pendientes { 1 } ;  // tareas previas sin terminar, más uno hasta que se lanza
+   std::atomic<bool>       fin { false } ;
+   std::mutex              mutex ;             // protege 'sucesoras' (y 'fin' al terminar)
+   std::condition_variable terminar ;          // se notifica al terminar (ver 'ReservaHebras::esperar')
+   std::vector<PtrTarea>   sucesoras ;         // tareas que dependen de esta
+   PtrTarea                propia ;            // mantiene la tarea mientras está lanzada
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Cola doble de tareas de una hebra de la reserva, sin cerrojos (la de Chase y Lev, con
+/// @brief capacidad fija): solo la hebra dueña usa 'agregar' y 'extraer' (por el final, así ejecuta
+/// @brief primero lo último que ha añadido, cuyos datos están en su caché), y cualquier otra hebra
+/// @brief puede usar 'robar' (por el principio, las tareas más antiguas, que suelen ser las mayores).
+///
+class ColaRobo
+{
+   public:
+
+   static constexpr int64_t capacidad = 1 << 12 ;
+
+   /// @brief Añade una tarea al final, devuelve 'false' si la cola está llena (solo la hebra dueña)
+   bool agregar( TareaReserva * tarea );
+
+   /// @brief Quita la tarea del final, o devuelve nulo si está vacía (solo la hebra dueña)
+   TareaReserva * extraer();
+
+   /// @brief Quita la tarea del principio, o devuelve nulo si está vacía o si otra hebra
+   /// @brief la ha quitado a la vez (cualquier hebra)
+   TareaReserva * robar();
+
+   private:
+
+   static constexpr int64_t mascara = capacidad - 1 ;
+
+   // la cola tiene las tareas en [principio,final) (índices que solo crecen, módulo 'capacidad')
+   alignas(64) std::atomic<int64_t> principio { 0 } ;
+   alignas(64) std::atomic<int64_t> final { 0 } ;
+   std::atomic<TareaReserva *>      tareas[capacidad] = {} ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Reserva de hebras ('thread pool') con robo de tareas: cada hebra tiene su cola ('ColaRobo'),
+/// @brief en la que añade las tareas que crea, y cuando se queda sin tareas roba las de las colas de otras
+/// @brief hebras. Las tareas creadas fuera de la reserva van a una cola compartida. Hay una sola reserva en
+/// @brief la aplicación (la crea 'AplicacionBase'), para que las cargas, los cálculos de geometría y las
+/// @brief texturas no creen más hebras que núcleos. Las tareas de la reserva no deben usar OpenGL (el contexto
+/// @brief solo está activo en la hebra principal): las que lo necesitan se encolan con 'encolarPrincipal'.
+///
+class ReservaHebras
+{
+   public:
+
+   /// @brief Crea la reserva con 'num_hebras' hebras (al menos una)
+   ReservaHebras( const unsigned num_hebras );
+
+   /// @brief Espera a que se ejecuten todas las tareas encoladas y termina las hebras
+   ~ReservaHebras();
+
+   /// @brief Devuelve la reserva de la aplicación (la crea la primera vez, con una hebra menos
+   /// @brief que el número de núcleos, para dejar uno libre a la hebra principal)
+   static ReservaHebras * instancia() ;
+
+   /// @brief Encola una tarea (una función sin parámetros) y devuelve un 'std::future' para
+   /// @brief esperar a que termine y leer su resultado ('nombre' es el de su zona en el perfilador)
+   template< class F >
+   std::future<std::invoke_result_t<F>> encolar( F tarea, const char * nombre = "tarea" )
+   {
+      using R = std::invoke_result_t<F> ;
+      // 'std::function' necesita un objeto copiable, así que la tarea se guarda en un puntero compartido
+      auto paquete = std::make_shared<std::packaged_task<R()>>( std::move( tarea ) );
+      std::future<R> futuro = paquete->get_future();
+      lanzar( crearTarea( nombre, [paquete]() { (*paquete)(); } ));
+      return futuro ;
+   }
+
+   /// @brief Crea una tarea sin lanzarla (para añadirle dependencias antes de lanzarla)
+   PtrTarea crearTarea( const char * nombre, std::function<void()> funcion );
+
+   /// @brief Hace que 'tarea' (todavía sin lanzar) no empiece hasta que termine 'previa'
+   void agregarDependencia( const PtrTarea & tarea, const PtrTarea & previa );
+
+   /// @brief Lanza una tarea: se encola en cuanto hayan terminado todas sus tareas previas
+   void lanzar( const PtrTarea & tarea );
+
+   /// @brief Espera a que termine una tarea lanzada, ejecutando otras tareas mientras tanto
+   /// @brief (así se puede esperar desde una tarea de la reserva sin bloquear una hebra)
+   void esperar( const PtrTarea & tarea );
+
+   /// @brief Ejecuta 'iteracion(i)' para cada 'i' entre 0 y 'n'-1, repartiendo las iteraciones entre las
+   /// @brief hebras de la reserva y la hebra que llama, y espera a que terminen todas. Las iteraciones se
+   /// @brief reparten en grupos de 'grano' consecutivas (con 0, se elige para que haya unos cuantos grupos
+   /// @brief por hebra). La hebra que llama ejecuta grupos mientras queden, así que se puede usar dentro
+   /// @brief de una tarea de la reserva (no se bloquea esperando a tareas que no han empezado).
+   void paraCada( const unsigned n, const std::function<void(unsigned)> & iteracion, const unsigned grano = 1 );
+
+   /// @brief Encola una tarea que se debe ejecutar en la hebra principal (la que tiene el contexto
+   /// @brief OpenGL), en la siguiente llamada a 'ejecutarPrincipal' (se puede llamar desde cualquier hebra)
+   void encolarPrincipal( std::function<void()> tarea );
+
+   /// @brief Ejecuta las tareas de la hebra principal encoladas, por orden de llegada, hasta que se
+   /// @brief vacía la cola o pasan 'max_ms' milisegundos (se llama en cada iteración del bucle principal)
+   /// @return 'true' si se ha ejecutado alguna tarea
+   bool ejecutarPrincipal( const double max_ms );
+
+   /// @brief Indica si hay tareas de la hebra principal pendientes
+   bool hayPendientesPrincipal() ;
+
+   /// @brief Fija la función que se llama al encolar una tarea de la hebra principal, para despertar
+   /// @brief el bucle principal si está esperando eventos
+   void fijarAvisoPrincipal( std::function<void()> aviso );
+
+   /// @brief Devuelve el número de hebras de la reserva
+   unsigned leerNumHebras() const { return hebras.size() ; }
+
+   /// @brief Devuelve el número de tareas robadas de la cola de otra hebra (desde la creación)
+   uint64_t leerNumRobos() const { return num_robos.load( std::memory_order_relaxed ); }
+
+   private:
+
+   // bucle de la hebra 'ih': ejecuta tareas de su cola, de las otras o de la compartida,
+   // y duerme cuando no hay ninguna, hasta que se termina la reserva
+   void ejecutarTareas( const unsigned ih );
+
+   // encola una tarea sin tareas previas pendientes: en la cola de la hebra que llama, si es
+   // de la reserva, o en la compartida, y despierta a una hebra dormida (si la hay)
+   void encolarLista( TareaReserva * tarea );
+
+   // busca una tarea (en la cola de la hebra que llama, en la compartida o robando a las demás)
+   // y la quita de su cola, devuelve nulo si no hay ninguna
+   TareaReserva * buscarTarea() ;
+
+   // ejecuta una tarea y lanza las que dependen de ella
+   void ejecutar( TareaReserva * tarea );
+
+   std::vector<std::thread>                hebras ;
+   std::vector<std::unique_ptr<ColaRobo>>  colas ;          // una por hebra
+
+   std::deque<TareaReserva *>              compartida ;     // tareas encoladas fuera de la reserva
+   std::mutex                              mutex ;          // protege 'compartida' y 'terminar'
+   std::condition_variable                 hay_tareas ;     // se notifica al encolar con hebras dormidas, o al terminar
+   std::atomic<unsigned>                   num_encoladas { 0 } , // tareas encoladas que no han empezado
+                                           num_dormidas  { 0 } ; // hebras esperando en 'hay_tareas'
+   std::atomic<uint64_t>                   num_robos     { 0 } ;
+   bool                                    terminar = false ;
+
+   std::deque<std::function<void()>>       principal ;      // tareas de la hebra principal
+   std::mutex                              mutex_principal ;// protege 'principal' y 'aviso_principal'
+   std::function<void()>                   aviso_principal ;
+} ;
@@ -0,0 +1,111 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Ritmo de cuadros y simulación con paso fijo (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <algorithm>  // std::min, std::max
+#include "utilidades.h"
+#include "ritmo-cuadros.h"
+
+using namespace std::chrono ;
+
+// ******************************************************************************************************
+// RitmoCuadros
+// ------------------------------------------------------------------------------------------------------
+
+void RitmoCuadros::fijarModo( const ModoRitmo p_modo, const double p_fps )
+{
+   assert( 0.0 < p_fps );
+   modo  = p_modo ;
+   fps   = p_fps ;
+   plazo = steady_clock::now() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::string RitmoCuadros::descripcion() const
+{
+   const std::string s_fps = std::to_string( int( fps + 0.5 ) );
+   switch( modo )
+   {
+      case ModoRitmo::objetivo : return s_fps + " cuadros por segundo" ;
+      case ModoRitmo::vsync    : return "sincronización vertical (" + s_fps + " Hz)" ;
+      default                  : return "sin límite" ;
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RitmoCuadros::iniciarSimulacion()
+{
+   ultima_simulacion = steady_clock::now() ;
+   sobrante_seg      = 0.0 ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned RitmoCuadros::avanzarSimulacion( double & alfa )
+{
+   const Instante ahora = steady_clock::now() ;
+   const double   transcurrido = std::min( Segundos( ahora - ultima_simulacion ).count(), max_retraso );
+   ultima_simulacion = ahora ;
+
+   sobrante_seg += transcurrido ;
+   const unsigned pasos = unsigned( sobrante_seg/paso_simulacion );
+   sobrante_seg -= pasos*paso_simulacion ;
+
+   alfa = std::clamp( sobrante_seg/paso_simulacion, 0.0, 1.0 );
+   return pasos ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool RitmoCuadros::plazoCumplido() const
+{
+   return modo == ModoRitmo::libre || plazo <= steady_clock::now() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void RitmoCuadros::siguientePlazo()
+{
+   const Instante ahora   = steady_clock::now() ;
+   const auto     periodo = duration_cast<steady_clock::duration>( Segundos( 1.0/fps ) );
+
+   switch( modo )
+   {
+      case ModoRitmo::objetivo :
+         // plazos equiespaciados, pero si ya se ha pasado el siguiente (el cuadro ha tardado
+         // más de un periodo), se empieza a contar desde ahora en lugar de recuperar cuadros
+         plazo = std::max( plazo + periodo, ahora );
+         break ;
+      case ModoRitmo::vsync :
+         // 'glfwSwapBuffers' ya espera al refresco, solo se duerme medio periodo por si no lo
+         // hace (por ejemplo, con la ventana oculta)
+         plazo = ahora + periodo/2 ;
+         break ;
+      default :
+         plazo = ahora ;
+         break ;
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+double RitmoCuadros::segundosHastaPlazo() const
+{
+   if ( modo == ModoRitmo::libre )
+      return 0.0 ;
+   return std::max( 0.0, Segundos( plazo - steady_clock::now() ).count() );
+}
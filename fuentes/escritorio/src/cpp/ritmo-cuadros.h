@@ -0,0 +1,96 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Ritmo de cuadros y simulación con paso fijo (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de
+// **
+// **  + ModoRitmo:     forma de fijar los instantes en los que se visualizan los cuadros durante
+// **                   las animaciones (frecuencia objetivo, sincronización vertical o sin límite)
+// **  + RitmoCuadros:  calcula el plazo del siguiente cuadro (el bucle principal espera a los
+// **                   eventos hasta ese plazo) y el número de pasos fijos de simulación que hay
+// **                   que dar en cada cuadro, con la fracción de paso que queda para interpolar
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// --------------------------------------------------------------------------------------------
+/// @brief Modo del ritmo de cuadros
+///
+enum class ModoRitmo
+{
+   objetivo ,  // un cuadro cada 1/fps segundos, durmiendo entre cuadros
+   vsync ,     // sincronización vertical: 'glfwSwapBuffers' espera al refresco del monitor
+   libre       // sin límite: un cuadro detrás de otro (solo para medir)
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Ritmo de los cuadros y pasos de la simulación durante las animaciones (no depende de GLFW,
+/// @brief el intervalo de intercambio lo fija 'AplicacionBase::fijarRitmo')
+///
+class RitmoCuadros
+{
+   public:
+
+   static constexpr double paso_simulacion = 1.0/120.0 ,  // segundos simulados en cada paso
+                           max_retraso     = 0.25 ;       // máximo tiempo real simulado de una vez
+
+   /// @brief Cambia el modo y la frecuencia (con 'vsync', la de refresco del monitor)
+   void fijarModo( const ModoRitmo p_modo, const double p_fps );
+
+   ModoRitmo leerModo() const { return modo ; }
+   double    leerFPS() const  { return fps ; }
+
+   /// @brief Devuelve una descripción del modo (para imprimirla)
+   std::string descripcion() const ;
+
+   /// @brief Empieza a contar el tiempo simulado (al activar las animaciones)
+   void iniciarSimulacion() ;
+
+   /// @brief Devuelve cuántos pasos de simulación de 'paso_simulacion' segundos caben en el tiempo real
+   /// @brief transcurrido (más el sobrante de la llamada anterior), y en 'alfa' la fracción de paso
+   /// @brief que sobra (entre 0 y 1). Si han pasado más de 'max_retraso' segundos (por ejemplo, tras un
+   /// @brief tirón) solo se simulan 'max_retraso' segundos, para no acumular un retraso creciente.
+   unsigned avanzarSimulacion( double & alfa );
+
+   /// @brief Devuelve 'true' si ya ha llegado el plazo del siguiente cuadro
+   bool plazoCumplido() const ;
+
+   /// @brief Fija el plazo del siguiente cuadro (se llama al visualizar cada cuadro en una animación)
+   void siguientePlazo() ;
+
+   /// @brief Devuelve los segundos que faltan hasta el plazo del siguiente cuadro (0 si ya ha llegado)
+   double segundosHastaPlazo() const ;
+
+   private:
+
+   using Instante = std::chrono::steady_clock::time_point ;
+   using Segundos = std::chrono::duration<double> ;
+
+   ModoRitmo modo = ModoRitmo::objetivo ;
+   double    fps  = 60.0 ;
+
+   Instante  plazo ;               // instante en el que se debe visualizar el siguiente cuadro
+   Instante  ultima_simulacion ;   // instante de la última llamada a 'avanzarSimulacion'
+   double    sobrante_seg = 0.0 ;  // tiempo real todavía no simulado (menos de un paso)
+} ;
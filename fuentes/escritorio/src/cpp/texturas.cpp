@@ -4,6 +4,9 @@
 // ** Copyright (C) 2014 Carlos Ureña
 // **
 // ** Implementación de:
+// **    + clase 'ImagenTextura' (imagen leída de un archivo y textura de OpenGL)
+// **    + clase 'SubidorTexturas' (envío gradual de las imágenes a la GPU)
+// **    + clase 'ArregloTexturas' (varias imágenes en una textura 'GL_TEXTURE_2D_ARRAY')
 // **    + clase 'Textura' (y derivadas 'TexturaXY', 'TexturaXZ')
 // **
 // ** This program is free software: you can redistribute it and/or modify
@@ -21,69 +24,327 @@
 // **
 // *********************************************************************
 
+#include <algorithm>  // std::min, std::max, std::find
+#include <cstring>    // std::memcpy, std::strcmp
+#include <cmath>      // std::abs
 #include "aplic-3d.h"
 #include "texturas.h"
+#include "cache-recursos.h"
+#include "reserva-hebras.h"
+#include "mipmaps.h"
+#include "compresion-bc.h"
+#include "perfilador.h"
+#include "rasterizador-cpu.h"
 
 using namespace std ;
 
 //const bool trazam = false ;
 
 // **********************************************************************
+// Clase ImagenTextura
 
-Textura::Textura( const std::string & p_nombre_archivo )
+ImagenTextura::ImagenTextura( const std::string & p_nombre_archivo )
 {
-   // Cargar imagen de textura
-   // (las variables de instancia están inicializadas en la decl. de la clase)
-   // El nombre del archivo debe convertirse a una cadena (char *) acabada en 
-   // 0 tradicional en C. Para eso debe usarse el método 'c_str' de la clase 
-   // 'std::string'.
    // El nombre del archivo debe ir sin el 'path', la función 'LeerArchivoJPG' lo 
-   // busca en 'materiales/imgs' 
-   
-   // cargar imagen de textura, escribe en 'ancho' y 'alto'
-   using namespace std ;
+   // busca en 'materiales/imgs'. Se empieza con la versión más pequeña, que es la 
+   // más rápida de decodificar, y se refina cuando se sabe el detalle necesario. 
+
    nombre_archivo = p_nombre_archivo ;
-   imagen = LeerArchivoJPEG( nombre_archivo.c_str(), ancho, alto ) ;
-   assert( imagen != nullptr ) ;
-   cout << "Leído archivo de textura '" << nombre_archivo << "' (" << ancho << " x " << alto << ")" << endl ;
+   en_arreglo     = usar_arreglos && ! RasterizadorCPU::activo() ; // (los arreglos solo están en la GPU)
+   if ( en_arreglo )
+      lanzarDecodificacionCapa();
+   else 
+      lanzarDecodificacion( 8 );
 }
 //----------------------------------------------------------------------
 
-void Textura::enviar()
+void ImagenTextura::lanzarDecodificacion( const unsigned reduccion )
 {
-   // Enviar la imagen de textura a la GPU
-   // y configurar parámetros de la textura (glTexParameter)
-   assert( imagen != NULL );
-   CError();
+   // La imagen se lee en una hebra de la reserva (la lectura y decodificación del 
+   // JPEG y el cálculo de los mipmaps es lo más lento), y los mipmaps se comprimen en 
+   // otra tarea que depende de esa. Las tareas no usan OpenGL ni los atributos del 
+   // objeto, solo escriben la cadena en el estado compartido 'decodificacion'.
+   // Reducir la imagen a 1/2^k es casi lo mismo que quitar sus 'k' primeros niveles de 
+   // mipmap, así que de la caché se leen solo los niveles a partir del 'k'. Las cachés 
+   // se escriben solo con la cadena completa (sin reducir).
+
+   assert( reduccion == 1 || reduccion == 2 || reduccion == 4 || reduccion == 8 );
+   assert( decodificacion == nullptr && reduccion_pendiente == 0 );
+
+   reduccion_pendiente = reduccion ;
+   decodificacion      = std::make_shared<DecodificacionTextura>();
+   decodificacion->imagen = this ;
+
+   auto decodificar = [estado = decodificacion, nombre = nombre_archivo, reduccion, filtro = filtro_mipmaps, formato = formato_texels]()
+   {
+      using namespace std ;
+      const string    ruta     = BuscarArchivo( nombre, "imgs" );
+      const bool      completa = reduccion == 1 ;
+      CadenaMipmaps & cadena   = estado->cadena ;
+
+      unsigned primer_nivel = 0 ; // log2( reduccion )
+      while( (1u << primer_nivel) < reduccion )
+         primer_nivel++ ;
+
+      // si los mipmaps ya se calcularon en otra ejecución, no hace falta ni decodificar la imagen
+      if ( LeerCacheMipmaps( ruta, filtro, formato, cadena, primer_nivel ) )
+      {  cout << "Leídos mipmaps de la textura '" << nombre << "' (" << cadena[0].ancho << " x " << cadena[0].alto 
+              << ", " << NombreFormato( formato ) << ", 1/" << reduccion << ") de la caché" << endl ;
+         estado->leida_cache = true ;
+         return ;
+      }
+
+      // sin comprimir, los mipmaps pueden estar en la caché aunque no estén comprimidos
+      if ( formato == FormatoTexels::rgb || ! LeerCacheMipmaps( ruta, filtro, FormatoTexels::rgb, cadena, primer_nivel ) )
+      {
+         // cargar imagen de textura (reducida), escribe en 'ancho' y 'alto'
+         NivelMipmap     nivel0 ;
+         unsigned char * pixels = LeerArchivoJPEG( nombre.c_str(), nivel0.ancho, nivel0.alto, reduccion ) ;
+         assert( pixels != nullptr ) ;
+         nivel0.texels.assign( pixels, pixels + std::size_t( nivel0.ancho )*nivel0.alto*3 );
+         delete [] pixels ;
+         cout << "Leído archivo de textura '" << nombre << "' (" << nivel0.ancho << " x " << nivel0.alto 
+              << ", 1/" << reduccion << ")" << endl ;
+
+         cadena = { std::move( nivel0 ) };
+         GenerarMipmaps( cadena, filtro );
+         if ( completa && ! EscribirCacheMipmaps( ruta, filtro, cadena ) )
+            cout << "No se ha podido escribir la caché de mipmaps de '" << nombre << "'" << endl ;
+      }
+   };
+
+   auto comprimir = [estado = decodificacion, nombre = nombre_archivo, reduccion, filtro = filtro_mipmaps, formato = formato_texels]()
+   {
+      using namespace std ;
+      if ( estado->leida_cache || formato == FormatoTexels::rgb )
+         return ;
+      estado->cadena = ComprimirCadena( estado->cadena, formato );
+      if ( reduccion == 1 && ! EscribirCacheMipmaps( BuscarArchivo( nombre, "imgs" ), filtro, estado->cadena ) )
+         cout << "No se ha podido escribir la caché de mipmaps (" << NombreFormato( formato ) << ") de '" << nombre << "'" << endl ;
+   };
+
+   lanzarTareas( "decodificar textura", decodificar, "comprimir textura", comprimir );
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::lanzarDecodificacionCapa()
+{
+   // Igual que 'lanzarDecodificacion', pero el nivel 0 de la cadena se obtiene remuestreando 
+   // el nivel de la imagen completa más pequeño que no es menor que la capa. La cadena 
+   // remuestreada (ya comprimida, si procede) se guarda en su propia caché, así en las 
+   // siguientes ejecuciones no se decodifica ni se comprime nada.
+
+   assert( decodificacion == nullptr && reduccion_pendiente == 0 );
+
+   reduccion_pendiente = 1 ;
+   decodificacion      = std::make_shared<DecodificacionTextura>();
+   decodificacion->imagen = this ;
+
+   auto decodificar = [estado = decodificacion, nombre = nombre_archivo, filtro = filtro_mipmaps, formato = formato_texels]()
+   {
+      using namespace std ;
+      const string    ruta   = BuscarArchivo( nombre, "imgs" );
+      CadenaMipmaps & cadena = estado->cadena ;
+      CadenaMipmaps   completa ;
+
+      // la caché de la capa solo vale si su lado es uno de los que admiten los arreglos
+      if ( LeerCacheMipmaps( ruta, filtro, formato, cadena, 0, "capa" ) && cadena[0].ancho == cadena[0].alto && 
+           cadena[0].ancho <= ArregloTexturas::lado_max_capa && ( cadena[0].ancho & (cadena[0].ancho-1) ) == 0 )
+      {  cout << "Leídos mipmaps de la capa de la textura '" << nombre << "' (" << cadena[0].ancho << " x " << cadena[0].alto 
+              << ", " << NombreFormato( formato ) << ") de la caché" << endl ;
+         estado->leida_cache = true ;
+         return ;
+      }
+
+      if ( ! LeerCacheMipmaps( ruta, filtro, FormatoTexels::rgb, completa ) )
+      {
+         NivelMipmap     nivel0 ;
+         unsigned char * pixels = LeerArchivoJPEG( nombre.c_str(), nivel0.ancho, nivel0.alto ) ;
+         assert( pixels != nullptr ) ;
+         nivel0.texels.assign( pixels, pixels + std::size_t( nivel0.ancho )*nivel0.alto*3 );
+         delete [] pixels ;
+
+         completa = { std::move( nivel0 ) };
+         GenerarMipmaps( completa, filtro );
+         if ( ! EscribirCacheMipmaps( ruta, filtro, completa ) )
+            cout << "No se ha podido escribir la caché de mipmaps de '" << nombre << "'" << endl ;
+      }
 
-   //glEnable( GL_TEXTURE_2D ) ; CError(); // no en OPENGL4 ??
-   glActiveTexture( GL_TEXTURE0 ) ; CError();// ¿ innecesario si es la única activa ?
+      const unsigned lado = ArregloTexturas::ladoCapa( completa[0].ancho, completa[0].alto );
+      unsigned       k    = 0 ;
+      while( k+1 < completa.size() && std::max( completa[k+1].ancho, completa[k+1].alto ) >= lado )
+         k++ ;
+      cout << "Leído archivo de textura '" << nombre << "' (" << completa[0].ancho << " x " << completa[0].alto 
+           << ", capa de " << lado << " x " << lado << ")" << endl ;
 
-   // generar un nuevo nombre o identificador de textura
-   glGenTextures( 1, &ident_textura ) ;            CError();
-   glBindTexture( GL_TEXTURE_2D, ident_textura ) ; CError();
+      cadena = { RemuestrearNivel( completa[k], lado, lado ) };
+      completa.clear();
+      GenerarMipmaps( cadena, filtro );
+   };
 
+   // la caché de la capa se escribe también sin comprimir (no hay otra copia remuestreada)
+   auto comprimir = [estado = decodificacion, nombre = nombre_archivo, filtro = filtro_mipmaps, formato = formato_texels]()
+   {
+      using namespace std ;
+      if ( estado->leida_cache )
+         return ;
+      if ( formato != FormatoTexels::rgb )
+         estado->cadena = ComprimirCadena( estado->cadena, formato );
+      if ( ! EscribirCacheMipmaps( BuscarArchivo( nombre, "imgs" ), filtro, estado->cadena, "capa" ) )
+         cout << "No se ha podido escribir la caché de mipmaps de la capa (" << NombreFormato( formato ) << ") de '" << nombre << "'" << endl ;
+   };
+
+   lanzarTareas( "decodificar capa de textura", decodificar, "comprimir capa de textura", comprimir );
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::lanzarTareas( const char * nombre_decodificar, std::function<void()> decodificar, 
+                                  const char * nombre_comprimir, std::function<void()> comprimir )
+{
+   // la compresión no empieza hasta que termina la decodificación (la reserva lanza la 
+   // segunda tarea al terminar la primera), y al acabar encola la entrega de la cadena en 
+   // la hebra principal, donde se usan los atributos de la imagen (si todavía existe)
+   ReservaHebras * reserva = ReservaHebras::instancia();
+   PtrTarea        tarea_decodificar = reserva->crearTarea( nombre_decodificar, std::move( decodificar ) );
+   PtrTarea        tarea_comprimir   = reserva->crearTarea( nombre_comprimir, 
+      [estado = decodificacion, comprimir = std::move( comprimir )]()
+      {
+         comprimir();
+         ReservaHebras::instancia()->encolarPrincipal( [estado]()
+         {
+            std::lock_guard<std::mutex> bloqueo( estado->mutex );
+            if ( estado->imagen != nullptr )
+               estado->imagen->completarDecodificacion( std::move( estado->cadena ) );
+         });
+      });
+
+   reserva->agregarDependencia( tarea_comprimir, tarea_decodificar );
+   reserva->lanzar( tarea_comprimir );
+   reserva->lanzar( tarea_decodificar );
+}
+//----------------------------------------------------------------------
+
+ImagenTextura::~ImagenTextura( )
+{
    using namespace std ;
-   
-   // enviar texels a la memoria de vídeo o la memoria de la GPU y
-   // generar los mip-maps (versiones a múltiples resoluciones)
-   
-   CError();
-   glTexImage2D
-   (	
-      GL_TEXTURE_2D ,   // GLenum target,
-      0,                // GLint level (nivel de mipmap ?)
-      GL_RGB,           // GLint internalformat (formato en el que quedará en la memoria de la GPU)
-      ancho,            // GLsizei width   (número de columnas de pixels en la imagen)
-      alto,             // GLsizei height (numero de filas de pixel en la imagen)
-      0,                // GLint border (borde, no se usa, se pone a 0)
-      GL_RGB,           // GLenum format (formato en la memoria de la aplicación)
-      GL_UNSIGNED_BYTE, // GLenum type,
-      imagen            // const void * data
-   );
-   CError();
-   glGenerateMipmap( GL_TEXTURE_2D ); // generar mipmaps automáticamente
+   cout << "Liberando imagen de textura leída de archivo '" <<  nombre_archivo << "'" << endl ;
+
+   // si la decodificación no ha terminado, las tareas acaban igual (y el resultado se descarta)
+   if ( decodificacion != nullptr )
+   {  std::lock_guard<std::mutex> bloqueo( decodificacion->mutex );
+      decodificacion->imagen = nullptr ;
+   }
+   if ( encolada )
+      SubidorTexturas::instancia()->cancelar( this );
+   if ( arreglo != nullptr )
+      ArregloTexturas::liberarCapa( arreglo, capa );
+
+   // las texturas de OpenGL solo se crean en la hebra principal, si no hay ninguna no se usa 
+   // OpenGL: la imagen se puede destruir en una hebra de la reserva, sin contexto (p.ej. cuando 
+   // la caché descarta la copia de una hebra porque otra ha leído el mismo archivo a la vez)
+   if ( ident_textura == 0 && ident_textura_nueva == 0 && ident_textura_baja == 0 )
+      return ;
+   for( GLuint ident : { ident_textura, ident_textura_nueva, ident_textura_baja } )
+      if ( ident != 0 )
+         glDeleteTextures( 1, &ident ) ;
    CError();
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::completarDecodificacion( CadenaMipmaps && cadena )
+{
+   assert( ! decodificada );
+   niveles = std::move( cadena );
+
+   // el tamaño de la imagen sin reducir se conoce con la primera versión (es aproximado: 
+   // la reducción del JPEG redondea hacia arriba)
+   if ( lado_completo == 0 )
+      lado_completo = std::max( niveles[0].ancho, niveles[0].alto )*reduccion_pendiente ;
+
+   // la textura de baja resolución (solo antes de la primera versión) empieza en el 
+   // primer nivel con los dos lados de 64 texels o menos
+   constexpr unsigned lado_max_baja = 64 ;
+   nivel_baja = 0 ;
+   while( std::max( niveles[nivel_baja].ancho, niveles[nivel_baja].alto ) > lado_max_baja )
+      nivel_baja++ ;
+
+   decodificada   = true ;
+   decodificacion = nullptr ; // (la tarea que llama todavía tiene el estado)
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::solicitarDetalle( const float texels_necesarios )
+{
+   // no se sabe el tamaño de la imagen hasta la primera versión, y solo se 
+   // decodifica una versión a la vez (las capas de los arreglos tienen tamaño fijo)
+   if ( en_arreglo || lado_completo == 0 || reduccion_pendiente != 0 )
+      return ;
+
+   unsigned reduccion = reduccion_actual ;
+   while( reduccion > 1 && float( lado_completo/reduccion ) < texels_necesarios )
+      reduccion /= 2 ;
+   if ( reduccion < reduccion_actual )
+      lanzarDecodificacion( reduccion );
+}
+//----------------------------------------------------------------------
+
+// formato de OpenGL de los texels de un nivel en la GPU (los formatos comprimidos no siempre están 
+// definidos en las cabeceras)
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+static GLenum FormatoGL( const FormatoTexels formato )
+{
+   switch( formato )
+   {
+      case FormatoTexels::bc1 : return GL_COMPRESSED_RGB_S3TC_DXT1_EXT ;
+      case FormatoTexels::bc7 : return GL_COMPRESSED_RGBA_BPTC_UNORM ;
+      default :                 return GL_RGB ;
+   }
+}
+//----------------------------------------------------------------------
+
+// devuelve true si el contexto de OpenGL actual tiene la extensión 'nombre'
+
+static bool ExtensionDisponible( const char * nombre )
+{
+   GLint num_ext = 0 ;
+   glGetIntegerv( GL_NUM_EXTENSIONS, &num_ext );
+   for( GLint i = 0 ; i < num_ext ; i++ )
+      if ( std::strcmp( (const char *) glGetStringi( GL_EXTENSIONS, i ), nombre ) == 0 )
+         return true ;
+   return false ;
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::fijarFormatoTexels( const FormatoTexels nuevo_formato )
+{
+   using namespace std ;
+   formato_texels = nuevo_formato ;
+
+   if ( formato_texels == FormatoTexels::bc7 && ! ExtensionDisponible( "GL_ARB_texture_compression_bptc" ) )
+      formato_texels = FormatoTexels::bc1 ;
+   if ( formato_texels == FormatoTexels::bc1 && ! ExtensionDisponible( "GL_EXT_texture_compression_s3tc" ) )
+      formato_texels = FormatoTexels::rgb ;
+   cout << "Formato de las texturas en la GPU: " << NombreFormato( formato_texels ) << endl ;
+}
+//----------------------------------------------------------------------
+
+// crea una textura de OpenGL, sin texels, con los parámetros de interpolación y repetición
+// (queda activada en la unidad 0)
+
+static GLuint CrearTexturaGL()
+{
+   GLuint ident = 0 ;
+
+   glActiveTexture( GL_TEXTURE0 ) ; 
+   glGenTextures( 1, &ident ) ;            
+   glBindTexture( GL_TEXTURE_2D, ident ) ; 
 
    // configurar parámetros para interpolación de texels y mipmapping
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,  GL_LINEAR_MIPMAP_LINEAR );
@@ -94,49 +355,478 @@ void Textura::enviar()
    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
    CError();
 
-   enviada = true ;
+   return ident ;
 }
 //----------------------------------------------------------------------
 
-Textura::~Textura( )
+void ImagenTextura::crearTexturas()
+{
+   assert( decodificada && ident_textura_nueva == 0 && arreglo == nullptr );
+   CError();
+
+   const FormatoTexels formato    = niveles[0].formato ;
+   const GLenum        formato_gl = FormatoGL( formato );
+
+   // las filas de los niveles no tienen relleno, así que la alineación debe ser 1
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+   // los niveles de baja resolución se envían enteros (son pequeños), solo hacen 
+   // falta hasta que está la primera versión
+   if ( ident_textura == 0 )
+   {
+      ident_textura_baja = CrearTexturaGL();
+      for( unsigned i = nivel_baja ; i < niveles.size() ; i++ )
+      {
+         const NivelMipmap & nivel = niveles[i] ;
+         if ( formato == FormatoTexels::rgb )
+            glTexImage2D( GL_TEXTURE_2D, i-nivel_baja, GL_RGB, nivel.ancho, nivel.alto, 0, 
+                          GL_RGB, GL_UNSIGNED_BYTE, nivel.texels.data() );
+         else 
+            glCompressedTexImage2D( GL_TEXTURE_2D, i-nivel_baja, formato_gl, nivel.ancho, nivel.alto, 0, 
+                                    nivel.texels.size(), nivel.texels.data() );
+         bytes_textura_baja += nivel.texels.size() ;
+         Textura::contadores.bytes_subidos += nivel.texels.size() ;
+      }
+      CError();
+   }
+
+   // la memoria de las capas ya está reservada al crear el arreglo
+   if ( en_arreglo )
+   {  arreglo = ArregloTexturas::reservarCapa( niveles[0].ancho, formato, capa );
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+      return ;
+   }
+
+   // de la nueva solo se reserva la memoria de cada nivel (también con un formato 
+   // comprimido), los texels se copian por bandas (con 'glTexSubImage2D' o 
+   // 'glCompressedTexSubImage2D')
+   ident_textura_nueva = CrearTexturaGL();
+   bytes_textura_nueva = 0 ;
+   for( unsigned i = 0 ; i < niveles.size() ; i++ )
+   {
+      glTexImage2D
+      (	
+         GL_TEXTURE_2D ,   // GLenum target,
+         i,                // GLint level (nivel de mipmap)
+         formato_gl,       // GLint internalformat (formato en el que quedará en la memoria de la GPU)
+         niveles[i].ancho, // GLsizei width   (número de columnas de pixels en el nivel)
+         niveles[i].alto,  // GLsizei height (numero de filas de pixel en el nivel)
+         0,                // GLint border (borde, no se usa, se pone a 0)
+         GL_RGB,           // GLenum format (formato en la memoria de la aplicación)
+         GL_UNSIGNED_BYTE, // GLenum type,
+         nullptr           // const void * data (nulo: solo se reserva la memoria)
+      );
+      bytes_textura_nueva += niveles[i].texels.size() ;
+   }
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+   CError();
+}
+//----------------------------------------------------------------------
+
+void ImagenTextura::finalizarSubida()
+{
+   assert( nivel_subida == niveles.size() );
+
+   // la versión anterior (o la de baja resolución) ya no se usa
+   capa_completa = en_arreglo ;
+   if ( ident_textura != 0 )
+      glDeleteTextures( 1, &ident_textura ) ;
+   if ( ident_textura_baja != 0 )
+      glDeleteTextures( 1, &ident_textura_baja ) ;
+   CError();
+
+   ident_textura       = ident_textura_nueva ;
+   bytes_textura       = bytes_textura_nueva ;
+   reduccion_actual    = reduccion_pendiente ;
+   ident_textura_nueva = 0 ;
+   bytes_textura_nueva = 0 ;
+   ident_textura_baja  = 0 ;
+   bytes_textura_baja  = 0 ;
+   reduccion_pendiente = 0 ;
+
+   // los texels ya no hacen falta en la memoria de la aplicación (excepto el nivel 0 si
+   // se usa el rasterizador por software, que no lee las texturas de la GPU)
+   if ( RasterizadorCPU::activo() )
+      nivel_cpu = niveles[0].formato == FormatoTexels::rgb ? std::move( niveles[0] ) : DescomprimirNivel( niveles[0] );
+   niveles.clear();
+   niveles.shrink_to_fit();
+   decodificada  = false ;
+   nivel_subida  = 0 ;
+   filas_subidas = 0 ;
+}
+//----------------------------------------------------------------------
+
+GLuint ImagenTextura::leerIdentTextura()
+{
+   // pedir el envío a la GPU de la versión que se está decodificando (si hay alguna)
+   if ( reduccion_pendiente != 0 && ! encolada )
+   {  SubidorTexturas::instancia()->encolar( this );
+      encolada = true ;
+   }
+   if ( ident_textura != 0 )
+      return ident_textura ;
+   if ( ident_textura_baja != 0 )
+      return ident_textura_baja ;
+   return SubidorTexturas::identTexturaProvisional();
+}
+//----------------------------------------------------------------------
+
+UsoMemoria ImagenTextura::leerUsoMemoria() const 
+{
+   UsoMemoria uso ;
+
+   // la memoria de todos los niveles de cada textura se reserva al crearla (la de las capas 
+   // de los arreglos se cuenta en 'ArregloTexturas')
+   uso.cpu_imagenes = BytesCadena( niveles ) + nivel_cpu.texels.size() ;
+   uso.gpu_texturas = bytes_textura + bytes_textura_nueva + bytes_textura_baja ;
+   return uso ;
+}
+//----------------------------------------------------------------------
+
+// **********************************************************************
+// Clase SubidorTexturas
+
+SubidorTexturas * SubidorTexturas::instancia()
+{
+   static SubidorTexturas subidor ;
+   return &subidor ;
+}
+//----------------------------------------------------------------------
+
+GLuint SubidorTexturas::identTexturaProvisional()
+{
+   static GLuint ident = 0 ;
+
+   // (sin contexto de OpenGL no hay textura, el rasterizador por software usa el mismo gris)
+   if ( ident == 0 && ! RasterizadorCPU::activo() )
+   {  const unsigned char gris[3] = { 128, 128, 128 };
+      ident = CrearTexturaGL();
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+      glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, gris );
+      glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+      CError();  // (con 1x1 texels, el nivel 0 es toda la cadena de mipmaps)
+   }
+   return ident ;
+}
+//----------------------------------------------------------------------
+
+void SubidorTexturas::encolar( ImagenTextura * imagen )
+{
+   assert( imagen != nullptr );
+   cola.push_back( imagen );
+}
+//----------------------------------------------------------------------
+
+void SubidorTexturas::cancelar( ImagenTextura * imagen )
+{
+   auto it = std::find( cola.begin(), cola.end(), imagen );
+   if ( it != cola.end() )
+      cola.erase( it );
+}
+//----------------------------------------------------------------------
+
+void SubidorTexturas::crearPBOs()
+{
+   if ( pbos[0] != 0 )
+      return ;
+   glGenBuffers( num_pbos, pbos );
+   for( unsigned i = 0 ; i < num_pbos ; i++ )
+   {  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbos[i] );
+      glBufferData( GL_PIXEL_UNPACK_BUFFER, tam_pbo, nullptr, GL_STREAM_DRAW );
+   }
+   glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+   CError();
+}
+//----------------------------------------------------------------------
+
+std::size_t SubidorTexturas::subirBandas( ImagenTextura * imagen, const std::size_t max_bytes )
+{
+   ZONA_PERFIL_CPU( "SubidorTexturas::subirBandas" );
+   std::size_t bytes = 0 ;
+
+   // las filas de los niveles no tienen relleno, así que la alineación debe ser 1
+   GLint alineacion = 4 ;
+   glGetIntegerv( GL_UNPACK_ALIGNMENT, &alineacion );
+   glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+   // (las capas de los arreglos se envían desde la unidad 0, la 1 es la del cauce)
+   const GLenum destino = imagen->arreglo != nullptr ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D ;
+   glActiveTexture( GL_TEXTURE0 ) ;
+   glBindTexture( destino, imagen->arreglo != nullptr ? imagen->arreglo->leerIdent() : imagen->ident_textura_nueva );
+
+   do
+   {
+      // las filas son de texels o, con un formato comprimido, de bloques de 4x4 texels
+      const unsigned              num_nivel  = imagen->nivel_subida ;
+      const NivelMipmap &         nivel      = imagen->niveles[num_nivel] ;
+      const std::size_t           bytes_fila = nivel.bytesFila() ;
+      const unsigned              fila0      = imagen->filas_subidas ;
+      const unsigned char * const orig       = nivel.texels.data() + fila0*bytes_fila ;
+      const unsigned              num_filas  = bytes_fila <= tam_pbo 
+                                             ? std::min<std::size_t>( tam_pbo/bytes_fila, nivel.numFilas() - fila0 ) : 1 ;
+      const std::size_t           tam        = num_filas*bytes_fila ;
+      const unsigned              y0         = fila0*nivel.altoFila() ,
+                                  alto_banda = std::min( num_filas*nivel.altoFila(), nivel.alto - y0 );
+
+      // copiar en el siguiente PBO del anillo tantas filas como quepan, y de ahí a la textura
+      // (al invalidar el buffer, no hay que esperar a que termine una copia anterior desde él),
+      // si una fila no cabe en un PBO, se copia directamente desde la memoria de la aplicación
+      const void * datos = orig ;
+      if ( bytes_fila <= tam_pbo )
+      {
+         glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbos[sig_pbo] );
+         void * destino = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, tam, 
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+         assert( destino != nullptr );
+         std::memcpy( destino, orig, tam );
+         glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+         datos   = nullptr ;  // con un PBO activo, es un desplazamiento en el buffer
+         sig_pbo = (sig_pbo+1) % num_pbos ;
+      }
+      if ( destino == GL_TEXTURE_2D_ARRAY && nivel.formato == FormatoTexels::rgb )
+         glTexSubImage3D( destino, num_nivel, 0, y0, imagen->capa, nivel.ancho, alto_banda, 1, 
+                          GL_RGB, GL_UNSIGNED_BYTE, datos );
+      else if ( destino == GL_TEXTURE_2D_ARRAY )
+         glCompressedTexSubImage3D( destino, num_nivel, 0, y0, imagen->capa, nivel.ancho, alto_banda, 1, 
+                                    FormatoGL( nivel.formato ), tam, datos );
+      else if ( nivel.formato == FormatoTexels::rgb )
+         glTexSubImage2D( destino, num_nivel, 0, y0, nivel.ancho, alto_banda, GL_RGB, GL_UNSIGNED_BYTE, datos );
+      else 
+         glCompressedTexSubImage2D( destino, num_nivel, 0, y0, nivel.ancho, alto_banda, 
+                                    FormatoGL( nivel.formato ), tam, datos );
+      glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+      CError();
+
+      imagen->filas_subidas += num_filas ;
+      bytes += tam ;
+
+      // pasar al siguiente nivel al terminar uno
+      if ( imagen->filas_subidas == nivel.numFilas() )
+      {  imagen->nivel_subida++ ;
+         imagen->filas_subidas = 0 ;
+      }
+   }
+   while( bytes < max_bytes && imagen->nivel_subida < imagen->niveles.size() );
+
+   glPixelStorei( GL_UNPACK_ALIGNMENT, alineacion );
+   return bytes ;
+}
+//----------------------------------------------------------------------
+
+bool SubidorTexturas::subirPendientes()
+{
+   bool        cambios = false ;
+   std::size_t bytes   = 0 ;
+
+   if ( cola.empty() )
+      return false ;
+   ZONA_PERFIL_CPU( "SubidorTexturas::subirPendientes" );
+   ZONA_PERFIL_GPU( "SubidorTexturas::subirPendientes" );
+
+   // sin contexto de OpenGL (rasterizador por software) no se envía nada: las imágenes
+   // decodificadas se terminan directamente (conservan su nivel 0 en la CPU)
+   if ( RasterizadorCPU::activo() )
+   {
+      for( auto it = cola.begin() ; it != cola.end() ; )
+      {
+         ImagenTextura * imagen = *it ;
+         if ( ! imagen->decodificada )
+         {  ++it ;
+            continue ;
+         }
+         imagen->nivel_subida = imagen->niveles.size() ;
+         imagen->finalizarSubida();
+         imagen->encolada = false ;
+         cambios = true ;
+         it = cola.erase( it );
+      }
+      return cambios ;
+   }
+   crearPBOs();
+
+   // se recorre la cola en orden: las imágenes que aún se están decodificando no 
+   // detienen el envío de las siguientes
+   for( auto it = cola.begin() ; it != cola.end() && bytes < presupuesto ; )
+   {
+      ImagenTextura * imagen = *it ;
+
+      if ( ! imagen->decodificada )
+      {  ++it ;
+         continue ;
+      }
+      if ( imagen->ident_textura_nueva == 0 && imagen->arreglo == nullptr )
+      {  imagen->crearTexturas();
+         cambios = true ;
+      }
+      const std::size_t bytes_imagen = subirBandas( imagen, presupuesto - bytes );
+      bytes += bytes_imagen ;
+      Textura::contadores.bytes_subidos += bytes_imagen ;
+
+      if ( imagen->nivel_subida == imagen->niveles.size() )
+      {  imagen->finalizarSubida();
+         imagen->encolada = false ;
+         cambios = true ;
+         it = cola.erase( it );
+      }
+      else 
+         ++it ;
+   }
+   return cambios ;
+}
+//----------------------------------------------------------------------
+
+UsoMemoria SubidorTexturas::leerUsoMemoria() const 
+{
+   UsoMemoria uso ;
+   if ( pbos[0] != 0 )
+      uso.gpu_buffers = num_pbos*tam_pbo ;
+   return uso ;
+}
+//----------------------------------------------------------------------
+
+// **********************************************************************
+// Clase ArregloTexturas
+
+ArregloTexturas::ArregloTexturas( const unsigned p_lado, const FormatoTexels p_formato )
 {
    using namespace std ;
-   cout << "Destruyendo textura leída de archivo '" <<  nombre_archivo << "'" << endl ;
-   if ( imagen != nullptr )
-      delete [] imagen ;
+   lado    = p_lado ;
+   formato = p_formato ;
+   ocupada.resize( num_capas, false );
 
-   imagen = nullptr ;
-   cout << "hecho (no hecho!)" << endl << flush ;
+   glActiveTexture( GL_TEXTURE0 ) ;
+   glGenTextures( 1, &ident ) ;
+   glBindTexture( GL_TEXTURE_2D_ARRAY, ident ) ;
+
+   // mismos parámetros que las texturas de cada imagen ('GL_REPEAT' se aplica dentro de cada capa)
+   glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+   glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+   glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT );
+   glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT );
+
+   // reservar la memoria de todos los niveles de todas las capas (los texels los envía el subidor)
+   for( unsigned nivel = 0, l = lado ; ; nivel++, l /= 2 )
+   {
+      glTexImage3D( GL_TEXTURE_2D_ARRAY, nivel, FormatoGL( formato ), l, l, num_capas, 0, 
+                    GL_RGB, GL_UNSIGNED_BYTE, nullptr );
+      const NivelMipmap vacio { .ancho = l, .alto = l, .formato = formato, .texels = {} };
+      bytes += vacio.numFilas()*vacio.bytesFila()*num_capas ;
+      if ( l == 1 )
+         break ;
+   }
+   CError();
+   cout << "Creado arreglo de texturas de " << num_capas << " capas de " << lado << " x " << lado 
+        << " (" << NombreFormato( formato ) << ", " << bytes/1024 << " KB)" << endl ;
 }
+//----------------------------------------------------------------------
+
+ArregloTexturas * ArregloTexturas::reservarCapa( const unsigned lado, const FormatoTexels formato, unsigned & capa )
+{
+   for( ArregloTexturas * arreglo : arreglos )
+      if ( arreglo->lado == lado && arreglo->formato == formato )
+         for( unsigned i = 0 ; i < num_capas ; i++ )
+            if ( ! arreglo->ocupada[i] )
+            {  arreglo->ocupada[i] = true ;
+               capa = i ;
+               return arreglo ;
+            }
 
+   arreglos.push_back( new ArregloTexturas( lado, formato ) );
+   arreglos.back()->ocupada[0] = true ;
+   capa = 0 ;
+   return arreglos.back() ;
+}
 //----------------------------------------------------------------------
-// por ahora, se asume la unidad de texturas #0
 
-// void Textura::activar(  )
-// {
-//    using namespace std ;
-//    Cauce3D * cauce = Aplicacion3D::instancia()->cauce3D() ;
+void ArregloTexturas::liberarCapa( ArregloTexturas * arreglo, const unsigned capa )
+{
+   assert( arreglo != nullptr && capa < num_capas && arreglo->ocupada[capa] );
+   arreglo->ocupada[capa] = false ;
 
-//    // Enviar la textura a la GPU (solo la primera vez) y activarla
-//    if ( ! enviada )
-//       enviar();
+   // el arreglo se destruye con la última imagen (si se necesita otra vez, se vuelve a crear)
+   if ( std::find( arreglo->ocupada.begin(), arreglo->ocupada.end(), true ) != arreglo->ocupada.end() )
+      return ;
+   std::cout << "Liberado arreglo de texturas de " << arreglo->lado << " x " << arreglo->lado 
+             << " (" << NombreFormato( arreglo->formato ) << ", " << arreglo->bytes/1024 << " KB)" << std::endl ;
+   glDeleteTextures( 1, &(arreglo->ident) );
+   CError();
+   arreglos.erase( std::find( arreglos.begin(), arreglos.end(), arreglo ) );
+   delete arreglo ;
+}
+//----------------------------------------------------------------------
 
-//    cauce->fijarEvalText( true, ident_textura );
-//    cauce->fijarTipoGCT( int(modo_gen_ct), coefs_s, coefs_t );
-   
-// }
+unsigned ArregloTexturas::ladoCapa( const unsigned ancho, const unsigned alto )
+{
+   unsigned lado = 1 ;
+   while( 2*lado <= std::max( ancho, alto ) && 2*lado <= lado_max_capa )
+      lado *= 2 ;
+   return lado ;
+}
+//----------------------------------------------------------------------
+
+UsoMemoria ArregloTexturas::leerUsoMemoriaTotal()
+{
+   UsoMemoria uso ;
+   for( const ArregloTexturas * arreglo : arreglos )
+      uso.gpu_texturas += arreglo->bytes ;
+   return uso ;
+}
+//----------------------------------------------------------------------
+
+// **********************************************************************
+// Clase Textura
+
+Textura::Textura( const std::string & p_nombre_archivo )
+{
+   // obtener la imagen de la caché (la lee del archivo solo si no la usa ya otra textura)
+   imagen = CacheRecursos::instancia()->imagenTextura( p_nombre_archivo );
+   assert( imagen != nullptr );
+}
+//----------------------------------------------------------------------
+
+Textura::~Textura( )
+{
+   // la imagen (y la textura de OpenGL) se libera al destruirse el último puntero
+   imagen = nullptr ;
+}
+//----------------------------------------------------------------------
+
+UsoMemoria Textura::leerUsoMemoria() const 
+{
+   return imagen->leerUsoMemoria();
+}
+//----------------------------------------------------------------------
 
 void Textura::activar( CauceBase * cauce )
 {
    using namespace std ;
    assert( cauce != nullptr );
+   contadores.activaciones++ ;
+
+   // el rasterizador por software usa la imagen en la memoria de la aplicación
+   if ( RasterizadorCPU::activo() )
+      RasterizadorCPU::instancia()->fijarTextura( imagen->leerNivelCPU() );
    
+   // Si la imagen ya está en un arreglo de texturas, basta con seleccionar su capa
+   if ( imagen->capaCompleta() )
+   {  cauce->fijarEvalTextArreglo( imagen->leerArreglo()->leerIdent(), imagen->leerCapa() );
+      cauce->fijarTipoGCT( int(modo_gen_ct), coefs_s, coefs_t );
+      return ;
+   }
 
-   // Enviar la textura a la GPU (solo la primera vez) y activarla
-   if ( ! enviada )
-      enviar();
+   // Texels necesarios a lo ancho de la imagen: con coordenadas de textura explícitas 
+   // se supone que la imagen cubre un objeto de lado 2 (como los de las prácticas), y 
+   // si se generan, cada unidad en coordenadas de objeto abarca 'k' veces la imagen 
+   // (con 'k' el mayor coeficiente de 's' o 't')
+   float unidades_por_imagen = 2.0f ;
+   if ( modo_gen_ct != mgct_desactivada )
+   {  const float k = std::max( { std::abs( coefs_s[0] ), std::abs( coefs_s[1] ), std::abs( coefs_s[2] ),
+                                  std::abs( coefs_t[0] ), std::abs( coefs_t[1] ), std::abs( coefs_t[2] ) } );
+      unidades_por_imagen = k > 0.0f ? 1.0f/k : 2.0f ;
+   }
+   imagen->solicitarDetalle( cauce->pixelsPorUnidadOC()*unidades_por_imagen );
 
-   cauce->fijarEvalText( true, ident_textura );
+   // Enviar la imagen a la GPU (o una versión con más detalle) y activarla
+   cauce->fijarEvalText( true, imagen->leerIdentTextura() );
    cauce->fijarTipoGCT( int(modo_gen_ct), coefs_s, coefs_t );
    
 }
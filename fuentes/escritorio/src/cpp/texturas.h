@@ -4,6 +4,9 @@
 // ** Copyright (C) 2014 Carlos Ureña
 // **
 // ** Declaraciones de:
+// **    + clase 'ImagenTextura' (imagen leída de un archivo y textura de OpenGL)
+// **    + clase 'SubidorTexturas' (envío gradual de las imágenes a la GPU)
+// **    + clase 'ArregloTexturas' (varias imágenes en una textura 'GL_TEXTURE_2D_ARRAY')
 // **    + clase 'Textura' (y derivadas 'TexturaXY', 'TexturaXZ')
 // **    
 // **
@@ -24,11 +27,20 @@
 
 #pragma once
 
+#include <deque>
+#include <mutex>
 #include <vector>
+#include <memory>
+#include <functional>
 #include "utilidades.h"
 #include "lector-jpg.h"
+#include "uso-memoria.h"
+#include "mipmaps.h"
+#include "estadisticas-render.h"
 
 class Textura  ;
+class ArregloTexturas ;
+class ImagenTextura ;
 
 //**********************************************************************
 // posibles modos de generacion de coords. de textura
@@ -40,45 +52,327 @@ typedef enum
 }
    ModoGenCT ;
 
+// *********************************************************************
+// Estado compartido entre una imagen y las tareas que la decodifican: la 
+// imagen lo suelta al destruirse (pone 'imagen' a nulo), así la tarea que 
+// entrega el resultado en la hebra principal no usa una imagen destruida 
+// (la imagen se puede destruir en otra hebra, por eso hace falta el cerrojo)
+
+struct DecodificacionTextura
+{
+   std::mutex      mutex ;
+   ImagenTextura * imagen      = nullptr ; // imagen que recibe la cadena (nulo si ya no existe)
+   CadenaMipmaps   cadena ;                // niveles decodificados (o leídos de la caché)
+   bool            leida_cache = false ;   // true si 'cadena' ya está en el formato final (no se comprime)
+} ;
+
+// *********************************************************************
+// Clase ImagenTextura:
+// ---------------
+// imagen leída de un archivo JPEG y textura de OpenGL creada con ella.
+// Los objetos se crean en la caché de recursos ('CacheRecursos'), que 
+// los comparte entre todas las texturas que usan el mismo archivo.
+//
+// La imagen se decodifica en la reserva de hebras, donde también se calculan 
+// todos los niveles de mipmap, y después (en otra tarea, que depende de la 
+// anterior) se comprimen en BC1 o BC7 si OpenGL lo permite (o se leen de la 
+// caché en disco, ver 'mipmaps.h' y 'compresion-bc.h'). La cadena se entrega a 
+// la imagen en la hebra principal y se envía a la GPU poco a poco (ver 'SubidorTexturas').
+//
+// Primero se decodifica a 1/8 de su tamaño, y después a más resolución según
+// el detalle que se pide al visualizarla (ver 'solicitarDetalle'). Mientras se 
+// envía una versión con más resolución se sigue usando la anterior (y antes de 
+// la primera, los niveles de baja resolución o un texel gris).
+//
+// Si se usan arreglos de texturas (por defecto no, ver 'fijarUsarArreglos'), la 
+// imagen no tiene su propia textura: se remuestrea al tamaño de las capas de un 
+// arreglo y se envía a una capa libre (ver 'ArregloTexturas'), y entonces no se 
+// empieza con la versión reducida ni se refina según el detalle.
+
+class ImagenTextura
+{
+   public:
+
+   // empieza a decodificar la imagen del archivo a 1/8 de su tamaño, en otra 
+   // hebra (sin 'path', se busca igual que en 'LeerArchivoJPEG')
+   ImagenTextura( const std::string & nombreArchivoJPG ) ;
+
+   // libera los pixels y las texturas de OpenGL que se hayan creado (si no se ha 
+   // creado ninguna no usa OpenGL, así que se puede destruir en cualquier hebra)
+   ~ImagenTextura() ;
+
+   // no se puede copiar (libera la textura al destruirse)
+   ImagenTextura( const ImagenTextura & ) = delete ;
+   ImagenTextura & operator = ( const ImagenTextura & ) = delete ;
+
+   // devuelve el identificador de la textura de OpenGL que se debe usar ahora: la 
+   // última completa que se ha enviado, si no la de baja resolución o la provisional 
+   // (si hay una versión pendiente de enviar, pide al subidor de texturas que la envíe)
+   GLuint leerIdentTextura() ;
+
+   // indica cuántos texels hacen falta a lo ancho de la imagen para que, tal como 
+   // se va a visualizar, cada texel no ocupe más de un pixel. Si la versión actual 
+   // tiene menos, se decodifica otra vez con la reducción más pequeña suficiente 
+   // (las peticiones se ignoran mientras se decodifica o envía otra versión)
+   void solicitarDetalle( const float texels_necesarios ) ;
+
+   // devuelve true si alguna versión de la imagen (con sus mipmaps) ya está en la GPU
+   bool residente() const { return ident_textura != 0 || capa_completa ; }
+
+   // devuelve true si la imagen ya está completa en una capa de un arreglo de texturas
+   bool capaCompleta() const { return capa_completa ; }
+
+   // devuelve el arreglo y la capa de la imagen (solo si 'capaCompleta()')
+   const ArregloTexturas * leerArreglo() const { return arreglo ; }
+   unsigned leerCapa() const { return capa ; }
+
+   // devuelve la reducción de la versión en la GPU (1, 2, 4 u 8, o 0 si no hay ninguna)
+   unsigned leerReduccion() const { return reduccion_actual ; }
+
+   // devuelve la memoria ocupada por la imagen en la CPU y por las texturas en la GPU
+   UsoMemoria leerUsoMemoria() const ;
+
+   const std::string & leerNombreArchivo() const { return nombre_archivo ; }
+
+   // devuelve el nivel 0 (RGB) de la última versión enviada, que se conserva en la memoria 
+   // de la aplicación solo con el rasterizador por software activo (nulo si no lo hay)
+   const NivelMipmap * leerNivelCPU() const { return nivel_cpu.texels.empty() ? nullptr : &nivel_cpu ; }
+
+   // fija el filtro con el que se calculan los mipmaps de las imágenes que se creen 
+   // después (por defecto Kaiser)
+   static void fijarFiltroMipmaps( const FiltroMipmaps nuevo_filtro ) { filtro_mipmaps = nuevo_filtro ; }
+
+   // fija el formato de los texels en la GPU de las imágenes que se creen después 
+   // (la aplicación fija BC1 al crearse), si OpenGL no lo admite se usa BC1 o RGB 
+   // sin comprimir. Se debe llamar en la hebra principal, con el contexto de OpenGL.
+   static void fijarFormatoTexels( const FormatoTexels nuevo_formato ) ;
+
+   // indica si las imágenes que se creen después van en arreglos de texturas (por defecto
+   // no: cada imagen tiene su textura, que se refina según el detalle necesario)
+   static void fijarUsarArreglos( const bool nuevo_usar_arreglos ) { usar_arreglos = nuevo_usar_arreglos ; }
+
+   private: //--------------------------------------------------------
+
+   friend class SubidorTexturas ;
+
+   // empieza a decodificar la imagen (o a leer su caché) reducida a 1/'reduccion'
+   void lanzarDecodificacion( const unsigned reduccion ) ;
+
+   // empieza a decodificar la imagen completa (o a leer su caché) y a remuestrearla 
+   // al tamaño de las capas de los arreglos
+   void lanzarDecodificacionCapa() ;
+
+   // lanza la tarea 'decodificar' y, cuando termina, la tarea 'comprimir', que al acabar 
+   // entrega la cadena de 'decodificacion' a la imagen en la hebra principal
+   void lanzarTareas( const char * nombre_decodificar, std::function<void()> decodificar, 
+                      const char * nombre_comprimir, std::function<void()> comprimir ) ;
+
+   // recoge la cadena decodificada (se llama en la hebra principal, al terminar las tareas)
+   void completarDecodificacion( CadenaMipmaps && cadena ) ;
+
+   // crea la textura nueva o reserva la capa del arreglo (y crea la de baja resolución, si no hay ninguna)
+   void crearTexturas() ;
+
+   // sustituye la textura actual por la nueva (o pasa a usar la capa), y libera la de baja 
+   // resolución y los pixels
+   void finalizarSubida() ;
+
+   static inline FiltroMipmaps
+      filtro_mipmaps = FiltroMipmaps::kaiser ;
+   static inline FormatoTexels
+      formato_texels = FormatoTexels::rgb ;  // (hasta que se llama a 'fijarFormatoTexels')
+   static inline bool
+      usar_arreglos  = false ;
+
+   std::string 
+      nombre_archivo = "no asignado"; // nombre del archivo de imagen de textura
+   std::shared_ptr<DecodificacionTextura>
+      decodificacion ;          // no nulo mientras se está decodificando
+   bool
+      decodificada    = false , // true si ya están los niveles de la versión nueva en 'niveles'
+      encolada        = false , // true si está en la cola del subidor de texturas
+      en_arreglo      = false , // true si la imagen va en una capa de un arreglo de texturas
+      capa_completa   = false ; // true si ya se ha enviado entera a esa capa
+   ArregloTexturas *
+      arreglo         = nullptr ; // arreglo con la capa de la imagen (nulo si no se ha reservado)
+   GLuint
+      ident_textura       = 0 , // 'nombre' o identif. de textura para OpenGL (0 si no se ha creado)
+      ident_textura_nueva = 0 , // textura que se está enviando (0 si no hay ninguna)
+      ident_textura_baja  = 0 ; // textura de baja resolución, mientras se envía la primera
+   std::size_t
+      bytes_textura       = 0 , // bytes de todos los niveles de cada textura en la GPU
+      bytes_textura_nueva = 0 ,
+      bytes_textura_baja  = 0 ;
+   unsigned
+      lado_completo       = 0 , // lado mayor de la imagen sin reducir (0 hasta la primera decodificación)
+      reduccion_actual    = 0 , // reducción de 'ident_textura' (0 si no hay)
+      reduccion_pendiente = 0 , // reducción de la versión que se decodifica o envía (0 si no hay)
+      capa                = 0 , // índice de la capa en 'arreglo'
+      nivel_baja          = 0 , // primer nivel de 'niveles' que va en la textura de baja resolución
+      nivel_subida        = 0 , // nivel que se está copiando en la textura nueva
+      filas_subidas       = 0 ; // filas (de texels o de bloques) de ese nivel ya copiadas
+   CadenaMipmaps
+      niveles ;                 // texels de todos los niveles de la versión nueva (hasta que se envía)
+   NivelMipmap
+      nivel_cpu ;               // nivel 0 sin comprimir de la versión actual (para el rasterizador por software)
+} ;
+
+// *********************************************************************
+// Clase SubidorTexturas:
+// ---------------
+// envía los niveles de las imágenes de textura a la GPU por bandas de filas, a través de
+// un anillo de 'pixel buffer objects' (PBOs), sin superar un número de bytes
+// por cada llamada a 'subirPendientes' (se llama una vez en cada iteración 
+// del bucle principal). Así una imagen grande no detiene la visualización.
+// (los PBOs no se destruyen, se liberan con el contexto de OpenGL)
+
+class SubidorTexturas
+{
+   public:
+
+   // devuelve el subidor de la aplicación (lo crea la primera vez)
+   static SubidorTexturas * instancia() ;
+
+   // añade una imagen a la cola de imágenes a enviar
+   void encolar( ImagenTextura * imagen ) ;
+
+   // quita una imagen de la cola (si está), se llama al destruir la imagen
+   void cancelar( ImagenTextura * imagen ) ;
+
+   // envía bandas de las imágenes de la cola que ya están decodificadas, como mucho 
+   // 'presupuesto' bytes, devuelve true si alguna textura visible ha cambiado (se ha 
+   // creado la de baja resolución o se ha completado una versión)
+   bool subirPendientes() ;
+
+   // devuelve true si hay imágenes en la cola
+   bool hayPendientes() const { return ! cola.empty() ; }
+
+   // fija el número máximo de bytes que se envían en cada llamada a 'subirPendientes'
+   void fijarPresupuesto( const std::size_t bytes ) { presupuesto = bytes ; }
+
+   // devuelve la memoria de los PBOs
+   UsoMemoria leerUsoMemoria() const ;
+
+   // devuelve el identificador de una textura de un texel gris (se usa mientras 
+   // no hay ninguna versión de la imagen en la GPU)
+   static GLuint identTexturaProvisional() ;
+
+   private: //--------------------------------------------------------
+
+   SubidorTexturas() {}
+
+   // crea los PBOs del anillo (la primera vez)
+   void crearPBOs() ;
+
+   // copia en la textura nueva bandas de filas de los niveles de la imagen, como mucho 'max_bytes' 
+   // (al menos una banda), devuelve los bytes copiados
+   std::size_t subirBandas( ImagenTextura * imagen, const std::size_t max_bytes ) ;
+
+   static constexpr unsigned num_pbos = 3 ;
+   GLuint                    pbos[num_pbos] = { 0, 0, 0 } ;
+   unsigned                  sig_pbo = 0 ;                     // siguiente PBO del anillo a usar
+   std::size_t               tam_pbo = std::size_t( 1 ) << 20 ; // 1 MB
+   std::size_t               presupuesto = std::size_t( 4 ) << 20 ; // 4 MB por llamada
+   std::deque<ImagenTextura *> cola ;
+} ;
+
+// *********************************************************************
+// Clase ArregloTexturas:
+// ---------------
+// textura de OpenGL de tipo 'GL_TEXTURE_2D_ARRAY', con un número fijo de capas 
+// cuadradas del mismo lado y formato (con todos sus mipmaps), cada una con una 
+// imagen remuestreada a ese tamaño (las coordenadas de textura no cambian). 
+// Las texturas con imágenes en el mismo arreglo se activan sin cambiar la textura 
+// ligada, solo el índice de la capa (ver 'CauceBase::fijarEvalTextArreglo').
+// Los arreglos se crean cuando no hay ninguno con capas libres del lado y formato 
+// necesarios, y cada uno se destruye cuando se libera su última capa ocupada (al 
+// destruirse la última imagen que tiene, ver 'liberarCapa').
+
+class ArregloTexturas
+{
+   public:
+
+   // reserva una capa libre de un arreglo de 'lado' x 'lado' texels en el formato 'formato' 
+   // (crea el arreglo si no hay ninguno con capas libres), devuelve el arreglo y escribe el 
+   // índice de la capa en 'capa'. Se debe llamar en la hebra principal.
+   static ArregloTexturas * reservarCapa( const unsigned lado, const FormatoTexels formato, unsigned & capa ) ;
+
+   // deja libre una capa de 'arreglo' (para otra imagen), se llama al destruir la imagen. Si 
+   // no queda ninguna capa ocupada, destruye el arreglo y su textura de OpenGL (así que se 
+   // debe llamar en la hebra principal, con el contexto todavía activo)
+   static void liberarCapa( ArregloTexturas * arreglo, const unsigned capa ) ;
+
+   // devuelve el identificador de la textura de OpenGL
+   GLuint leerIdent() const { return ident ; }
+
+   // lado de las capas para una imagen de 'ancho' x 'alto' texels: la mayor potencia de dos 
+   // que no supera su lado mayor (como mucho 'lado_max_capa')
+   static unsigned ladoCapa( const unsigned ancho, const unsigned alto ) ;
+
+   // devuelve la memoria de todos los arreglos (de todas sus capas, ocupadas o no)
+   static UsoMemoria leerUsoMemoriaTotal() ;
+
+   static constexpr unsigned 
+      lado_max_capa = 1024 ,
+      num_capas     = 8 ;
+
+   private: //--------------------------------------------------------
+
+   ArregloTexturas( const unsigned p_lado, const FormatoTexels p_formato ) ;
+
+   GLuint            ident   = 0 ;
+   unsigned          lado    = 0 ;
+   FormatoTexels     formato = FormatoTexels::rgb ;
+   std::size_t       bytes   = 0 ;  // bytes de todas las capas en la GPU
+   std::vector<bool> ocupada ;      // para cada capa, true si tiene una imagen
+
+   static inline std::vector<ArregloTexturas *> 
+      arreglos ;  // todos los arreglos creados
+} ;
+
 // *********************************************************************
 // Clase Textura:
 // ---------------
 // clase que encapsula una imagen de textura de OpenGL, así como los
 // parámetros relativos a como se aplica  a las primitivas que se dibujen
-// mientras está activa
+// mientras está activa. La imagen se comparte (a través de la caché de 
+// recursos) con las demás texturas leídas del mismo archivo.
 
 class Textura
 {
    public:
 
-   // carga una imagen de textura en la memoria de vídeo, e
-   // inicializa los atributos de la textura a valores por defecto.
+   // obtiene la imagen de textura de la caché de recursos (que la lee solo si
+   // no la usa ya otra textura), e inicializa los atributos de la textura a 
+   // valores por defecto.
    // El nombre del archivo debe ir sin el 'path', se busca en 'materiales/imgs' y si 
    // no está se busca en 'archivos-alumno'
    Textura( const std::string & nombreArchivoJPG ) ;
 
-   // libera la memoria dinámica usada por la textura, si hay alguna
+   // deja de usar la imagen (se libera si era la última textura que la usaba)
    ~Textura() ;
 
    // activar una textura en un cauce base (el cauce base tiene funcionalidad de texturas)
    void activar( CauceBase * cauce ) ;
 
-   protected: //--------------------------------------------------------
+   // contadores de activaciones y de bytes de texels enviados a la GPU (de todas las 
+   // texturas, ver 'EstadisticasRender')
+   static inline ContadoresTextura contadores ;
 
-   void enviar() ;    // envia la imagen a la GPU (gluBuild2DMipmaps)
+   // devuelve el modo de generación de coordenadas de textura
+   ModoGenCT leerModoGenCT() const { return modo_gen_ct ; }
 
-   std::string 
-      nombre_archivo = "no asignado"; // nombre del archivo de imagen de textura
+   // devuelve la imagen (compartida) de la textura
+   const ImagenTextura * leerImagen() const { return imagen.get() ; }
 
-   bool
-      enviada       = false ; // true si ha sido enviada, false en otro caso
-   GLuint
-      ident_textura = -1 ;// 'nombre' o identif. de textura para OpenGL
-   unsigned
-      ancho         = 0,  // número de columnas de la imagen
-      alto          = 0 ; // número de filas de la imagen
-   unsigned char *
-      imagen        = nullptr ; // pixels de la imagen, por filas.
+   // devuelve la memoria ocupada por la imagen en la CPU y por la textura (con sus 
+   // mipmaps) en la GPU, si ya se ha enviado
+   UsoMemoria leerUsoMemoria() const ;
+
+   protected: //--------------------------------------------------------
+
+   std::shared_ptr<ImagenTextura>
+      imagen ;   // imagen y textura de OpenGL (compartidas)
    ModoGenCT
       modo_gen_ct   = mgct_desactivada ;  // modo de generacion de coordenadas de textura
    float
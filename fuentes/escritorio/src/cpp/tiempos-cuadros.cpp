@@ -0,0 +1,295 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Medida de los tiempos por cuadro y detección de tirones (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <algorithm>  // std::min, std::max, std::sort
+#include <bit>        // std::bit_width
+#include <map>
+#include "utilidades.h"
+#include "tiempos-cuadros.h"
+
+// ******************************************************************************************************
+// HistogramaTiempos
+// ------------------------------------------------------------------------------------------------------
+
+unsigned HistogramaTiempos::indice( const uint64_t us )
+{
+   const uint64_t v = std::min( us, ( uint64_t(1) << (max_exp+1) ) - 1 );
+   if ( v < num_sub )
+      return unsigned( v );
+
+   // 'v >> e' está entre num_sub/2 y num_sub-1
+   const unsigned e = std::bit_width( v ) - bits_sub ;
+   return num_sub + (e-1)*(num_sub/2) + unsigned( v >> e ) - num_sub/2 ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+uint64_t HistogramaTiempos::limiteInferior( const unsigned ind )
+{
+   if ( ind < num_sub )
+      return ind ;
+   const unsigned k = ind - num_sub ,
+                  e = k/(num_sub/2) + 1 ;
+   return uint64_t( k % (num_sub/2) + num_sub/2 ) << e ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+uint64_t HistogramaTiempos::limiteSuperior( const unsigned ind )
+{
+   if ( ind < num_sub )
+      return ind+1 ;
+   const unsigned k = ind - num_sub ,
+                  e = k/(num_sub/2) + 1 ;
+   return uint64_t( k % (num_sub/2) + num_sub/2 + 1 ) << e ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HistogramaTiempos::agregar( const uint64_t us )
+{
+   cuentas[ indice( us ) ]++ ;
+   num_valores++ ;
+   max_valor = std::max( max_valor, us );
+}
+// ------------------------------------------------------------------------------------------------------
+
+uint64_t HistogramaTiempos::percentil( const double p ) const
+{
+   assert( 0.0 <= p && p <= 100.0 );
+   if ( num_valores == 0 )
+      return 0 ;
+
+   // (mismo criterio que 'Percentil': el primer valor cuyo rango alcanza el 'p' % de los valores)
+   const uint64_t rango = std::max( uint64_t(1), uint64_t( std::ceil( p/100.0*double( num_valores ) ) ) );
+   uint64_t       suma  = 0 ;
+   for( unsigned i = 0 ; i < num_inter ; i++ )
+   {
+      suma += cuentas[i] ;
+      if ( suma >= rango )
+         return std::min( limiteSuperior( i ), max_valor );
+   }
+   return max_valor ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void HistogramaTiempos::imprimir( std::ostream & os ) const
+{
+   using namespace std ;
+   constexpr unsigned ancho_barra = 40 ;
+
+   // agrupar los intervalos por potencias de dos: la fila 'r' tiene los valores entre 2^r y 2^(r+1)
+   // (la fila 0 también tiene el 0)
+   vector<uint64_t> filas( max_exp+2, 0 );
+   for( unsigned i = 0 ; i < num_inter ; i++ )
+   {
+      const uint64_t inf = limiteInferior( i );
+      filas[ inf == 0 ? 0 : std::bit_width( inf ) - 1 ] += cuentas[i] ;
+   }
+   const auto primera = find_if( filas.begin(), filas.end(), []( uint64_t c ) { return c > 0 ; } );
+   if ( primera == filas.end() )
+   {  os << "   (sin valores)" << endl ;
+      return ;
+   }
+   const unsigned r0       = primera - filas.begin() ,
+                  r1       = filas.rend() - find_if( filas.rbegin(), filas.rend(), []( uint64_t c ) { return c > 0 ; } );
+   const uint64_t max_fila = *max_element( filas.begin(), filas.end() );
+
+   ios estado_anterior( nullptr );
+   estado_anterior.copyfmt( os );
+   os << fixed << setprecision( 3 );
+   for( unsigned r = r0 ; r < r1 ; r++ )
+   {
+      const unsigned largo = unsigned( ( filas[r]*ancho_barra + max_fila-1 )/max_fila );
+      os << "   [" << setw(9) << double( r == 0 ? 0 : uint64_t(1) << r )*1e-3 << ", "
+         << setw(9) << double( uint64_t(1) << (r+1) )*1e-3 << ") ms: "
+         << setw(7) << filas[r] << " " << string( largo, '#' ) << endl ;
+   }
+   os.copyfmt( estado_anterior );
+}
+
+// ******************************************************************************************************
+// MedidorCuadros
+// ------------------------------------------------------------------------------------------------------
+
+MedidorCuadros * MedidorCuadros::instancia()
+{
+   static MedidorCuadros medidor ;
+   return &medidor ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+MedidorCuadros::MedidorCuadros()
+{
+   anillo_ms.resize( capacidad_anillo, 0.0 );
+   fin_cuadro_anterior_ns = Perfilador::instanteNs() ;
+
+   // (sin zonas en el código, los tirones se registran igual pero sin zonas)
+   Perfilador::instancia()->fijarRegistroContinuo( true );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::sumarTrabajo( const int64_t inicio_ns )
+{
+   const int64_t ahora_ns = Perfilador::instanteNs(),
+                 desde_ns = std::max( inicio_ns, fin_cuadro_anterior_ns );
+   if ( desde_ns < ahora_ns )
+      trabajo_ns += ahora_ns - desde_ns ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::inicioVisualizacion()
+{
+   inicio_vis_ns = Perfilador::instanteNs() ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool MedidorCuadros::finCuadro( const EstadisticasRender & estadisticas )
+{
+   const int64_t ahora_ns = Perfilador::instanteNs(),
+                 vis_ns   = inicio_vis_ns < 0 ? 0 : ahora_ns - std::max( inicio_vis_ns, fin_cuadro_anterior_ns );
+   const double  ms       = double( trabajo_ns + vis_ns )*1e-6 ;
+
+   anillo_ms[ num_cuadros % capacidad_anillo ] = ms ;
+   histograma.agregar( uint64_t( ms*1e3 ) );
+
+   ultimo_tiron = ms > presupuesto_ms ;
+   if ( ultimo_tiron )
+   {
+      tirones.push_back( { .num_cuadro = num_cuadros, .ms = ms, .estadisticas = estadisticas, .zonas = zonasCuadro( ahora_ns ) } );
+      if ( tirones.size() > max_tirones )
+         tirones.pop_front();
+      num_tirones++ ;
+   }
+
+   num_cuadros++ ;
+   fin_cuadro_anterior_ns = ahora_ns ;
+   inicio_vis_ns          = -1 ;
+   trabajo_ns             = 0 ;
+   return ultimo_tiron ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::vector<ZonaTiron> MedidorCuadros::zonasCuadro( const int64_t fin_ns ) const
+{
+   using namespace std ;
+
+   vector<EventoPerfil> eventos ;
+   Perfilador::instancia()->leerEventosHebra( fin_cuadro_anterior_ns, fin_ns, eventos );
+
+   map<string,ZonaTiron> por_nombre ;
+   for( const EventoPerfil & ev : eventos )
+   {
+      ZonaTiron & zona = por_nombre[ ev.nombre ] ;
+      zona.nombre = ev.nombre ;
+      zona.ms    += double( ev.fin_ns - ev.inicio_ns )*1e-6 ;
+      zona.veces ++ ;
+   }
+
+   vector<ZonaTiron> zonas ;
+   for( const auto & [nombre, zona] : por_nombre )
+      zonas.push_back( zona );
+   sort( zonas.begin(), zonas.end(), []( const ZonaTiron & a, const ZonaTiron & b ) { return a.ms > b.ms ; } );
+   if ( zonas.size() > max_zonas_tiron )
+      zonas.resize( max_zonas_tiron );
+   return zonas ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::fijarPresupuesto( const double ms )
+{
+   assert( 0.0 < ms );
+   presupuesto_ms = ms ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::imprimirPercentilesRecientes( std::ostream & os ) const
+{
+   using namespace std ;
+
+   const unsigned n = std::min( num_cuadros, uint64_t( capacidad_anillo ) );
+   if ( n == 0 )
+   {  os << "Tiempos por cuadro: no se ha visualizado ningún cuadro." << endl ;
+      return ;
+   }
+   const vector<double> recientes( anillo_ms.begin(), anillo_ms.begin() + n );
+
+   ios estado_anterior( nullptr );
+   estado_anterior.copyfmt( os );
+   os << fixed << setprecision( 2 )
+      << "Tiempos por cuadro (últimos " << n << "): p50 " << Percentil( recientes, 50.0 ) << " ms, p95 "
+      << Percentil( recientes, 95.0 ) << " ms, p99 " << Percentil( recientes, 99.0 ) << " ms, máx. "
+      << Percentil( recientes, 100.0 ) << " ms (presupuesto " << presupuesto_ms << " ms, " << num_tirones << " tirones)." << endl ;
+   os.copyfmt( estado_anterior );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::imprimirTiron( std::ostream & os, const TironCuadro & tiron )
+{
+   using namespace std ;
+
+   ios estado_anterior( nullptr );
+   estado_anterior.copyfmt( os );
+   os << fixed << setprecision( 2 )
+      << "Tirón en el cuadro " << tiron.num_cuadro << ": " << tiron.ms << " ms" << endl ;
+   if ( ! tiron.zonas.empty() )
+   {
+      os << "   zonas:    " ;
+      for( unsigned i = 0 ; i < tiron.zonas.size() ; i++ )
+         os << (i > 0 ? ", " : "") << tiron.zonas[i].nombre << " " << tiron.zonas[i].ms << " ms (x" << tiron.zonas[i].veces << ")" ;
+      os << endl ;
+   }
+   os.copyfmt( estado_anterior );
+   tiron.estadisticas.imprimir( os );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::imprimirCuadro( std::ostream & os ) const
+{
+   if ( ultimo_tiron )
+      imprimirTiron( os, tirones.back() );
+   if ( num_cuadros % cuadros_linea == 0 )
+      imprimirPercentilesRecientes( os );
+}
+// ------------------------------------------------------------------------------------------------------
+
+void MedidorCuadros::imprimirInforme( std::ostream & os ) const
+{
+   using namespace std ;
+
+   os << endl << "Informe de tiempos por cuadro (" << num_cuadros << " cuadros):" << endl ;
+   imprimirPercentilesRecientes( os );
+
+   ios estado_anterior( nullptr );
+   estado_anterior.copyfmt( os );
+   os << fixed << setprecision( 2 )
+      << "Histograma de todos los cuadros: p50 " << double( histograma.percentil( 50.0 ) )*1e-3 << " ms, p90 "
+      << double( histograma.percentil( 90.0 ) )*1e-3 << " ms, p99 " << double( histograma.percentil( 99.0 ) )*1e-3
+      << " ms, p99.9 " << double( histograma.percentil( 99.9 ) )*1e-3 << " ms, máx. " << double( histograma.maximo() )*1e-3 << " ms" << endl ;
+   os.copyfmt( estado_anterior );
+   histograma.imprimir( os );
+
+   if ( tirones.empty() )
+      os << "No ha habido tirones." << endl ;
+   else
+   {  os << "Tirones (" << num_tirones << " en total, se muestran los " << tirones.size() << " últimos):" << endl ;
+      for( const TironCuadro & tiron : tirones )
+         imprimirTiron( os, tiron );
+   }
+}
@@ -0,0 +1,190 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Medida de los tiempos por cuadro y detección de tirones (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de las clases
+// **
+// **  + HistogramaTiempos: histograma de tiempos con intervalos de anchura proporcional al
+// **                       valor (como los histogramas 'HDR'), con error relativo acotado
+// **  + MedidorCuadros:    mide el tiempo de trabajo de cada cuadro, guarda los últimos en un
+// **                       buffer circular (percentiles recientes) y todos en un histograma, y
+// **                       registra los cuadros que superan el presupuesto ('tirones')
+// **  + TrabajoCuadro:     objeto que suma al cuadro en curso el tiempo entre su creación y su destrucción
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "estadisticas-render.h"
+#include "perfilador.h"
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Histograma de tiempos en microsegundos: los valores menores que 'num_sub' tienen un
+/// @brief intervalo cada uno, el resto se agrupan en intervalos de anchura 2^e entre 2^(e+b-1) y
+/// @brief 2^(e+b) (con 2^b == 'num_sub'), así que el error relativo es menor que 2/num_sub (~6 %)
+///
+class HistogramaTiempos
+{
+   public:
+
+   static constexpr unsigned bits_sub  = 5 ,              // 'b'
+                             num_sub   = 1u << bits_sub , // intervalos por cada potencia de dos (la mitad)
+                             max_exp   = 28 ,             // los valores mayores que 2^28 us (~4.5 min) se saturan
+                             num_inter = num_sub + (max_exp-bits_sub+1)*(num_sub/2) ;
+
+   HistogramaTiempos() : cuentas( num_inter, 0 ) {}
+
+   /// @brief Añade un valor (en microsegundos)
+   void agregar( const uint64_t us );
+
+   /// @brief Devuelve el percentil 'p' (entre 0 y 100) en microsegundos (límite superior del
+   /// @brief intervalo que lo contiene), o 0 si no hay valores
+   uint64_t percentil( const double p ) const ;
+
+   /// @brief Número de valores añadidos, y máximo de ellos
+   uint64_t numValores() const { return num_valores ; }
+   uint64_t maximo() const { return max_valor ; }
+
+   /// @brief Escribe una línea por cada potencia de dos (en milisegundos) con algún valor, con su
+   /// @brief cuenta y una barra proporcional
+   void imprimir( std::ostream & os ) const ;
+
+   private:
+
+   // índice del intervalo de un valor, y límites inferior y superior (excluido) de un intervalo
+   static unsigned indice( const uint64_t us );
+   static uint64_t limiteInferior( const unsigned ind );
+   static uint64_t limiteSuperior( const unsigned ind );
+
+   std::vector<uint64_t> cuentas ;
+   uint64_t              num_valores = 0 ,
+                         max_valor   = 0 ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Zona del perfilador durante un tirón: tiempo total (incluye el de las zonas anidadas)
+///
+struct ZonaTiron
+{
+   std::string nombre ;
+   double      ms    = 0.0 ;
+   unsigned    veces = 0 ;
+} ;
+
+/// @brief Cuadro cuyo tiempo ha superado el presupuesto, con las estadísticas del cuadro y las
+/// @brief zonas de la hebra principal que más tiempo han ocupado
+///
+struct TironCuadro
+{
+   uint64_t               num_cuadro = 0 ;
+   double                 ms         = 0.0 ;
+   EstadisticasRender     estadisticas ;
+   std::vector<ZonaTiron> zonas ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Medidor de los tiempos por cuadro de la aplicación (hay una sola instancia, se usa en la
+/// @brief hebra principal). El tiempo de un cuadro es el tiempo de trabajo desde el cuadro anterior:
+/// @brief el de visualizarlo más el de los gestores de eventos y las cargas que se han procesado antes,
+/// @brief sin el tiempo de espera a los eventos (el bucle principal no visualiza cuadros si no hay cambios).
+///
+class MedidorCuadros
+{
+   public:
+
+   static constexpr unsigned capacidad_anillo = 512 ,  // cuadros recientes guardados
+                             max_tirones      = 128 ,  // tirones guardados (los más recientes)
+                             max_zonas_tiron  = 8 ,    // zonas guardadas de cada tirón
+                             cuadros_linea    = 20 ;   // cuadros entre cada dos líneas de 'imprimirCuadro'
+
+   /// @brief Devuelve el medidor de la aplicación (lo crea la primera vez, y activa el registro
+   /// @brief continuo del perfilador para conocer las zonas de los tirones)
+   static MedidorCuadros * instancia() ;
+
+   /// @brief Suma al cuadro en curso un tiempo de trabajo que ha empezado en 'inicio_ns' (el tiempo
+   /// @brief anterior al final del último cuadro ya se ha contado en ese cuadro)
+   void sumarTrabajo( const int64_t inicio_ns );
+
+   /// @brief Se llama al empezar a visualizar un cuadro
+   void inicioVisualizacion() ;
+
+   /// @brief Se llama al terminar de visualizar un cuadro, con sus estadísticas: registra el tiempo
+   /// @brief del cuadro, y si supera el presupuesto registra un tirón (devuelve 'true' en ese caso)
+   bool finCuadro( const EstadisticasRender & estadisticas );
+
+   /// @brief Cambia el presupuesto de tiempo por cuadro (en milisegundos)
+   void fijarPresupuesto( const double ms );
+   double leerPresupuesto() const { return presupuesto_ms ; }
+
+   /// @brief Se llama después de cada cuadro si se quieren ver los tiempos: imprime el último tirón si el
+   /// @brief cuadro lo ha sido, y cada 'cuadros_linea' cuadros una línea con los percentiles recientes
+   void imprimirCuadro( std::ostream & os ) const ;
+
+   /// @brief Imprime un informe completo: percentiles recientes, histograma y tirones registrados
+   void imprimirInforme( std::ostream & os ) const ;
+
+   private:
+
+   MedidorCuadros() ;
+
+   // escribe una línea con los percentiles de los cuadros recientes, y las líneas de un tirón
+   void imprimirPercentilesRecientes( std::ostream & os ) const ;
+   static void imprimirTiron( std::ostream & os, const TironCuadro & tiron );
+
+   // zonas de la hebra principal en el cuadro que termina, agrupadas por nombre y ordenadas
+   std::vector<ZonaTiron> zonasCuadro( const int64_t fin_ns ) const ;
+
+   double   presupuesto_ms = 1000.0/60.0 ;
+
+   // tiempos del cuadro en curso (instantes en nanosegundos de 'Perfilador::instanteNs')
+   int64_t  fin_cuadro_anterior_ns = 0 ,   // final del último cuadro (o creación del medidor)
+            inicio_vis_ns          = -1 ,  // inicio de la visualización en curso (-1 si no hay)
+            trabajo_ns             = 0 ;   // trabajo antes de visualizar, desde el último cuadro
+
+   // buffer circular con los últimos tiempos (el cuadro 'i' en 'i % capacidad_anillo'), en ms
+   std::vector<double>     anillo_ms ;
+   uint64_t                num_cuadros = 0 ;
+   bool                    ultimo_tiron = false ;
+
+   HistogramaTiempos       histograma ;
+   std::deque<TironCuadro> tirones ;
+   uint64_t                num_tirones = 0 ;  // incluye los que ya no se guardan
+} ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Suma al cuadro en curso el tiempo de trabajo desde la creación hasta la destrucción del objeto
+/// @brief (se usa en el bucle principal y en los gestores de eventos)
+///
+class TrabajoCuadro
+{
+   public:
+   TrabajoCuadro() : inicio_ns( Perfilador::instanteNs() ) {}
+   ~TrabajoCuadro() { MedidorCuadros::instancia()->sumarTrabajo( inicio_ns ); }
+   private:
+   int64_t inicio_ns ;
+} ;
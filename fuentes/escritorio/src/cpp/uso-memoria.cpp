@@ -0,0 +1,112 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Contabilidad del uso de memoria (implementación)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#include <cstdio>     // std::snprintf
+#include <algorithm>  // std::max
+#include "uso-memoria.h"
+
+// ------------------------------------------------------------------------------------------------------
+// número de KB (redondeado hacia arriba) de un número de bytes
+
+inline std::size_t KB( const std::size_t bytes )
+{
+   return ( bytes + 1023 )/1024 ;
+}
+
+// ******************************************************************************************************
+// UsoMemoria
+// ------------------------------------------------------------------------------------------------------
+
+UsoMemoria & UsoMemoria::operator += ( const UsoMemoria & otro )
+{
+   cpu_tablas   += otro.cpu_tablas ;
+   cpu_imagenes += otro.cpu_imagenes ;
+   gpu_buffers  += otro.gpu_buffers ;
+   gpu_texturas += otro.gpu_texturas ;
+   gpu_render   += otro.gpu_render ;
+   return *this ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void UsoMemoria::imprimir( std::ostream & os ) const 
+{
+   os << "CPU " << KB( totalCPU() ) << " KB (tablas " << KB( cpu_tablas ) << ", imágenes " << KB( cpu_imagenes ) << "), "
+      << "GPU " << KB( totalGPU() ) << " KB (buffers " << KB( gpu_buffers ) << ", texturas " << KB( gpu_texturas ) 
+      << ", framebuffers " << KB( gpu_render ) << ")" ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void UsoMemoria::escribirJSON( std::ostream & os ) const 
+{
+   os << "{ \"cpu_tablas\": "   << cpu_tablas 
+      << ", \"cpu_imagenes\": " << cpu_imagenes 
+      << ", \"gpu_buffers\": "  << gpu_buffers 
+      << ", \"gpu_texturas\": " << gpu_texturas 
+      << ", \"gpu_render\": "   << gpu_render 
+      << ", \"total_cpu\": "    << totalCPU() 
+      << ", \"total_gpu\": "    << totalGPU() << " }" ;
+}
+
+// ******************************************************************************************************
+// funciones auxiliares
+// ------------------------------------------------------------------------------------------------------
+
+std::size_t BytesCadenaMipmaps( const unsigned ancho, const unsigned alto, const unsigned bytes_texel )
+{
+   std::size_t bytes = 0 ;
+   unsigned    w = ancho, h = alto ;
+
+   // cada nivel tiene la mitad de columnas y de filas que el anterior (al menos una)
+   while( w > 0 && h > 0 )
+   {
+      bytes += std::size_t( w )*std::size_t( h )*bytes_texel ;
+      if ( w == 1 && h == 1 )
+         break ;
+      w = std::max( 1u, w/2 );
+      h = std::max( 1u, h/2 );
+   }
+   return bytes ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+std::string CadenaJSON( const std::string & s )
+{
+   std::string res = "\"" ;
+   for( const char c : s )
+      switch( c )
+      {
+         case '"'  : res += "\\\"" ; break ;
+         case '\\' : res += "\\\\" ; break ;
+         case '\n' : res += "\\n" ;  break ;
+         case '\t' : res += "\\t" ;  break ;
+         default   :
+            if ( (unsigned char)( c ) < 0x20 )
+            {  char buf[8] ;
+               std::snprintf( buf, sizeof( buf ), "\\u%04x", unsigned( c ) );
+               res += buf ;
+            }
+            else 
+               res += c ;
+            break ;
+      }
+   return res + "\"" ;
+}
@@ -0,0 +1,71 @@
+// *********************************************************************
+// **
+// ** Máster en Desarrollo de Software (PCG+ARS)
+// **
+// ** Contabilidad del uso de memoria (declaración)
+// ** Copyright (C) 2016-2023 Carlos Ureña
+// **
+// ** Declaración de:
+// **
+// **  + UsoMemoria: bytes ocupados por uno o varios objetos en la CPU y en la GPU
+// **  + funciones auxiliares para calcular tamaños y escribir los informes
+// **
+// ** This program is free software: you can redistribute it and/or modify
+// ** it under the terms of the GNU General Public License as published by
+// ** the Free Software Foundation, either version 3 of the License, or
+// ** (at your option) any later version.
+// **
+// ** This program is distributed in the hope that it will be useful,
+// ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+// ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// ** GNU General Public License for more details.
+// **
+// ** You should have received a copy of the GNU General Public License
+// ** along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// **
+// *********************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Bytes de memoria ocupados por un objeto (o por un conjunto de objetos), separados 
+/// @brief según dónde están y qué contienen
+///
+struct UsoMemoria
+{
+   std::size_t cpu_tablas   = 0 , // tablas de atributos, índices y matrices en la memoria de la aplicación
+               cpu_imagenes = 0 , // imágenes de texturas en la memoria de la aplicación
+               gpu_buffers  = 0 , // buffers de atributos e índices en la GPU
+               gpu_texturas = 0 , // texturas en la GPU (incluyendo todos los niveles de mipmap)
+               gpu_render   = 0 ; // destinos de rendering de los framebuffers (color y profundidad)
+
+   /// @brief Suma otro uso de memoria a este
+   UsoMemoria & operator += ( const UsoMemoria & otro );
+
+   /// @brief Totales en la CPU y en la GPU
+   std::size_t totalCPU() const { return cpu_tablas + cpu_imagenes ; }
+   std::size_t totalGPU() const { return gpu_buffers + gpu_texturas + gpu_render ; }
+
+   /// @brief Escribe en 'os' los totales y el desglose en KB, en una línea (sin el salto de línea)
+   void imprimir( std::ostream & os ) const ;
+
+   /// @brief Escribe en 'os' un objeto JSON con los valores en bytes
+   void escribirJSON( std::ostream & os ) const ;
+} ;
+
+// --------------------------------------------------------------------------------------------
+/// @brief Devuelve el número de bytes de una textura de 'ancho' x 'alto' texels, con 'bytes_texel'
+/// @brief bytes por texel, incluyendo toda la cadena de mipmaps (hasta el nivel de 1x1)
+///
+std::size_t BytesCadenaMipmaps( const unsigned ancho, const unsigned alto, const unsigned bytes_texel );
+
+// --------------------------------------------------------------------------------------------
+/// @brief Devuelve una cadena JSON (entre comillas) con el texto 's', escapando los caracteres
+/// @brief que lo requieren
+///
+std::string CadenaJSON( const std::string & s );
@@ -35,6 +35,7 @@
 #include "utilidades.h"
 #include "vaos-vbos.h"
 #include "aplic-3d.h"
+#include "rasterizador-cpu.h"
 
 // *********************************************************************
 // gestion de errores
@@ -127,6 +128,10 @@ std::string ErrorCodeString( GLenum errorCode )
 
 void CompruebaErrorOpenGL( const char * nomArchivo, int linea )
 {
+   // con el rasterizador por software no hay contexto de OpenGL
+   if ( RasterizadorCPU::activo() )
+      return ;
+
    const GLint codigoError = glGetError() ;
 
    if ( codigoError != GL_NO_ERROR )
@@ -250,6 +255,12 @@ void InicializaGLEW(  ) // necesario para Linux y resto de SS.OO. excepto MAC
    Error("no se han incluido los headers de GLEW correctamente, usa '#include <utilidades.hpp>' para incluir símbolos de OpenGL/GLFW/GLEW") ;
 #else
    GLenum codigoError = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+   // con un contexto de EGL (sin ventana) no hay 'display' de GLX, pero las funciones 
+   // de OpenGL ya se han cargado antes de comprobarlo
+   if ( codigoError == GLEW_ERROR_NO_GLX_DISPLAY )
+      codigoError = GLEW_OK ;
+#endif
    if ( codigoError != GLEW_OK ) // comprobar posibles errores
    {
       const std::string errmsg =
@@ -542,7 +553,8 @@ void DibujarEjesSolido( Cauce3D & cauce )
    // no se usa iluminación ni texturas, se dibuja relleno. 
    cauce.fijarEvalMIL( false );
    cauce.fijarEvalText( false );
-   glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+   if ( ! RasterizadorCPU::activo() )
+      glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
 
    // dibujar ejes:
 
@@ -576,61 +588,18 @@ void DibujarEjesSolido( Cauce3D & cauce )
 
 
 // -----------------------------------------------------------------------------
-// imprimie en 'cout' una línea con información de la frecuencia con la que se llama
-// a la función
 
-void ImprimirFPS()
+double Percentil( std::vector<double> valores, const double p )
 {
-   using namespace std ; 
-   using namespace std::chrono ;
-
-   // tipo para duraciones en segundos
-   typedef duration<float,ratio<1,1>> DuracionSegs ;
-
-   
-   constexpr int  num_cuadros = 20 ;   // numero de frames entre impresiones de los FPS
-   static int     count       = 0 ;    // cuenta de frames
-   static bool    primera_vez = true ;
-
-   // instante final del cuadro anterior (excepto en la 1a llamada)
-   static time_point<steady_clock> fin_cuadro_anterior ;
-
-   // saltar 'num_cuadros' veces la impresión
-   if ( count % num_cuadros != 0 )
-   {
-      count++ ;
-      return ;
-   }
-
-   // registrar instante actual
-   time_point<steady_clock> fin_cuadro_actual = steady_clock::now() ;
-
-
-   // si no es la primera vez, calcular e imprimir
-   if ( ! primera_vez )
-   {
-      const float segundos_cuadro = (DuracionSegs( fin_cuadro_actual - fin_cuadro_anterior )).count()/float(num_cuadros) ,
-                  fps             = 1.0/segundos_cuadro ;
-
-      // guardar flags de formato de 'cout'
-      ios estado_anterior( nullptr );
-      estado_anterior.copyfmt( cout );
-
-      // imprimir cambiando los flags
-      cout << fixed << setprecision( 1 )
-           << setw(5) << fps << "FPS "
-           << "(" << setw(5) <<  (segundos_cuadro*1000.0) << " ms)."
-           << defaultfloat << endl ;
+   assert( 0 < valores.size() );
+   assert( 0.0 <= p && p <= 100.0 );
 
-      // restaurar formato de 'cout'
-      cout.copyfmt( estado_anterior );
-   }
-   count ++ ;
-   primera_vez = false ;
-   fin_cuadro_anterior = fin_cuadro_actual ;
+   // rango (desde 1) del valor buscado en la secuencia ordenada (no hace falta ordenarla entera)
+   const std::size_t rango = std::max( std::size_t( 1 ), std::size_t( std::ceil( p*0.01*double( valores.size() ) ) ) );
+   std::nth_element( valores.begin(), valores.begin()+(rango-1), valores.end() );
+   return valores[rango-1] ;
 }
 
-
 // ----------------------------------------------------------------------------
 //
 void DibujarFBO( Cauce3D & cauce, Framebuffer & fbo )
@@ -779,16 +748,14 @@ std::string PathCarpeta( const std::string & carpeta, unsigned int n )
 
 std::string PathCarpetaMateriales(  )
 {
-   static bool primera = true ;
-   static std::string path ;
-
-   if ( primera )
+   // se calcula una sola vez, en la primera llamada (la inicialización de una variable 
+   // local estática es segura aunque se llame a la vez desde varias hebras)
+   static const std::string path = []()
    {
-      path = PathCarpeta( "materiales", 8 );
-      primera = false ;
-      std::cout << "Carpeta de materiales encontrada en: [" << path << "]" << std::endl ;
-      return path ;
-   }
+      const std::string p = PathCarpeta( "materiales", 8 );
+      std::cout << "Carpeta de materiales encontrada en: [" << p << "]" << std::endl ;
+      return p ;
+   }();
 
    return path ;
 }
@@ -798,16 +765,13 @@ std::string PathCarpetaMateriales(  )
 
 std::string PathCarpetaArchivosVarios(  )
 {
-   static bool        primera = true ;
-   static std::string path ;
-
-   if ( primera )
+   // se calcula una sola vez (ver 'PathCarpetaMateriales')
+   static const std::string path = []()
    {
-      path = PathCarpeta( "materiales/varios", 8 );
-      primera = false ;
-      std::cout << "Carpeta de archivos 'varios' encontrada en: [" << path << "]" << std::endl ;
-      return path ;
-   }
+      const std::string p = PathCarpeta( "materiales/varios", 8 );
+      std::cout << "Carpeta de archivos 'varios' encontrada en: [" << p << "]" << std::endl ;
+      return p ;
+   }();
 
    return path ;
 }
@@ -817,16 +781,13 @@ std::string PathCarpetaArchivosVarios(  )
 
 std::string PathCarpetaFuentesShaders(  )
 {
-   static bool        primera = true ;
-   static std::string path ;
-
-   if ( primera )
+   // se calcula una sola vez (ver 'PathCarpetaMateriales')
+   static const std::string path = []()
    {
-      path = PathCarpeta( "src/shaders", 8 );
-      primera = false ;
-      std::cout << "Carpeta de fuentes de shaders encontrada en: [" << path << "]" << std::endl ;
-      return path ;
-   }
+      const std::string p = PathCarpeta( "src/shaders", 8 );
+      std::cout << "Carpeta de fuentes de shaders encontrada en: [" << p << "]" << std::endl ;
+      return p ;
+   }();
 
    return path ;
 }
@@ -1156,4 +1117,13 @@ bool SustituirTriangulosPorParches()
    return sust ;
 
 }
+// ------------------------------------------------------------------------------ 
+
+void FijarDecodPosiciones( const bool decod_pos, const glm::vec3 & escala, const glm::vec3 & despl )
+{
+   const auto apl3d   = Aplicacion3D::instancia() ; 
+   const auto cauce3d = (apl3d != nullptr) ? apl3d->cauce3D() : nullptr ;
+   if ( cauce3d != nullptr )
+      cauce3d->fijarDecodPosiciones( decod_pos, escala, despl );
+}
 
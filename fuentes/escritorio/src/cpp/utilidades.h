@@ -210,9 +210,9 @@ void DibujarEjesSolido( Cauce3D & cauce );
 void DibujarEjesLineas( Cauce3D & cauce );
 
 // -----------------------------------------------------------------------------
-/// @brief imprimie en 'cout' una línea con información de la frecuencia con la que se llama
-/// @brief a la función
-void ImprimirFPS();
+/// @brief devuelve el percentil 'p' (entre 0 y 100) de una secuencia no vacía de valores: el menor
+/// @brief de ellos que es mayor o igual que el 'p' % de los valores (método del rango más cercano)
+double Percentil( std::vector<double> valores, const double p );
 
 // -----------------------------------------------------------------------------
 /// @brief dibujar una cruz
@@ -320,3 +320,10 @@ void VisualizarCuadrado();
 /// @brief Devuelve true si el cauce necesita que se envíen parches en lugar de triángulos
 ///
 bool SustituirTriangulosPorParches() ;
+
+// ---------------------------------------------------------------------
+
+/// @brief Activa o desactiva, en el cauce 3D de la aplicación (si hay), la decodificación de las 
+/// @brief posiciones cuantizadas de los vértices (posición = despl + escala*valor entero)
+///
+void FijarDecodPosiciones( const bool decod_pos, const glm::vec3 & escala, const glm::vec3 & despl ) ;
@@ -26,8 +26,11 @@
 // **
 // *********************************************************************
 
+#include <glm/gtc/packing.hpp> // funciones 'packSnorm3x10_1x2', 'packUnorm4x8' y 'packHalf2x16'
 #include "aplic-3d.h"
 #include "vaos-vbos.h"
+#include "perfilador.h"
+#include "rasterizador-cpu.h"
     
 constexpr GLsizei stride = 0 ;
 constexpr void *  offset = 0 ;
@@ -42,6 +45,9 @@ constexpr inline GLsizeiptr size_in_bytes( const GLenum type )
    {
       case GL_FLOAT          : return sizeof( float );          break ;
       case GL_DOUBLE         : return sizeof( double );         break ;
+      case GL_HALF_FLOAT     : return sizeof( GLhalf );         break ;
+      case GL_BYTE           : return sizeof( char );           break ;
+      case GL_SHORT          : return sizeof( short );          break ;
       case GL_UNSIGNED_BYTE  : return sizeof( unsigned char );  break ;
       case GL_UNSIGNED_SHORT : return sizeof( unsigned short ); break ;
       case GL_UNSIGNED_INT   : return sizeof( unsigned int );   break ;
@@ -49,12 +55,26 @@ constexpr inline GLsizeiptr size_in_bytes( const GLenum type )
    }
 }
 
+// ------------------------------------------------------------------------------------------------------
+// devuelve el tamaño en bytes de una tupla de 'size' valores de tipo 'type' (en los tipos 
+// empaquetados, la tupla completa ocupa un entero de 32 bits)
+
+constexpr inline GLsizeiptr tuple_size_in_bytes( const GLenum type, const GLint size )
+{
+   if ( type == GL_INT_2_10_10_10_REV )
+      return sizeof( GLuint );
+   return size*size_in_bytes( type );
+}
+
 // ----------------------------------------------------------------------------
 // 
 constexpr inline void comprobar_tipo_atrib( const GLenum type )
 {
-   assert( type == GL_FLOAT  || 
-           type == GL_DOUBLE );
+   assert( type == GL_FLOAT      || type == GL_DOUBLE         || 
+           type == GL_HALF_FLOAT || 
+           type == GL_BYTE       || type == GL_UNSIGNED_BYTE  ||
+           type == GL_SHORT      || type == GL_UNSIGNED_SHORT ||
+           type == GL_INT_2_10_10_10_REV );
 }
 
 // ----------------------------------------------------------------------------
@@ -66,6 +86,17 @@ constexpr inline void check_indices_type( const GLenum type )
            type == GL_UNSIGNED_INT   );
 }
 
+// ------------------------------------------------------------------------------------------------------
+// mueve un vector a la memoria dinámica (sin copiar sus datos), escribe en 'datos' la dirección de 
+// los datos y devuelve el puntero propietario (que los libera cuando deja de haber referencias)
+
+template< class T > std::shared_ptr<void> MoverAMemoriaDinamica( std::vector<T> && vec, void * & datos )
+{
+   auto propietario = std::make_shared< std::vector<T> >( std::move( vec ) );
+   datos = propietario->data();
+   return propietario ;
+}
+
 // ------------------------------------------------------------------------------------------------------
 // comprueba que el modo es válido para las llamadas glDrawArrays y glDrawElements
 
@@ -88,7 +119,7 @@ DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, const GLenum p_type, con
    size     = p_size ;
    count    = p_count ;
    data     = p_data ;
-   tot_size = size*count*size_in_bytes( type );
+   tot_size = count*tuple_size_in_bytes( type, size );
 
    copiarDatos();
    comprobar() ; 
@@ -124,6 +155,106 @@ DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, const std::vector<glm::v
    comprobar();
 }
 
+// ----------------------------------------------------------------------------
+
+DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, const std::vector<glm::mat4> & src_vec )
+{
+   index    = p_index ;
+   type     = GL_FLOAT ;
+   size     = 4 ;
+   num_cols = 4 ;
+   count    = src_vec.size();
+   data     = src_vec.data();
+   tot_size = num_cols*size*count*size_in_bytes( type );
+   
+   copiarDatos();
+   comprobar();
+}
+
+// ----------------------------------------------------------------------------
+
+DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, const std::vector<glm::mat3> & src_vec )
+{
+   index    = p_index ;
+   type     = GL_FLOAT ;
+   size     = 3 ;
+   num_cols = 3 ;
+   count    = src_vec.size();
+   data     = src_vec.data();
+   tot_size = num_cols*size*count*size_in_bytes( type );
+   
+   copiarDatos();
+   comprobar();
+}
+
+// ----------------------------------------------------------------------------
+
+DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, std::vector<glm::vec3> && src_vec )
+{
+   index    = p_index ;
+   type     = GL_FLOAT ;
+   size     = 3 ;
+   count    = src_vec.size();
+   tot_size = size*count*size_in_bytes( type );
+
+   datos_cpu = MoverAMemoriaDinamica( std::move( src_vec ), own_data );
+   data      = own_data ;
+   comprobar();
+}
+
+// ----------------------------------------------------------------------------
+
+DescrVBOAtribs::DescrVBOAtribs( const unsigned p_index, std::vector<glm::vec2> && src_vec )
+{
+   index    = p_index ;
+   type     = GL_FLOAT ;
+   size     = 2 ;
+   count    = src_vec.size();
+   tot_size = size*count*size_in_bytes( type );
+
+   datos_cpu = MoverAMemoriaDinamica( std::move( src_vec ), own_data );
+   data      = own_data ;
+   comprobar();
+}
+
+// --------------------------------------------------------------------------------------
+
+void DescrVBOAtribs::fijarDivisor( const unsigned p_divisor )
+{
+   assert( buffer == 0 ); // el divisor se registra en el VAO al crear el VBO
+   divisor = p_divisor ;
+}
+
+// --------------------------------------------------------------------------------------
+
+void DescrVBOAtribs::fijarNormalizado( const bool p_normalizado )
+{
+   assert( buffer == 0 ); // el formato se registra en el VAO al crear el VBO
+   normalizado = p_normalizado ? GL_TRUE : GL_FALSE ;
+}
+
+// --------------------------------------------------------------------------------------
+
+void DescrVBOAtribs::actualizarDatos( const void * p_data )
+{
+   assert( own_data != nullptr );
+   if ( p_data != nullptr && p_data != own_data )
+      std::memcpy( own_data, p_data, tot_size );
+
+   if ( buffer != 0 )
+   {
+      // se pasa un puntero nulo antes de copiar para que el driver no tenga que esperar a que 
+      // terminen de usarse los datos anteriores ('orphaning')
+      CError();
+      glBindBuffer( GL_ARRAY_BUFFER, buffer );
+      glBufferData( GL_ARRAY_BUFFER, tot_size, nullptr, GL_DYNAMIC_DRAW );
+      glBufferSubData( GL_ARRAY_BUFFER, 0, tot_size, data );
+      glBindBuffer( GL_ARRAY_BUFFER, 0 );
+      DescrVAO::contadores.bytes_subidos += tot_size ;
+      CError();
+   }
+}
+
 // --------------------------------------------------------------------------------------
 
 void DescrVBOAtribs::copiarDatos()
@@ -132,10 +263,21 @@ void DescrVBOAtribs::copiarDatos()
    assert( 0 < tot_size );        // 'tot_size' debe tener el tamaño total de los datos
    assert( own_data == nullptr ); // impide copiar los datos dos veces 
 
-   own_data = new unsigned char [tot_size] ; // reservar memoria
-   assert( own_data != nullptr );            // comprobar que se ha podido reservar la memoria
-   std::memcpy( own_data, data, tot_size );  // copiar bytes
-   data = own_data ;                         // apuntar a los datos propios
+   const unsigned char * origen = (const unsigned char *) data ;
+   std::vector<unsigned char> copia( origen, origen + tot_size );      // copiar bytes
+   datos_cpu = MoverAMemoriaDinamica( std::move( copia ), own_data );  // pasar a ser el propietario
+   data = own_data ;                                                   // apuntar a los datos propios
+}
+
+// --------------------------------------------------------------------------------------
+
+void DescrVBOAtribs::liberarDatosCPU()
+{
+   assert( divisor == 0 ); // las tablas por instancia se actualizan desde la CPU
+   datos_cpu.reset();
+   data            = nullptr ;
+   own_data        = nullptr ;
+   datos_liberados = true ;
 }
 
 // --------------------------------------------------------------------------------------
@@ -144,12 +286,14 @@ void DescrVBOAtribs::comprobar() const
 {
    comprobar_tipo_atrib( type );
 
-   assert( data != nullptr );
+   assert( data != nullptr || datos_liberados );
    assert( 0 < count );
    assert( own_data == nullptr || own_data == data );
    assert( 1 <= size && size <= 4 ); 
-   assert( type == GL_FLOAT || type == GL_DOUBLE );
-   assert( tot_size == size*count*size_in_bytes( type ));
+   assert( num_cols == 1 || ( num_cols == GLuint( size ) && 3 <= size && type == GL_FLOAT ));
+   assert( type != GL_INT_2_10_10_10_REV || size == 4 );
+   assert( normalizado == GL_FALSE || ( type != GL_FLOAT && type != GL_DOUBLE && type != GL_HALF_FLOAT ));
+   assert( tot_size == num_cols*count*tuple_size_in_bytes( type, size ));
 }
 
 // ------------------------------------------------------------------------------------------------------
@@ -159,6 +303,7 @@ void DescrVBOAtribs::crearVBO()
    // comprobar precondiciones
    CError();
    assert( buffer == 0 );  
+   assert( data != nullptr ); // los datos deben estar todavía en la CPU
    comprobar();
 
    // Crea el VBO (transferir datos y registrar metadatos), 
@@ -170,16 +315,32 @@ void DescrVBOAtribs::crearVBO()
    glBindBuffer( GL_ARRAY_BUFFER, buffer ); 
 
    // 3. transfiere los datos desde la memoria de la aplicación al VBO en GPU
-   glBufferData( GL_ARRAY_BUFFER, tot_size, data, GL_STATIC_DRAW );  
+   //    (las tablas por instancia se suelen actualizar en cada cuadro)
+   glBufferData( GL_ARRAY_BUFFER, tot_size, data, divisor > 0 ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW );  
+   DescrVAO::contadores.bytes_subidos += tot_size ;
       
    // 4. indicar, para este índice de atributo, la localización y el formato de la tabla en el buffer 
-   glVertexAttribPointer( index, size, type, GL_FALSE, stride, offset  );
+   //    (para matrices, cada columna va en un índice de atributo, con las columnas entrelazadas)
+   if ( num_cols == 1 )
+      glVertexAttribPointer( index, size, type, normalizado, stride, offset  );
+   else 
+   {
+      const GLsizeiptr tam_col = tuple_size_in_bytes( type, size );
+      for( GLuint c = 0 ; c < num_cols ; c++ )
+         glVertexAttribPointer( index+c, size, type, GL_FALSE, num_cols*tam_col, (void *)(c*tam_col) );
+   }
 
-   // 5. desactivar el buffer
+   // 5. si es una tabla por instancia, fijar el divisor de cada columna
+   if ( divisor > 0 )
+      for( GLuint c = 0 ; c < num_cols ; c++ )
+         glVertexAttribDivisor( index+c, divisor );
+
+   // 6. desactivar el buffer
    glBindBuffer( GL_ARRAY_BUFFER, 0 );
 
-   // 6. por defecto, habilita el uso de esta tabla de atributos
-   glEnableVertexAttribArray( index );
+   // 7. por defecto, habilita el uso de esta tabla de atributos
+   for( GLuint c = 0 ; c < num_cols ; c++ )
+      glEnableVertexAttribArray( index+c );
   
 
    // comprobar que no ha habido error durante la creación del VBO
@@ -189,9 +350,7 @@ void DescrVBOAtribs::crearVBO()
 
 DescrVBOAtribs::~DescrVBOAtribs()
 {
-   delete [] (unsigned char *) own_data ;
-   own_data = nullptr ; // probablemente innecesario
-   
+   // los datos en la CPU (si quedan) los libera 'datos_cpu'
    if ( buffer != 0 )
    {
       CError();
@@ -245,23 +404,56 @@ DescrVBOInds::DescrVBOInds( const std::vector<glm::uvec3> & src_vec )
 }
 // ------------------------------------------------------------------------------------------------------
 
+DescrVBOInds::DescrVBOInds( std::vector<unsigned> && src_vec )
+{
+   type     = GL_UNSIGNED_INT ;
+   count    = src_vec.size() ;
+   tot_size = count*size_in_bytes( type ) ;
+
+   datos_cpu = MoverAMemoriaDinamica( std::move( src_vec ), own_indices );
+   indices   = own_indices ;
+   comprobar();
+}
+// ------------------------------------------------------------------------------------------------------
+
+DescrVBOInds::DescrVBOInds( std::vector<glm::uvec3> && src_vec )
+{
+   type     = GL_UNSIGNED_INT ;
+   count    = 3*src_vec.size() ;
+   tot_size = count*size_in_bytes( type ) ;
+
+   datos_cpu = MoverAMemoriaDinamica( std::move( src_vec ), own_indices );
+   indices   = own_indices ;
+   comprobar();
+}
+// ------------------------------------------------------------------------------------------------------
+
 void DescrVBOInds::copyIndices()
 {
    assert( indices != nullptr );     // 'indices' debe apuntar a los indices originales
    assert( 0 < tot_size );           // 'tot_size' debe tener el tamaño total de los datos
    assert( own_indices == nullptr ); // impide copiar los datos dos veces 
 
-   own_indices = new unsigned char [tot_size] ;    // reservar memoria
-   assert( own_indices != nullptr );               // comprobar que se ha podido reservar
-   std::memcpy( own_indices, indices, tot_size );  // copiar bytes
-   indices = own_indices ;                         // apuntar a los índices propios
+   const unsigned char * origen = (const unsigned char *) indices ;
+   std::vector<unsigned char> copia( origen, origen + tot_size );         // copiar bytes
+   datos_cpu = MoverAMemoriaDinamica( std::move( copia ), own_indices );  // pasar a ser el propietario
+   indices = own_indices ;                                                // apuntar a los índices propios
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVBOInds::liberarDatosCPU()
+{
+   datos_cpu.reset();
+   indices         = nullptr ;
+   own_indices     = nullptr ;
+   datos_liberados = true ;
 }
 
 // ------------------------------------------------------------------------------------------------------
 
 void DescrVBOInds::comprobar() const 
 {
-   assert( indices != nullptr ); 
+   assert( indices != nullptr || datos_liberados ); 
    check_indices_type( type );
    assert( 0 < count );
    assert( type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_SHORT || type == GL_UNSIGNED_INT  );
@@ -274,6 +466,7 @@ void DescrVBOInds::crearVBO( )
    // comprobar precondiciones:
    CError(); // comprobar y limpiar errores previos de OpenGL
    assert( buffer == 0 );                 // impedir que se llame más de una vez para este objeto
+   assert( indices != nullptr );          // los índices deben estar todavía en la CPU
    comprobar();                           // comprobar que este objeto está en un estado correcto
 
    // Crear el VBO en la GPU y transferir los datos
@@ -286,6 +479,7 @@ void DescrVBOInds::crearVBO( )
 
    // 3. transferir los datos desde la memoria de la aplicación al VBO en GPU
    glBufferData( GL_ELEMENT_ARRAY_BUFFER, tot_size, indices, GL_STATIC_DRAW ); 
+   DescrVAO::contadores.bytes_subidos += tot_size ;
       
    // comprueba que no ha habido error al crear el VBO 
    CError();
@@ -294,9 +488,7 @@ void DescrVBOInds::crearVBO( )
 
 DescrVBOInds::~DescrVBOInds()
 {
-   delete [] (unsigned char *) own_indices ;
-   own_indices = nullptr ; // probablemente innecesario
-
+   // los índices en la CPU (si quedan) los libera 'datos_cpu'
    if ( buffer != 0 )
    {
       CError();
@@ -326,19 +518,202 @@ void TablasDatosVAO::comprobar() const
    assert( triangulos.size() == 0 || indices.size() == 0 );
 }
 
+// ******************************************************************************************************
+// DisposicionVAO 
+// ------------------------------------------------------------------------------------------------------
+
+std::string NombreDisposicion( const DisposicionVAO disposicion )
+{
+   switch( disposicion )
+   {
+      case DisposicionVAO::separada    : return "separada" ;
+      case DisposicionVAO::entrelazada : return "entrelazada" ;
+      default                          : return "pos-separada" ;
+   }
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool LeerDisposicion( const std::string & nombre, DisposicionVAO & disposicion )
+{
+   for( const DisposicionVAO d : { DisposicionVAO::separada, DisposicionVAO::entrelazada, 
+                                   DisposicionVAO::entrelazada_pos_separada } )
+      if ( nombre == NombreDisposicion( d ) )
+      {  disposicion = d ;
+         return true ;
+      }
+   return false ;
+}
+
+// ******************************************************************************************************
+// CuantizacionVAO 
+// ------------------------------------------------------------------------------------------------------
+
+std::string NombreCuantizacion( const CuantizacionVAO & cuantizacion )
+{
+   std::string nombre ;
+   for( const auto & [usada, nombre_tabla] : { std::pair{ cuantizacion.posiciones, "pos" }, { cuantizacion.normales,   "nor" }, 
+                                               { cuantizacion.colores,    "col" }, { cuantizacion.coord_text, "ct" }, 
+                                               { cuantizacion.indices,    "ind" } } )
+      if ( usada )
+         nombre += ( nombre.empty() ? "" : "," ) + std::string( nombre_tabla );
+   return nombre.empty() ? "ninguna" : nombre ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+bool LeerCuantizacion( const std::string & lista, CuantizacionVAO & cuantizacion )
+{
+   cuantizacion = CuantizacionVAO{ .posiciones = false, .normales = false, .colores = false, 
+                                   .coord_text = false, .indices = true };
+   std::size_t inicio = 0 ;
+   while( inicio <= lista.size() )
+   {
+      const std::size_t fin    = std::min( lista.find( ',', inicio ), lista.size() );
+      const std::string nombre = lista.substr( inicio, fin-inicio );
+      if ( nombre == "pos" )      cuantizacion.posiciones = true ;
+      else if ( nombre == "nor" ) cuantizacion.normales   = true ;
+      else if ( nombre == "col" ) cuantizacion.colores    = true ;
+      else if ( nombre == "ct" )  cuantizacion.coord_text = true ;
+      else if ( nombre != "ind" ) return false ;
+      inicio = fin+1 ;
+   }
+   return true ;
+}
+
 // ******************************************************************************************************
 // Clase DescrVAO
 // ------------------------------------------------------------------------------------------------------
 
-DescrVAO::DescrVAO( const TablasDatosVAO & tablas ) 
+DisposicionVAO  DescrVAO::disposicion_defecto  = DisposicionVAO::separada ;
+CuantizacionVAO DescrVAO::cuantizacion_defecto = CuantizacionVAO{} ;
+bool            DescrVAO::usar_almacen_defecto = false ;
+
+// ------------------------------------------------------------------------------------------------------
+// Crea el VBO de posiciones 3D cuantizadas: cada coordenada es un entero de 16 bits con signo, relativo 
+// al centro de la caja englobante (se añade una cuarta coordenada a cero, así cada tupla ocupa 8 bytes 
+// y queda alineada). Escribe en 'escala' y 'despl' los parámetros para decodificarlas.
+
+DescrVBOAtribs * CrearVBOPosicionesCuantizadas( const std::vector<glm::vec3> & posiciones, 
+                                                glm::vec3 & escala, glm::vec3 & despl )
+{
+   using namespace glm ;
+   constexpr float max_short = 32767.0f ;
+   assert( posiciones.size() > 0 );
+
+   // calcular la caja englobante, su centro y la escala en cada eje
+   vec3 pmin = posiciones[0], 
+        pmax = posiciones[0] ;
+   for( const vec3 & p : posiciones )
+   {  pmin = min( pmin, p );
+      pmax = max( pmax, p );
+   }
+   const vec3 semilado = 0.5f*( pmax - pmin );
+   despl = 0.5f*( pmin + pmax );
+   for( unsigned k = 0 ; k < 3 ; k++ )
+      escala[k] = semilado[k] > 0.0f ? semilado[k]/max_short : 1.0f ;
+
+   // codificar las coordenadas
+   std::vector<GLshort> valores( 4*posiciones.size(), 0 );
+   for( size_t iv = 0 ; iv < posiciones.size() ; iv++ )
+      for( unsigned k = 0 ; k < 3 ; k++ )
+         valores[4*iv+k] = GLshort( clamp( std::round( (posiciones[iv][k]-despl[k])/escala[k] ), -max_short, max_short ) );
+
+   return new DescrVBOAtribs( ind_atrib_posiciones, GL_SHORT, 4, posiciones.size(), valores.data() );
+}
+// ------------------------------------------------------------------------------------------------------
+// Crea el VBO de normales en formato empaquetado 10_10_10_2 con signo (normalizado: la GPU 
+// obtiene valores en [-1,1], el vertex shader los lee igual que si fuesen flotantes)
+
+DescrVBOAtribs * CrearVBONormalesCuantizadas( const std::vector<glm::vec3> & normales )
+{
+   using namespace glm ;
+   std::vector<GLuint> valores( normales.size() );
+   for( size_t iv = 0 ; iv < normales.size() ; iv++ )
+   {
+      const float l = length( normales[iv] );
+      valores[iv] = packSnorm3x10_1x2( vec4( l > 0.0f ? normales[iv]/l : normales[iv], 0.0f ));
+   }
+   DescrVBOAtribs * dvbo = new DescrVBOAtribs( ind_atrib_normales, GL_INT_2_10_10_10_REV, 4, 
+                                               normales.size(), valores.data() );
+   dvbo->fijarNormalizado( true );
+   return dvbo ;
+}
+// ------------------------------------------------------------------------------------------------------
+// Crea el VBO de colores con un byte sin signo por componente (normalizado, se añade 
+// la componente alfa a 1 para que cada tupla ocupe 4 bytes)
+
+DescrVBOAtribs * CrearVBOColoresCuantizados( const std::vector<glm::vec3> & colores )
+{
+   using namespace glm ;
+   std::vector<GLuint> valores( colores.size() );
+   for( size_t iv = 0 ; iv < colores.size() ; iv++ )
+      valores[iv] = packUnorm4x8( vec4( colores[iv], 1.0f ));  // primera componente en el byte menos significativo
+
+   DescrVBOAtribs * dvbo = new DescrVBOAtribs( ind_atrib_colores, GL_UNSIGNED_BYTE, 4, 
+                                               colores.size(), valores.data() );
+   dvbo->fijarNormalizado( true );
+   return dvbo ;
+}
+// ------------------------------------------------------------------------------------------------------
+// Crea el VBO de coordenadas de textura con flotantes de 16 bits ('half float')
+
+DescrVBOAtribs * CrearVBOCoordTextCuantizadas( const std::vector<glm::vec2> & coord_text )
+{
+   std::vector<GLuint> valores( coord_text.size() );
+   for( size_t iv = 0 ; iv < coord_text.size() ; iv++ )
+      valores[iv] = glm::packHalf2x16( coord_text[iv] );
+
+   return new DescrVBOAtribs( ind_atrib_coord_text, GL_HALF_FLOAT, 2, coord_text.size(), valores.data() );
+}
+// ------------------------------------------------------------------------------------------------------
+// Crea el VBO de índices con enteros de 16 bits sin signo (todos los índices deben ser menores que 65536)
+
+DescrVBOInds * CrearVBOIndices16( const unsigned * indices, const size_t num_indices )
+{
+   std::vector<GLushort> valores( num_indices );
+   for( size_t i = 0 ; i < num_indices ; i++ )
+   {
+      assert( indices[i] <= 0xFFFFu );
+      valores[i] = GLushort( indices[i] );
+   }
+   return new DescrVBOInds( GL_UNSIGNED_SHORT, num_indices, valores.data() );
+}
+
+// ------------------------------------------------------------------------------------------------------
+
+DescrVAO::DescrVAO( const TablasDatosVAO & tablas, const unsigned p_num_atribs, 
+                    const DisposicionVAO p_disposicion, const CuantizacionVAO p_cuantizacion ) 
+
+   // se copian las tablas una vez, y la copia se mueve a los descriptores de VBOs
+   : DescrVAO( TablasDatosVAO( tablas ), p_num_atribs, p_disposicion, p_cuantizacion )
+{
+}
+// ------------------------------------------------------------------------------------------------------
+
+DescrVAO::DescrVAO( TablasDatosVAO && tablas, const unsigned p_num_atribs, 
+                    const DisposicionVAO p_disposicion, const CuantizacionVAO p_cuantizacion ) 
 {
    CError();
 
    // comprobar precondiciones
    tablas.comprobar();
-
-   // registrar el número de atributos: posiciones, colores, normales, coordenadas de textura
-   num_atribs = 4 ;
+   assert( numero_atributos_cauce_3d <= p_num_atribs );
+
+   // registrar la disposición (los VBOs se crean igual, solo cambia cómo se envían a la GPU)
+   disposicion = p_disposicion ;
+
+   // decidir si se guarda en el almacén de geometría: solo con posiciones 3D, índices y sin atributos 
+   // por instancia (en el almacén todas las tablas son de flotantes y los índices de 32 bits)
+   CuantizacionVAO cuantizacion = p_cuantizacion ;
+   // (con el rasterizador por software, las tablas se quedan en los descriptores de VBOs)
+   en_almacen = usar_almacen_defecto && ! RasterizadorCPU::activo() && p_num_atribs == numero_atributos_cauce_3d && 
+                tablas.posiciones_3d.size() > 0 && 
+                ( tablas.triangulos.size() > 0 || tablas.indices.size() > 0 ) ;
+   if ( en_almacen )
+      cuantizacion = CuantizacionVAO{ .indices = false };
+
+   // registrar el número de atributos: posiciones, colores, normales, coordenadas de textura 
+   // (y quizás atributos por instancia que se añaden después)
+   num_atribs = p_num_atribs ;
 
    // crear el vector con punteros a los descriptores de VBOs (todos a null)
    dvbo_atributo.resize( num_atribs, nullptr ); 
@@ -346,10 +721,13 @@ DescrVAO::DescrVAO( const TablasDatosVAO & tablas )
    // crear el vector con los flags de habilitado/deshabilitado (todos a 'true', por defecto están habilitados)
    atrib_habilitado.resize( num_atribs, true );
 
-   // crear y agregar el VBO de posiciones (2D o 3D)
-   DescrVBOAtribs * p_dvbo_posiciones = tablas.posiciones_2d.size() > 0 ?
-                        new DescrVBOAtribs( ind_atrib_posiciones, tablas.posiciones_2d ) : 
-                        new DescrVBOAtribs( ind_atrib_posiciones, tablas.posiciones_3d ) ;
+   // crear y agregar el VBO de posiciones (2D o 3D, solo las 3D se pueden cuantizar)
+   pos_cuantizadas = cuantizacion.posiciones && tablas.posiciones_3d.size() > 0 ;
+
+   DescrVBOAtribs * p_dvbo_posiciones = 
+      tablas.posiciones_2d.size() > 0 ? new DescrVBOAtribs( ind_atrib_posiciones, std::move( tablas.posiciones_2d ) ) : 
+      pos_cuantizadas ? CrearVBOPosicionesCuantizadas( tablas.posiciones_3d, decod_pos_escala, decod_pos_despl ) :
+                        new DescrVBOAtribs( ind_atrib_posiciones, std::move( tablas.posiciones_3d ) ) ;
 
    // registrar el número de vértices en la tabla de posiciones
    count = p_dvbo_posiciones->leerCount() ;
@@ -361,22 +739,30 @@ DescrVAO::DescrVAO( const TablasDatosVAO & tablas )
 
    // Colores
    if ( tablas.colores.size() > 0 )
-      agregar( new DescrVBOAtribs( ind_atrib_colores, tablas.colores ));
+      agregar( cuantizacion.colores ? CrearVBOColoresCuantizados( tablas.colores ) 
+                                      : new DescrVBOAtribs( ind_atrib_colores, std::move( tablas.colores ) ));
 
    // Normales
    if ( tablas.normales.size() > 0 )
-      agregar( new DescrVBOAtribs( ind_atrib_normales, tablas.normales ) );
+      agregar( cuantizacion.normales ? CrearVBONormalesCuantizadas( tablas.normales ) 
+                                       : new DescrVBOAtribs( ind_atrib_normales, std::move( tablas.normales ) ) );
 
    // Coordenadas de textura
    if ( tablas.coord_text.size() > 0 )
-      agregar( new DescrVBOAtribs( ind_atrib_coord_text, tablas.coord_text ) );
+      agregar( cuantizacion.coord_text ? CrearVBOCoordTextCuantizadas( tablas.coord_text ) 
+                                         : new DescrVBOAtribs( ind_atrib_coord_text, std::move( tablas.coord_text ) ) );
+
+   // Si hay índices, crear y agregar el VBO de índices (con 16 bits si se pueden indexar todos 
+   // los vértices)
 
-   // Si hay índices, crear y agregar el VBO de índices:
+   const bool indices_16 = cuantizacion.indices && count <= 0x10000 ;
 
    if ( tablas.triangulos.size() > 0 )
-      agregar( new DescrVBOInds( tablas.triangulos ));
+      agregar( indices_16 ? CrearVBOIndices16( glm::value_ptr( tablas.triangulos[0] ), 3*tablas.triangulos.size() ) 
+                          : new DescrVBOInds( std::move( tablas.triangulos ) ));
    else if ( tablas.indices.size() > 0 )
-      agregar( new DescrVBOInds( tablas.indices ));
+      agregar( indices_16 ? CrearVBOIndices16( tablas.indices.data(), tablas.indices.size() ) 
+                          : new DescrVBOInds( std::move( tablas.indices ) ));
    
    CError();
    
@@ -411,12 +797,13 @@ DescrVAO::DescrVAO( const unsigned p_num_atribs, DescrVBOAtribs * p_dvbo_posicio
 // Comprueba que el estado del VAO es correcto justo antes de añadir una tabla de atributos con índice 'index' 
 // (aborta si no)
 //
-void DescrVAO::check( const unsigned index )
+void DescrVAO::check( const unsigned index, const unsigned num_cols )
 {
    assert( dvbo_atributo[0] != nullptr ); // el VAO ya debe tener el VBO de posiciones.
    assert( 0 < index );  // no permite el índice 0, son las posiciones y se dan al construir el VAO
-   assert( index < num_atribs ); // no permite índices fuera de rango
-   assert( dvbo_atributo[index] == nullptr ); // no permite añadir un atributo dos veces 
+   assert( index+num_cols <= num_atribs ); // no permite índices fuera de rango
+   for( unsigned c = 0 ; c < num_cols ; c++ )
+      assert( dvbo_atributo[index+c] == nullptr ); // no permite añadir un atributo dos veces 
    assert( array == 0 ); // no permite añadir atributos si el VAO ya esá alojado en la GPU
 }
 // ----------------------------------------------------------------------------
@@ -426,9 +813,17 @@ void DescrVAO::agregar( DescrVBOAtribs * p_dvbo_atributo )
    // comprobar precondiciones
    assert( p_dvbo_atributo != nullptr );
    const unsigned index = p_dvbo_atributo->leerIndex();
-   check( index );
+   check( index, p_dvbo_atributo->leerNumCols() );
    p_dvbo_atributo->comprobar();
-   assert( count == p_dvbo_atributo->leerCount() ); // debe tener el mismo núm de items que el VBO posiciones
+
+   if ( p_dvbo_atributo->leerDivisor() == 0 )
+      assert( count == p_dvbo_atributo->leerCount() ); // debe tener el mismo núm de items que el VBO posiciones
+   else 
+   {  
+      // todas las tablas por instancia deben tener el mismo número de instancias
+      assert( num_instancias == 0 || num_instancias == p_dvbo_atributo->leerCount() );
+      num_instancias = p_dvbo_atributo->leerCount();
+   }
 
    // registrar el descriptor de VBO en la tabla de descriptores de VBOs de atributos
    dvbo_atributo[index] = p_dvbo_atributo ;
@@ -477,10 +872,15 @@ void DescrVAO::crearVAO()
    glBindVertexArray( array );
 
    // crear (y habilitar) los VBOs de posiciones y atributos en este VAO 
-   dvbo_atributo[0]->crearVBO();
-   for( unsigned i = 1 ; i < num_atribs ; i++ )
-      if ( dvbo_atributo[i] != nullptr )
-         dvbo_atributo[i]->crearVBO();
+   if ( disposicion == DisposicionVAO::separada )
+   {
+      dvbo_atributo[0]->crearVBO();
+      for( unsigned i = 1 ; i < num_atribs ; i++ )
+         if ( dvbo_atributo[i] != nullptr )
+            dvbo_atributo[i]->crearVBO();
+   }
+   else 
+      crearVBOsEntrelazados();
       
    // si procede, crea el VBO de índices 
    if ( dvbo_indices != nullptr )
@@ -490,9 +890,73 @@ void DescrVAO::crearVAO()
    for( unsigned i = 1 ; i < num_atribs ; i++ )
       if ( dvbo_atributo[i] != nullptr )
          if ( ! atrib_habilitado[i] )
-            glDisableVertexAttribArray( i );
+            for( unsigned c = 0 ; c < dvbo_atributo[i]->leerNumCols() ; c++ )
+               glDisableVertexAttribArray( i+c );
   
+   // los datos ya están en la GPU, no es necesario conservarlos en la memoria de la aplicación
+   liberarDatosCPU();
+
+   CError();
+}
+// ------------------------------------------------------------------------------------------------------
+// Crea los VBOs con disposición entrelazada: las tablas por vértice de una columna se copian en 
+// un único buffer, con los atributos de cada vértice consecutivos (el VAO debe estar activado)
+
+void DescrVAO::crearVBOsEntrelazados()
+{
+   CError();
+   assert( disposicion != DisposicionVAO::separada );
+   assert( buffer_entrelazado == 0 );
+
+   // seleccionar las tablas que van en el buffer entrelazado, crear el VBO del resto
+   std::vector<DescrVBOAtribs *> entrelazados ;
+   GLsizei stride = 0 ; // tamaño en bytes de los atributos de un vértice 
+
+   for( unsigned i = 0 ; i < num_atribs ; i++ )
+   {
+      DescrVBOAtribs * dvbo = dvbo_atributo[i] ;
+      if ( dvbo == nullptr )
+         continue ;
+      const bool separar = dvbo->divisor > 0 || dvbo->num_cols > 1 || 
+                           ( i == ind_atrib_posiciones && disposicion == DisposicionVAO::entrelazada_pos_separada );
+      if ( separar )
+         dvbo->crearVBO();
+      else 
+      {  entrelazados.push_back( dvbo );
+         stride += tuple_size_in_bytes( dvbo->type, dvbo->size );
+      }
+   }
+   if ( entrelazados.size() == 0 )
+      return ;
+
+   // copiar los datos de cada vértice consecutivos (en el orden de los índices de atributo)
+   std::vector<unsigned char> datos( GLsizeiptr(stride)*count );
+   GLsizeiptr desplaz = 0 ;
+   for( DescrVBOAtribs * dvbo : entrelazados )
+   {
+      const GLsizeiptr      tam    = tuple_size_in_bytes( dvbo->type, dvbo->size );
+      const unsigned char * origen = (const unsigned char *) dvbo->data ;
+      for( GLsizei iv = 0 ; iv < count ; iv++ )
+         std::memcpy( datos.data() + iv*stride + desplaz, origen + iv*tam, tam );
+      desplaz += tam ;
+   }
+
+   // crear el buffer, enviar los datos y registrar el formato de cada atributo (mismo 'stride' 
+   // para todos, distinto desplazamiento), habilitándolos por defecto
+   glGenBuffers( 1, &buffer_entrelazado ); assert( 0 < buffer_entrelazado );
+   glBindBuffer( GL_ARRAY_BUFFER, buffer_entrelazado );
+   glBufferData( GL_ARRAY_BUFFER, datos.size(), datos.data(), GL_STATIC_DRAW );
+   tam_entrelazado = datos.size() ;
+   contadores.bytes_subidos += datos.size() ;
 
+   desplaz = 0 ;
+   for( DescrVBOAtribs * dvbo : entrelazados )
+   {
+      glVertexAttribPointer( dvbo->index, dvbo->size, dvbo->type, dvbo->normalizado, stride, (void *) desplaz );
+      glEnableVertexAttribArray( dvbo->index );
+      desplaz += tuple_size_in_bytes( dvbo->type, dvbo->size );
+   }
+   glBindBuffer( GL_ARRAY_BUFFER, 0 );
    CError();
 }
 // ------------------------------------------------------------------------------------------------------
@@ -518,10 +982,11 @@ void DescrVAO::habilitarAtrib( const unsigned index, const bool habilitar )
       CError();
       glBindVertexArray( array );
       
-      if ( habilitar ) 
-         glEnableVertexAttribArray( index );
-      else 
-         glDisableVertexAttribArray( index );
+      for( unsigned c = 0 ; c < dvbo_atributo[index]->leerNumCols() ; c++ )
+         if ( habilitar ) 
+            glEnableVertexAttribArray( index+c );
+         else 
+            glDisableVertexAttribArray( index+c );
 
       glBindVertexArray( 0 );
       CError();
@@ -530,14 +995,13 @@ void DescrVAO::habilitarAtrib( const unsigned index, const bool habilitar )
 }
 // ------------------------------------------------------------------------------------------------------
 
-void DescrVAO::draw( const GLenum mode )
+bool DescrVAO::activarParaDraw( const GLenum mode, GLenum & draw_mode )
 {
-
    CError();
    assert( dvbo_atributo[0] != nullptr ); // asegurarnos que hay una tabla de coordenadas de posición.
    check_mode( mode );                // comprobar que el modo es el correcto.
    
-   GLenum draw_mode = mode ;
+   draw_mode = mode ;
 
    // Si hay un tesselation shader preparado únicamente para triángulos, 
    // entonces únicamente se pueden visualizar triángulos, 
@@ -546,12 +1010,25 @@ void DescrVAO::draw( const GLenum mode )
    if ( SustituirTriangulosPorParches() )
    {
       if ( mode != GL_TRIANGLES )
-         return ;
+         return false ;
       draw_mode = GL_PATCHES ;
       glPatchParameteri( GL_PATCH_VERTICES, 3 );
       CError();
    }
+
+   // Si las posiciones están cuantizadas, el vertex shader debe decodificarlas (y si no, no): 
+   // el cauce solo envía los uniforms cuando cambian, así que no se desactiva al terminar
+
+   FijarDecodPosiciones( pos_cuantizadas, decod_pos_escala, decod_pos_despl );
       
+   // Si está en el almacén de geometría, no tiene VAO propio (se usa el del almacén al dibujar)
+
+   if ( en_almacen )
+   {
+      reservarRegionAlmacen();
+      return true ;
+   }
+
    // Visualizar el VAO
    
    // 1. Comprobar si el array se ha creado o no (antes de crearse, 'array' vale 0, después es >0). 
@@ -564,7 +1041,51 @@ void DescrVAO::draw( const GLenum mode )
       crearVAO();
    else 
       glBindVertexArray( array );
+   contadores.binds_vao++ ;
+   CError();
+
+   return true ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::terminarDraw()
+{
+   // desactivar el VAO (activar el VAO 0 con 'glBindVertexArray')
+   glBindVertexArray( 0 );
    CError();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::contarDibujo( const GLenum mode, const uint64_t num_vertices, const uint64_t num_instancias )
+{
+   uint64_t num_triangulos = 0 ;
+   if ( mode == GL_TRIANGLES || mode == GL_PATCHES ) // (los parches son siempre de 3 vértices)
+      num_triangulos = num_vertices/3 ;
+   else if ( ( mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN ) && num_vertices > 2 )
+      num_triangulos = num_vertices-2 ;
+
+   contadores.draws++ ;
+   contadores.vertices   += num_vertices*num_instancias ;
+   contadores.triangulos += num_triangulos*num_instancias ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::draw( const GLenum mode )
+{
+   ZONA_PERFIL_CPU( "DescrVAO::draw" );
+
+   // con el rasterizador por software, no se usa OpenGL
+   if ( RasterizadorCPU::activo() )
+   {  const GLsizei num = dvbo_indices != nullptr ? idxs_count : count ;
+      RasterizadorCPU::instancia()->dibujar( *this, mode, 0, num );
+      contarDibujo( mode, num );
+      return ;
+   }
+
+   // 0. Calcular el modo de dibujo y, si hay algo que dibujar, activar el VAO (paso 1)
+   GLenum draw_mode ;
+   if ( ! activarParaDraw( mode, draw_mode ) )
+      return ;
  
    // 2. Comprobar si la secuencia es indexada o no lo es (si no es indexada 'dvbo_indices' es nulo)
    //    Si la secuencia es indexada
@@ -573,23 +1094,189 @@ void DescrVAO::draw( const GLenum mode )
    //     - visualizar con 'glDrawArrays'
    //
   
-   if ( dvbo_indices != nullptr ) // es una secuencia indexada
-      glDrawElements( draw_mode, idxs_count, idxs_type, offset );
+   if ( en_almacen ) // está en el almacén de geometría (siempre es indexada)
+      AlmacenGeometria::instancia()->dibujar( region_almacen, draw_mode, mascaraHabilitados(), 0, idxs_count );
+   else if ( dvbo_indices != nullptr ) // es una secuencia indexada
+   {  glDrawElements( draw_mode, idxs_count, idxs_type, offset );
+      contarDibujo( draw_mode, idxs_count );
+   }
    else // no es una secuencia indexada
-      glDrawArrays( draw_mode, first, count );
+   {  glDrawArrays( draw_mode, first, count );
+      contarDibujo( draw_mode, count );
+   }
 
    CError();
    
    // 3. Desactivar el VAO (activar el VAO 0 con 'glBindVertexArray')
-   glBindVertexArray( 0 );
+   terminarDraw();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::drawInstanciado( const GLenum mode, const GLsizei p_num_instancias )
+{
+   ZONA_PERFIL_CPU( "DescrVAO::drawInstanciado" );
+   assert( 0 < num_instancias ); // debe haber al menos una tabla de atributos por instancia
+   assert( ! en_almacen );       // (por tanto no puede estar en el almacén)
+   assert( 0 <= p_num_instancias && p_num_instancias <= num_instancias );
+
+   if ( RasterizadorCPU::activo() )
+   {  const GLsizei num = dvbo_indices != nullptr ? idxs_count : count ;
+      RasterizadorCPU::instancia()->dibujar( *this, mode, 0, num, p_num_instancias );
+      contarDibujo( mode, num, p_num_instancias );
+      return ;
+   }
+
+   GLenum draw_mode ;
+   if ( ! activarParaDraw( mode, draw_mode ) )
+      return ;
+
+   // igual que en 'draw', pero dibujando todas las instancias con una sola llamada
+   if ( dvbo_indices != nullptr ) 
+      glDrawElementsInstanced( draw_mode, idxs_count, idxs_type, offset, p_num_instancias );
+   else 
+      glDrawArraysInstanced( draw_mode, first, count, p_num_instancias );
+   contarDibujo( draw_mode, dvbo_indices != nullptr ? idxs_count : count, p_num_instancias );
+   CError();
    
+   terminarDraw();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::drawRango( const GLenum mode, const GLsizei inicio, const GLsizei num )
+{
+   assert( 0 <= inicio && 0 <= num );
+   assert( inicio + num <= ( dvbo_indices != nullptr ? idxs_count : count ) );
+
+   if ( RasterizadorCPU::activo() )
+   {  RasterizadorCPU::instancia()->dibujar( *this, mode, inicio, num );
+      contarDibujo( mode, num );
+      return ;
+   }
+
+   GLenum draw_mode ;
+   if ( ! activarParaDraw( mode, draw_mode ) )
+      return ;
+
+   // igual que en 'draw', pero el rango empieza en 'inicio' (en la tabla de índices, el 
+   // desplazamiento se da en bytes)
+   if ( en_almacen )
+      AlmacenGeometria::instancia()->dibujar( region_almacen, draw_mode, mascaraHabilitados(), inicio, num );
+   else if ( dvbo_indices != nullptr ) 
+      glDrawElements( draw_mode, num, idxs_type, (void *)( inicio*size_in_bytes( idxs_type ) ) );
+   else 
+      glDrawArrays( draw_mode, first + inicio, num );
+   if ( ! en_almacen )
+      contarDibujo( draw_mode, num );
    CError();
+   
+   terminarDraw();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::reservarRegionAlmacen()
+{
+   assert( en_almacen );
+   if ( region_reservada )
+      return ;
+
+   // en el almacén las tablas son de flotantes (sin cuantizar) y los índices de 32 bits
+   auto datos = [&]( const unsigned index ) -> const void *
+   {  
+      if ( dvbo_atributo[index] == nullptr )
+         return nullptr ;
+      assert( dvbo_atributo[index]->type == GL_FLOAT );
+      return dvbo_atributo[index]->data ;
+   };
+   assert( dvbo_indices != nullptr && dvbo_indices->leerType() == GL_UNSIGNED_INT );
+
+   region_almacen = AlmacenGeometria::instancia()->reservar( count, 
+                        (const glm::vec3 *) datos( ind_atrib_posiciones ),
+                        (const glm::vec3 *) datos( ind_atrib_colores ),
+                        (const glm::vec2 *) datos( ind_atrib_coord_text ),
+                        (const glm::vec3 *) datos( ind_atrib_normales ),
+                        idxs_count, (const GLuint *) dvbo_indices->indices );
+   region_reservada = true ;
+
+   // las tablas ya están copiadas en el almacén
+   liberarDatosCPU();
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::liberarDatosCPU()
+{
+   // el rasterizador por software lee las tablas de la memoria de la aplicación en cada dibujo
+   if ( RasterizadorCPU::activo() )
+      return ;
+
+   for( DescrVBOAtribs * dvbo : dvbo_atributo )
+      if ( dvbo != nullptr && dvbo->leerDivisor() == 0 )
+         dvbo->liberarDatosCPU();
+
+   if ( dvbo_indices != nullptr )
+      dvbo_indices->liberarDatosCPU();
+}
+// ------------------------------------------------------------------------------------------------------
+
+unsigned DescrVAO::mascaraHabilitados() const
+{
+   unsigned mascara = 0 ;
+   for( unsigned i = 0 ; i < num_atribs ; i++ )
+      if ( dvbo_atributo[i] != nullptr && ( i == 0 || atrib_habilitado[i] ))
+         mascara |= 1u << i ;
+   return mascara ;
+}
+// ------------------------------------------------------------------------------------------------------
+
+void DescrVAO::agregarAlLoteAlmacen( const glm::mat4 & matriz, const bool solo_posiciones )
+{
+   assert( en_almacen );
+   reservarRegionAlmacen();
+   AlmacenGeometria::instancia()->agregarAlLote( region_almacen, matriz, 
+                                                 solo_posiciones ? 1u : mascaraHabilitados() );
+}
+// ------------------------------------------------------------------------------------------------------
+
+UsoMemoria DescrVAO::leerUsoMemoria() const 
+{
+   UsoMemoria uso ;
+
+   // tablas de atributos (las que van en el buffer entrelazado no tienen VBO propio)
+   for( const DescrVBOAtribs * dvbo : dvbo_atributo )
+      if ( dvbo != nullptr )
+      {
+         if ( dvbo->datosEnCPU() )
+            uso.cpu_tablas += dvbo->leerTotSize() ;
+         if ( dvbo->creado() )
+            uso.gpu_buffers += dvbo->leerTotSize() ;
+      }
+   uso.gpu_buffers += tam_entrelazado ;
+
+   // tabla de índices
+   if ( dvbo_indices != nullptr )
+   {
+      if ( dvbo_indices->datosEnCPU() )
+         uso.cpu_tablas += dvbo_indices->leerTotSize() ;
+      if ( dvbo_indices->creado() )
+         uso.gpu_buffers += dvbo_indices->leerTotSize() ;
+   }
+
+   // región en el almacén de geometría
+   if ( region_reservada )
+      uso.gpu_buffers += AlmacenGeometria::bytesRegion( region_almacen );
+
+   return uso ;
 }
 // ------------------------------------------------------------------------------------------------------
 
 DescrVAO::~DescrVAO()
 {
-   for( unsigned i = 1 ; i < num_atribs ; i++ )
+   if ( region_reservada )
+   {
+      AlmacenGeometria::instancia()->liberar( region_almacen );
+      region_reservada = false ;
+   }
+
+   for( unsigned i = 0 ; i < num_atribs ; i++ )
    {  
       delete dvbo_atributo[i] ;
       dvbo_atributo[i] = nullptr ; 
@@ -597,6 +1284,14 @@ DescrVAO::~DescrVAO()
    
    delete dvbo_indices ;
    dvbo_indices = nullptr ; 
+
+   if ( buffer_entrelazado != 0 )
+   {
+      CError();
+      glDeleteBuffers( 1, &buffer_entrelazado );
+      CError();
+      buffer_entrelazado = 0 ;
+   }
    
    if ( array != 0 )
    {
@@ -29,7 +29,11 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 #include "utilidades.h"
+#include "almacen-geom.h"
+#include "uso-memoria.h"
+#include "estadisticas-render.h"
 
 // --------------------------------------------------------------------------------------------
 
@@ -67,20 +71,33 @@ class DescrVBOAtribs
 
    GLuint       buffer   = 0 ; // nombre o id del buffer en la GPU (0 antes de crearlo, >0 después)
    GLuint       index    = 0 ; // índice de atributo (<num_attrs)
-   GLenum       type     = 0 ; // tipo de los valores (GL_FLOAT o GL_DOUBLE)
+   GLenum       type     = 0 ; // tipo de los valores (GL_FLOAT, GL_DOUBLE o uno de los tipos de datos cuantizados)
    GLint        size     = 0 ; // numero de valores por tupla (usualmente 2,3, o 4)
+   GLboolean    normalizado = GL_FALSE ; // GL_TRUE -> los enteros se convierten a flotantes en [0,1] o [-1,1]
    GLsizei      count    = 0 ; // número de tuplas en la tabla (>0)
-   GLsizeiptr   tot_size = 0 ; // tamaño completo de la tabla en bytes (=count*size*sizeof(c-type))
+   GLuint       num_cols = 1 ; // número de columnas (1 para vectores, 3 o 4 para matrices 'mat3' o 'mat4', que ocupan 3 o 4 índices consecutivos)
+   GLuint       divisor  = 0 ; // divisor para dibujo instanciado (0 -> un valor por vértice, 1 -> un valor por instancia)
+   GLsizeiptr   tot_size = 0 ; // tamaño completo de la tabla en bytes (=num_cols*count*size*sizeof(c-type))
    
-   const void * data     = nullptr ; // datos originales en la CPU (null antes de saberlos, no null después)
-   void *       own_data = nullptr ; // si no nulo, tiene copia de los datos (propiedad de este objeto).
+   const void * data     = nullptr ; // datos en la CPU (null antes de saberlos, o después de liberarlos)
+   void *       own_data = nullptr ; // si no nulo, apunta a los datos propios (guardados en 'datos_cpu').
+   bool         datos_liberados = false ; // true si ya se han liberado los datos en la CPU
    
+   // propietario de los datos en la CPU: una copia hecha por este objeto o un vector movido a él
+   std::shared_ptr<void> datos_cpu ;
+
    // Hace una copia de los datos de la tabla en una zona de memoria propiedad de esta 
    // instancia (copia los datos originales en 'data' en 'own_data', solo una vez).
    // 
    void copiarDatos() ; 
 
+   // Libera los datos en la CPU, una vez enviados a la GPU (no se puede hacer con las 
+   // tablas por instancia, que se actualizan con 'actualizarDatos')
+   //
+   void liberarDatosCPU() ;
+
    friend class DescrVAO ;
+   friend class RasterizadorCPU ;
 
    public:
 
@@ -93,7 +110,8 @@ class DescrVBOAtribs
    // puntero a los datos (p_data)
    // 
    // @param p_index (unsigned) índice del atributo 
-   // @param p_type  (GLenum)   tipo de los datos (GL_FLOAT o GL_DOUBLE)
+   // @param p_type  (GLenum)   tipo de los datos (GL_FLOAT, GL_DOUBLE, GL_HALF_FLOAT, GL_SHORT, GL_UNSIGNED_SHORT,
+   //                           GL_BYTE, GL_UNSIGNED_BYTE o GL_INT_2_10_10_10_REV, este último con p_size == 4)
    // @param p_size  (unsigned) tamaño de las tuplas o vectores (2, 3 o 4)
    // @param p_count (unsigned) número de tuplas (>0)
    // @param p_data  (void *)   puntero al array de tuplas (no nulo)   
@@ -117,6 +135,54 @@ class DescrVBOAtribs
    //
    DescrVBOAtribs( const unsigned p_index, const std::vector<glm::vec2> & src_vec );
 
+   // Crean un descriptor de VBO de atributos que pasa a ser el propietario de una tabla de 
+   // 'vec3' o de 'vec2' (la tabla se mueve al descriptor, sin copiar los datos, y queda vacía)
+   //
+   // @param p_index (unsigned)      índice del atributo 
+   // @param src_vec (vector<vec3/2>) vector con los datos (queda vacío)
+   //
+   DescrVBOAtribs( const unsigned p_index, std::vector<glm::vec3> && src_vec );
+   DescrVBOAtribs( const unsigned p_index, std::vector<glm::vec2> && src_vec );
+
+   // Crea un descriptor de VBO de atributos, a partir de una tabla de matrices 4x4,
+   // almacenada como un vector (std::vector) de 'mat4'. Cada matriz ocupa 4 índices de 
+   // atributo consecutivos (una columna en cada uno), empezando en 'p_index'.
+   // 
+   // @param p_index  (unsigned)     índice del atributo de la primera columna
+   // @param src_vec  (vector<mat4>) vector con los datos (solo se lee)
+   //
+   DescrVBOAtribs( const unsigned p_index, const std::vector<glm::mat4> & src_vec );
+
+   // Igual que el anterior, para una tabla de matrices 3x3 ('mat3'), que ocupan 3 índices
+   // de atributo consecutivos (por ejemplo, las matrices de las normales de las instancias)
+   // 
+   // @param p_index  (unsigned)     índice del atributo de la primera columna
+   // @param src_vec  (vector<mat3>) vector con los datos (solo se lee)
+   //
+   DescrVBOAtribs( const unsigned p_index, const std::vector<glm::mat3> & src_vec );
+
+   // Fija el divisor del atributo para dibujo instanciado (0 -> un valor por vértice, 
+   // 1 -> un valor por instancia), solo se puede llamar antes de crear el VBO
+   //
+   void fijarDivisor( const unsigned p_divisor );
+
+   // Indica si los valores enteros se deben normalizar al leerlos en el shader (a [0,1] si 
+   // son sin signo, a [-1,1] si tienen signo), solo se puede llamar antes de crear el VBO
+   //
+   void fijarNormalizado( const bool p_normalizado );
+
+   // Sustituye los datos de la tabla por otros con el mismo tamaño (se leen 'tot_size' 
+   // bytes a partir de 'p_data'). Si 'p_data' es nulo, se usan los datos propios tal como 
+   // estén (se pueden modificar antes con 'leerDatosPropios'). Si el VBO ya está creado, 
+   // se actualiza en la GPU.
+   //
+   void actualizarDatos( const void * p_data = nullptr );
+
+   // Devuelve un puntero a la copia de los datos propiedad de este objeto, para poder 
+   // modificarlos sin hacer otra copia (después se debe llamar a 'actualizarDatos()')
+   //
+   inline void * leerDatosPropios() { return own_data ; }
+
    // Comprueba que los descriptores de la tabla de datos son correctos, aborta si no
    //
    void comprobar() const;
@@ -141,6 +207,18 @@ class DescrVBOAtribs
    // Devuelve el número de vértices
    inline GLuint getCount() const { return count; }
 
+   // Devuelve el número de columnas (índices de atributo consecutivos que ocupa)
+   inline GLuint leerNumCols() const { return num_cols; }
+
+   // Devuelve el divisor (0 si es un atributo por vértice, >0 si es por instancia)
+   inline GLuint leerDivisor() const { return divisor; }
+
+   // Devuelve true si los datos siguen en la memoria de la aplicación (no se han liberado)
+   inline bool datosEnCPU() const { return data != nullptr ; }
+
+   // Devuelve el tamaño de la tabla en bytes
+   inline GLsizeiptr leerTotSize() const { return tot_size ; }
+
    // Libera la memoria ocupada por el VBO, tanto en la memoria de la aplicación, como 
    // en la memoria del buffer en la GPU (si ya se ha creado)
    //
@@ -162,14 +240,25 @@ class DescrVBOInds
    GLsizei      count    = 0 ; // número de índices en la tabla (>0)
    GLsizeiptr   tot_size = 0 ; // tamaño completo de la tabla en bytes (=count*sizeof(c-type))
    
-   const void * indices     = nullptr ; // datos originales en la CPU (null antes de saberlos, no null después)
-   void *       own_indices = nullptr ; // si no nulo, tiene copia de los datos (propiedad de este objeto).
+   const void * indices     = nullptr ; // datos en la CPU (null antes de saberlos, o después de liberarlos)
+   void *       own_indices = nullptr ; // si no nulo, apunta a los datos propios (guardados en 'datos_cpu').
+   bool         datos_liberados = false ; // true si ya se han liberado los datos en la CPU
+
+   // propietario de los datos en la CPU: una copia hecha por este objeto o un vector movido a él
+   std::shared_ptr<void> datos_cpu ;
    
    // Inicializa 'own_indices' con una copia de los datos en 'indices', y apunta 
    // 'indices' a 'own_indices'
    //
    void copyIndices() ; 
 
+   // Libera los índices en la CPU, una vez enviados a la GPU
+   //
+   void liberarDatosCPU() ;
+
+   friend class DescrVAO ;
+   friend class RasterizadorCPU ;
+
    public:
 
    // impide usar constructor por defecto (sin parámetros)
@@ -198,6 +287,12 @@ class DescrVBOInds
    // 
    DescrVBOInds( const std::vector<glm::uvec3> & src_vec );
 
+   // Crean un descriptor de VBO de índices que pasa a ser el propietario de la tabla
+   // (la tabla se mueve al descriptor, sin copiar los datos, y queda vacía)
+   //
+   DescrVBOInds( std::vector<unsigned> && src_vec );
+   DescrVBOInds( std::vector<glm::uvec3> && src_vec );
+
    // Comprueba que los metadatos son correctos, aborta si no
    void comprobar() const ;
 
@@ -210,6 +305,12 @@ class DescrVBOInds
    // Devuelve el valor de 'type' para este descriptor
    inline GLenum leerType() { return type ; }
 
+   // Devuelve true si los índices siguen en la memoria de la aplicación (no se han liberado)
+   inline bool datosEnCPU() const { return indices != nullptr ; }
+
+   // Devuelve el tamaño de la tabla en bytes
+   inline GLsizeiptr leerTotSize() const { return tot_size ; }
+
    // Crear y activar el VBO de índices, es decir:
    //   1. Crea el VBO y envía la tabla de índices a la GPU (únicamente la primera vez)
    //   2. Hace 'bind' de la tabla en el 'target' GL_ELEMENT_ARRAY_BUFFER
@@ -221,6 +322,59 @@ class DescrVBOInds
 
 } ;
 
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Disposición en los buffers de la GPU de las tablas de atributos por vértice de un VAO
+///
+/// @brief * separada: un VBO por cada tabla de atributos 
+/// @brief * entrelazada: un único VBO con todos los atributos de cada vértice consecutivos
+/// @brief * entrelazada_pos_separada: un VBO solo con las posiciones y otro entrelazado con el 
+/// @brief   resto de atributos (al visualizar solo la geometría, se leen únicamente las posiciones)
+/// @brief (las tablas por instancia y las de matrices siempre van en VBOs separados)
+///
+enum class DisposicionVAO { separada, entrelazada, entrelazada_pos_separada } ;
+
+/// @brief Devuelve el nombre de una disposición ('separada', 'entrelazada' o 'pos-separada')
+///
+std::string NombreDisposicion( const DisposicionVAO disposicion ) ;
+
+/// @brief Lee en 'disposicion' una disposición por su nombre (el de 'NombreDisposicion'), 
+/// @brief devuelve false si no se reconoce
+///
+bool LeerDisposicion( const std::string & nombre, DisposicionVAO & disposicion ) ;
+
+// --------------------------------------------------------------------------------------------
+//
+/// @brief Tablas que se codifican con menos bits al crear un VAO a partir de tablas (para reducir 
+/// @brief la memoria en la GPU y el ancho de banda al leer los vértices)
+///
+/// @brief * posiciones: enteros de 16 bits relativos a la caja englobante (solo posiciones 3D, se 
+/// @brief   decodifican en el vertex shader con la escala y el desplazamiento que guarda el VAO)
+/// @brief * normales: formato empaquetado 10_10_10_2 con signo, normalizado 
+/// @brief * colores: un byte sin signo por componente, normalizado 
+/// @brief * coord_text: flotantes de 16 bits ('half float')
+/// @brief * indices: enteros de 16 bits, si el número de vértices lo permite (no pierde precisión)
+///
+struct CuantizacionVAO
+{
+   bool posiciones = false ;
+   bool normales   = false ;
+   bool colores    = false ;
+   bool coord_text = false ;
+   bool indices    = true ;
+} ;
+
+/// @brief Devuelve los nombres de las tablas cuantizadas separados por comas ('pos', 'nor', 'col', 
+/// @brief 'ct' e 'ind'), o 'ninguna'
+///
+std::string NombreCuantizacion( const CuantizacionVAO & cuantizacion ) ;
+
+/// @brief Lee en 'cuantizacion' una lista de nombres de tablas separados por comas (los mismos que 
+/// @brief en 'NombreCuantizacion', los índices de 16 bits se usan siempre que se pueda), devuelve
+/// @brief false si algún nombre no se reconoce
+///
+bool LeerCuantizacion( const std::string & lista, CuantizacionVAO & cuantizacion ) ;
+
 // --------------------------------------------------------------------------------------------
 //
 /// @brief Guarda los datos y metadatos de los VBOs que forman un VAO
@@ -241,6 +395,9 @@ class DescrVAO
    // número de índices en la tabla de índices (si hay índices, en otro caso 0)
    GLsizei idxs_count = 0 ;
 
+   // número de instancias en las tablas de atributos por instancia (0 si no hay ninguna)
+   GLsizei num_instancias = 0 ;
+
    // si hay índices, tiene el tipo de los índices 
    GLenum idxs_type ;
 
@@ -253,22 +410,94 @@ class DescrVAO
    // array que indica si cada tabla de atributos está habilitada o deshabilitada
    std::vector<bool> atrib_habilitado ;
 
-   void check( const unsigned index ); // comprueba precondiciones antes de añadir tabla de atribs
+   // disposición de los atributos por vértice en los buffers, y buffer con los atributos 
+   // entrelazados (0 si no se usa o si no se ha creado todavía)
+   DisposicionVAO disposicion        = DisposicionVAO::separada ;
+   GLuint         buffer_entrelazado = 0 ;
+   GLsizeiptr     tam_entrelazado    = 0 ; // tamaño en bytes de 'buffer_entrelazado'
+
+   // disposición usada en el constructor a partir de tablas si no se indica otra
+   static DisposicionVAO disposicion_defecto ;
+
+   // si las posiciones están cuantizadas, parámetros para decodificarlas en el vertex shader 
+   // (posición = decod_pos_despl + decod_pos_escala*valor entero)
+   bool      pos_cuantizadas  = false ;
+   glm::vec3 decod_pos_escala = glm::vec3( 1.0f ),
+             decod_pos_despl  = glm::vec3( 0.0f );
+
+   // cuantización usada en el constructor a partir de tablas si no se indica otra
+   static CuantizacionVAO cuantizacion_defecto ;
+
+   // si está en el almacén de geometría compartido, en lugar de tener su propio VAO y buffers, 
+   // ocupa una región del almacén (se reserva y se copian las tablas la primera vez que se dibuja)
+   bool              en_almacen        = false ;
+   bool              region_reservada  = false ;
+   RegionAlmacenGeom region_almacen    ;
+
+   // true si los VAOs creados a partir de tablas se guardan en el almacén (cuando es posible)
+   static bool usar_almacen_defecto ;
+
+   // reserva la región en el almacén y copia las tablas (solo si está en el almacén)
+   void reservarRegionAlmacen();
+
+   // devuelve la máscara con las tablas de atributos habilitadas (bit 'i' para el atributo 'i')
+   unsigned mascaraHabilitados() const ;
+
+   // crea los VBOs de atributos cuando la disposición no es separada: los atributos por vértice 
+   // van en 'buffer_entrelazado' (excepto las posiciones, si se separan), el resto en su VBO
+   void crearVBOsEntrelazados();
+
+   void check( const unsigned index, const unsigned num_cols ); // comprueba precondiciones antes de añadir tabla de atribs
+
+   // libera la memoria de la aplicación con las tablas por vértice y los índices, una vez 
+   // enviados a la GPU (propia o del almacén), las tablas por instancia se conservan
+   void liberarDatosCPU();
+
+   // comprueba el modo, calcula el modo a usar (GL_PATCHES si hay teselación) y deja el VAO 
+   // activado (creándolo si es necesario), devuelve 'false' si no se debe dibujar nada
+   bool activarParaDraw( const GLenum mode, GLenum & draw_mode );
+
+   // desactiva el VAO después de dibujar
+   void terminarDraw();
+
+   // con el rasterizador por software activo, los dibujos se le pasan a él (lee las tablas en la CPU)
+   friend class RasterizadorCPU ;
 
    public:    
 
+   /// @brief contadores de dibujos, primitivas, VAOs activados y bytes enviados a los buffers
+   /// @brief (de todos los VAOs y del almacén de geometría, ver 'EstadisticasRender')
+   static inline ContadoresVAO contadores ;
+
+   /// @brief Registra en 'contadores' una llamada de dibujo con el modo, el número de vértices 
+   /// @brief (o índices) y el número de instancias dados
+   static void contarDibujo( const GLenum mode, const uint64_t num_vertices, const uint64_t num_instancias = 1 );
+
    // impide usar constructor por defecto (sin parámetros)
    DescrVAO() = delete ; 
 
 
    /// @brief Crea un descriptor de VAO, a partir de una estructura con las tablas, 
-   /// @brief fija el número de atributos a 4.
+   /// @brief fija el número de atributos a 4 (o al valor dado, si se van a añadir atributos por instancia).
    ///
-   /// @param tablas (TablasDatosVAO &) tablas de atributos e indices que se leen para crear el VAO.
+   /// @param tablas        (TablasDatosVAO &) tablas de atributos e indices que se leen para crear el VAO.
+   /// @param p_num_atribs  (unsigned)         número de atributos que puede tener este VAO (al menos 4)
+   /// @param p_disposicion (DisposicionVAO)   disposición de los atributos en los buffers 
+   /// @param p_cuantizacion (CuantizacionVAO) tablas que se codifican con menos bits
    ///
-   DescrVAO( const TablasDatosVAO & tablas ) ;
+   DescrVAO( const TablasDatosVAO & tablas, const unsigned p_num_atribs = numero_atributos_cauce_3d,
+             const DisposicionVAO p_disposicion = leerDisposicionDefecto(), 
+             const CuantizacionVAO p_cuantizacion = leerCuantizacionDefecto() ) ;
+
+   /// @brief Igual que el anterior, pero las tablas (las que no se cuantizan) se mueven a los 
+   /// @brief descriptores de VBOs en lugar de copiarse (todas quedan vacías o sin especificar)
+   ///
+   DescrVAO( TablasDatosVAO && tablas, const unsigned p_num_atribs = numero_atributos_cauce_3d,
+             const DisposicionVAO p_disposicion = leerDisposicionDefecto(), 
+             const CuantizacionVAO p_cuantizacion = leerCuantizacionDefecto() ) ;
 
    /// @brief Crea un descriptor de VAO, dando un descriptor del VBO de posiciones de vértices
+   /// @brief (usa siempre la disposición separada)
    //
    /// @param p_num_atribs     (unsigned)        número de atributos que puede tener este VAO 
    /// @param dvbo_posiciones  (DescrVBOAttrib *) puntero al descriptor del VBO de atributos (no nulo)
@@ -301,6 +530,58 @@ class DescrVAO
    ///
    void draw( const GLenum mode ) ;
 
+   /// @brief Visualiza varias instancias del VAO con una única llamada (dibujo instanciado), 
+   /// @brief los atributos con divisor >0 toman un valor distinto en cada instancia.
+   /// @param mode           (GLenum)  igual que en 'draw'
+   /// @param p_num_instancias (GLsizei) número de instancias a dibujar (como mucho el número de 
+   ///                                  tuplas de las tablas de atributos por instancia)
+   ///
+   void drawInstanciado( const GLenum mode, const GLsizei p_num_instancias ) ;
+
+   /// @brief Visualiza únicamente un rango de la secuencia (de índices si es indexada, o de vértices si no)
+   /// @param mode    (GLenum)  igual que en 'draw'
+   /// @param inicio  (GLsizei) primer índice (o vértice) del rango
+   /// @param num     (GLsizei) número de índices (o vértices) del rango
+   ///
+   void drawRango( const GLenum mode, const GLsizei inicio, const GLsizei num ) ;
+
+   /// @brief Devuelve true si el VAO tiene una tabla para el atributo 'index' (esté habilitada o no)
+   bool tieneTablaAtrib( const unsigned index ) const 
+      { return index < num_atribs && dvbo_atributo[index] != nullptr ; }
+
+   /// @brief Devuelve la memoria ocupada por las tablas que siguen en la CPU y por los buffers 
+   /// @brief en la GPU (propios, o la región que ocupa en el almacén de geometría)
+   UsoMemoria leerUsoMemoria() const ;
+
+   /// @brief Devuelve la disposición de los atributos en los buffers de este VAO
+   DisposicionVAO leerDisposicion() const { return disposicion ; }
+
+   /// @brief Lee o cambia la disposición que se usa por defecto en los VAOs creados a partir de 
+   /// @brief tablas (solo afecta a los que se creen después)
+   static DisposicionVAO leerDisposicionDefecto() { return disposicion_defecto ; }
+   static void fijarDisposicionDefecto( const DisposicionVAO nueva_disposicion ) { disposicion_defecto = nueva_disposicion ; }
+
+   /// @brief Devuelve true si este VAO ocupa una región del almacén de geometría compartido
+   bool enAlmacen() const { return en_almacen ; }
+
+   /// @brief Añade un dibujo de todo el VAO (que debe estar en el almacén) al lote actual del almacén,
+   /// @brief con la matriz de modelado 'matriz' (se compone con la del cauce al dibujar el lote), 
+   /// @brief con las tablas de atributos habilitadas o, si 'solo_posiciones' es true, solo con las posiciones
+   void agregarAlLoteAlmacen( const glm::mat4 & matriz, const bool solo_posiciones = false );
+
+   /// @brief Lee o cambia si los VAOs que se creen a partir de tablas con posiciones 3D, índices y 
+   /// @brief sin atributos por instancia se guardan en el almacén de geometría compartido
+   static bool leerUsarAlmacenDefecto() { return usar_almacen_defecto ; }
+   static void fijarUsarAlmacenDefecto( const bool nuevo_usar_almacen ) { usar_almacen_defecto = nuevo_usar_almacen ; }
+
+   /// @brief Devuelve true si las posiciones de este VAO están cuantizadas
+   bool posicionesCuantizadas() const { return pos_cuantizadas ; }
+
+   /// @brief Lee o cambia la cuantización que se usa por defecto en los VAOs creados a partir de 
+   /// @brief tablas (solo afecta a los que se creen después)
+   static CuantizacionVAO leerCuantizacionDefecto() { return cuantizacion_defecto ; }
+   static void fijarCuantizacionDefecto( const CuantizacionVAO nueva_cuantizacion ) { cuantizacion_defecto = nueva_cuantizacion ; }
+
    // ....
    ~DescrVAO();
 } ;
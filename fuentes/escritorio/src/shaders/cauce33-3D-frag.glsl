@@ -54,6 +54,8 @@ uniform vec3  u_color_luz[max_num_luces] ;      // color o intensidad de cada fu
 
 // 6. 'sampler' de textura
 uniform sampler2D u_tex ;         // al ser el primer 'sampler', está ligado a la unidad 0 de texturas
+uniform sampler2DArray u_tex_arreglo ; // arreglo de texturas, ligado a la unidad 1 (la aplicación fija el valor)
+uniform int   u_capa_text ;       // -1 --> usar 'u_tex', >= 0 --> usar esa capa de 'u_tex_arreglo'
 
 // --------------------------------------------------------------------
 // Parámetros varying ( 'in' aquí, 'out' en el vertex shader)
@@ -156,7 +158,8 @@ void main()
    // consultar color del objeto en el centro del pixel ('color_obj')
    vec4 color_obj ;
    if ( u_eval_text  ) // si hay textura:
-      color_obj = texture( u_tex, v_coord_text );  // es el color de la textura en las coordenadas de textura actuales
+      color_obj = u_capa_text < 0 ? texture( u_tex, v_coord_text )  // es el color de la textura en las coordenadas de textura actuales
+                                  : texture( u_tex_arreglo, vec3( v_coord_text, float( u_capa_text ) ) ); // (o de su capa en el arreglo)
    else  // si no hay textura:
       color_obj = v_color ; // no hacer nada, simplemente usar color de entrada
  
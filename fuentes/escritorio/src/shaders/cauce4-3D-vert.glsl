@@ -23,6 +23,10 @@ uniform mat4  u_mat_modelado ;    // matriz de modelado actual
 uniform mat4  u_mat_modelado_nor; // matriz de modelado para normales (traspuesta inversa de la anterior)
 uniform mat4  u_mat_vista ;       // matriz de vista (mundo --> camara)
 uniform mat4  u_mat_proyeccion ;  // matriz de proyeccion
+uniform bool  u_usar_instancias ; // true --> componer con la matriz de modelado de cada instancia (dibujo instanciado)
+uniform bool  u_decod_pos ;        // true --> posiciones cuantizadas (enteros), decodificar con escala y desplazamiento
+uniform vec3  u_decod_pos_escala ; // escala de las posiciones cuantizadas
+uniform vec3  u_decod_pos_despl ;  // desplazamiento de las posiciones cuantizadas (centro de la caja englobante)
 
 // 3. parámetros relativos a texturas
 uniform bool  u_eval_text ;       // false --> no evaluar texturas, true -> evaluar textura en FS, sustituye a (v_color)
@@ -53,6 +57,8 @@ layout( location = 0 ) in vec3 in_posicion_occ ;   // posición del vértice en
 layout( location = 1 ) in vec3 in_color ;          // color del vértice
 layout( location = 2 ) in vec2 in_coords_textura ; // coordenadas de textura del vértice 
 layout( location = 3 ) in vec3 in_normal_occ  ;    // normal del vértice 
+layout( location = 4 ) in mat4 in_mat_instancia ;  // matriz de modelado de la instancia (ocupa las 'locations' 4 a 7)
+layout( location = 8 ) in mat3 in_mat_nor_instancia ; // matriz de las normales de la instancia (ocupa las 'locations' 8 a 10)
 
 //
 // Valores calculados como salida ('out' aquí, 'in' en el fragment shader, distintos de cada vértice)
@@ -68,6 +74,13 @@ out vec3 v1_vec_obs_ecc ; // vector hacia el observador (en coords de cámara)
 // ------------------------------------------------------------------------------
 // calculo de los parámetros de salida (io_... y gl_Position)
 
+vec3 PosicionOcc() // posición del vértice en coords. de objeto (decodificada si está cuantizada)
+{
+   if ( u_decod_pos )
+      return u_decod_pos_despl + u_decod_pos_escala*in_posicion_occ ;
+   return in_posicion_occ ;
+}
+
 vec2 CoordsTextura( vec4 pos_ecc ) // calcula las coordenadas de textura
 {
    if ( ! u_eval_text )            // si no se están evaluando las coordenadas de textura
@@ -77,7 +90,7 @@ vec2 CoordsTextura( vec4 pos_ecc ) // calcula las coordenadas de textura
 
    vec4 pos_ver ;
    if ( u_tipo_gct == 1 )         // generacion en coordenadas de objeto
-      pos_ver = vec4( in_posicion_occ, 1.0 ) ;        //    usar las coords originales (objeto)
+      pos_ver = vec4( PosicionOcc(), 1.0 ) ;          //    usar las coords originales (objeto)
    else                           // generacion en coords de cámara
       pos_ver = pos_ecc ;         //    usar las coordenadas de cámara
 
@@ -107,8 +120,17 @@ vec3 VectorObservadorVS( vec4 pos_ecc )
 
 void main()
 {
-   vec4 posic_wcc  = u_mat_modelado * vec4( in_posicion_occ, 1.0 ) ; // posición del vértice en coords. de mundo
-   vec3 normal_wcc = (u_mat_modelado_nor * vec4(in_normal_occ,0)).xyz ;
+   // en dibujo instanciado, pasar posición y normal a las coordenadas del objeto que se instancia
+   vec3 posicion_occ = PosicionOcc() ;
+   vec3 normal_occ   = in_normal_occ ;
+   if ( u_usar_instancias )
+   {
+      posicion_occ = (in_mat_instancia * vec4( posicion_occ, 1.0 )).xyz ;
+      normal_occ   = in_mat_nor_instancia * in_normal_occ ;
+   }
+
+   vec4 posic_wcc  = u_mat_modelado * vec4( posicion_occ, 1.0 ) ; // posición del vértice en coords. de mundo
+   vec3 normal_wcc = (u_mat_modelado_nor * vec4(normal_occ,0)).xyz ;
 
    
    vec4 posic_ecc  = u_mat_vista*posic_wcc ; // posición en coordenadas de vista 